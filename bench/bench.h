@@ -0,0 +1,105 @@
+//
+// Minimal microbenchmark harness. Results are printed as a table and written as JSON
+// so runs can be compared between commits.
+//
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/**
+ * Passed to every benchmark. Setup goes before the loop; only the loop is timed:
+ *
+ *     void BM_Something(BenchmarkState& state) {
+ *         auto data = MakeData(state.Size());
+ *         for (auto _ : state) {
+ *             DoNotOptimize(Process(data));
+ *         }
+ *         state.SetItemsProcessed(state.Size());
+ *     }
+ */
+class BenchmarkState {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    BenchmarkState(size_t size, uint64_t iterations) : mSize(size), mIterations(iterations) {}
+
+    size_t Size() const { return mSize; }
+    uint64_t Iterations() const { return mIterations; }
+
+    // Work items per iteration, used to report time per item (defaults to 1)
+    void SetItemsProcessed(size_t items) { mItemsPerIteration = items; }
+    size_t ItemsPerIteration() const { return mItemsPerIteration; }
+
+    double ElapsedNs() const { return std::chrono::duration<double, std::nano>(mStop - mStart).count(); }
+
+    // What the loop variable holds; it is never used
+    struct Value {
+        ~Value() {}
+    };
+
+    struct Iterator {
+        BenchmarkState* mState;
+        uint64_t mRemaining;
+
+        bool operator!=(const Iterator&) {
+            if (mRemaining != 0) { return true; }
+            mState->mStop = Clock::now();
+            return false;
+        }
+        void operator++() { --mRemaining; }
+        Value operator*() const { return Value{}; }
+    };
+
+    Iterator begin() {
+        mStart = Clock::now();
+        return Iterator{this, mIterations};
+    }
+    Iterator end() { return Iterator{this, 0}; }
+
+private:
+    size_t mSize;
+    uint64_t mIterations;
+    size_t mItemsPerIteration{1};
+    Clock::time_point mStart{};
+    Clock::time_point mStop{};
+};
+
+using BenchmarkFunction = void (*)(BenchmarkState&);
+
+struct Benchmark {
+    std::string mName;
+    BenchmarkFunction mFunction;
+    std::vector<size_t> mSizes;
+};
+
+std::vector<Benchmark>& Benchmarks();
+
+struct BenchmarkRegistrar {
+    BenchmarkRegistrar(const char* name, BenchmarkFunction function, std::vector<size_t> sizes) {
+        Benchmarks().push_back(Benchmark{name, function, std::move(sizes)});
+    }
+};
+
+// Register a benchmark to run once per listed data size
+#define BENCHMARK(function, ...) \
+    static BenchmarkRegistrar function##Registrar{#function, function, {__VA_ARGS__}}
+
+// Keep the compiler from optimizing away a result or the work that produced it
+template <class T>
+inline void DoNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+inline void ClobberMemory() {
+    asm volatile("" : : : "memory");
+}
+
+
+#endif //BENCH_H
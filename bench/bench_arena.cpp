@@ -0,0 +1,69 @@
+//
+// Transient containers: frame arena against the general heap.
+//
+
+#include "bench.h"
+
+#include <unordered_map>
+#include <vector>
+
+#include "frame_arena.h"
+
+// A per-frame list built, used and thrown away, the way chunk lists and sort keys are
+static void BM_HeapVector(BenchmarkState& state) {
+    for (auto _ : state) {
+        std::vector<uint64_t> keys;
+        keys.reserve(state.Size());
+        for (size_t i = 0; i < state.Size(); ++i) {
+            keys.push_back(i * 2654435761u);
+        }
+        DoNotOptimize(keys.data());
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_HeapVector, 64, 4096, 65536);
+
+static void BM_ArenaVector(BenchmarkState& state) {
+    LinearArena arena;
+    for (auto _ : state) {
+        arena.Reset();
+        ArenaVector<uint64_t> keys{ArenaAllocator<uint64_t>(&arena)};
+        keys.reserve(state.Size());
+        for (size_t i = 0; i < state.Size(); ++i) {
+            keys.push_back(i * 2654435761u);
+        }
+        DoNotOptimize(keys.data());
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_ArenaVector, 64, 4096, 65536);
+
+// Node-based maps allocate per insert, which is where an arena helps most
+static void BM_HeapHashMap(BenchmarkState& state) {
+    for (auto _ : state) {
+        std::unordered_map<uint32_t, uint32_t> map;
+        map.reserve(state.Size());
+        for (size_t i = 0; i < state.Size(); ++i) {
+            map.emplace(static_cast<uint32_t>(i * 2654435761u), static_cast<uint32_t>(i));
+        }
+        DoNotOptimize(map.size());
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_HeapHashMap, 64, 4096, 65536);
+
+static void BM_ArenaHashMap(BenchmarkState& state) {
+    LinearArena arena;
+    for (auto _ : state) {
+        arena.Reset();
+        ArenaHashMap<uint32_t, uint32_t> map{0, std::hash<uint32_t>{}, std::equal_to<uint32_t>{},
+                                             ArenaAllocator<std::pair<const uint32_t, uint32_t>>(&arena)};
+        map.reserve(state.Size());
+        for (size_t i = 0; i < state.Size(); ++i) {
+            map.emplace(static_cast<uint32_t>(i * 2654435761u), static_cast<uint32_t>(i));
+        }
+        DoNotOptimize(map.size());
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_ArenaHashMap, 64, 4096, 65536);
@@ -0,0 +1,96 @@
+//
+// Camera math as it is used per frame and per draw.
+//
+
+#include "bench.h"
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "camera.h"
+
+static std::vector<Camera> MakeCameras(size_t count) {
+    std::vector<Camera> cameras(count);
+    for (size_t i = 0; i < count; ++i) {
+        cameras[i].SetProjectionMatrix(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 10.0f);
+        cameras[i].MoveForward(static_cast<float>(i) * 0.01f);
+        cameras[i].Interpolate(1.0f);
+    }
+    return cameras;
+}
+
+// View matrix of many independent cameras
+static void BM_CameraGetViewMatrix(BenchmarkState& state) {
+    const std::vector<Camera> cameras{MakeCameras(state.Size())};
+    for (auto _ : state) {
+        for (const Camera& camera : cameras) {
+            DoNotOptimize(camera.GetViewMatrix());
+        }
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_CameraGetViewMatrix, 1, 64, 4096);
+
+// One camera, view and projection fetched again for every draw; served from the cache
+static void BM_CameraMatricesPerDraw(BenchmarkState& state) {
+    const std::vector<Camera> cameras{MakeCameras(1)};
+    const Camera& camera{cameras.front()};
+    for (auto _ : state) {
+        for (size_t draw = 0; draw < state.Size(); ++draw) {
+            DoNotOptimize(camera.GetViewMatrix());
+            DoNotOptimize(camera.GetProjectionMatrix());
+        }
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_CameraMatricesPerDraw, 2, 1024, 65536);
+
+// A camera that moves every frame: each fetch rebuilds the view and view-projection
+static void BM_CameraRecomputeMatrices(BenchmarkState& state) {
+    std::vector<Camera> cameras{MakeCameras(state.Size())};
+    float alpha{0.0f};
+    for (auto _ : state) {
+        alpha = alpha > 0.5f ? 0.25f : 0.75f;
+        for (Camera& camera : cameras) {
+            camera.MoveForward(0.001f);
+            camera.Interpolate(alpha);
+            DoNotOptimize(camera.GetViewProjectionMatrix());
+        }
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_CameraRecomputeMatrices, 1, 64, 4096);
+
+// Mouse motion events fed to a single camera
+static void BM_CameraMouseLook(BenchmarkState& state) {
+    std::vector<Camera> cameras{MakeCameras(1)};
+    Camera& camera{cameras.front()};
+    int mouseX{0};
+    for (auto _ : state) {
+        for (size_t event = 0; event < state.Size(); ++event) {
+            mouseX += (event & 1) ? 3 : -2;
+            camera.MouseLook(mouseX, 240);
+        }
+        ClobberMemory();
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_CameraMouseLook, 1, 64, 4096);
+
+// Fixed-step movement as done in Simulate
+static void BM_CameraMovement(BenchmarkState& state) {
+    std::vector<Camera> cameras{MakeCameras(1)};
+    Camera& camera{cameras.front()};
+    for (auto _ : state) {
+        for (size_t step = 0; step < state.Size(); ++step) {
+            camera.StoreState();
+            camera.MoveForward(0.001f);
+            camera.MoveLeft(0.001f);
+            camera.MoveBackward(0.001f);
+            camera.MoveRight(0.001f);
+        }
+        ClobberMemory();
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_CameraMovement, 1, 64, 4096);
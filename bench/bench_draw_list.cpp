@@ -0,0 +1,111 @@
+//
+// Culling, draw recording and draw sorting.
+//
+
+#include "bench.h"
+
+#include <random>
+#include <thread>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "components.h"
+#include "draw_list.h"
+#include "ecs.h"
+#include "frustum.h"
+#include "job_system.h"
+
+/**
+ * Objects spread around the camera so roughly half of them are visible, with a
+ * handful of pipelines and meshes like a generated scene.
+ */
+static void MakeSceneObjects(World* world, size_t count) {
+    std::mt19937 random{42};
+    std::uniform_real_distribution<float> lateral{-8.0f, 8.0f};
+    std::uniform_real_distribution<float> depth{-10.0f, 2.0f};
+
+    for (size_t i = 0; i < count; ++i) {
+        LocalTransform transform;
+        transform.mPosition = Transform{lateral(random), lateral(random) * 0.75f, depth(random)};
+        transform.mScale = 0.25f;
+        MeshInstance instance;
+        instance.mPipeline = static_cast<GLuint>(1 + random() % 8);
+        instance.mVertexArray = static_cast<GLuint>(1 + random() % 4);
+        instance.mIndexCount = 6;
+        world->Create(transform, WorldMatrix{MakeModelMatrix(transform)}, instance);
+    }
+}
+
+static Frustum MakeFrustum() {
+    const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 10.0f);
+    const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    return FrustumFromMatrix(projection * view);
+}
+
+// Frustum culling and command recording on one thread
+static void BM_RecordMeshDraws(BenchmarkState& state) {
+    World world;
+    MakeSceneObjects(&world, state.Size());
+    Query query{Query::With<WorldMatrix, MeshInstance>()};
+    const Frustum frustum{MakeFrustum()};
+    CommandList list;
+    for (auto _ : state) {
+        list.Reset();
+        world.ForEachChunk(query, [&](const ChunkView& chunk) {
+            RecordMeshDraws(&list, chunk.Column<WorldMatrix>(), chunk.Column<MeshInstance>(), chunk.Count(), frustum);
+        });
+        DoNotOptimize(list.Commands().size());
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_RecordMeshDraws, 1024, 65536, 1048576);
+
+// The same work split over all cores, as RenderScene does it
+static void BM_RecordMeshDrawsParallel(BenchmarkState& state) {
+    World world;
+    MakeSceneObjects(&world, state.Size());
+    Query query{Query::With<WorldMatrix, MeshInstance>()};
+    const Frustum frustum{MakeFrustum()};
+
+    JobSystem jobs;
+    jobs.Start(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+    std::vector<CommandList> lists(jobs.ThreadCount());
+
+    for (auto _ : state) {
+        for (CommandList& list : lists) {
+            list.Reset();
+        }
+        world.ParallelForEachChunk(query, jobs, 16, [&](const ChunkView& chunk, size_t thread) {
+            RecordMeshDraws(&lists[thread], chunk.Column<WorldMatrix>(), chunk.Column<MeshInstance>(),
+                            chunk.Count(), frustum);
+        });
+        ClobberMemory();
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_RecordMeshDrawsParallel, 1024, 65536, 1048576);
+
+// Merging per-thread lists and sorting by state key before submission
+static void BM_MergeDrawLists(BenchmarkState& state) {
+    World world;
+    MakeSceneObjects(&world, state.Size());
+    Query query{Query::With<WorldMatrix, MeshInstance>()};
+    const Frustum frustum{MakeFrustum()};
+
+    // Record into 8 lists as if from 8 threads
+    std::vector<CommandList> lists(8);
+    size_t next = 0;
+    world.ForEachChunk(query, [&](const ChunkView& chunk) {
+        RecordMeshDraws(&lists[next++ % lists.size()], chunk.Column<WorldMatrix>(), chunk.Column<MeshInstance>(),
+                        chunk.Count(), frustum);
+    });
+
+    DrawQueue queue;
+    for (auto _ : state) {
+        queue.Merge(lists);
+        DoNotOptimize(queue.LastDrawCount());
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_MergeDrawLists, 1024, 65536, 1048576);
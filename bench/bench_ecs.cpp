@@ -0,0 +1,105 @@
+//
+// Entity storage: creating entities, iterating chunks, and the pointer-chasing
+// layout it replaced.
+//
+
+#include "bench.h"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "components.h"
+#include "ecs.h"
+#include "systems.h"
+
+static void BM_WorldCreate(BenchmarkState& state) {
+    for (auto _ : state) {
+        World world;
+        for (size_t i = 0; i < state.Size(); ++i) {
+            world.Create(LocalTransform{}, PreviousTransform{}, WorldMatrix{}, MeshInstance{});
+        }
+        DoNotOptimize(world.EntityCount());
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_WorldCreate, 1024, 65536);
+
+// Interpolated model matrices streamed from chunk arrays
+static void BM_TransformChunks(BenchmarkState& state) {
+    World world;
+    for (size_t i = 0; i < state.Size(); ++i) {
+        const LocalTransform transform{Transform{static_cast<float>(i % 100), 0.0f, -5.0f}, 1.0f, 0.5f};
+        world.Create(transform, PreviousTransform{transform.mPosition, 0.0f}, WorldMatrix{}, MeshInstance{});
+    }
+    Query query{Query::With<LocalTransform, PreviousTransform, WorldMatrix>()};
+
+    for (auto _ : state) {
+        world.ForEachChunk(query, [](const ChunkView& chunk) {
+            const LocalTransform* current = chunk.Column<LocalTransform>();
+            const PreviousTransform* previous = chunk.Column<PreviousTransform>();
+            WorldMatrix* matrices = chunk.Column<WorldMatrix>();
+            for (size_t i = 0; i < chunk.Count(); ++i) {
+                matrices[i].mMatrix = MakeModelMatrix(previous[i], current[i], 0.5f);
+            }
+        });
+        ClobberMemory();
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_TransformChunks, 1024, 65536, 1048576);
+
+// The same work over separately allocated objects reached through a pointer list,
+// the way the scene used to be stored
+static void BM_TransformPointers(BenchmarkState& state) {
+    struct Object {
+        unsigned mVertexArray;
+        int mIndexCount;
+        unsigned mPipeline;
+        LocalTransform mTransform;
+        PreviousTransform mPrevious;
+        glm::mat4 mMatrix;
+    };
+
+    std::vector<std::unique_ptr<Object>> storage;
+    std::vector<Object*> objects;
+    for (size_t i = 0; i < state.Size(); ++i) {
+        storage.push_back(std::make_unique<Object>());
+        storage.back()->mTransform = LocalTransform{Transform{static_cast<float>(i % 100), 0.0f, -5.0f}, 1.0f, 0.5f};
+        objects.push_back(storage.back().get());
+    }
+    std::shuffle(objects.begin(), objects.end(), std::mt19937{7});
+
+    for (auto _ : state) {
+        for (Object* object : objects) {
+            object->mMatrix = MakeModelMatrix(object->mPrevious, object->mTransform, 0.5f);
+        }
+        ClobberMemory();
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_TransformPointers, 1024, 65536, 1048576);
+
+// Deferred structural changes: tag half the entities and remove the tag again
+static void BM_CommandBufferPlayback(BenchmarkState& state) {
+    World world;
+    std::vector<Entity> entities;
+    for (size_t i = 0; i < state.Size(); ++i) {
+        entities.push_back(world.Create(LocalTransform{}, WorldMatrix{}, MeshInstance{}));
+    }
+
+    CommandBuffer commands;
+    for (auto _ : state) {
+        for (size_t i = 0; i < entities.size(); i += 2) {
+            commands.Add(entities[i], Spin{90.0f});
+        }
+        world.Playback(commands);
+        for (size_t i = 0; i < entities.size(); i += 2) {
+            commands.Remove<Spin>(entities[i]);
+        }
+        world.Playback(commands);
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_CommandBufferPlayback, 1024, 65536);
@@ -0,0 +1,101 @@
+//
+// Job system scaling and overhead.
+//
+// The size of the scaling benchmarks is the thread count (main thread included),
+// with a fixed amount of work, so items/s shows how well each extra thread pays off.
+//
+
+#include "bench.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "components.h"
+#include "draw_list.h"
+#include "ecs.h"
+#include "frustum.h"
+#include "job_system.h"
+
+static constexpr size_t kScalingItems{1 << 20};
+
+// Pure arithmetic per item, so the result is limited by the scheduler rather than memory
+static void BM_JobParallelForScaling(BenchmarkState& state) {
+    JobSystem jobs;
+    jobs.Start(state.Size() - 1);
+    std::vector<float> values(kScalingItems, 1.0f);
+
+    for (auto _ : state) {
+        jobs.ParallelFor(values.size(), 4096, [&](size_t begin, size_t end, size_t) {
+            for (size_t i = begin; i < end; ++i) {
+                values[i] = std::sqrt(values[i] * 1.0001f + 0.5f);
+            }
+        });
+        ClobberMemory();
+    }
+    state.SetItemsProcessed(kScalingItems);
+}
+BENCHMARK(BM_JobParallelForScaling, 1, 2, 4, 8, 16);
+
+// Culling and draw recording over a 1M object scene, as RenderScene runs it
+static void BM_JobRecordDrawsScaling(BenchmarkState& state) {
+    JobSystem jobs;
+    jobs.Start(state.Size() - 1);
+
+    std::mt19937 random{42};
+    std::uniform_real_distribution<float> lateral{-8.0f, 8.0f};
+    std::uniform_real_distribution<float> depth{-10.0f, 2.0f};
+    World world;
+    for (size_t i = 0; i < kScalingItems; ++i) {
+        LocalTransform transform;
+        transform.mPosition = Transform{lateral(random), lateral(random) * 0.75f, depth(random)};
+        transform.mScale = 0.25f;
+        MeshInstance instance;
+        instance.mPipeline = static_cast<GLuint>(1 + random() % 8);
+        instance.mVertexArray = static_cast<GLuint>(1 + random() % 4);
+        instance.mIndexCount = 6;
+        world.Create(transform, WorldMatrix{MakeModelMatrix(transform)}, instance);
+    }
+    Query query{Query::With<WorldMatrix, MeshInstance>()};
+
+    const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 4.0f / 3.0f, 0.1f, 10.0f);
+    const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    const Frustum frustum{FrustumFromMatrix(projection * view)};
+    std::vector<CommandList> lists(jobs.ThreadCount());
+
+    for (auto _ : state) {
+        for (CommandList& list : lists) {
+            list.Reset();
+        }
+        world.ParallelForEachChunk(query, jobs, 16, [&](const ChunkView& chunk, size_t thread) {
+            RecordMeshDraws(&lists[thread], chunk.Column<WorldMatrix>(), chunk.Column<MeshInstance>(),
+                            chunk.Count(), frustum);
+        });
+        ClobberMemory();
+    }
+    state.SetItemsProcessed(kScalingItems);
+}
+BENCHMARK(BM_JobRecordDrawsScaling, 1, 2, 4, 8, 16);
+
+// Cost of scheduling and running empty jobs, each batch depending on the previous one
+static void BM_JobScheduleOverhead(BenchmarkState& state) {
+    JobSystem jobs;
+    jobs.Start(3);
+    constexpr auto kEmpty = [](void*) {};
+
+    for (auto _ : state) {
+        JobCounter first;
+        JobCounter second;
+        for (size_t i = 0; i < state.Size(); ++i) {
+            jobs.Schedule(Job{kEmpty, nullptr, &first});
+        }
+        for (size_t i = 0; i < state.Size(); ++i) {
+            jobs.Schedule(Job{kEmpty, nullptr, &second}, &first);
+        }
+        jobs.Wait(&second);
+    }
+    state.SetItemsProcessed(state.Size() * 2);
+}
+BENCHMARK(BM_JobScheduleOverhead, 64, 1024);
@@ -0,0 +1,53 @@
+//
+// Clustered lighting: binning lights into the view clusters, on one thread and on all of them.
+//
+
+#include "bench.h"
+
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "clustered_lighting.h"
+#include "job_system.h"
+
+// Lights spread through the first 20 units in front of the camera, like --lights N
+static void MakeLights(ClusteredLighting* lighting, size_t count) {
+    std::mt19937 random{42};
+    std::uniform_real_distribution<float> unit{0.0f, 1.0f};
+    lighting->mLights.resize(count);
+    for (Light& light : lighting->mLights) {
+        const float depth = 0.1f + 20.0f * unit(random);
+        light.mPosition = glm::vec3((unit(random) * 2.0f - 1.0f) * depth * 0.7f,
+                                    (unit(random) * 2.0f - 1.0f) * depth * 0.4f,
+                                    -depth);
+        light.mRange = 0.5f + unit(random);
+    }
+}
+
+static void BinLights(BenchmarkState& state, JobSystem* jobs) {
+    ClusteredLighting lighting;
+    MakeLights(&lighting, state.Size());
+    const glm::mat4 view{1.0f};
+    const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    for (auto _ : state) {
+        ClusteredLightingBin(&lighting, view, projection, 0.1f, jobs);
+        DoNotOptimize(lighting.mLightIndices.data());
+        ClobberMemory();
+    }
+    state.SetItemsProcessed(state.Size());
+}
+
+static void BM_BinLights(BenchmarkState& state) {
+    BinLights(state, nullptr);
+}
+BENCHMARK(BM_BinLights, 256, 1024, 4096);
+
+// One depth slice per job
+static void BM_BinLightsParallel(BenchmarkState& state) {
+    JobSystem jobs;
+    jobs.Start(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+    BinLights(state, &jobs);
+}
+BENCHMARK(BM_BinLightsParallel, 256, 1024, 4096);
@@ -0,0 +1,144 @@
+//
+// Runs every registered benchmark and reports the results as a table and as JSON.
+//
+// Usage: OpenGLTutorialBench [--filter SUBSTRING] [--out FILE] [--min-time SECONDS]
+// Without --out the JSON goes to stdout and the table to stderr.
+//
+
+#include "bench.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <print>
+
+std::vector<Benchmark>& Benchmarks() {
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+}
+
+namespace {
+
+struct BenchmarkResult {
+    std::string mName;
+    size_t mSize;
+    uint64_t mIterations;
+    double mNsPerIteration;
+    double mNsPerItem;
+    double mMinNsPerIteration;
+    double mMaxNsPerIteration;
+};
+
+constexpr int kRepetitions{5};
+
+/**
+ * Doubles the iteration count until one run takes at least minTime, then repeats
+ * that run and keeps the median, which is robust against the odd interrupted run.
+ */
+BenchmarkResult RunBenchmark(const Benchmark& benchmark, size_t size, double minTimeNs) {
+    uint64_t iterations{1};
+    while (true) {
+        BenchmarkState state(size, iterations);
+        benchmark.mFunction(state);
+        if (state.ElapsedNs() >= minTimeNs || iterations >= (1ull << 40)) { break; }
+
+        // Jump close to the target once we have a usable measurement
+        const double perIteration{std::max(state.ElapsedNs() / static_cast<double>(iterations), 1.0)};
+        const auto estimate{static_cast<uint64_t>(minTimeNs * 1.2 / perIteration)};
+        iterations = std::clamp<uint64_t>(estimate, iterations * 2, iterations * 100);
+    }
+
+    std::vector<double> samples;
+    size_t items{1};
+    for (int repetition = 0; repetition < kRepetitions; ++repetition) {
+        BenchmarkState state(size, iterations);
+        benchmark.mFunction(state);
+        samples.push_back(state.ElapsedNs() / static_cast<double>(iterations));
+        items = std::max<size_t>(state.ItemsPerIteration(), 1);
+    }
+    std::sort(samples.begin(), samples.end());
+
+    const double median{samples[samples.size() / 2]};
+    return BenchmarkResult{benchmark.mName, size, iterations, median,
+                           median / static_cast<double>(items), samples.front(), samples.back()};
+}
+
+void WriteJson(std::ostream& out, const std::vector<BenchmarkResult>& results) {
+    out << "{\n  \"context\": {\n";
+#if defined(__clang__)
+    out << "    \"compiler\": \"clang " << __clang_major__ << "." << __clang_minor__ << "\",\n";
+#elif defined(__GNUC__)
+    out << "    \"compiler\": \"gcc " << __GNUC__ << "." << __GNUC_MINOR__ << "\",\n";
+#endif
+#ifdef NDEBUG
+    out << "    \"build_type\": \"release\",\n";
+#else
+    out << "    \"build_type\": \"debug\",\n";
+#endif
+    out << "    \"repetitions\": " << kRepetitions << "\n  },\n";
+
+    out << "  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult& result{results[i]};
+        std::print(out, "{}\n    {{\"name\": \"{}\", \"size\": {}, \"iterations\": {}, "
+                        "\"ns_per_iteration\": {:.3f}, \"ns_per_item\": {:.3f}, "
+                        "\"min_ns_per_iteration\": {:.3f}, \"max_ns_per_iteration\": {:.3f}}}",
+                   i == 0 ? "" : ",", result.mName, result.mSize, result.mIterations,
+                   result.mNsPerIteration, result.mNsPerItem,
+                   result.mMinNsPerIteration, result.mMaxNsPerIteration);
+    }
+    out << "\n  ]\n}\n";
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    std::string filter;
+    std::string outFile;
+    double minTimeSeconds{0.1};
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument{argv[i]};
+        const bool hasValue{i + 1 < argc};
+        if (argument == "--filter" && hasValue) {
+            filter = argv[++i];
+        } else if (argument == "--out" && hasValue) {
+            outFile = argv[++i];
+        } else if (argument == "--min-time" && hasValue) {
+            minTimeSeconds = std::atof(argv[++i]);
+        } else {
+            std::println(std::cerr, "Usage: {} [--filter SUBSTRING] [--out FILE] [--min-time SECONDS]", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+#ifndef NDEBUG
+    std::println(std::cerr, "{}", "WARNING: benchmarks were built without optimizations");
+#endif
+
+    std::vector<BenchmarkResult> results;
+    std::println(std::cerr, "{:<40} {:>10} {:>14} {:>14}", "Benchmark", "Size", "ns/iteration", "ns/item");
+    for (const Benchmark& benchmark : Benchmarks()) {
+        if (!filter.empty() && benchmark.mName.find(filter) == std::string::npos) { continue; }
+
+        for (const size_t size : benchmark.mSizes) {
+            const BenchmarkResult result{RunBenchmark(benchmark, size, minTimeSeconds * 1.0e9)};
+            std::println(std::cerr, "{:<40} {:>10} {:>14.2f} {:>14.3f}",
+                         result.mName, result.mSize, result.mNsPerIteration, result.mNsPerItem);
+            results.push_back(result);
+        }
+    }
+
+    if (outFile.empty()) {
+        WriteJson(std::cout, results);
+    } else {
+        std::ofstream out(outFile);
+        if (!out.is_open()) {
+            std::println(std::cerr, "Could not write {}", outFile);
+            return EXIT_FAILURE;
+        }
+        WriteJson(out, results);
+    }
+    return EXIT_SUCCESS;
+}
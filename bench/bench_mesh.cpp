@@ -0,0 +1,37 @@
+//
+// Per-object model matrix construction, as done by TransformSystem.
+//
+
+#include "bench.h"
+
+#include <random>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "components.h"
+
+static void BM_MeshModelMatrix(BenchmarkState& state) {
+    std::mt19937 random{1234};
+    std::uniform_real_distribution<float> position{-50.0f, 50.0f};
+    std::uniform_real_distribution<float> angle{0.0f, 360.0f};
+
+    std::vector<LocalTransform> current(state.Size());
+    std::vector<PreviousTransform> previous(state.Size());
+    for (size_t i = 0; i < current.size(); ++i) {
+        current[i].mPosition = Transform{position(random), position(random), position(random)};
+        current[i].mRotate = angle(random);
+        previous[i] = PreviousTransform{current[i].mPosition, current[i].mRotate};
+        current[i].mPosition.z += 0.1f;
+        current[i].mRotate += 1.0f;
+    }
+
+    std::vector<glm::mat4> models(current.size());
+    for (auto _ : state) {
+        for (size_t i = 0; i < current.size(); ++i) {
+            models[i] = MakeModelMatrix(previous[i], current[i], 0.5f);
+        }
+        ClobberMemory();
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_MeshModelMatrix, 16, 1024, 65536, 1048576);
@@ -0,0 +1,80 @@
+//
+// Back-to-front ordering of transparent draws: radix sort against std::sort.
+//
+
+#include "bench.h"
+
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "job_system.h"
+#include "radix_sort.h"
+#include "transparency.h"
+
+// Depth keys of particles spread between the near and the far end of the scene
+static std::vector<uint32_t> MakeDepthKeys(size_t count) {
+    std::mt19937 random{42};
+    std::uniform_real_distribution<float> depth{0.1f, 10.0f};
+    std::vector<uint32_t> keys(count);
+    for (uint32_t& key : keys) {
+        key = MakeBackToFrontKey(depth(random));
+    }
+    return keys;
+}
+
+// What the transparent pass did before: sort key and index pairs with std::sort
+static void BM_SortBackToFrontStdSort(BenchmarkState& state) {
+    const std::vector<uint32_t> keys{MakeDepthKeys(state.Size())};
+    std::vector<uint64_t> pairs(keys.size());
+    for (auto _ : state) {
+        for (size_t i = 0; i < keys.size(); ++i) {
+            pairs[i] = (static_cast<uint64_t>(keys[i]) << 32) | i;
+        }
+        std::sort(pairs.begin(), pairs.end());
+        ClobberMemory();
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_SortBackToFrontStdSort, 1024, 100000, 1000000);
+
+// Radix sort on one thread
+static void BM_SortBackToFrontRadix(BenchmarkState& state) {
+    const std::vector<uint32_t> input{MakeDepthKeys(state.Size())};
+    std::vector<uint32_t> keys;
+    std::vector<uint32_t> order;
+    RadixSortScratch scratch;
+    for (auto _ : state) {
+        keys = input;
+        order.resize(keys.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = static_cast<uint32_t>(i);
+        }
+        RadixSortPairs(&keys, &order, kBackToFrontKeyBits, &scratch, nullptr);
+        ClobberMemory();
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_SortBackToFrontRadix, 1024, 100000, 1000000);
+
+// Radix sort with counting and scattering spread over every core
+static void BM_SortBackToFrontRadixParallel(BenchmarkState& state) {
+    JobSystem jobs;
+    jobs.Start(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+    const std::vector<uint32_t> input{MakeDepthKeys(state.Size())};
+    std::vector<uint32_t> keys;
+    std::vector<uint32_t> order;
+    RadixSortScratch scratch;
+    for (auto _ : state) {
+        keys = input;
+        order.resize(keys.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = static_cast<uint32_t>(i);
+        }
+        RadixSortPairs(&keys, &order, kBackToFrontKeyBits, &scratch, &jobs);
+        ClobberMemory();
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_SortBackToFrontRadixParallel, 1024, 100000, 1000000);
@@ -0,0 +1,44 @@
+//
+// Building and compiling the frame's render graph, which happens every frame on the main thread.
+//
+
+#include "bench.h"
+
+#include "gpu_resources.h"
+#include "render_graph.h"
+
+static void Execute(RenderGraph&, void*) {}
+
+/**
+ * A chain of passes, each reading what the one before it wrote, with a side branch
+ * off every other pass that nothing reads and so is culled. Imported textures only,
+ * so compiling makes no GL calls.
+ */
+static void BuildChain(RenderGraph* graph, size_t passes) {
+    graph->Reset();
+    RenderGraphTexture color = graph->ImportTexture("Color", 1);
+    RenderGraphTexture unused = graph->ImportTexture("Unused", 2);
+    for (size_t i = 0; i < passes; ++i) {
+        const RenderGraph::PassIndex pass = graph->AddPass("Pass", Execute);
+        graph->Read(pass, color);
+        color = graph->Write(pass, color);
+        if (i % 2 == 0) {
+            const RenderGraph::PassIndex branch = graph->AddPass("Branch", Execute);
+            graph->Read(branch, color);
+            unused = graph->Write(branch, unused);
+        }
+    }
+    graph->SetOutput(color);
+}
+
+static void BM_CompileRenderGraph(BenchmarkState& state) {
+    GpuResources resources;
+    RenderGraph graph;
+    for (auto _ : state) {
+        BuildChain(&graph, state.Size());
+        graph.Compile(&resources);
+        DoNotOptimize(graph.CulledPassCount());
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_CompileRenderGraph, 8, 64);
@@ -0,0 +1,110 @@
+//
+// Resource handles: slot map churn and lookups, against the hash map they could have been,
+// and buddy allocation of pooled buffer ranges.
+//
+
+#include "bench.h"
+
+#include <algorithm>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "gpu_allocator.h"
+#include "gpu_handles.h"
+#include "slot_map.h"
+
+namespace {
+
+struct FakeBuffer {
+    unsigned mName;
+    size_t mBytes;
+};
+
+}
+
+// Insert everything, then remove it all again so every slot goes through the free list
+static void BM_SlotMapInsertRemove(BenchmarkState& state) {
+    SlotMap<FakeBuffer, BufferTag> slots;
+    std::vector<BufferHandle> handles(state.Size());
+    for (auto _ : state) {
+        for (size_t i = 0; i < state.Size(); ++i) {
+            handles[i] = slots.Insert(FakeBuffer{static_cast<unsigned>(i), 64});
+        }
+        for (const BufferHandle handle : handles) {
+            slots.Remove(handle);
+        }
+        DoNotOptimize(slots.Size());
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_SlotMapInsertRemove, 1024, 65536);
+
+// Random lookups, as when each draw resolves its mesh
+static void BM_SlotMapLookup(BenchmarkState& state) {
+    SlotMap<FakeBuffer, BufferTag> slots;
+    std::vector<BufferHandle> handles(state.Size());
+    for (size_t i = 0; i < state.Size(); ++i) {
+        handles[i] = slots.Insert(FakeBuffer{static_cast<unsigned>(i), 64});
+    }
+    std::shuffle(handles.begin(), handles.end(), std::mt19937{1});
+
+    for (auto _ : state) {
+        size_t bytes = 0;
+        for (const BufferHandle handle : handles) {
+            bytes += slots.Get(handle)->mBytes;
+        }
+        DoNotOptimize(bytes);
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_SlotMapLookup, 1024, 65536, 1048576);
+
+// The same lookups keyed by GL name in a hash map
+static void BM_HashMapLookup(BenchmarkState& state) {
+    std::unordered_map<unsigned, FakeBuffer> buffers;
+    std::vector<unsigned> names(state.Size());
+    for (size_t i = 0; i < state.Size(); ++i) {
+        names[i] = static_cast<unsigned>(i + 1);
+        buffers.emplace(names[i], FakeBuffer{names[i], 64});
+    }
+    std::shuffle(names.begin(), names.end(), std::mt19937{1});
+
+    for (auto _ : state) {
+        size_t bytes = 0;
+        for (const unsigned name : names) {
+            bytes += buffers.find(name)->second.mBytes;
+        }
+        DoNotOptimize(bytes);
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_HashMapLookup, 1024, 65536, 1048576);
+
+// Mesh-sized ranges allocated and freed in random order from one 64 MiB pool
+static void BM_BuddyAllocateFree(BenchmarkState& state) {
+    std::mt19937 random{1};
+    std::uniform_int_distribution<uint32_t> sizes{64, 64 * 1024};
+    std::vector<uint32_t> requests(state.Size());
+    for (uint32_t& request : requests) {
+        request = sizes(random);
+    }
+    std::vector<uint32_t> offsets(state.Size());
+
+    for (auto _ : state) {
+        BuddyAllocator blocks{64u * 1024 * 1024, GpuBufferAllocator::kMinBlockSize};
+        for (size_t i = 0; i < requests.size(); ++i) {
+            offsets[i] = blocks.Allocate(requests[i]);
+        }
+        // Free every other range first, so merging has to wait for the second pass
+        for (size_t i = 0; i < offsets.size(); i += 2) {
+            if (offsets[i] != BuddyAllocator::kInvalidOffset) { blocks.Free(offsets[i]); }
+        }
+        for (size_t i = 1; i < offsets.size(); i += 2) {
+            if (offsets[i] != BuddyAllocator::kInvalidOffset) { blocks.Free(offsets[i]); }
+        }
+        DoNotOptimize(blocks.LargestFreeBlock());
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_BuddyAllocateFree, 256, 4096);
@@ -0,0 +1,43 @@
+//
+// Shader source loading.
+//
+
+#include "bench.h"
+
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <string>
+
+#include "shaders.h"
+
+/**
+ * Writes a GLSL-like file of roughly kilobytes KB once and returns its path.
+ */
+static std::string ShaderFileOfSize(size_t kilobytes) {
+    static std::map<size_t, std::string> files;
+    if (auto it = files.find(kilobytes); it != files.end()) {
+        return it->second;
+    }
+
+    const std::filesystem::path path{std::filesystem::temp_directory_path() /
+                                     ("bench_shader_" + std::to_string(kilobytes) + "kb.glsl")};
+    std::ofstream out(path);
+    out << "#version 410 core\n";
+    const std::string line{"    vec4 value = u_Projection * u_ViewMatrix * u_ModelMatrix * vec4(position, 1.0f);\n"};
+    for (size_t written = 0; written < kilobytes * 1024; written += line.size()) {
+        out << line;
+    }
+    files.emplace(kilobytes, path.string());
+    return path.string();
+}
+
+static void BM_LoadShaderAsString(BenchmarkState& state) {
+    const std::string path{ShaderFileOfSize(state.Size())};
+    for (auto _ : state) {
+        DoNotOptimize(LoadShaderAsString(path));
+    }
+    // Report time per KB
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_LoadShaderAsString, 4, 256, 4096);
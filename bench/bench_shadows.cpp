@@ -0,0 +1,98 @@
+//
+// Shadow caster recording for every cascade, with and without the static casters cached.
+//
+
+#include "bench.h"
+
+#include <limits>
+#include <random>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "components.h"
+#include "draw_list.h"
+#include "ecs.h"
+#include "shadows.h"
+
+// Objects in front of the camera, one in ten of them moving, like --scene N --dynamic 0.1
+static void MakeCasters(World* world, size_t count) {
+    std::mt19937 random{42};
+    std::uniform_real_distribution<float> lateral{-8.0f, 8.0f};
+    std::uniform_real_distribution<float> depth{-30.0f, -1.0f};
+
+    for (size_t i = 0; i < count; ++i) {
+        LocalTransform transform;
+        transform.mPosition = Transform{lateral(random), lateral(random) * 0.75f, depth(random)};
+        transform.mScale = 0.25f;
+        MeshInstance instance;
+        instance.mPipeline = 1;
+        instance.mVertexArray = static_cast<GLuint>(1 + random() % 4);
+        instance.mIndexCount = 6;
+        if (i % 10 == 0) {
+            world->Create(transform, PreviousTransform{transform.mPosition, transform.mRotate},
+                          WorldMatrix{MakeModelMatrix(transform)}, instance);
+        } else {
+            world->Create(transform, WorldMatrix{MakeModelMatrix(transform)}, instance);
+        }
+    }
+}
+
+// Cascades fitted as the renderer fits them, without creating any GL objects
+static CascadedShadows MakeCascades() {
+    Camera camera;
+    camera.SetProjectionMatrix(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, std::numeric_limits<float>::infinity());
+    CascadedShadows shadows;
+    shadows.mResolution = 2048;
+    const DirectionalLight sun{glm::normalize(glm::vec3(0.4f, -0.5f, -1.0f)), glm::vec3(1.0f)};
+    CascadedShadowsUpdate(&shadows, &sun, camera, 0.1f, 0);
+    return shadows;
+}
+
+static void Record(CommandList* list, World& world, Query& query, const Frustum& frustum) {
+    world.ForEachChunk(query, [&](const ChunkView& chunk) {
+        RecordMeshDraws(list, chunk.Column<WorldMatrix>(), chunk.Column<MeshInstance>(), chunk.Count(), frustum);
+    });
+}
+
+// Every caster into every cascade, every frame
+static void BM_RecordShadowCasters(BenchmarkState& state) {
+    World world;
+    MakeCasters(&world, state.Size());
+    Query casters{Query::With<WorldMatrix, MeshInstance>()};
+    const CascadedShadows shadows{MakeCascades()};
+    CommandList list;
+    for (auto _ : state) {
+        for (const ShadowCascade& cascade : shadows.mCascades) {
+            list.Reset();
+            Record(&list, world, casters, cascade.mFrustum);
+            DoNotOptimize(list.Commands().size());
+        }
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_RecordShadowCasters, 1024, 65536);
+
+// A frame where the cached cascades' static depth is still good: only the first
+// cascade takes everything, the others take the moving casters
+static void BM_RecordShadowCastersCached(BenchmarkState& state) {
+    World world;
+    MakeCasters(&world, state.Size());
+    Query staticCasters{Query::With<WorldMatrix, MeshInstance>().Without<PreviousTransform>()};
+    Query dynamicCasters{Query::With<WorldMatrix, MeshInstance, PreviousTransform>()};
+    const CascadedShadows shadows{MakeCascades()};
+    CommandList list;
+    for (auto _ : state) {
+        for (int i = 0; i < kShadowCascadeCount; ++i) {
+            const Frustum& frustum = shadows.mCascades[i].mFrustum;
+            list.Reset();
+            if (i < kFirstCachedCascade) {
+                Record(&list, world, staticCasters, frustum);
+            }
+            Record(&list, world, dynamicCasters, frustum);
+            DoNotOptimize(list.Commands().size());
+        }
+    }
+    state.SetItemsProcessed(state.Size());
+}
+BENCHMARK(BM_RecordShadowCastersCached, 1024, 65536);
@@ -0,0 +1,70 @@
+//
+// Transparent billboards: the CPU work for sorted blending against weighted blended OIT.
+//
+
+#include "bench.h"
+
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "components.h"
+#include "ecs.h"
+#include "frustum.h"
+#include "job_system.h"
+#include "transparency.h"
+
+// Particles through the first 20 units in front of the camera, like --particles N,
+// all sorted (--oit 0) or all order-independent (--oit 1)
+static void MakeParticles(World* world, size_t count, bool orderIndependent) {
+    std::mt19937 random{42};
+    std::uniform_real_distribution<float> unit{0.0f, 1.0f};
+    for (size_t i = 0; i < count; ++i) {
+        const float depth = 0.5f + 20.0f * unit(random);
+        Billboard particle;
+        particle.mPosition = glm::vec3((unit(random) * 2.0f - 1.0f) * depth * 0.7f,
+                                       (unit(random) * 2.0f - 1.0f) * depth * 0.4f,
+                                       -depth);
+        particle.mSize = 0.02f + 0.06f * unit(random);
+        particle.mColor = glm::vec4(unit(random), unit(random), 1.0f, 0.1f + 0.4f * unit(random));
+        if (orderIndependent) {
+            world->Create(particle, OrderIndependent{});
+        } else {
+            world->Create(particle);
+        }
+    }
+}
+
+static void GatherBillboards(BenchmarkState& state, bool orderIndependent) {
+    JobSystem jobs;
+    jobs.Start(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+    World world;
+    MakeParticles(&world, state.Size(), orderIndependent);
+    Query sorted{Query::With<Billboard>().Without<OrderIndependent>()};
+    Query weighted{Query::With<Billboard, OrderIndependent>()};
+
+    const glm::mat4 view{1.0f};
+    const glm::mat4 projection = glm::perspective(glm::radians(45.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    const Frustum frustum = FrustumFromMatrix(projection * view);
+    TransparentPass pass;
+    for (auto _ : state) {
+        TransparentPassGather(&pass, world, sorted, weighted, view, frustum, jobs);
+        DoNotOptimize(pass.mOrder.data());
+        DoNotOptimize(pass.mWeightedCount);
+        ClobberMemory();
+    }
+    state.SetItemsProcessed(state.Size());
+}
+
+// Cull, compute depth keys, and radix sort back to front
+static void BM_GatherSortedBillboards(BenchmarkState& state) {
+    GatherBillboards(state, false);
+}
+BENCHMARK(BM_GatherSortedBillboards, 10000, 100000);
+
+// Cull only; weighted blending does not care about order
+static void BM_GatherWeightedBillboards(BenchmarkState& state) {
+    GatherBillboards(state, true);
+}
+BENCHMARK(BM_GatherWeightedBillboards, 10000, 100000);
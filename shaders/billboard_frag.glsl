@@ -0,0 +1,33 @@
+#version 410 core
+
+in vec4 v_color;
+in vec2 v_corner;
+
+#ifdef WEIGHTED_OIT
+in float v_viewDepth;
+
+// Weighted blended order-independent transparency, resolved by oit_composite_frag.glsl
+layout (location = 0) out vec4 accumulation;
+layout (location = 1) out float revealage;
+#else
+out vec4 color;
+#endif
+
+void main() {
+    // Round, soft-edged particle
+    float falloff = clamp(1.0f - dot(v_corner, v_corner), 0.0f, 1.0f);
+    float alpha = v_color.a * falloff;
+    if (alpha <= 0.0f) {
+        discard;
+    }
+
+#ifdef WEIGHTED_OIT
+    // Nearer and more opaque fragments count for more (McGuire and Bavoil, equation 9)
+    float weight = alpha * clamp(10.0f / (1e-5f + pow(v_viewDepth / 5.0f, 2.0f) + pow(v_viewDepth / 200.0f, 6.0f)),
+                                 1e-2f, 3e3f);
+    accumulation = vec4(v_color.rgb * alpha, alpha) * weight;
+    revealage = alpha;
+#else
+    color = vec4(v_color.rgb, alpha);
+#endif
+}
@@ -0,0 +1,44 @@
+#version 410 core
+
+// One instance per billboard: center and half size, then color
+layout (location = 0) in vec4 instancePositionSize;
+layout (location = 1) in vec4 instanceColor;
+
+// Shared by every program and written once per frame, see frame_uniforms.h
+layout (std140) uniform FrameUniforms {
+    mat4 u_ViewMatrix;
+    mat4 u_Projection;
+    vec4 u_ClusterScale;
+    uvec4 u_ClusterCounts;
+    vec4 u_Ambient;
+    mat4 u_ShadowMatrices[4];
+    vec4 u_CascadeSplits;
+    vec4 u_CascadeNormalOffsets;
+    vec4 u_SunDirection;
+    vec4 u_SunColor;
+    mat4 u_InverseViewProjection;
+    vec4 u_CameraPosition;
+    vec4 u_Viewport;
+};
+
+out vec4 v_color;
+out vec2 v_corner;
+
+#ifdef WEIGHTED_OIT
+out float v_viewDepth;
+#endif
+
+void main() {
+    // Triangle strip corners (-1,-1), (1,-1), (-1,1), (1,1)
+    v_corner = vec2(float(gl_VertexID & 1), float(gl_VertexID >> 1)) * 2.0f - 1.0f;
+    v_color = instanceColor;
+
+    // Offset in view space, so the square always faces the camera
+    vec4 viewPosition = u_ViewMatrix * vec4(instancePositionSize.xyz, 1.0f);
+    viewPosition.xy += v_corner * instancePositionSize.w;
+    gl_Position = u_Projection * viewPosition;
+
+#ifdef WEIGHTED_OIT
+    v_viewDepth = -viewPosition.z;
+#endif
+}
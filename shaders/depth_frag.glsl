@@ -0,0 +1,5 @@
+#version 410 core
+
+// Depth pre-pass: color writes are off, only the depth test and write matter
+void main() {
+}
@@ -0,0 +1,30 @@
+#version 410 core
+
+// Depth pre-pass: positions only, from their own tightly packed stream
+layout (location = 0) in vec3 position;
+
+uniform mat4 u_ModelMatrix;
+
+// Shared by every program and written once per frame, see frame_uniforms.h
+layout (std140) uniform FrameUniforms {
+    mat4 u_ViewMatrix;
+    mat4 u_Projection;
+    vec4 u_ClusterScale;
+    uvec4 u_ClusterCounts;
+    vec4 u_Ambient;
+    mat4 u_ShadowMatrices[4];
+    vec4 u_CascadeSplits;
+    vec4 u_CascadeNormalOffsets;
+    vec4 u_SunDirection;
+    vec4 u_SunColor;
+    mat4 u_InverseViewProjection;
+    vec4 u_CameraPosition;
+    vec4 u_Viewport;
+};
+
+// The shading pass tests for equal depth, so both must compute it identically
+invariant gl_Position;
+
+void main() {
+    gl_Position = u_Projection * u_ViewMatrix * u_ModelMatrix * vec4(position, 1.0f);
+}
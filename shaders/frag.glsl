@@ -1,8 +1,217 @@
 #version 410 core
 
+// Forward shading of the opaque meshes by default. With GBUFFER the meshes write their
+// surface to the G-buffer instead, and DEFERRED_LIGHTING is the full-screen pass that
+// shades it, with the same lighting; see deferred.h.
+
+#ifdef DEFERRED_LIGHTING
+// Albedo and packed material, octahedral normal, and the depth the position is rebuilt from
+uniform sampler2D u_GBufferAlbedoMaterial;
+uniform sampler2D u_GBufferNormal;
+uniform sampler2D u_GBufferDepth;
+out vec4 color;
+#else
 in vec3 v_vertexColors;
+in vec3 v_worldPosition;
+in float v_viewDepth;
+#ifdef GBUFFER
+layout (location = 0) out vec4 gAlbedoMaterial;
+layout (location = 1) out vec2 gNormal;
+#else
 out vec4 color;
+#endif
+#endif
+
+// Shared by every program and written once per frame, see frame_uniforms.h
+layout (std140) uniform FrameUniforms {
+    mat4 u_ViewMatrix;
+    mat4 u_Projection;
+    vec4 u_ClusterScale;
+    uvec4 u_ClusterCounts;
+    vec4 u_Ambient;
+    mat4 u_ShadowMatrices[4];
+    vec4 u_CascadeSplits;
+    vec4 u_CascadeNormalOffsets;
+    vec4 u_SunDirection;
+    vec4 u_SunColor;
+    mat4 u_InverseViewProjection;
+    vec4 u_CameraPosition;
+    vec4 u_Viewport;
+};
+
+// Filled by ClusteredLightingUpload, see clustered_lighting.h. Each light is three
+// texels: position and range, color and outer spot cosine, direction and inner spot cosine.
+uniform samplerBuffer u_LightData;
+// Per cluster: offset into u_LightIndices and count
+uniform usamplerBuffer u_ClusterGrid;
+uniform usamplerBuffer u_LightIndices;
+// One layer per cascade, compared against the reference depth, see shadows.h
+uniform sampler2DArrayShadow u_ShadowMap;
+
+#ifdef FOG
+// Same as the clear color, so that distant geometry fades into the background
+const vec3 kFogColor = vec3(1.0f, 1.0f, 0.0f);
+const float kFogDensity = 0.25f;
+#endif
+
+// The meshes have no material yet, so every surface is a rough dielectric
+const vec2 kDefaultMaterial = vec2(0.8f, 0.0f);
+
+// Roughness in the high four bits, metalness in the low four, of one 8-bit channel
+float PackMaterial(vec2 material) {
+    vec2 quantized = floor(clamp(material, 0.0f, 1.0f) * 15.0f + 0.5f);
+    return (quantized.x * 16.0f + quantized.y) / 255.0f;
+}
+
+vec2 UnpackMaterial(float packed) {
+    uint bits = uint(packed * 255.0f + 0.5f);
+    return vec2(float(bits >> 4u), float(bits & 15u)) / 15.0f;
+}
+
+// A unit vector folded onto the octahedron and flattened to two [0, 1] channels
+vec2 OctahedralEncode(vec3 normal) {
+    normal /= abs(normal.x) + abs(normal.y) + abs(normal.z);
+    vec2 folded = normal.xy;
+    if (normal.z < 0.0f) {
+        folded = (1.0f - abs(normal.yx)) * vec2(normal.x >= 0.0f ? 1.0f : -1.0f, normal.y >= 0.0f ? 1.0f : -1.0f);
+    }
+    return folded * 0.5f + 0.5f;
+}
+
+vec3 OctahedralDecode(vec2 encoded) {
+    encoded = encoded * 2.0f - 1.0f;
+    vec3 normal = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-normal.z, 0.0f);
+    normal.xy += vec2(normal.x >= 0.0f ? -fold : fold, normal.y >= 0.0f ? -fold : fold);
+    return normalize(normal);
+}
+
+// Lambert diffuse plus normalized Blinn-Phong specular, for light arriving from
+// lightDirection. Both are scaled by pi, so lights keep the brightness they had unshaded.
+vec3 Brdf(vec3 albedo, vec2 material, vec3 normal, vec3 lightDirection, vec3 toEye) {
+    float roughness = max(material.x, 0.05f);
+    float metal = material.y;
+    float shininess = 2.0f / (roughness * roughness * roughness * roughness) - 2.0f;
+    vec3 halfway = normalize(lightDirection + toEye);
+    float specular = (shininess + 8.0f) / 8.0f * pow(max(dot(normal, halfway), 0.0f), shininess);
+    vec3 reflectance = mix(vec3(0.04f), albedo, metal);
+    return albedo * (1.0f - metal) + reflectance * specular;
+}
+
+// Light from every light listed in the cluster of this pixel at viewDepth
+vec3 ClusteredLight(vec3 albedo, vec2 material, vec3 position, float viewDepth, vec3 normal, vec3 toEye) {
+    uvec3 cluster = uvec3(uvec2(gl_FragCoord.xy * u_ClusterScale.xy),
+                          uint(max(log(viewDepth) * u_ClusterScale.z + u_ClusterScale.w, 0.0f)));
+    cluster = min(cluster, u_ClusterCounts.xyz - 1u);
+    uvec2 range = texelFetch(u_ClusterGrid, int(cluster.x + u_ClusterCounts.x * (cluster.y + u_ClusterCounts.y * cluster.z))).xy;
+
+    vec3 light = vec3(0.0f);
+    for (uint i = 0u; i < range.y; ++i) {
+        int first = int(texelFetch(u_LightIndices, int(range.x + i)).x) * 3;
+        vec4 positionRange = texelFetch(u_LightData, first);
+        vec4 colorSpotOuter = texelFetch(u_LightData, first + 1);
+        vec4 directionSpotInner = texelFetch(u_LightData, first + 2);
+
+        vec3 toLight = positionRange.xyz - position;
+        float distanceSquared = dot(toLight, toLight);
+        vec3 lightDirection = toLight * inversesqrt(max(distanceSquared, 1e-8f));
+
+        // Inverse square falloff, windowed to reach zero at the light's range
+        float window = clamp(1.0f - pow(distanceSquared / (positionRange.w * positionRange.w), 2.0f), 0.0f, 1.0f);
+        float attenuation = window * window / (distanceSquared + 1.0f);
+        // Point lights have an outer cosine below -1, so this is 1
+        float spot = smoothstep(colorSpotOuter.w, directionSpotInner.w, dot(-lightDirection, directionSpotInner.xyz));
+
+        light += Brdf(albedo, material, normal, lightDirection, toEye) * colorSpotOuter.rgb *
+                 (max(dot(normal, lightDirection), 0.0f) * attenuation * spot);
+    }
+    return light;
+}
+
+// How much of the directional light reaches position: a 3x3 PCF in its cascade
+float SunShadow(vec3 position, float viewDepth, vec3 normal) {
+    int cascade = 0;
+    while (cascade < 4 && viewDepth >= u_CascadeSplits[cascade]) {
+        ++cascade;
+    }
+    if (cascade == 4) {
+        return 1.0f;
+    }
+
+    // Looked up a little out along the normal, so a surface does not shadow itself
+    position += normal * u_CascadeNormalOffsets[cascade];
+    vec3 shadowPosition = (u_ShadowMatrices[cascade] * vec4(position, 1.0f)).xyz;
+    float lit = 0.0f;
+    for (int y = -1; y <= 1; ++y) {
+        for (int x = -1; x <= 1; ++x) {
+            vec2 offset = vec2(x, y) * u_SunColor.w;
+            lit += texture(u_ShadowMap, vec4(shadowPosition.xy + offset, float(cascade), shadowPosition.z));
+        }
+    }
+    return lit / 9.0f;
+}
+
+// The lit color of a surface; without any lights it keeps its own color
+vec3 Shade(vec3 albedo, vec2 material, vec3 position, float viewDepth, vec3 normal) {
+    if (u_ClusterCounts.w == 0u && u_SunDirection.w == 0.0f) {
+        return albedo;
+    }
+    vec3 toEye = normalize(u_CameraPosition.xyz - position);
+    vec3 result = albedo * u_Ambient.rgb + ClusteredLight(albedo, material, position, viewDepth, normal, toEye);
+    if (u_SunDirection.w > 0.0f) {
+        vec3 sunDirection = u_SunDirection.xyz;
+        result += Brdf(albedo, material, normal, sunDirection, toEye) * u_SunColor.rgb *
+                  (max(dot(normal, sunDirection), 0.0f) * SunShadow(position, viewDepth, normal));
+    }
+    return result;
+}
 
 void main() {
-    color = vec4(v_vertexColors.r, v_vertexColors.g, v_vertexColors.b, 1.0f);
-}
\ No newline at end of file
+#ifdef DEFERRED_LIGHTING
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(u_GBufferDepth, pixel, 0).r;
+    bool zeroToOneDepth = u_CameraPosition.w > 0.0f;
+    // Nothing was drawn here, so the clear color shows through
+    if (depth == (zeroToOneDepth ? 0.0f : 1.0f)) {
+        discard;
+    }
+
+    // There is no position target; the position comes back from the pixel and its depth
+    vec2 ndc = gl_FragCoord.xy * u_Viewport.zw * 2.0f - 1.0f;
+    vec4 world = u_InverseViewProjection * vec4(ndc, zeroToOneDepth ? depth : depth * 2.0f - 1.0f, 1.0f);
+    vec3 position = world.xyz / world.w;
+    float viewDepth = -(u_ViewMatrix * vec4(position, 1.0f)).z;
+
+    vec4 albedoMaterial = texelFetch(u_GBufferAlbedoMaterial, pixel, 0);
+    vec3 normal = OctahedralDecode(texelFetch(u_GBufferNormal, pixel, 0).rg);
+    color = vec4(Shade(albedoMaterial.rgb, UnpackMaterial(albedoMaterial.a), position, viewDepth, normal), 1.0f);
+#else
+    vec3 albedo = v_vertexColors;
+
+#ifdef PIPELINE_INDEX
+    // Generated scenes use several otherwise identical programs; tint them apart
+    albedo *= 1.0f - 0.05f * float(PIPELINE_INDEX % 8);
+#endif
+
+    // The meshes have no normals; the faceted one from the screen space derivatives faces the viewer
+    vec3 normal = normalize(cross(dFdx(v_worldPosition), dFdy(v_worldPosition)));
+
+#ifdef FOG
+    float visibility = clamp(exp(-kFogDensity * v_viewDepth), 0.0f, 1.0f);
+#endif
+
+#ifdef GBUFFER
+#ifdef FOG
+    // Lit later, so the fog goes on the surface color
+    albedo = mix(kFogColor, albedo, visibility);
+#endif
+    gAlbedoMaterial = vec4(albedo, PackMaterial(kDefaultMaterial));
+    gNormal = OctahedralEncode(normal);
+#else
+    color = vec4(Shade(albedo, kDefaultMaterial, v_worldPosition, v_viewDepth, normal), 1.0f);
+#ifdef FOG
+    color.rgb = mix(kFogColor, color.rgb, visibility);
+#endif
+#endif
+#endif
+}
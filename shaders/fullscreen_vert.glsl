@@ -0,0 +1,10 @@
+#version 410 core
+
+// One triangle that covers the screen, from gl_VertexID alone: draw 3 vertices
+// with an empty vertex array
+out vec2 v_texCoord;
+
+void main() {
+    v_texCoord = vec2(float((gl_VertexID << 1) & 2), float(gl_VertexID & 2));
+    gl_Position = vec4(v_texCoord * 2.0f - 1.0f, 0.0f, 1.0f);
+}
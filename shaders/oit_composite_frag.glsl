@@ -0,0 +1,26 @@
+#version 410 core
+
+// Resolves weighted blended order-independent transparency over the scene
+uniform sampler2D u_Accumulation;
+uniform sampler2D u_Revealage;
+
+out vec4 color;
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float revealage = texelFetch(u_Revealage, pixel, 0).r;
+    if (revealage >= 1.0f) {
+        // Nothing transparent covers this pixel
+        discard;
+    }
+
+    vec4 accumulation = texelFetch(u_Accumulation, pixel, 0);
+    // Keep half-float overflow from turning the average into NaN
+    if (isinf(max(max(abs(accumulation.r), abs(accumulation.g)), max(abs(accumulation.b), abs(accumulation.a))))) {
+        accumulation.rgb = vec3(accumulation.a);
+    }
+    vec3 averageColor = accumulation.rgb / max(accumulation.a, 1e-5f);
+
+    // Blended with SRC_ALPHA, ONE_MINUS_SRC_ALPHA: the scene shows through by the revealage
+    color = vec4(averageColor, 1.0f - revealage);
+}
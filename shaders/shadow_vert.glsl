@@ -0,0 +1,11 @@
+#version 410 core
+
+// Shadow casters: positions only, into the light's clip space for one cascade
+layout (location = 0) in vec3 position;
+
+uniform mat4 u_ModelMatrix;
+uniform mat4 u_LightViewProjection;
+
+void main() {
+    gl_Position = u_LightViewProjection * u_ModelMatrix * vec4(position, 1.0f);
+}
@@ -0,0 +1,41 @@
+#version 410 core
+
+// Stretches the part of the scene target drawn this frame over the window, and
+// sharpens what bilinear filtering blurred: contrast adaptive, so flat areas get the
+// most and edges that already stand out get little, which keeps them from ringing
+uniform sampler2D u_SceneColor;
+// The drawn part as a fraction of the whole target, from its bottom-left corner
+uniform vec2 u_SourceScale;
+// 0 to 1
+uniform float u_Sharpness;
+
+in vec2 v_texCoord;
+
+out vec4 color;
+
+vec3 Sample(vec2 uv, vec2 halfTexel) {
+    // Never reach past the drawn part into what an earlier, larger frame left there
+    return texture(u_SceneColor, clamp(uv, halfTexel, u_SourceScale - halfTexel)).rgb;
+}
+
+void main() {
+    vec2 texel = 1.0f / vec2(textureSize(u_SceneColor, 0));
+    vec2 halfTexel = 0.5f * texel;
+    vec2 uv = v_texCoord * u_SourceScale;
+
+    vec3 center = Sample(uv, halfTexel);
+    vec3 north = Sample(uv + vec2(0.0f, texel.y), halfTexel);
+    vec3 south = Sample(uv - vec2(0.0f, texel.y), halfTexel);
+    vec3 east = Sample(uv + vec2(texel.x, 0.0f), halfTexel);
+    vec3 west = Sample(uv - vec2(texel.x, 0.0f), halfTexel);
+
+    vec3 lowest = min(center, min(min(north, south), min(east, west)));
+    vec3 highest = max(center, max(max(north, south), max(east, west)));
+    // How far the neighborhood is from clipping at either end, relative to its peak
+    vec3 headroom = clamp(min(lowest, 1.0f - highest) / max(highest, 1e-4f), 0.0f, 1.0f);
+    // A negative weight on the neighbors: -1/8 is gentle, -1/5 the most there is
+    vec3 weight = sqrt(headroom) * -1.0f / mix(8.0f, 5.0f, u_Sharpness);
+
+    vec3 sharpened = (center + (north + south + east + west) * weight) / (1.0f + 4.0f * weight);
+    color = vec4(clamp(sharpened, 0.0f, 1.0f), 1.0f);
+}
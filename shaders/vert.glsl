@@ -4,15 +4,39 @@ layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 vertexColors;
 
 uniform mat4 u_ModelMatrix;
-uniform mat4 u_Projection;
-uniform mat4 u_ViewMatrix;
+
+// Shared by every program and written once per frame, see frame_uniforms.h
+layout (std140) uniform FrameUniforms {
+    mat4 u_ViewMatrix;
+    mat4 u_Projection;
+    vec4 u_ClusterScale;
+    uvec4 u_ClusterCounts;
+    vec4 u_Ambient;
+    mat4 u_ShadowMatrices[4];
+    vec4 u_CascadeSplits;
+    vec4 u_CascadeNormalOffsets;
+    vec4 u_SunDirection;
+    vec4 u_SunColor;
+    mat4 u_InverseViewProjection;
+    vec4 u_CameraPosition;
+    vec4 u_Viewport;
+};
 
 out vec3 v_vertexColors;
+out vec3 v_worldPosition;
+// Distance along the view direction: picks the light cluster, and fades out far away geometry
+out float v_viewDepth;
+
+// Must match depth_vert.glsl exactly for the depth pre-pass's equal test
+invariant gl_Position;
 
 void main() {
     v_vertexColors = vertexColors;
 
-    vec4 newPosition = u_Projection * u_ViewMatrix * u_ModelMatrix * vec4(position, 1.0f);
-    gl_Position = vec4(newPosition.x, newPosition.y, newPosition.z, newPosition.w);
+    vec4 worldPosition = u_ModelMatrix * vec4(position, 1.0f);
+    v_worldPosition = worldPosition.xyz;
+    v_viewDepth = -(u_ViewMatrix * worldPosition).z;
+
+    gl_Position = u_Projection * u_ViewMatrix * u_ModelMatrix * vec4(position, 1.0f);
 }
 
@@ -0,0 +1,399 @@
+//
+// Opt-in heap allocation tracking: per-frame counts, tagged scopes and a leak report.
+//
+
+#include "alloc_tracker.h"
+
+#ifdef OPENGLNOTES_TRACK_ALLOCATIONS
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <print>
+
+#if __has_include(<dlfcn.h>)
+#include <dlfcn.h>
+#define ALLOC_HAVE_DLADDR 1
+#endif
+#if __has_include(<cxxabi.h>)
+#include <cxxabi.h>
+#define ALLOC_HAVE_DEMANGLE 1
+#endif
+
+// glibc exports the allocator under these names as well, so the hooks below can
+// forward to it. ASan brings its own malloc, which must not be shadowed.
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+#define ALLOC_HOOK_MALLOC 1
+extern "C" {
+void* __libc_malloc(size_t bytes);
+void* __libc_calloc(size_t count, size_t bytes);
+void* __libc_realloc(void* pointer, size_t bytes);
+void* __libc_memalign(size_t alignment, size_t bytes);
+void __libc_free(void* pointer);
+}
+#endif
+
+namespace {
+
+constexpr uint32_t kMaxTags{64};
+constexpr uint32_t kUntagged{0};
+// Power of two; once full, further call sites are only counted by tag
+constexpr uint32_t kMaxSites{4096};
+constexpr uint32_t kNoSite{UINT32_MAX};
+constexpr double kKiB{1024.0};
+
+// Placed in front of every block handed out by operator new
+struct alignas(16) Header {
+    uint64_t mBytes;
+    uint32_t mSite;
+    // From the start of the underlying block to the user's pointer
+    uint32_t mOffset;
+};
+static_assert(sizeof(Header) == 16);
+
+struct TagCounters {
+    std::atomic<uint64_t> mNewCalls;
+    std::atomic<uint64_t> mNewBytes;
+    std::atomic<uint64_t> mMallocCalls;
+    std::atomic<uint64_t> mMallocBytes;
+};
+
+struct TagSnapshot {
+    uint64_t mNewCalls{0};
+    uint64_t mNewBytes{0};
+    uint64_t mMallocCalls{0};
+    uint64_t mMallocBytes{0};
+};
+
+// One per (caller address, tag). Slots are claimed with a CAS and never released.
+struct CallSite {
+    std::atomic<uint64_t> mKey;
+    std::atomic<uint64_t> mAllocations;
+    std::atomic<uint64_t> mLiveCount;
+    std::atomic<uint64_t> mLiveBytes;
+};
+
+// All of this is constant-initialized: allocations made by other static
+// constructors can arrive before any of our own code has run.
+std::array<const char*, kMaxTags> gTagNames{"untagged"};
+std::atomic<uint32_t> gTagCount{1};
+std::mutex gTagMutex;
+
+std::array<TagCounters, kMaxTags> gTags;
+std::array<TagSnapshot, kMaxTags> gFrameStart;
+std::array<CallSite, kMaxSites> gSites;
+
+std::atomic<uint64_t> gNewCalls;
+std::atomic<uint64_t> gNewBytes;
+std::atomic<uint64_t> gDeleteCalls;
+std::atomic<uint64_t> gMallocCalls;
+std::atomic<uint64_t> gMallocBytes;
+AllocationCounts gFrameStartTotals;
+
+thread_local uint32_t tCurrentTag{kUntagged};
+
+uint32_t FindSite(const void* caller, uint32_t tag) {
+    // Code addresses fit in 48 bits on every platform we build for
+    const uint64_t key = (reinterpret_cast<uintptr_t>(caller) & 0xFFFF'FFFF'FFFFull) | uint64_t{tag} << 48;
+    uint64_t hash = key * 0x9E37'79B9'7F4A'7C15ull;
+    for (uint32_t probe = 0; probe < kMaxSites; ++probe) {
+        const auto index = static_cast<uint32_t>((hash >> 40) + probe) & (kMaxSites - 1);
+        CallSite& site = gSites[index];
+        uint64_t existing = site.mKey.load(std::memory_order_acquire);
+        if (existing == key) { return index; }
+        if (existing == 0 && site.mKey.compare_exchange_strong(existing, key, std::memory_order_acq_rel)) {
+            return index;
+        }
+        if (existing == key) { return index; }
+    }
+    return kNoSite;
+}
+
+void* AllocateRaw(size_t bytes, size_t alignment) {
+#ifdef ALLOC_HOOK_MALLOC
+    return alignment <= alignof(Header) ? __libc_malloc(bytes) : __libc_memalign(alignment, bytes);
+#else
+    if (alignment <= alignof(Header)) { return std::malloc(bytes); }
+    return std::aligned_alloc(alignment, (bytes + alignment - 1) & ~(alignment - 1));
+#endif
+}
+
+void FreeRaw(void* pointer) {
+#ifdef ALLOC_HOOK_MALLOC
+    __libc_free(pointer);
+#else
+    std::free(pointer);
+#endif
+}
+
+void* TrackedAllocate(size_t bytes, size_t alignment, const void* caller) {
+    const size_t headerBytes = std::max(sizeof(Header), alignment);
+    auto* block = static_cast<std::byte*>(AllocateRaw(bytes + headerBytes, std::max(alignment, alignof(Header))));
+    if (block == nullptr) { return nullptr; }
+
+    const uint32_t tag = tCurrentTag;
+    gNewCalls.fetch_add(1, std::memory_order_relaxed);
+    gNewBytes.fetch_add(bytes, std::memory_order_relaxed);
+    gTags[tag].mNewCalls.fetch_add(1, std::memory_order_relaxed);
+    gTags[tag].mNewBytes.fetch_add(bytes, std::memory_order_relaxed);
+
+    const uint32_t site = FindSite(caller, tag);
+    if (site != kNoSite) {
+        gSites[site].mAllocations.fetch_add(1, std::memory_order_relaxed);
+        gSites[site].mLiveCount.fetch_add(1, std::memory_order_relaxed);
+        gSites[site].mLiveBytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    std::byte* user = block + headerBytes;
+    auto* header = reinterpret_cast<Header*>(user) - 1;
+    header->mBytes = bytes;
+    header->mSite = site;
+    header->mOffset = static_cast<uint32_t>(headerBytes);
+    return user;
+}
+
+void* TrackedAllocateOrThrow(size_t bytes, size_t alignment, const void* caller) {
+    void* pointer = TrackedAllocate(bytes, alignment, caller);
+    if (pointer == nullptr) { throw std::bad_alloc(); }
+    return pointer;
+}
+
+void TrackedFree(void* pointer) {
+    if (pointer == nullptr) { return; }
+
+    const auto* header = static_cast<const Header*>(pointer) - 1;
+    gDeleteCalls.fetch_add(1, std::memory_order_relaxed);
+    if (header->mSite != kNoSite) {
+        gSites[header->mSite].mLiveCount.fetch_sub(1, std::memory_order_relaxed);
+        gSites[header->mSite].mLiveBytes.fetch_sub(header->mBytes, std::memory_order_relaxed);
+    }
+    FreeRaw(static_cast<std::byte*>(pointer) - header->mOffset);
+}
+
+void CountMalloc(size_t bytes) {
+    gMallocCalls.fetch_add(1, std::memory_order_relaxed);
+    gMallocBytes.fetch_add(bytes, std::memory_order_relaxed);
+    gTags[tCurrentTag].mMallocCalls.fetch_add(1, std::memory_order_relaxed);
+    gTags[tCurrentTag].mMallocBytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+TagSnapshot Snapshot(const TagCounters& counters) {
+    return TagSnapshot{
+        counters.mNewCalls.load(std::memory_order_relaxed),
+        counters.mNewBytes.load(std::memory_order_relaxed),
+        counters.mMallocCalls.load(std::memory_order_relaxed),
+        counters.mMallocBytes.load(std::memory_order_relaxed),
+    };
+}
+
+// Function name and offset for a call site, or just the address when there are no symbols
+void PrintSite(const void* address) {
+#ifdef ALLOC_HAVE_DLADDR
+    Dl_info info{};
+    if (dladdr(address, &info) != 0 && info.dli_sname != nullptr) {
+        const auto offset = reinterpret_cast<uintptr_t>(address) - reinterpret_cast<uintptr_t>(info.dli_saddr);
+#ifdef ALLOC_HAVE_DEMANGLE
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        if (status == 0 && demangled != nullptr) {
+            std::println("    at {}+{:#x}", demangled, offset);
+            std::free(demangled);
+            return;
+        }
+#endif
+        std::println("    at {}+{:#x}", info.dli_sname, offset);
+        return;
+    }
+#endif
+    std::println("    at {}", address);
+}
+
+}
+
+uint32_t AllocRegisterTag(const char* name) {
+    std::lock_guard lock{gTagMutex};
+    const uint32_t count = gTagCount.load(std::memory_order_relaxed);
+    for (uint32_t tag = 0; tag < count; ++tag) {
+        if (std::strcmp(gTagNames[tag], name) == 0) { return tag; }
+    }
+    if (count == kMaxTags) {
+        std::println(stderr, "Allocation tracking: too many tags, '{}' counts as untagged", name);
+        return kUntagged;
+    }
+    gTagNames[count] = name;
+    gTagCount.store(count + 1, std::memory_order_release);
+    return count;
+}
+
+AllocScope::AllocScope(uint32_t tag) : mPrevious(tCurrentTag) {
+    tCurrentTag = tag;
+}
+
+AllocScope::~AllocScope() {
+    tCurrentTag = mPrevious;
+}
+
+AllocationCounts AllocTotals() {
+    return AllocationCounts{
+        gNewCalls.load(std::memory_order_relaxed),
+        gNewBytes.load(std::memory_order_relaxed),
+        gDeleteCalls.load(std::memory_order_relaxed),
+        gMallocCalls.load(std::memory_order_relaxed),
+        gMallocBytes.load(std::memory_order_relaxed),
+    };
+}
+
+void AllocBeginFrame() {
+    gFrameStartTotals = AllocTotals();
+    const uint32_t count = gTagCount.load(std::memory_order_acquire);
+    for (uint32_t tag = 0; tag < count; ++tag) {
+        gFrameStart[tag] = Snapshot(gTags[tag]);
+    }
+}
+
+AllocationCounts AllocFrameCounts() {
+    const AllocationCounts now = AllocTotals();
+    return AllocationCounts{
+        now.mNewCalls - gFrameStartTotals.mNewCalls,
+        now.mNewBytes - gFrameStartTotals.mNewBytes,
+        now.mDeleteCalls - gFrameStartTotals.mDeleteCalls,
+        now.mMallocCalls - gFrameStartTotals.mMallocCalls,
+        now.mMallocBytes - gFrameStartTotals.mMallocBytes,
+    };
+}
+
+void AllocPrintFrameReport() {
+    const AllocationCounts frame = AllocFrameCounts();
+    std::println("Heap this frame: {} new ({:.1f} KiB), {} delete, {} malloc ({:.1f} KiB)",
+                 frame.mNewCalls, static_cast<double>(frame.mNewBytes) / kKiB, frame.mDeleteCalls,
+                 frame.mMallocCalls, static_cast<double>(frame.mMallocBytes) / kKiB);
+
+    const uint32_t count = gTagCount.load(std::memory_order_acquire);
+    for (uint32_t tag = 0; tag < count; ++tag) {
+        const TagSnapshot now = Snapshot(gTags[tag]);
+        const TagSnapshot& start = gFrameStart[tag];
+        if (now.mNewCalls == start.mNewCalls && now.mMallocCalls == start.mMallocCalls) { continue; }
+        std::println("  {:<16} {:>6} new ({:>9.1f} KiB) {:>6} malloc ({:>9.1f} KiB)", gTagNames[tag],
+                     now.mNewCalls - start.mNewCalls,
+                     static_cast<double>(now.mNewBytes - start.mNewBytes) / kKiB,
+                     now.mMallocCalls - start.mMallocCalls,
+                     static_cast<double>(now.mMallocBytes - start.mMallocBytes) / kKiB);
+    }
+}
+
+void AllocPrintLeakReport() {
+    // Collected into a fixed array so the report does not allocate while it reads the table
+    static std::array<uint32_t, kMaxSites> live;
+    size_t liveCount = 0;
+    uint64_t liveBytes = 0;
+    for (uint32_t index = 0; index < kMaxSites; ++index) {
+        if (gSites[index].mLiveCount.load(std::memory_order_relaxed) == 0) { continue; }
+        live[liveCount++] = index;
+        liveBytes += gSites[index].mLiveBytes.load(std::memory_order_relaxed);
+    }
+    std::sort(live.begin(), live.begin() + static_cast<std::ptrdiff_t>(liveCount), [](uint32_t a, uint32_t b) {
+        return gSites[a].mLiveBytes.load(std::memory_order_relaxed) > gSites[b].mLiveBytes.load(std::memory_order_relaxed);
+    });
+
+    const AllocationCounts totals = AllocTotals();
+    std::println("Heap over the run: {} new ({:.1f} KiB), {} delete, {} malloc ({:.1f} KiB)",
+                 totals.mNewCalls, static_cast<double>(totals.mNewBytes) / kKiB, totals.mDeleteCalls,
+                 totals.mMallocCalls, static_cast<double>(totals.mMallocBytes) / kKiB);
+    if (liveCount == 0) {
+        std::println("{}", "No allocations made with new are still live");
+        return;
+    }
+
+    // Function statics and library singletons show up here too; anything tagged is ours
+    std::println("Still live at shutdown: {:.1f} KiB from {} call sites", static_cast<double>(liveBytes) / kKiB,
+                 liveCount);
+    for (size_t i = 0; i < liveCount; ++i) {
+        const CallSite& site = gSites[live[i]];
+        const uint64_t key = site.mKey.load(std::memory_order_relaxed);
+        const auto tag = static_cast<uint32_t>(key >> 48);
+        std::println("  {:<16} {:>6} blocks {:>9.1f} KiB (of {} allocations)", gTagNames[tag],
+                     site.mLiveCount.load(std::memory_order_relaxed),
+                     static_cast<double>(site.mLiveBytes.load(std::memory_order_relaxed)) / kKiB,
+                     site.mAllocations.load(std::memory_order_relaxed));
+        PrintSite(reinterpret_cast<const void*>(static_cast<uintptr_t>(key & 0xFFFF'FFFF'FFFFull)));
+    }
+}
+
+// Replacements for every form of the global operator new and delete
+
+void* operator new(size_t bytes) {
+    return TrackedAllocateOrThrow(bytes, alignof(Header), __builtin_return_address(0));
+}
+
+void* operator new[](size_t bytes) {
+    return TrackedAllocateOrThrow(bytes, alignof(Header), __builtin_return_address(0));
+}
+
+void* operator new(size_t bytes, const std::nothrow_t&) noexcept {
+    return TrackedAllocate(bytes, alignof(Header), __builtin_return_address(0));
+}
+
+void* operator new[](size_t bytes, const std::nothrow_t&) noexcept {
+    return TrackedAllocate(bytes, alignof(Header), __builtin_return_address(0));
+}
+
+void* operator new(size_t bytes, std::align_val_t alignment) {
+    return TrackedAllocateOrThrow(bytes, static_cast<size_t>(alignment), __builtin_return_address(0));
+}
+
+void* operator new[](size_t bytes, std::align_val_t alignment) {
+    return TrackedAllocateOrThrow(bytes, static_cast<size_t>(alignment), __builtin_return_address(0));
+}
+
+void* operator new(size_t bytes, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return TrackedAllocate(bytes, static_cast<size_t>(alignment), __builtin_return_address(0));
+}
+
+void* operator new[](size_t bytes, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    return TrackedAllocate(bytes, static_cast<size_t>(alignment), __builtin_return_address(0));
+}
+
+void operator delete(void* pointer) noexcept { TrackedFree(pointer); }
+void operator delete[](void* pointer) noexcept { TrackedFree(pointer); }
+void operator delete(void* pointer, size_t) noexcept { TrackedFree(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { TrackedFree(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { TrackedFree(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { TrackedFree(pointer); }
+void operator delete(void* pointer, std::align_val_t) noexcept { TrackedFree(pointer); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { TrackedFree(pointer); }
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept { TrackedFree(pointer); }
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept { TrackedFree(pointer); }
+void operator delete(void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { TrackedFree(pointer); }
+void operator delete[](void* pointer, std::align_val_t, const std::nothrow_t&) noexcept { TrackedFree(pointer); }
+
+#ifdef ALLOC_HOOK_MALLOC
+
+// C allocations (SDL, the GL driver, libc itself) are counted but not followed to
+// their free, so they show up in the frame counts and not in the leak report.
+extern "C" {
+
+void* malloc(size_t bytes) noexcept {
+    CountMalloc(bytes);
+    return __libc_malloc(bytes);
+}
+
+void* calloc(size_t count, size_t bytes) noexcept {
+    CountMalloc(count * bytes);
+    return __libc_calloc(count, bytes);
+}
+
+void* realloc(void* pointer, size_t bytes) noexcept {
+    CountMalloc(bytes);
+    return __libc_realloc(pointer, bytes);
+}
+
+}
+
+#endif
+
+#endif
@@ -0,0 +1,80 @@
+//
+// Opt-in heap allocation tracking: per-frame counts, tagged scopes and a leak report.
+//
+
+#ifndef ALLOC_TRACKER_H
+#define ALLOC_TRACKER_H
+
+#include <cstdint>
+
+
+// Heap activity since the program started, or over a frame
+struct AllocationCounts {
+    // operator new and delete, from our code and the standard library
+    uint64_t mNewCalls{0};
+    uint64_t mNewBytes{0};
+    uint64_t mDeleteCalls{0};
+    // malloc, calloc and realloc, which is how C libraries and drivers allocate (glibc only)
+    uint64_t mMallocCalls{0};
+    uint64_t mMallocBytes{0};
+
+    uint64_t Allocations() const { return mNewCalls + mMallocCalls; }
+};
+
+#ifdef OPENGLNOTES_TRACK_ALLOCATIONS
+
+// Built with -DOPENGLNOTES_TRACK_ALLOCATIONS=ON. Global operator new and delete are
+// replaced, and on glibc malloc, calloc and realloc are interposed, so that every
+// allocation is counted against the calling thread's innermost ALLOC_SCOPE and the
+// code address it came from.
+
+constexpr bool kAllocationTracking{true};
+
+// Returns the id of a tag, registering it on first use. The name must be a string
+// that lives forever (a literal).
+uint32_t AllocRegisterTag(const char* name);
+
+class AllocScope {
+public:
+    explicit AllocScope(uint32_t tag);
+    ~AllocScope();
+
+    AllocScope(const AllocScope&) = delete;
+    AllocScope& operator=(const AllocScope&) = delete;
+
+private:
+    uint32_t mPrevious;
+};
+
+#define ALLOC_CONCAT_INNER(a, b) a##b
+#define ALLOC_CONCAT(a, b) ALLOC_CONCAT_INNER(a, b)
+#define ALLOC_SCOPE(name)                                                                   \
+    static const uint32_t ALLOC_CONCAT(allocTag, __LINE__){AllocRegisterTag(name)};         \
+    AllocScope ALLOC_CONCAT(allocScope, __LINE__){ALLOC_CONCAT(allocTag, __LINE__)}
+
+AllocationCounts AllocTotals();
+// Starts a new frame for AllocFrameCounts and AllocPrintFrameReport
+void AllocBeginFrame();
+// What the current frame has allocated so far
+AllocationCounts AllocFrameCounts();
+// The current frame's allocations by tag
+void AllocPrintFrameReport();
+// Everything allocated with new that has not been deleted, by tag and call site
+void AllocPrintLeakReport();
+
+#else
+
+constexpr bool kAllocationTracking{false};
+
+#define ALLOC_SCOPE(name) ((void)0)
+
+inline AllocationCounts AllocTotals() { return {}; }
+inline void AllocBeginFrame() {}
+inline AllocationCounts AllocFrameCounts() { return {}; }
+inline void AllocPrintFrameReport() {}
+inline void AllocPrintLeakReport() {}
+
+#endif
+
+
+#endif //ALLOC_TRACKER_H
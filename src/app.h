@@ -9,6 +9,28 @@
 #include <SDL2/SDL.h>
 #include <glad/glad.h>
 #include "camera.h"
+#include "shader_permutations.h"
+#include "shader_watcher.h"
+#include "frame_clock.h"
+#include "profiler.h"
+#include "frame_stats.h"
+#include "headless.h"
+#include "gpu_resources.h"
+#include "render_target.h"
+#include "depth_state.h"
+#include "scene.h"
+#include "draw_list.h"
+#include "job_system.h"
+#include "frame_arena.h"
+#include "frame_uniforms.h"
+#include "transparency.h"
+#include "clustered_lighting.h"
+#include "shadows.h"
+#include "deferred.h"
+#include "render_graph.h"
+#include "dynamic_resolution.h"
+#include "ecs.h"
+#include "systems.h"
 
 
 struct App {
@@ -18,12 +40,118 @@ struct App {
     SDL_Window* mGraphicsAppWindow{nullptr};
     SDL_GLContext mOpenGLContext{nullptr};
 
+    // Headless benchmark mode (--headless): no window, an EGL context rendering
+    // for a fixed number of frames or seconds
+    bool mHeadless{false};
+    int mBenchmarkFrames{0};
+    double mBenchmarkSeconds{0.0};
+    // Fail the run when a frame after warm-up makes more heap allocations than this
+    // (--max-frame-allocations, needs OPENGLNOTES_TRACK_ALLOCATIONS); -1 for no limit
+    int mMaxFrameAllocations{-1};
+    HeadlessContext mHeadlessContext;
+
+    // Every buffer, texture, program and mesh, deleted once the GPU is done with it.
+    // Declared before everything that holds handles into it.
+    GpuResources mResources;
+
+    // The scene is drawn here, with a floating-point depth buffer the window cannot
+    // have, then copied to the window (or just read back when headless)
+    RenderTarget mOffscreenTarget;
+    // Reverse-Z when the driver has glClipControl
+    DepthMode mDepthMode{DepthMode::Standard};
+    // Forward, or deferred through a G-buffer (--renderer)
+    RendererKind mRenderer{RendererKind::Forward};
+    // How much of the offscreen target the scene is drawn into, kept to a GPU frame
+    // time (--dynamic-resolution); the upscale pass then fills the window from it
+    DynamicResolution mDynamicResolution;
+
     // shader
     // The following stores a unique ID for the graphics pipeline
     // program object that will be used for our OpenGL draw calls.
     GLuint mGraphicsPipelineShaderProgram{0};
+    // Every #define variant of our shaders. Reloaded variants are compiled in the
+    // background, and we keep drawing with the current ones until they are ready.
+    ShaderPermutationManager mShaderPermutations;
+    // Positions-only program for the depth pre-pass, from its own pair of shaders
+    ShaderPermutationManager mDepthPermutations;
+    GLuint mDepthPrePassProgram{0};
+    // Positions-only program that draws shadow casters from the light
+    ShaderPermutationManager mShadowPermutations;
+    GLuint mShadowProgram{0};
+    // Full-screen pass of the deferred renderer, frag.glsl with SHADER_FEATURE_DEFERRED_LIGHTING
+    ShaderPermutationManager mDeferredLightingPermutations;
+    GLuint mDeferredLightingProgram{0};
+    // Stretches the dynamic resolution scene over the window
+    ShaderPermutationManager mUpscalePermutations;
+    GLuint mUpscaleProgram{0};
+    // Instanced billboards for the transparent pass, and the order-independent resolve
+    ShaderPermutationManager mBillboardPermutations;
+    ShaderPermutationManager mCompositePermutations;
+    TransparentPrograms mTransparentPrograms;
+    ShaderWatcher mShaderWatcher;
 
     Camera mCamera;
+
+    // Every object in the scene, and the queries the systems run over them
+    World mWorld;
+    SystemQueries mSystemQueries;
+
+    // Generated stress scene, empty unless --scene is given
+    SceneConfig mSceneConfig;
+    Scene mScene;
+
+    // Draw recording
+    // Worker threads cull and record draw commands for chunks of the scene into their
+    // own command list; the main thread merges them and makes the GL calls.
+    // --immediate-draws goes back to one MeshDraw call per object for comparison.
+    bool mImmediateDraws{false};
+    // Lay down depth for all opaque draws first, then shade only the visible surface
+    // (--depth-prepass, Z toggles it while running)
+    bool mDepthPrePass{false};
+    // Number of worker threads, -1 for one per core besides the main thread
+    int mWorkerThreads{-1};
+    JobSystem mJobSystem;
+    // Scratch memory for each job system thread, reset every other frame
+    FrameArena mFrameArena;
+    std::vector<CommandList> mCommandLists;
+    DrawQueue mDrawQueue;
+    // Camera matrices for all programs, written right before the draws are submitted
+    FrameUniformBuffer mFrameUniforms;
+    // Blended billboards, sorted back to front and drawn after the opaque draws
+    TransparentPass mTransparentPass;
+    // Lights binned into view clusters, re-binned every frame with the latched camera
+    ClusteredLighting mClusteredLighting;
+    // Directional light shadows, off unless --shadows or --shadow-resolution is given;
+    // this is each cascade's width and height
+    int mShadowResolution{0};
+    CascadedShadows mShadows;
+    // Full-screen pass that lights the deferred renderer's G-buffer
+    DeferredLighting mDeferredLighting;
+    // The frame's passes, rebuilt every frame; owns the transient targets, like the G-buffer
+    RenderGraph mRenderGraph;
+
+    // Frame pacing
+    // The simulation advances in fixed steps of mFixedTimeStep seconds, and rendering
+    // interpolates between the last two steps by mInterpolationAlpha.
+    float mFixedTimeStep{1.0f / 120.0f};
+    float mInterpolationAlpha{1.0f};
+    FrameClock mFrameClock;
+    // --vsync off|on|adaptive; adaptive vsync falls back to vsync when unsupported
+    SwapInterval mSwapInterval{SwapInterval::Adaptive};
+    // --fps N caps the frame rate; 0 means the swap interval alone decides
+    double mTargetFrameRate{0.0};
+    FrameLimiter mFrameLimiter;
+    // How many frames the CPU may queue ahead of the GPU (--max-frames-in-flight N,
+    // --low-latency for 1). Fewer frames queued means less delay on mouse look.
+    FrameLatencyLimiter mLatencyLimiter;
+
+    // Profiling
+    // Pressing P captures this many frames of CPU and GPU zones
+    GpuProfiler mGpuProfiler;
+    int mProfileCaptureFrames{120};
+    int mProfileFramesRemaining{0};
+    // Draw calls and state changes of the current frame
+    RenderCounters mRenderCounters;
 };
 
 #endif //APP_H
@@ -3,64 +3,137 @@
 //
 
 #include "camera.h"
+
+#include <algorithm>
+#include <cmath>
 #include <print>
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/rotate_vector.hpp>
+
+// Looking straight up or down would leave yaw undefined
+static const float kMaxPitch{glm::radians(89.0f)};
 
 Camera::Camera() {
     // Assume the view is placed at the origin
     mEye = glm::vec3(0.0f, 0.0f, 0.0f);
-    // Starting view direction for starting at the world
-    mViewDirection = glm::vec3(0.0f, 0.0f, -1.0f);
+    mPreviousEye = mEye;
+    mRenderEye = mEye;
     // Assume a perfect plane
     mUpVector = glm::vec3(0.0f, 1.0f, 0.0f);
+    mProjectionMatrix = glm::mat4(1.0f);
+    // Starting view direction for starting at the world is -Z
+    UpdateOrientation();
+}
+
+const glm::mat4& Camera::GetViewMatrix() const {
+    if (mDirty & kViewDirty) {
+        // The inverse of placing the camera: undo the translation, then the rotation
+        mViewMatrix = glm::mat4_cast(glm::conjugate(mOrientation)) * glm::translate(glm::mat4(1.0f), -mRenderEye);
+        mDirty &= ~kViewDirty;
+    }
+    return mViewMatrix;
 }
 
-glm::mat4 Camera::GetViewMatrix() const {
-    return glm::lookAt(mEye, mEye + mViewDirection, mUpVector);
+const glm::mat4& Camera::GetViewProjectionMatrix() const {
+    if (mDirty & kViewProjectionDirty) {
+        mViewProjectionMatrix = mProjectionMatrix * GetViewMatrix();
+        mDirty &= ~kViewProjectionDirty;
+    }
+    return mViewProjectionMatrix;
 }
 
+const glm::mat4& Camera::GetInverseViewMatrix() const {
+    if (mDirty & kInverseViewDirty) {
+        // Rotation and translation only, so no general inverse is needed
+        mInverseViewMatrix = glm::translate(glm::mat4(1.0f), mRenderEye) * glm::mat4_cast(mOrientation);
+        mDirty &= ~kInverseViewDirty;
+    }
+    return mInverseViewMatrix;
+}
 
-glm::mat4 Camera::GetProjectionMatrix() const {
-    return mProjectionMatrix;
+const glm::mat4& Camera::GetInverseViewProjectionMatrix() const {
+    if (mDirty & kInverseViewProjectionDirty) {
+        mInverseViewProjectionMatrix = glm::inverse(GetViewProjectionMatrix());
+        mDirty &= ~kInverseViewProjectionDirty;
+    }
+    return mInverseViewProjectionMatrix;
 }
 
-void Camera::SetProjectionMatrix(float fovy, float aspect, float near, float far) {
-    mProjectionMatrix = glm::perspective(fovy, aspect, near, far);
+void Camera::SetProjectionMatrix(float fovy, float aspect, float near, float far, DepthMode depthMode) {
+    mDepthMode = depthMode;
+
+    // Clip z = depthScale * view z + depthOffset and clip w = -view z; x and y as usual
+    const float focalLength = 1.0f / std::tan(fovy / 2.0f);
+    float depthScale;
+    float depthOffset;
+    if (depthMode == DepthMode::ReverseZ) {
+        // 1 at the near plane, 0 at the far plane; with no far plane, just near / distance
+        depthScale = std::isinf(far) ? 0.0f : near / (far - near);
+        depthOffset = std::isinf(far) ? near : far * near / (far - near);
+    } else {
+        depthScale = std::isinf(far) ? -1.0f : -(far + near) / (far - near);
+        depthOffset = std::isinf(far) ? -2.0f * near : -2.0f * far * near / (far - near);
+    }
+
+    mProjectionMatrix = glm::mat4(0.0f);
+    mProjectionMatrix[0][0] = focalLength / aspect;
+    mProjectionMatrix[1][1] = focalLength;
+    mProjectionMatrix[2][2] = depthScale;
+    mProjectionMatrix[2][3] = -1.0f;
+    mProjectionMatrix[3][2] = depthOffset;
+    mDirty |= kViewProjectionDirty | kInverseViewProjectionDirty;
 }
 
 void Camera::MouseLook(int mouseX, int mouseY) {
     const glm::vec2 currentMousePosition = glm::vec2(mouseX, mouseY);
 
-    static bool firstLook = true;
-    if (firstLook) {
+    if (mFirstLook) {
         mOldMousePosition = currentMousePosition;
-        firstLook = false;
+        mFirstLook = false;
     }
 
-
     const glm::vec2 mouseDelta = mOldMousePosition - currentMousePosition;
-    mViewDirection = glm::rotate(mViewDirection, glm::radians(mouseDelta.x), mUpVector);
-
     mOldMousePosition = currentMousePosition;
+    if (mouseDelta.x != 0.0f || mouseDelta.y != 0.0f) {
+        Rotate(glm::radians(mouseDelta.x), glm::radians(mouseDelta.y));
+    }
+}
+
+void Camera::Rotate(const float yawRadians, const float pitchRadians) {
+    mYaw += yawRadians;
+    mPitch = std::clamp(mPitch + pitchRadians, -kMaxPitch, kMaxPitch);
+    UpdateOrientation();
+}
+
+void Camera::UpdateOrientation() {
+    mOrientation = glm::angleAxis(mYaw, mUpVector) * glm::angleAxis(mPitch, glm::vec3(1.0f, 0.0f, 0.0f));
+    mDirty = kAllDirty;
 }
 
 
 void Camera::MoveForward(const float speed) {
-    mEye += (mViewDirection * speed);
+    mEye += (GetViewDirection() * speed);
 }
 
 void Camera::MoveBackward(const float speed) {
-    mEye -= (mViewDirection * speed);
+    mEye -= (GetViewDirection() * speed);
 }
 
 void Camera::MoveLeft(const float speed) {
-    glm::vec3 rightVector = glm::cross(mViewDirection, mUpVector);
-
-    mEye -= rightVector * speed;
+    mEye -= GetRightVector() * speed;
 }
 
 void Camera::MoveRight(const float speed) {
-    glm::vec3 rightVector = glm::cross(mViewDirection, mUpVector);
-    mEye += rightVector * speed;
+    mEye += GetRightVector() * speed;
+}
+
+void Camera::StoreState() {
+    mPreviousEye = mEye;
+}
+
+void Camera::Interpolate(const float alpha) {
+    // Moving changes mEye only; the matrices follow once the rendered position does
+    const glm::vec3 renderEye = glm::mix(mPreviousEye, mEye, alpha);
+    if (renderEye != mRenderEye) {
+        mRenderEye = renderEye;
+        mDirty = kAllDirty;
+    }
 }
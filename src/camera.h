@@ -5,34 +5,93 @@
 #ifndef CAMERA_H
 #define CAMERA_H
 
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <glm/ext/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 
 
+/**
+ * How depth is laid out in clip space. Standard is OpenGL's default: z/w from -1 at
+ * the near plane to 1 at the far plane. ReverseZ maps the near plane to 1 and the far
+ * plane to 0 in a [0, 1] range (glClipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE)), which
+ * spreads the precision of a floating-point depth buffer evenly over distance.
+ */
+enum class DepthMode : uint8_t { Standard, ReverseZ };
+
+/**
+ * First person camera: a position and a yaw/pitch orientation kept as a quaternion.
+ * The matrices are cached and only rebuilt, on first use, after something they
+ * depend on has changed, so asking for them once per draw costs a copy.
+ */
 class Camera {
 public:
     Camera();
-    glm::mat4 GetViewMatrix() const;
-    glm::mat4 GetProjectionMatrix() const;
+    const glm::mat4& GetViewMatrix() const;
+    const glm::mat4& GetProjectionMatrix() const { return mProjectionMatrix; }
+    // Projection * view
+    const glm::mat4& GetViewProjectionMatrix() const;
+    const glm::mat4& GetInverseViewMatrix() const;
+    const glm::mat4& GetInverseViewProjectionMatrix() const;
 
-    void SetProjectionMatrix(float fovy, float aspect, float near, float far);
+    // A far plane of infinity puts the far plane at infinity
+    void SetProjectionMatrix(float fovy, float aspect, float near, float far,
+                             DepthMode depthMode = DepthMode::Standard);
+    DepthMode GetDepthMode() const { return mDepthMode; }
 
+    // Turns by the mouse movement since the last call, a degree per pixel. The first
+    // call only records where the mouse is.
     void MouseLook(int mouseX, int mouseY);
+    // Adds to yaw (about the world up axis) and pitch; pitch stops short of straight up or down
+    void Rotate(float yawRadians, float pitchRadians);
     void MoveForward(float speed);
     void MoveBackward(float speed);
     void MoveLeft(float speed);
     void MoveRight(float speed);
 
+    glm::vec3 GetViewDirection() const { return mOrientation * glm::vec3(0.0f, 0.0f, -1.0f); }
+    glm::vec3 GetRightVector() const { return mOrientation * glm::vec3(1.0f, 0.0f, 0.0f); }
+
+    // Fixed-step interpolation: StoreState before a simulation step,
+    // Interpolate before rendering
+    void StoreState();
+    void Interpolate(float alpha);
+
 private:
+    enum DirtyFlags : uint8_t {
+        kViewDirty = 1 << 0,
+        kViewProjectionDirty = 1 << 1,
+        kInverseViewDirty = 1 << 2,
+        kInverseViewProjectionDirty = 1 << 3,
+        // Everything that depends on the view
+        kAllDirty = kViewDirty | kViewProjectionDirty | kInverseViewDirty | kInverseViewProjectionDirty,
+    };
+
+    void UpdateOrientation();
 
     glm::mat4 mProjectionMatrix;
+    DepthMode mDepthMode{DepthMode::Standard};
 
     glm::vec3 mEye;
-    glm::vec3 mViewDirection;
+    glm::vec3 mPreviousEye;
+    // Eye position used for rendering, between mPreviousEye and mEye
+    glm::vec3 mRenderEye;
     glm::vec3 mUpVector;
 
+    float mYaw{0.0f};
+    float mPitch{0.0f};
+    // Yaw about mUpVector, then pitch about the camera's right; -Z is forward
+    glm::quat mOrientation;
 
     glm::vec2 mOldMousePosition;
+    bool mFirstLook{true};
+
+    // Built on demand from the state above
+    mutable uint8_t mDirty{kAllDirty};
+    mutable glm::mat4 mViewMatrix{1.0f};
+    mutable glm::mat4 mViewProjectionMatrix{1.0f};
+    mutable glm::mat4 mInverseViewMatrix{1.0f};
+    mutable glm::mat4 mInverseViewProjectionMatrix{1.0f};
 };
 
 
@@ -0,0 +1,324 @@
+//
+// Clustered forward lighting: lights binned into view frustum froxels on the CPU, looked up per fragment.
+//
+
+#include "clustered_lighting.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+#include "profiler.h"
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CLUSTERED_LIGHTING_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define CLUSTERED_LIGHTING_NEON 1
+#endif
+
+static_assert(sizeof(Light) == 12 * sizeof(GLfloat), "Light is uploaded as three vec4 texels");
+
+// Texture buffers start at this size, so the shaders always have something to read
+static constexpr size_t kMinBufferBytes{4096};
+// Padding lanes: so far away that no box reaches them
+static constexpr float kFarAwayLane{1e18f};
+
+namespace {
+
+/**
+ * Which of four spheres touch the box: bit i for sphere i. A sphere touches the box
+ * when the squared distance from its center to the nearest point of the box is at
+ * most its squared radius.
+ */
+uint32_t SpheresTouchBox4(const float* x, const float* y, const float* z, const float* radius,
+                          const ClusterBounds& box) {
+#if CLUSTERED_LIGHTING_SSE2
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 cx = _mm_loadu_ps(x);
+    const __m128 cy = _mm_loadu_ps(y);
+    const __m128 cz = _mm_loadu_ps(z);
+    const __m128 r = _mm_loadu_ps(radius);
+    const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(box.mMin.x), cx),
+                                            _mm_sub_ps(cx, _mm_set1_ps(box.mMax.x))), zero);
+    const __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(box.mMin.y), cy),
+                                            _mm_sub_ps(cy, _mm_set1_ps(box.mMax.y))), zero);
+    const __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_set1_ps(box.mMin.z), cz),
+                                            _mm_sub_ps(cz, _mm_set1_ps(box.mMax.z))), zero);
+    const __m128 distanceSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                                              _mm_mul_ps(dz, dz));
+    return static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(distanceSquared, _mm_mul_ps(r, r))));
+#elif CLUSTERED_LIGHTING_NEON
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t cx = vld1q_f32(x);
+    const float32x4_t cy = vld1q_f32(y);
+    const float32x4_t cz = vld1q_f32(z);
+    const float32x4_t r = vld1q_f32(radius);
+    const float32x4_t dx = vmaxq_f32(vmaxq_f32(vsubq_f32(vdupq_n_f32(box.mMin.x), cx),
+                                               vsubq_f32(cx, vdupq_n_f32(box.mMax.x))), zero);
+    const float32x4_t dy = vmaxq_f32(vmaxq_f32(vsubq_f32(vdupq_n_f32(box.mMin.y), cy),
+                                               vsubq_f32(cy, vdupq_n_f32(box.mMax.y))), zero);
+    const float32x4_t dz = vmaxq_f32(vmaxq_f32(vsubq_f32(vdupq_n_f32(box.mMin.z), cz),
+                                               vsubq_f32(cz, vdupq_n_f32(box.mMax.z))), zero);
+    const float32x4_t distanceSquared = vmlaq_f32(vmlaq_f32(vmulq_f32(dx, dx), dy, dy), dz, dz);
+    const uint32x4_t touches = vcleq_f32(distanceSquared, vmulq_f32(r, r));
+    const uint32_t laneBits[4]{1, 2, 4, 8};
+    return vaddvq_u32(vandq_u32(touches, vld1q_u32(laneBits)));
+#else
+    uint32_t mask{0};
+    for (int lane = 0; lane < 4; ++lane) {
+        const float dx = std::max({box.mMin.x - x[lane], x[lane] - box.mMax.x, 0.0f});
+        const float dy = std::max({box.mMin.y - y[lane], y[lane] - box.mMax.y, 0.0f});
+        const float dz = std::max({box.mMin.z - z[lane], z[lane] - box.mMax.z, 0.0f});
+        if (dx * dx + dy * dy + dz * dz <= radius[lane] * radius[lane]) {
+            mask |= 1u << lane;
+        }
+    }
+    return mask;
+#endif
+}
+
+// View depth where slice begins; slices grow exponentially so each is about as deep as it is wide
+float SliceNearDepth(uint32_t slice, float nearDepth) {
+    return nearDepth * std::pow(kClusterFarDepth / nearDepth, static_cast<float>(slice) / kClusterCountZ);
+}
+
+float SliceFarDepth(uint32_t slice, float nearDepth) {
+    // The last slice takes everything beyond kClusterFarDepth as well
+    return slice + 1 == kClusterCountZ ? 1e30f : SliceNearDepth(slice + 1, nearDepth);
+}
+
+/**
+ * Bounds of every cluster in view space. Assumes a symmetric perspective projection,
+ * where view x = ndc x * depth / projection[0][0], and likewise for y.
+ */
+void BuildClusterBounds(ClusteredLighting* lighting, const glm::mat4& projection, float nearDepth) {
+    lighting->mClusterBounds.resize(kClusterCount);
+    lighting->mBoundsProjection = projection;
+    lighting->mNearDepth = nearDepth;
+
+    for (uint32_t z = 0; z < kClusterCountZ; ++z) {
+        const float sliceNear = SliceNearDepth(z, nearDepth);
+        const float sliceFar = SliceFarDepth(z, nearDepth);
+        for (uint32_t y = 0; y < kClusterCountY; ++y) {
+            const float ndcY0 = -1.0f + 2.0f * static_cast<float>(y) / kClusterCountY;
+            const float ndcY1 = -1.0f + 2.0f * static_cast<float>(y + 1) / kClusterCountY;
+            for (uint32_t x = 0; x < kClusterCountX; ++x) {
+                const float ndcX0 = -1.0f + 2.0f * static_cast<float>(x) / kClusterCountX;
+                const float ndcX1 = -1.0f + 2.0f * static_cast<float>(x + 1) / kClusterCountX;
+
+                // The tile's edges move apart with depth, so the extremes are at either end
+                ClusterBounds& bounds = lighting->mClusterBounds[x + kClusterCountX * (y + kClusterCountY * z)];
+                const float xs[4]{ndcX0 * sliceNear, ndcX1 * sliceNear, ndcX0 * sliceFar, ndcX1 * sliceFar};
+                const float ys[4]{ndcY0 * sliceNear, ndcY1 * sliceNear, ndcY0 * sliceFar, ndcY1 * sliceFar};
+                bounds.mMin = glm::vec3(*std::min_element(xs, xs + 4) / projection[0][0],
+                                        *std::min_element(ys, ys + 4) / projection[1][1],
+                                        -sliceFar);
+                bounds.mMax = glm::vec3(*std::max_element(xs, xs + 4) / projection[0][0],
+                                        *std::max_element(ys, ys + 4) / projection[1][1],
+                                        -sliceNear);
+            }
+        }
+    }
+}
+
+/**
+ * Bin the lights of one depth slice: find the lights that reach into the slice's
+ * depth range, then test them four at a time against each of its clusters.
+ */
+void BinSlice(ClusteredLighting* lighting, uint32_t z) {
+    ClusterSlice& slice = lighting->mSlices[z];
+    const float sliceNear = SliceNearDepth(z, lighting->mNearDepth);
+    const float sliceFar = SliceFarDepth(z, lighting->mNearDepth);
+
+    slice.mX.clear();
+    slice.mY.clear();
+    slice.mZ.clear();
+    slice.mRadius.clear();
+    slice.mCandidates.clear();
+    for (size_t light = 0; light < lighting->mViewSpheres.size(); ++light) {
+        const glm::vec4& sphere = lighting->mViewSpheres[light];
+        const float depth = -sphere.z;
+        if (depth + sphere.w < sliceNear || depth - sphere.w > sliceFar) { continue; }
+        slice.mX.push_back(sphere.x);
+        slice.mY.push_back(sphere.y);
+        slice.mZ.push_back(sphere.z);
+        slice.mRadius.push_back(sphere.w);
+        slice.mCandidates.push_back(static_cast<uint16_t>(light));
+    }
+    while (slice.mX.size() % 4 != 0) {
+        slice.mX.push_back(kFarAwayLane);
+        slice.mY.push_back(kFarAwayLane);
+        slice.mZ.push_back(kFarAwayLane);
+        slice.mRadius.push_back(0.0f);
+    }
+
+    constexpr uint32_t clustersPerSlice{kClusterCountX * kClusterCountY};
+    slice.mIndices.clear();
+    slice.mOffsets.resize(clustersPerSlice);
+    slice.mCounts.resize(clustersPerSlice);
+    const ClusterBounds* bounds = &lighting->mClusterBounds[z * clustersPerSlice];
+    for (uint32_t cluster = 0; cluster < clustersPerSlice; ++cluster) {
+        const size_t first = slice.mIndices.size();
+        slice.mOffsets[cluster] = static_cast<uint32_t>(first);
+        for (size_t group = 0; group < slice.mX.size(); group += 4) {
+            uint32_t mask = SpheresTouchBox4(&slice.mX[group], &slice.mY[group], &slice.mZ[group],
+                                             &slice.mRadius[group], bounds[cluster]);
+            while (mask != 0) {
+                const int lane = std::countr_zero(mask);
+                mask &= mask - 1;
+                slice.mIndices.push_back(slice.mCandidates[group + lane]);
+            }
+        }
+        const size_t count = std::min<size_t>(slice.mIndices.size() - first, kMaxLightsPerCluster);
+        slice.mIndices.resize(first + count);
+        slice.mCounts[cluster] = static_cast<uint32_t>(count);
+    }
+}
+
+/**
+ * Replace the buffer's contents, growing it when needed. The old storage is orphaned
+ * rather than overwritten, so the GPU can still be reading last frame's.
+ */
+void UploadLightingBuffer(LightingBuffer* buffer, GpuResources* resources, const void* data, size_t bytes) {
+    if (buffer->mBuffer.IsNull() || bytes > buffer->mCapacity) {
+        resources->Release(buffer->mBuffer);
+        const size_t capacity = std::max(bytes + bytes / 2, kMinBufferBytes);
+        buffer->mBuffer = resources->CreateBuffer(GL_TEXTURE_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+        buffer->mCapacity = buffer->mBuffer.IsNull() ? 0 : capacity;
+        glBindTexture(GL_TEXTURE_BUFFER, buffer->mTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, buffer->mFormat, resources->Name(buffer->mBuffer));
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    } else {
+        glBindBuffer(GL_TEXTURE_BUFFER, resources->Name(buffer->mBuffer));
+        glBufferData(GL_TEXTURE_BUFFER, static_cast<GLsizeiptr>(buffer->mCapacity), nullptr, GL_STREAM_DRAW);
+    }
+    if (bytes > 0 && bytes <= buffer->mCapacity) {
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, static_cast<GLsizeiptr>(bytes), data);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+}
+
+bool ClusteredLightingCreate(ClusteredLighting* lighting) {
+    LightingBuffer* buffers[]{&lighting->mLightData, &lighting->mClusterGridBuffer, &lighting->mLightIndexBuffer};
+    constexpr GLenum formats[]{GL_RGBA32F, GL_RG32UI, GL_R16UI};
+    for (size_t i = 0; i < 3; ++i) {
+        glGenTextures(1, &buffers[i]->mTexture);
+        buffers[i]->mFormat = formats[i];
+        if (buffers[i]->mTexture == 0) { return false; }
+    }
+    lighting->mSlices.resize(kClusterCountZ);
+    lighting->mClusterGrid.assign(kClusterCount * 2, 0);
+    return true;
+}
+
+void ClusteredLightingGather(ClusteredLighting* lighting, World& world, Query& query) {
+    PROFILE_FUNCTION();
+    lighting->mLights.clear();
+    world.ForEachChunk(query, [&](const ChunkView& chunk) {
+        const Light* lights = chunk.Column<Light>();
+        const size_t room = kMaxClusteredLights - lighting->mLights.size();
+        lighting->mLights.insert(lighting->mLights.end(), lights, lights + std::min(chunk.Count(), room));
+    });
+}
+
+void ClusteredLightingBin(ClusteredLighting* lighting, const glm::mat4& view, const glm::mat4& projection,
+                          const float nearDepth, JobSystem* jobs) {
+    PROFILE_FUNCTION();
+
+    if (lighting->mClusterBounds.empty() || projection != lighting->mBoundsProjection ||
+        nearDepth != lighting->mNearDepth) {
+        BuildClusterBounds(lighting, projection, nearDepth);
+    }
+    lighting->mSlices.resize(kClusterCountZ);
+
+    lighting->mViewSpheres.resize(lighting->mLights.size());
+    for (size_t i = 0; i < lighting->mLights.size(); ++i) {
+        const Light& light = lighting->mLights[i];
+        lighting->mViewSpheres[i] = glm::vec4(glm::vec3(view * glm::vec4(light.mPosition, 1.0f)), light.mRange);
+    }
+
+    if (jobs != nullptr) {
+        jobs->ParallelFor(kClusterCountZ, 1, [&](size_t begin, size_t end, size_t) {
+            for (size_t z = begin; z < end; ++z) {
+                BinSlice(lighting, static_cast<uint32_t>(z));
+            }
+        });
+    } else {
+        for (uint32_t z = 0; z < kClusterCountZ; ++z) {
+            BinSlice(lighting, z);
+        }
+    }
+
+    // Stitch the slices together into one index list
+    lighting->mClusterGrid.resize(kClusterCount * 2);
+    lighting->mLightIndices.clear();
+    constexpr uint32_t clustersPerSlice{kClusterCountX * kClusterCountY};
+    for (uint32_t z = 0; z < kClusterCountZ; ++z) {
+        const ClusterSlice& slice = lighting->mSlices[z];
+        const auto base = static_cast<uint32_t>(lighting->mLightIndices.size());
+        for (uint32_t cluster = 0; cluster < clustersPerSlice; ++cluster) {
+            uint32_t* grid = &lighting->mClusterGrid[(z * clustersPerSlice + cluster) * 2];
+            grid[0] = base + slice.mOffsets[cluster];
+            grid[1] = slice.mCounts[cluster];
+        }
+        lighting->mLightIndices.insert(lighting->mLightIndices.end(), slice.mIndices.begin(), slice.mIndices.end());
+    }
+}
+
+void ClusteredLightingUpload(ClusteredLighting* lighting, GpuResources* resources) {
+    PROFILE_FUNCTION();
+    UploadLightingBuffer(&lighting->mLightData, resources, lighting->mLights.data(),
+                         lighting->mLights.size() * sizeof(Light));
+    UploadLightingBuffer(&lighting->mClusterGridBuffer, resources, lighting->mClusterGrid.data(),
+                         lighting->mClusterGrid.size() * sizeof(uint32_t));
+    UploadLightingBuffer(&lighting->mLightIndexBuffer, resources, lighting->mLightIndices.data(),
+                         lighting->mLightIndices.size() * sizeof(uint16_t));
+
+    // Left bound for the frame; nothing else uses these units
+    glActiveTexture(GL_TEXTURE0 + kLightDataTextureUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, lighting->mLightData.mTexture);
+    glActiveTexture(GL_TEXTURE0 + kClusterGridTextureUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, lighting->mClusterGridBuffer.mTexture);
+    glActiveTexture(GL_TEXTURE0 + kLightIndexTextureUnit);
+    glBindTexture(GL_TEXTURE_BUFFER, lighting->mLightIndexBuffer.mTexture);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void ClusteredLightingFillUniforms(const ClusteredLighting& lighting, const int width, const int height,
+                                   FrameUniforms* uniforms) {
+    // slice = log(depth) * scale + bias inverts SliceNearDepth
+    const float logDepthRange = std::log(kClusterFarDepth / lighting.mNearDepth);
+    // Fractional tiles, so that the shader splits the screen exactly where
+    // BuildClusterBounds splits clip space
+    const float tileWidth = static_cast<float>(std::max(width, 1)) / kClusterCountX;
+    const float tileHeight = static_cast<float>(std::max(height, 1)) / kClusterCountY;
+    uniforms->mClusterScale = glm::vec4(1.0f / tileWidth,
+                                        1.0f / tileHeight,
+                                        kClusterCountZ / logDepthRange,
+                                        -kClusterCountZ * std::log(lighting.mNearDepth) / logDepthRange);
+    uniforms->mClusterCounts = glm::uvec4(kClusterCountX, kClusterCountY, kClusterCountZ,
+                                          static_cast<uint32_t>(lighting.mLights.size()));
+}
+
+void ClusteredLightingDelete(GpuResources* resources, ClusteredLighting* lighting) {
+    for (LightingBuffer* buffer : {&lighting->mLightData, &lighting->mClusterGridBuffer,
+                                   &lighting->mLightIndexBuffer}) {
+        resources->Release(buffer->mBuffer);
+        glDeleteTextures(1, &buffer->mTexture);
+    }
+    *lighting = ClusteredLighting{};
+}
+
+void BindClusteredLightingSamplers(const GLuint program) {
+    const GLint lightData = glGetUniformLocation(program, "u_LightData");
+    const GLint clusterGrid = glGetUniformLocation(program, "u_ClusterGrid");
+    const GLint lightIndices = glGetUniformLocation(program, "u_LightIndices");
+    if (lightData != -1) { glUniform1i(lightData, kLightDataTextureUnit); }
+    if (clusterGrid != -1) { glUniform1i(clusterGrid, kClusterGridTextureUnit); }
+    if (lightIndices != -1) { glUniform1i(lightIndices, kLightIndexTextureUnit); }
+}
@@ -0,0 +1,118 @@
+//
+// Clustered forward lighting: lights binned into view frustum froxels on the CPU, looked up per fragment.
+//
+
+#ifndef CLUSTERED_LIGHTING_H
+#define CLUSTERED_LIGHTING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "components.h"
+#include "ecs.h"
+#include "frame_uniforms.h"
+#include "gpu_resources.h"
+#include "job_system.h"
+
+
+// The view frustum is cut into this many clusters across, down and in depth
+constexpr uint32_t kClusterCountX{16};
+constexpr uint32_t kClusterCountY{9};
+constexpr uint32_t kClusterCountZ{24};
+constexpr uint32_t kClusterCount{kClusterCountX * kClusterCountY * kClusterCountZ};
+// Depth slices grow exponentially from the near plane to here; anything farther
+// shares the last slice. The projection's far plane may be infinite, so it is not used.
+constexpr float kClusterFarDepth{100.0f};
+// Lights past this in one cluster are dropped
+constexpr uint32_t kMaxLightsPerCluster{256};
+// Light indices are 16 bit
+constexpr size_t kMaxClusteredLights{65535};
+
+// Texture units the shaders read the light data, cluster grid and light indices from
+constexpr GLint kLightDataTextureUnit{4};
+constexpr GLint kClusterGridTextureUnit{5};
+constexpr GLint kLightIndexTextureUnit{6};
+
+// View space bounding box of one cluster
+struct ClusterBounds {
+    glm::vec3 mMin;
+    glm::vec3 mMax;
+};
+
+// One depth slice's share of the binning, filled by whichever thread bins it
+struct ClusterSlice {
+    // Lights that reach into the slice's depth range: view space centers and radii,
+    // as separate arrays padded to a multiple of four for the SIMD test
+    std::vector<float> mX;
+    std::vector<float> mY;
+    std::vector<float> mZ;
+    std::vector<float> mRadius;
+    std::vector<uint16_t> mCandidates;
+    // Each cluster's light indices, one cluster after the other
+    std::vector<uint16_t> mIndices;
+    // Where each cluster's indices start in mIndices, and how many there are
+    std::vector<uint32_t> mOffsets;
+    std::vector<uint32_t> mCounts;
+};
+
+// A texture buffer: a buffer object viewed as a 1D texture of one format
+struct LightingBuffer {
+    BufferHandle mBuffer{};
+    GLuint mTexture{0};
+    GLenum mFormat{0};
+    size_t mCapacity{0};
+};
+
+/**
+ * Lights are gathered from the world and binned into clusters on the job system, one
+ * depth slice per job, with a four-wide sphere against box test. The shaders find a
+ * fragment's cluster from its window position and view depth and loop over only the
+ * lights listed for it, so the cost per fragment follows the lights nearby rather
+ * than the lights in the scene. CPU storage is kept between frames.
+ */
+struct ClusteredLighting {
+    // Every light this frame, in world space; uploaded as is
+    std::vector<Light> mLights;
+
+    // This frame's lights in view space: center and radius
+    std::vector<glm::vec4> mViewSpheres;
+
+    // Cluster bounds for mBoundsProjection, x fastest, then y, then depth
+    std::vector<ClusterBounds> mClusterBounds;
+    glm::mat4 mBoundsProjection{0.0f};
+    float mNearDepth{0.1f};
+
+    std::vector<ClusterSlice> mSlices;
+    // For each cluster: offset into mLightIndices and count
+    std::vector<uint32_t> mClusterGrid;
+    std::vector<uint16_t> mLightIndices;
+
+    LightingBuffer mLightData;
+    LightingBuffer mClusterGridBuffer;
+    LightingBuffer mLightIndexBuffer;
+};
+
+bool ClusteredLightingCreate(ClusteredLighting* lighting);
+// Copies the lights out of the world
+void ClusteredLightingGather(ClusteredLighting* lighting, World& world, Query& query);
+/**
+ * Assign the gathered lights to the clusters of the view and projection. nearDepth is
+ * the projection's near plane. jobs may be null to bin on this thread.
+ */
+void ClusteredLightingBin(ClusteredLighting* lighting, const glm::mat4& view, const glm::mat4& projection,
+                          float nearDepth, JobSystem* jobs);
+// Uploads the lights and bins and binds them to their texture units
+void ClusteredLightingUpload(ClusteredLighting* lighting, GpuResources* resources);
+// The cluster parameters the shaders need, for a target of width x height
+void ClusteredLightingFillUniforms(const ClusteredLighting& lighting, int width, int height,
+                                   FrameUniforms* uniforms);
+void ClusteredLightingDelete(GpuResources* resources, ClusteredLighting* lighting);
+
+// Points the program's light samplers at their texture units; the program must be in use
+void BindClusteredLightingSamplers(GLuint program);
+
+
+#endif //CLUSTERED_LIGHTING_H
@@ -0,0 +1,136 @@
+//
+// Components of the objects in the world, and the model matrices built from them.
+//
+
+#ifndef COMPONENTS_H
+#define COMPONENTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "gpu_handles.h"
+#include "shader_permutations.h"
+#include "transform.h"
+
+
+// Where an object is at the current simulation step
+struct LocalTransform {
+    Transform mPosition{};
+    // Rotation about the y axis, in degrees
+    float mRotate{0.0f};
+    float mScale{0.5f};
+};
+
+// Where it was at the previous step, so rendering can interpolate between fixed steps.
+// Objects without one never move, and their WorldMatrix is only set when they are created.
+struct PreviousTransform {
+    Transform mPosition{};
+    float mRotate{0.0f};
+};
+
+// The model matrix used for culling and drawing this frame
+struct WorldMatrix {
+    glm::mat4 mMatrix{1.0f};
+};
+
+/**
+ * What to draw. The GL names are copied from the Mesh3D that owns them so that
+ * recording draws does not have to follow a pointer per object.
+ */
+struct MeshInstance {
+    // Copied from the mesh, so recording draws never looks it up
+    MeshHandle mMesh{};
+    GLuint mVertexArray{0};
+    GLsizei mIndexCount{0};
+    GLint mBaseVertex{0};
+    GLuint mIndexOffset{0};
+    // Position-only stream for the depth pre-pass
+    GLuint mDepthVertexArray{0};
+    GLint mPositionBaseVertex{0};
+    // Pipeline for mShaderVariant, set by the shader permutation manager
+    GLuint mPipeline{0};
+    ShaderVariantKey mShaderVariant{SHADER_FEATURE_NONE};
+};
+
+/**
+ * A camera-facing square drawn with alpha blending, e.g. a particle. Blended objects
+ * have no MeshInstance: they are drawn after everything opaque, back to front, by the
+ * transparent pass, which uploads this struct as is as per-instance vertex data.
+ */
+struct Billboard {
+    glm::vec3 mPosition{0.0f};
+    // Half the width of the square, in world units
+    float mSize{0.05f};
+    // Straight (not premultiplied) alpha
+    glm::vec4 mColor{1.0f};
+};
+
+// Blend this billboard with weighted blended order-independent transparency rather
+// than sorting it: cheaper and right where objects intersect, but only approximate
+struct OrderIndependent {};
+
+/**
+ * A point or spot light for clustered forward shading. Uploaded as is, three vec4
+ * texels per light, so keep the layout. Point lights leave the spot cosines alone:
+ * -2 and -1 accept every direction.
+ */
+struct Light {
+    glm::vec3 mPosition{0.0f};
+    // Distance at which the light has faded out completely
+    float mRange{1.0f};
+    glm::vec3 mColor{1.0f};
+    // Cosine of the angle from mDirection where a spot light's cone ends
+    float mSpotCosOuter{-2.0f};
+    glm::vec3 mDirection{0.0f, 0.0f, -1.0f};
+    // Cosine of the angle where the cone starts to fade out
+    float mSpotCosInner{-1.0f};
+};
+
+// A light infinitely far away, like the sun; the first one casts shadows
+struct DirectionalLight {
+    // The way the light travels
+    glm::vec3 mDirection{0.0f, -1.0f, 0.0f};
+    glm::vec3 mColor{1.0f};
+};
+
+// Moves a light in a horizontal circle
+struct LightOrbit {
+    glm::vec3 mCenter{0.0f};
+    float mRadius{1.0f};
+    float mRadiansPerSecond{1.0f};
+    float mAngle{0.0f};
+};
+
+// Turns about the y axis at a constant rate
+struct Spin {
+    float mDegreesPerSecond{0.0f};
+};
+
+// Moved with the arrow keys
+struct PlayerControlled {};
+
+inline glm::mat4 MakeModelMatrix(const Transform& position, float rotate, float scale) {
+    // Model transformation by translating our object into world space
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(position.x, position.y, position.z));
+    model = glm::rotate(model, glm::radians(rotate), glm::vec3(0.0f, 1.0f, 0.0f));
+    // Update the model matrix by applying a rotation after our translation
+    return glm::scale(model, glm::vec3(scale, scale, scale));
+}
+
+inline glm::mat4 MakeModelMatrix(const LocalTransform& transform) {
+    return MakeModelMatrix(transform.mPosition, transform.mRotate, transform.mScale);
+}
+
+/**
+ * Build the model matrix interpolated between the previous and the current
+ * simulation step by alpha.
+ */
+inline glm::mat4 MakeModelMatrix(const PreviousTransform& previous, const LocalTransform& current, float alpha) {
+    return MakeModelMatrix(LerpTransform(previous.mPosition, current.mPosition, alpha),
+                           previous.mRotate + (current.mRotate - previous.mRotate) * alpha,
+                           current.mScale);
+}
+
+
+#endif //COMPONENTS_H
@@ -0,0 +1,90 @@
+//
+// Deferred renderer: opaque surfaces into a compact G-buffer, lit afterwards in one full-screen pass.
+//
+
+#include "deferred.h"
+
+#include "clustered_lighting.h"
+#include "frame_uniforms.h"
+#include "profiler.h"
+#include "shadows.h"
+
+bool ParseRendererKind(const std::string& name, RendererKind* kind) {
+    for (const RendererKind candidate : {RendererKind::Forward, RendererKind::Deferred}) {
+        if (name == RendererKindName(candidate)) {
+            *kind = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* RendererKindName(const RendererKind kind) {
+    switch (kind) {
+        case RendererKind::Forward: return "forward";
+        case RendererKind::Deferred: return "deferred";
+    }
+    return "unknown";
+}
+
+bool DeferredLightingCreate(DeferredLighting* lighting) {
+    glGenVertexArrays(1, &lighting->mVertexArray);
+    return lighting->mVertexArray != 0;
+}
+
+void DeferredLightingDraw(const DeferredLighting& lighting, const GBuffer& gbuffer, const RenderTarget& scene,
+                          const GLuint program, RenderCounters* counters) {
+    PROFILE_FUNCTION();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, scene.mFramebuffer);
+    if (program != 0) {
+        // Every pixel once; the empty ones are discarded and keep the clear color
+        glDisable(GL_DEPTH_TEST);
+        glUseProgram(program);
+        BindFrameUniformBlock(program);
+        BindClusteredLightingSamplers(program);
+        BindShadowSampler(program);
+        BindGBufferSamplers(program);
+        glActiveTexture(GL_TEXTURE0 + kGBufferAlbedoMaterialTextureUnit);
+        glBindTexture(GL_TEXTURE_2D, gbuffer.mAlbedoMaterial);
+        glActiveTexture(GL_TEXTURE0 + kGBufferNormalTextureUnit);
+        glBindTexture(GL_TEXTURE_2D, gbuffer.mNormal);
+        glActiveTexture(GL_TEXTURE0 + kGBufferDepthTextureUnit);
+        glBindTexture(GL_TEXTURE_2D, gbuffer.mDepth);
+        glBindVertexArray(lighting.mVertexArray);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        counters->mProgramBinds += 1;
+        counters->mDrawCalls += 1;
+        counters->mTriangles += 1;
+
+        for (const GLint unit : {kGBufferAlbedoMaterialTextureUnit, kGBufferNormalTextureUnit,
+                                 kGBufferDepthTextureUnit}) {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_2D, 0);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        glBindVertexArray(0);
+        glEnable(GL_DEPTH_TEST);
+    }
+
+    // The scene's depth is a renderbuffer the lighting pass could not have read, so it
+    // gets a copy of the G-buffer's instead; both are kDepthFormat
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, gbuffer.mFramebuffer);
+    glBlitFramebuffer(0, 0, gbuffer.mWidth, gbuffer.mHeight, 0, 0, scene.mViewportWidth, scene.mViewportHeight,
+                      GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, scene.mFramebuffer);
+}
+
+void DeferredLightingDelete(DeferredLighting* lighting) {
+    glDeleteVertexArrays(1, &lighting->mVertexArray);
+    *lighting = DeferredLighting{};
+}
+
+void BindGBufferSamplers(const GLuint program) {
+    const GLint albedoMaterial = glGetUniformLocation(program, "u_GBufferAlbedoMaterial");
+    const GLint normal = glGetUniformLocation(program, "u_GBufferNormal");
+    const GLint depth = glGetUniformLocation(program, "u_GBufferDepth");
+    if (albedoMaterial != -1) { glUniform1i(albedoMaterial, kGBufferAlbedoMaterialTextureUnit); }
+    if (normal != -1) { glUniform1i(normal, kGBufferNormalTextureUnit); }
+    if (depth != -1) { glUniform1i(depth, kGBufferDepthTextureUnit); }
+}
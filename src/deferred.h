@@ -0,0 +1,94 @@
+//
+// Deferred renderer: opaque surfaces into a compact G-buffer, lit afterwards in one full-screen pass.
+//
+
+#ifndef DEFERRED_H
+#define DEFERRED_H
+
+#include <cstdint>
+#include <string>
+#include <glad/glad.h>
+
+#include "depth_state.h"
+#include "frame_stats.h"
+#include "render_graph.h"
+#include "render_target.h"
+
+
+// How the opaque scene is shaded, picked at startup with --renderer
+enum class RendererKind : uint8_t {
+    // Every mesh draw shades its own fragments
+    Forward,
+    // Mesh draws fill the G-buffer, and each pixel is shaded once afterwards
+    Deferred,
+};
+
+bool ParseRendererKind(const std::string& name, RendererKind* kind);
+const char* RendererKindName(RendererKind kind);
+
+// Texture units the lighting pass reads the G-buffer from, after the shadow map's
+constexpr GLint kGBufferAlbedoMaterialTextureUnit{8};
+constexpr GLint kGBufferNormalTextureUnit{9};
+constexpr GLint kGBufferDepthTextureUnit{10};
+
+/**
+ * The deferred renderer's targets, eight bytes of color per pixel plus depth:
+ *  - RGBA8 albedo, with roughness and metalness packed four bits each into alpha
+ *  - RG16 normal, folded onto an octahedron, which keeps it accurate in two channels
+ *  - depth in the scene's format; the lighting pass rebuilds each pixel's position
+ *    from it, so there is no position target
+ * They only live from the geometry pass to the lighting pass, so the render graph
+ * hands them out.
+ */
+struct GBuffer {
+    // All three attached, albedo and normal as draw buffers 0 and 1
+    GLuint mFramebuffer{0};
+    GLuint mAlbedoMaterial{0};
+    GLuint mNormal{0};
+    GLuint mDepth{0};
+    // The part drawn to, which is less than the textures when dynamic resolution scales down
+    int mWidth{0};
+    int mHeight{0};
+};
+
+inline RenderGraphTextureDesc GBufferAlbedoMaterialDesc(int width, int height) {
+    return RenderGraphTextureDesc{GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, width, height};
+}
+
+inline RenderGraphTextureDesc GBufferNormalDesc(int width, int height) {
+    return RenderGraphTextureDesc{GL_RG16, GL_RG, GL_UNSIGNED_SHORT, 4, width, height};
+}
+
+inline RenderGraphTextureDesc GBufferDepthDesc(int width, int height) {
+    return RenderGraphTextureDesc{kDepthFormat, GL_DEPTH_COMPONENT, GL_FLOAT, 4, width, height};
+}
+
+/**
+ * The full-screen pass that lights the G-buffer. It reads each pixel's lights from
+ * the clustered light lists, the screen tiles times depth slices binned on the CPU,
+ * so its cost goes with the pixels on screen and the lights that touch them, not
+ * with how much geometry was drawn.
+ */
+struct DeferredLighting {
+    // Binds nothing; the full-screen triangle comes from gl_VertexID
+    GLuint mVertexArray{0};
+};
+
+bool DeferredLightingCreate(DeferredLighting* lighting);
+
+/**
+ * Shade gbuffer into scene with program (SHADER_FEATURE_DEFERRED_LIGHTING), over its
+ * clear color, then copy the G-buffer's depth into scene's so that what is drawn
+ * after, like the transparent pass, is still hidden by the opaque surfaces.
+ * FrameUniforms, the light clusters and the shadow map must be ready. Leaves scene bound.
+ */
+void DeferredLightingDraw(const DeferredLighting& lighting, const GBuffer& gbuffer, const RenderTarget& scene,
+                          GLuint program, RenderCounters* counters);
+
+void DeferredLightingDelete(DeferredLighting* lighting);
+
+// Points the program's G-buffer samplers at their texture units; the program must be in use
+void BindGBufferSamplers(GLuint program);
+
+
+#endif //DEFERRED_H
@@ -0,0 +1,54 @@
+//
+// Depth buffer setup: reverse-Z through glClipControl when available, depth test and face culling.
+//
+
+#include "depth_state.h"
+
+#include <cstring>
+
+// glad was generated for the core profile, so on contexts older than 4.5 the
+// extension's entry point is loaded here (it has no suffix)
+using PFNClipControl = void (APIENTRY *)(GLenum origin, GLenum depth);
+
+DepthMode InitDepthMode(GLADloadproc loadProc) {
+    bool hasClipControl{GLAD_GL_VERSION_4_5 != 0};
+    if (!hasClipControl) {
+        GLint extensionCount{0};
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+        for (GLint i = 0; i < extensionCount; ++i) {
+            auto name{reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i))};
+            if (std::strcmp(name, "GL_ARB_clip_control") == 0) {
+                hasClipControl = true;
+                break;
+            }
+        }
+    }
+    if (!hasClipControl) { return DepthMode::Standard; }
+
+    auto clipControl{reinterpret_cast<PFNClipControl>(loadProc("glClipControl"))};
+    if (clipControl == nullptr) { return DepthMode::Standard; }
+    clipControl(GL_LOWER_LEFT, GL_ZERO_TO_ONE);
+    return DepthMode::ReverseZ;
+}
+
+void ApplyDepthState(const DepthMode mode) {
+    glEnable(GL_DEPTH_TEST);
+    glDepthMask(GL_TRUE);
+    if (mode == DepthMode::ReverseZ) {
+        // Nearer is bigger, and the far plane is 0
+        glDepthFunc(GL_GREATER);
+        glClearDepth(0.0);
+    } else {
+        glDepthFunc(GL_LESS);
+        glClearDepth(1.0);
+    }
+
+    // Meshes wind counter-clockwise seen from the front
+    glEnable(GL_CULL_FACE);
+    glCullFace(GL_BACK);
+    glFrontFace(GL_CCW);
+}
+
+const char* DepthModeName(const DepthMode mode) {
+    return mode == DepthMode::ReverseZ ? "reverse-Z, [0, 1] clip depth" : "standard, [-1, 1] clip depth";
+}
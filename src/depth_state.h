@@ -0,0 +1,31 @@
+//
+// Depth buffer setup: reverse-Z through glClipControl when available, depth test and face culling.
+//
+
+#ifndef DEPTH_STATE_H
+#define DEPTH_STATE_H
+
+#include <glad/glad.h>
+
+#include "camera.h"
+
+
+// Floating-point depth for every render target; reverse-Z needs it to pay off
+constexpr GLenum kDepthFormat{GL_DEPTH_COMPONENT32F};
+
+/**
+ * Switches clip space depth to [0, 1] when GL 4.5 or ARB_clip_control is there and
+ * returns ReverseZ; otherwise leaves OpenGL's default and returns Standard. macOS
+ * stops at 4.1 without the extension, so it gets Standard.
+ * Must be called after the OpenGL function pointers have been loaded.
+ */
+DepthMode InitDepthMode(GLADloadproc loadProc);
+
+// Depth test, depth writes and back-face culling for opaque geometry, plus the
+// matching clear depth. Call before clearing for the scene pass.
+void ApplyDepthState(DepthMode mode);
+
+const char* DepthModeName(DepthMode mode);
+
+
+#endif //DEPTH_STATE_H
@@ -0,0 +1,166 @@
+//
+// Draw commands recorded on worker threads and replayed on the GL thread.
+//
+
+#include "draw_list.h"
+
+#include <algorithm>
+#include <glad/glad.h>
+
+#include "clustered_lighting.h"
+#include "frame_uniforms.h"
+#include "mesh.h"
+#include "profiler.h"
+#include "shadows.h"
+
+// Radius of a sphere around our unit-sized quads and polygons, before scaling
+static constexpr float kMeshBoundingRadius{0.7072f};
+
+void CommandList::Reset() {
+    mCommands.clear();
+    mConstants.clear();
+}
+
+void CommandList::Record(const DrawCommand& command, const DrawConstants& constants) {
+    mCommands.push_back(command);
+    mCommands.back().mConstants = static_cast<uint32_t>(mConstants.size());
+    mConstants.push_back(constants);
+}
+
+void RecordMeshDraws(CommandList* list, const WorldMatrix* matrices, const MeshInstance* instances,
+                     const size_t count, const Frustum& frustum) {
+    for (size_t i = 0; i < count; ++i) {
+        const glm::mat4& model = matrices[i].mMatrix;
+        // Scale is uniform, so the length of any axis is the scale
+        const float scale = glm::length(glm::vec3(model[0]));
+        const glm::vec3 center{model[3]};
+        if (!FrustumIntersectsSphere(frustum, center, kMeshBoundingRadius * scale)) {
+            continue;
+        }
+
+        const MeshInstance& instance = instances[i];
+        DrawCommand command{};
+        // Front to back within each pipeline and geometry group
+        command.mSortKey = MakeDrawSortKey(instance.mPipeline, instance.mVertexArray,
+                                           MakeDepthSortOrder(FrustumNearDistance(frustum, center)));
+        command.mPipeline = instance.mPipeline;
+        command.mVertexArray = instance.mVertexArray;
+        command.mIndexCount = static_cast<uint32_t>(instance.mIndexCount);
+        command.mIndexOffset = instance.mIndexOffset;
+        command.mBaseVertex = instance.mBaseVertex;
+        command.mDepthVertexArray = instance.mDepthVertexArray;
+        command.mPositionBaseVertex = instance.mPositionBaseVertex;
+        list->Record(command, DrawConstants{model});
+    }
+}
+
+void DrawQueue::Merge(const std::vector<CommandList>& lists) {
+    PROFILE_SCOPE("MergeDrawLists");
+
+    mOrder.clear();
+    for (size_t list = 0; list < lists.size(); ++list) {
+        const std::vector<DrawCommand>& commands = lists[list].Commands();
+        for (size_t command = 0; command < commands.size(); ++command) {
+            mOrder.push_back(DrawRef{commands[command].mSortKey,
+                                     static_cast<uint32_t>(list),
+                                     static_cast<uint32_t>(command)});
+        }
+    }
+
+    std::sort(mOrder.begin(), mOrder.end(), [](const DrawRef& a, const DrawRef& b) {
+        return a.mSortKey < b.mSortKey;
+    });
+}
+
+const DrawQueue::ProgramUniforms& DrawQueue::UniformsFor(GLuint program) {
+    for (const ProgramUniforms& uniforms : mUniformCache) {
+        if (uniforms.mProgram == program) { return uniforms; }
+    }
+    BindFrameUniformBlock(program);
+    BindClusteredLightingSamplers(program);
+    BindShadowSampler(program);
+    return mUniformCache.emplace_back(ProgramUniforms{
+        program,
+        FindUniformLocation(program, "u_ModelMatrix")
+    });
+}
+
+void DrawQueue::Submit(const std::vector<CommandList>& lists, RenderCounters* counters) {
+    Merge(lists);
+    Replay(lists, counters);
+}
+
+void DrawQueue::Replay(const std::vector<CommandList>& lists, RenderCounters* counters) {
+    PROFILE_SCOPE("SubmitDraws");
+
+    GLuint currentPipeline{0};
+    GLuint currentVertexArray{0};
+    const ProgramUniforms* uniforms{nullptr};
+
+    for (const DrawRef& ref : mOrder) {
+        const CommandList& list = lists[ref.mList];
+        const DrawCommand& command = list.Commands()[ref.mCommand];
+        const DrawConstants& constants = list.Constants()[command.mConstants];
+
+        if (command.mPipeline != currentPipeline || uniforms == nullptr) {
+            currentPipeline = command.mPipeline;
+            glUseProgram(currentPipeline);
+            uniforms = &UniformsFor(currentPipeline);
+            counters->mProgramBinds += 1;
+        }
+        if (command.mVertexArray != currentVertexArray) {
+            currentVertexArray = command.mVertexArray;
+            glBindVertexArray(currentVertexArray);
+            counters->mVertexArrayBinds += 1;
+        }
+
+        glUniformMatrix4fv(uniforms->mModelMatrix, 1, GL_FALSE, &constants.mModelMatrix[0][0]);
+        glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(command.mIndexCount), GL_UNSIGNED_INT,
+                                 reinterpret_cast<const void*>(static_cast<uintptr_t>(command.mIndexOffset)),
+                                 command.mBaseVertex);
+        counters->mUniformUploads += 1;
+        counters->mDrawCalls += 1;
+        counters->mTriangles += command.mIndexCount / 3;
+    }
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
+
+void DrawQueue::ReplayDepthOnly(const std::vector<CommandList>& lists, const GLuint depthProgram,
+                                RenderCounters* counters) {
+    PROFILE_SCOPE("DepthPrePass");
+
+    // Every draw shares the one program; the key order still groups them by geometry
+    // and runs front to back within each group
+    glUseProgram(depthProgram);
+    BindFrameUniformBlock(depthProgram);
+    const GLint modelMatrix = FindUniformLocation(depthProgram, "u_ModelMatrix");
+    counters->mProgramBinds += 1;
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+
+    GLuint currentVertexArray{0};
+    for (const DrawRef& ref : mOrder) {
+        const CommandList& list = lists[ref.mList];
+        const DrawCommand& command = list.Commands()[ref.mCommand];
+        const DrawConstants& constants = list.Constants()[command.mConstants];
+
+        if (command.mDepthVertexArray != currentVertexArray) {
+            currentVertexArray = command.mDepthVertexArray;
+            glBindVertexArray(currentVertexArray);
+            counters->mVertexArrayBinds += 1;
+        }
+
+        glUniformMatrix4fv(modelMatrix, 1, GL_FALSE, &constants.mModelMatrix[0][0]);
+        glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(command.mIndexCount), GL_UNSIGNED_INT,
+                                 reinterpret_cast<const void*>(static_cast<uintptr_t>(command.mIndexOffset)),
+                                 command.mPositionBaseVertex);
+        counters->mUniformUploads += 1;
+        counters->mDrawCalls += 1;
+        counters->mTriangles += command.mIndexCount / 3;
+    }
+
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glBindVertexArray(0);
+    glUseProgram(0);
+}
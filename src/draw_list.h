@@ -0,0 +1,133 @@
+//
+// Draw commands recorded on worker threads and replayed on the GL thread.
+//
+
+#ifndef DRAW_LIST_H
+#define DRAW_LIST_H
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "components.h"
+#include "frame_stats.h"
+#include "frustum.h"
+
+
+/**
+ * Everything needed to issue one draw, without touching OpenGL.
+ * Object handles are stored as plain integers so recording can happen on any thread.
+ */
+struct DrawCommand {
+    // Commands are replayed in ascending key order, see MakeDrawSortKey
+    uint64_t mSortKey;
+    uint32_t mPipeline;
+    uint32_t mVertexArray;
+    uint32_t mIndexCount;
+    // Byte offset into the index buffer and value added to every index
+    uint32_t mIndexOffset;
+    int32_t mBaseVertex;
+    // Same indices over the packed positions, for the depth pre-pass
+    uint32_t mDepthVertexArray;
+    int32_t mPositionBaseVertex;
+    // Index of this draw's constants in the command list
+    uint32_t mConstants;
+};
+
+// Per-draw shader constants
+struct DrawConstants {
+    glm::mat4 mModelMatrix;
+};
+
+/**
+ * Group draws by pipeline, then by geometry, so that replay changes state as little
+ * as possible. The low bits are free for ordering within a group (e.g. by depth).
+ */
+inline uint64_t MakeDrawSortKey(uint32_t pipeline, uint32_t vertexArray, uint32_t order) {
+    return (static_cast<uint64_t>(pipeline & 0xFFFFFu) << 44) |
+           (static_cast<uint64_t>(vertexArray & 0xFFFFFu) << 24) |
+           (order & 0xFFFFFFu);
+}
+
+/**
+ * Order bits that sort opaque draws front to back, so the depth test rejects what
+ * they hide before it is shaded. Distance is from the near plane; the bits of a
+ * non-negative float sort like the float, and the top 24 keep 15 bits of mantissa.
+ */
+inline uint32_t MakeDepthSortOrder(float distance) {
+    return std::bit_cast<uint32_t>(std::max(distance, 0.0f)) >> 7;
+}
+
+/**
+ * Commands recorded by one thread. Storage is kept between frames, so once it has
+ * grown to fit the scene, recording does not allocate.
+ */
+class CommandList {
+public:
+    void Reset();
+    void Record(const DrawCommand& command, const DrawConstants& constants);
+
+    const std::vector<DrawCommand>& Commands() const { return mCommands; }
+    const std::vector<DrawConstants>& Constants() const { return mConstants; }
+
+private:
+    std::vector<DrawCommand> mCommands;
+    std::vector<DrawConstants> mConstants;
+};
+
+/**
+ * Cull count objects against the frustum and record a draw for each visible one,
+ * ordered front to back from the frustum's near plane.
+ * Takes the component arrays of one chunk. Safe to call from any thread, as long as
+ * each thread records into its own list.
+ */
+void RecordMeshDraws(CommandList* list, const WorldMatrix* matrices, const MeshInstance* instances,
+                     size_t count, const Frustum& frustum);
+
+/**
+ * Merges the command lists of all threads into one sorted order and issues the
+ * OpenGL calls. Must run on the thread that owns the GL context.
+ */
+class DrawQueue {
+public:
+    // View and projection come from the FrameUniforms buffer, which must be uploaded first
+    void Submit(const std::vector<CommandList>& lists, RenderCounters* counters);
+
+    // Gather the commands of all lists and sort them by key; Submit calls this first
+    void Merge(const std::vector<CommandList>& lists);
+    // Issue the merged commands; lists must be the ones last merged
+    void Replay(const std::vector<CommandList>& lists, RenderCounters* counters);
+    // Issue the merged commands with depthProgram over the position-only stream and
+    // color writes off, laying down depth for a following Replay to test against
+    void ReplayDepthOnly(const std::vector<CommandList>& lists, GLuint depthProgram, RenderCounters* counters);
+
+    size_t LastDrawCount() const { return mOrder.size(); }
+
+    // Forget the uniform locations looked up so far; call whenever the mesh programs
+    // are relinked or reloaded, since a new program may reuse an old one's name
+    void InvalidateUniformCache() { mUniformCache.clear(); }
+
+private:
+    struct DrawRef {
+        uint64_t mSortKey;
+        uint32_t mList;
+        uint32_t mCommand;
+    };
+
+    struct ProgramUniforms {
+        GLuint mProgram;
+        GLint mModelMatrix;
+    };
+
+    const ProgramUniforms& UniformsFor(GLuint program);
+
+    std::vector<DrawRef> mOrder;
+    // Looking uniforms up is slow, so do it once per program, kept between frames
+    std::vector<ProgramUniforms> mUniformCache;
+};
+
+
+#endif //DRAW_LIST_H
@@ -0,0 +1,90 @@
+//
+// Dynamic resolution: the scene is drawn into less of its target when the GPU falls behind, then upscaled and sharpened.
+//
+
+#include "dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+#include <print>
+
+#include "mesh.h"
+
+bool DynamicResolutionCreate(DynamicResolution* resolution) {
+    glGenVertexArrays(1, &resolution->mVertexArray);
+    return resolution->mVertexArray != 0;
+}
+
+void DynamicResolutionUpdate(DynamicResolution* resolution, const GpuProfiler& profiler) {
+    if (!resolution->mEnabled || resolution->mTargetFrameTimeMs <= 0.0) { return; }
+    // Nothing new came back, e.g. the readback dropped a frame; integrating the old
+    // sample again would push the scale further than it called for
+    if (profiler.WorkTimeSamples() == resolution->mLastSample) { return; }
+    resolution->mLastSample = profiler.WorkTimeSamples();
+
+    const double gpuTimeMs = profiler.LastWorkTimeMs();
+    resolution->mLastGpuTimeMs = gpuTimeMs;
+    // Positive with time to spare. A frame several times over budget, like one that
+    // compiled shaders, would otherwise throw the scale all the way down at once.
+    const float error = std::clamp(static_cast<float>((resolution->mTargetFrameTimeMs - gpuTimeMs) /
+                                                      resolution->mTargetFrameTimeMs), -1.0f, 1.0f);
+
+    // GPU time goes roughly with the pixels drawn, so the controller works on the
+    // fraction of them rather than on the scale of each axis
+    const float minArea = resolution->mMinScale * resolution->mMinScale;
+    const float maxArea = resolution->mMaxScale * resolution->mMaxScale;
+    // Clamped, so time spent at either bound does not wind up the integral
+    resolution->mIntegral = std::clamp(resolution->mIntegral + resolution->mIntegralGain * error, minArea, maxArea);
+    const float area = std::clamp(resolution->mIntegral + resolution->mProportionalGain * error, minArea, maxArea);
+
+    resolution->mScale = std::sqrt(area);
+    resolution->mLowestScale = std::min(resolution->mLowestScale, resolution->mScale);
+}
+
+void DynamicResolutionApply(const DynamicResolution& resolution, RenderTarget* target) {
+    const float scale = resolution.mEnabled ? resolution.mScale : 1.0f;
+    target->mViewportWidth = std::clamp(static_cast<int>(std::lround(target->mWidth * scale)), 1, target->mWidth);
+    target->mViewportHeight = std::clamp(static_cast<int>(std::lround(target->mHeight * scale)), 1, target->mHeight);
+}
+
+void DynamicResolutionUpscale(const DynamicResolution& resolution, const GpuResources& resources,
+                              const RenderTarget& source, const GLuint program, const int width, const int height,
+                              RenderCounters* counters) {
+    PROFILE_FUNCTION();
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, width, height);
+    if (program == 0) { return; }
+
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_BLEND);
+    glUseProgram(program);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, resources.Name(source.mColorTexture));
+    glUniform1i(FindUniformLocation(program, "u_SceneColor"), 0);
+    glUniform2f(FindUniformLocation(program, "u_SourceScale"),
+                static_cast<float>(source.mViewportWidth) / static_cast<float>(source.mWidth),
+                static_cast<float>(source.mViewportHeight) / static_cast<float>(source.mHeight));
+    glUniform1f(FindUniformLocation(program, "u_Sharpness"), resolution.mSharpness);
+    glBindVertexArray(resolution.mVertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    counters->mProgramBinds += 1;
+    counters->mDrawCalls += 1;
+    counters->mTriangles += 1;
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindVertexArray(0);
+    glEnable(GL_DEPTH_TEST);
+}
+
+void DynamicResolutionPrintReport(const DynamicResolution& resolution, const RenderTarget& target) {
+    if (!resolution.mEnabled) { return; }
+    std::println("Dynamic resolution: scale {:.2f} ({}x{}), lowest {:.2f}, last GPU passes {:.2f} ms of {:.2f} ms",
+                 resolution.mScale, target.mViewportWidth, target.mViewportHeight, resolution.mLowestScale,
+                 resolution.mLastGpuTimeMs, resolution.mTargetFrameTimeMs);
+}
+
+void DynamicResolutionDelete(DynamicResolution* resolution) {
+    glDeleteVertexArrays(1, &resolution->mVertexArray);
+    *resolution = DynamicResolution{};
+}
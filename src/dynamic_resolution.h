@@ -0,0 +1,77 @@
+//
+// Dynamic resolution: the scene is drawn into less of its target when the GPU falls behind, then upscaled and sharpened.
+//
+
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <glad/glad.h>
+
+#include "frame_stats.h"
+#include "profiler.h"
+#include "render_target.h"
+
+
+/**
+ * Picks how much of the offscreen target the scene is drawn into, from the GPU time
+ * of the render passes of the last frame the profiler has results for. A PI
+ * controller steers the fraction of the target's pixels toward what makes that time
+ * mTargetFrameTimeMs: the proportional term reacts to the frame just measured, and
+ * the integral term takes out what error is left over time. The timings come back a
+ * few frames late, so the gains are kept low enough for the scale not to swing back
+ * and forth.
+ *
+ * The target keeps its size, only the viewport shrinks, so nothing is reallocated
+ * when the scale moves. The upscale pass stretches the drawn corner over the window.
+ */
+struct DynamicResolution {
+    // Off unless --dynamic-resolution is given; the scene then always fills the target
+    bool mEnabled{false};
+    double mTargetFrameTimeMs{16.0};
+    // Bounds of the scale of each axis
+    float mMinScale{0.5f};
+    float mMaxScale{1.0f};
+    // Per frame, on the error relative to the target frame time
+    float mProportionalGain{0.25f};
+    float mIntegralGain{0.03f};
+    // How hard the upscale pass sharpens, from 0 to 1
+    float mSharpness{0.5f};
+
+    // The integral term, as a fraction of the target's pixels
+    float mIntegral{1.0f};
+    // Scale of each axis this frame
+    float mScale{1.0f};
+    // Seen over the run, for the report
+    float mLowestScale{1.0f};
+    double mLastGpuTimeMs{0.0};
+    // GpuProfiler::WorkTimeSamples when the scale last moved, so each sample counts once
+    uint64_t mLastSample{0};
+
+    // Binds nothing; the full-screen triangle comes from gl_VertexID
+    GLuint mVertexArray{0};
+};
+
+bool DynamicResolutionCreate(DynamicResolution* resolution);
+
+// Move the scale toward the target frame time, once per new sample from the profiler
+void DynamicResolutionUpdate(DynamicResolution* resolution, const GpuProfiler& profiler);
+
+// Size the target's viewport for the current scale; all of it when disabled
+void DynamicResolutionApply(const DynamicResolution& resolution, RenderTarget* target);
+
+/**
+ * Stretch the drawn part of source over the window, width x height, drawn
+ * with program (upscale_frag.glsl). Bilinear filtering softens the image as it grows,
+ * so the same pass sharpens it back, less where there is already contrast so edges
+ * do not ring.
+ */
+void DynamicResolutionUpscale(const DynamicResolution& resolution, const GpuResources& resources,
+                              const RenderTarget& source, GLuint program, int width, int height,
+                              RenderCounters* counters);
+
+void DynamicResolutionPrintReport(const DynamicResolution& resolution, const RenderTarget& target);
+
+void DynamicResolutionDelete(DynamicResolution* resolution);
+
+
+#endif //DYNAMIC_RESOLUTION_H
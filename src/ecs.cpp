@@ -0,0 +1,377 @@
+//
+// Entity-component storage: archetypes of fixed-size chunks with one array per component.
+//
+
+#include "ecs.h"
+
+#include <algorithm>
+#include <bit>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <print>
+
+namespace {
+
+constexpr std::align_val_t kChunkAlignment{64};
+
+struct ComponentRegistry {
+    std::mutex mMutex;
+    std::vector<ComponentInfo> mInfos;
+};
+
+ComponentRegistry& GetComponentRegistry() {
+    static ComponentRegistry registry;
+    return registry;
+}
+
+size_t AlignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+}
+
+ComponentId RegisterComponentType(size_t size, size_t alignment) {
+    ComponentRegistry& registry = GetComponentRegistry();
+    std::lock_guard lock(registry.mMutex);
+    if (registry.mInfos.size() == kMaxComponentTypes) {
+        std::println(std::cerr, "More than {} component types", kMaxComponentTypes);
+        std::exit(EXIT_FAILURE);
+    }
+    // The registry only grows up to kMaxComponentTypes, so references stay valid
+    if (registry.mInfos.capacity() < kMaxComponentTypes) {
+        registry.mInfos.reserve(kMaxComponentTypes);
+    }
+    registry.mInfos.push_back(ComponentInfo{size, alignment});
+    return static_cast<ComponentId>(registry.mInfos.size() - 1);
+}
+
+const ComponentInfo& GetComponentInfo(ComponentId id) {
+    return GetComponentRegistry().mInfos[id];
+}
+
+Archetype::Archetype(ComponentMask mask) : mMask(mask) {
+    mAddEdges.fill(UINT32_MAX);
+    mRemoveEdges.fill(UINT32_MAX);
+    mColumnOffsets.fill(kNoColumn);
+
+    size_t rowBytes{sizeof(Entity)};
+    for (ComponentMask bits = mask; bits != 0; bits &= bits - 1) {
+        const auto id = static_cast<ComponentId>(std::countr_zero(bits));
+        mComponents.push_back(id);
+        rowBytes += GetComponentInfo(id).mSize;
+    }
+
+    // Start from the capacity ignoring padding and shrink until the aligned columns fit
+    auto layout = [&](uint32_t capacity) {
+        size_t offset{sizeof(Entity) * capacity};
+        for (const ComponentId id : mComponents) {
+            const ComponentInfo& info = GetComponentInfo(id);
+            offset = AlignUp(offset, info.mAlignment);
+            mColumnOffsets[id] = static_cast<uint32_t>(offset);
+            offset += info.mSize * capacity;
+        }
+        return offset;
+    };
+    mChunkCapacity = static_cast<uint32_t>(kChunkBytes / rowBytes);
+    while (layout(mChunkCapacity) > kChunkBytes) {
+        --mChunkCapacity;
+    }
+}
+
+Archetype::~Archetype() {
+    Clear();
+}
+
+void Archetype::Clear() {
+    for (Chunk& chunk : mChunks) {
+        ::operator delete(chunk.mData, kChunkAlignment);
+    }
+    mChunks.clear();
+    mEntityCount = 0;
+    ++mVersion;
+}
+
+void Archetype::AllocateRow(uint32_t* chunk, uint32_t* row) {
+    if (mChunks.empty() || mChunks.back().mCount == mChunkCapacity) {
+        mChunks.push_back(Chunk{static_cast<std::byte*>(::operator new(kChunkBytes, kChunkAlignment)), 0});
+    }
+    Chunk& last = mChunks.back();
+    *chunk = static_cast<uint32_t>(mChunks.size() - 1);
+    *row = last.mCount++;
+    ++mEntityCount;
+    ++mVersion;
+
+    for (const ComponentId id : mComponents) {
+        std::memset(Component(last, id, *row), 0, GetComponentInfo(id).mSize);
+    }
+}
+
+Entity Archetype::RemoveRow(uint32_t chunk, uint32_t row) {
+    Chunk& last = mChunks.back();
+    const uint32_t lastRow{last.mCount - 1};
+    const bool isLast{chunk == mChunks.size() - 1 && row == lastRow};
+
+    Entity moved{kNullEntity};
+    if (!isLast) {
+        Chunk& target = mChunks[chunk];
+        for (const ComponentId id : mComponents) {
+            std::memcpy(Component(target, id, row), Component(last, id, lastRow), GetComponentInfo(id).mSize);
+        }
+        moved = Entities(last)[lastRow];
+        Entities(target)[row] = moved;
+    }
+
+    --last.mCount;
+    --mEntityCount;
+    ++mVersion;
+    if (last.mCount == 0) {
+        ::operator delete(last.mData, kChunkAlignment);
+        mChunks.pop_back();
+    }
+    return moved;
+}
+
+void CommandBuffer::Create() {
+    mCommands.push_back(Command{CommandType::Create, 0, kCreatedEntity, 0});
+}
+
+void CommandBuffer::Destroy(Entity entity) {
+    mCommands.push_back(Command{CommandType::Destroy, 0, entity, 0});
+}
+
+void CommandBuffer::AddRaw(Entity entity, ComponentId id, const void* value, size_t size) {
+    const size_t payload{mPayload.size()};
+    mPayload.resize(payload + size);
+    if (size > 0) {
+        std::memcpy(mPayload.data() + payload, value, size);
+    }
+    mCommands.push_back(Command{CommandType::Add, id, entity, payload});
+}
+
+void CommandBuffer::RemoveRaw(Entity entity, ComponentId id) {
+    mCommands.push_back(Command{CommandType::Remove, id, entity, 0});
+}
+
+void CommandBuffer::Clear() {
+    mCommands.clear();
+    mPayload.clear();
+}
+
+World::World() {
+    // Archetype 0 holds entities without components
+    FindOrCreateArchetype(0);
+}
+
+Entity World::CreateEntity(ComponentMask mask) {
+    uint32_t index;
+    if (!mFreeIndices.empty()) {
+        index = mFreeIndices.back();
+        mFreeIndices.pop_back();
+    } else {
+        index = static_cast<uint32_t>(mRecords.size());
+        mRecords.emplace_back();
+    }
+
+    EntityRecord& record = mRecords[index];
+    ++record.mGeneration;
+    record.mArchetype = FindOrCreateArchetype(mask);
+
+    Archetype& archetype = *mArchetypes[record.mArchetype];
+    archetype.AllocateRow(&record.mChunk, &record.mRow);
+    const Entity entity{index, record.mGeneration};
+    archetype.Entities(archetype.Chunks()[record.mChunk])[record.mRow] = entity;
+    return entity;
+}
+
+void World::Destroy(Entity entity) {
+    if (!IsAlive(entity)) { return; }
+    EntityRecord& record = mRecords[entity.mIndex];
+    ReleaseRow(record);
+    // Bumping the generation here makes stale handles fail IsAlive straight away
+    ++record.mGeneration;
+    mFreeIndices.push_back(entity.mIndex);
+}
+
+bool World::IsAlive(Entity entity) const {
+    return entity.mIndex < mRecords.size() && entity.mGeneration != 0 &&
+           mRecords[entity.mIndex].mGeneration == entity.mGeneration;
+}
+
+void World::ReleaseRow(const EntityRecord& record) {
+    const Entity moved{mArchetypes[record.mArchetype]->RemoveRow(record.mChunk, record.mRow)};
+    if (moved != kNullEntity) {
+        EntityRecord& movedRecord = mRecords[moved.mIndex];
+        movedRecord.mChunk = record.mChunk;
+        movedRecord.mRow = record.mRow;
+    }
+}
+
+uint32_t World::FindOrCreateArchetype(ComponentMask mask) {
+    const auto found = mArchetypeLookup.find(mask);
+    if (found != mArchetypeLookup.end()) { return found->second; }
+
+    const auto index = static_cast<uint32_t>(mArchetypes.size());
+    mArchetypes.push_back(std::make_unique<Archetype>(mask));
+    mArchetypeLookup.emplace(mask, index);
+    return index;
+}
+
+void World::AddComponent(Entity entity, ComponentId id) {
+    if (!IsAlive(entity)) { return; }
+    Archetype& current = *mArchetypes[mRecords[entity.mIndex].mArchetype];
+    if ((current.Mask() >> id) & 1) { return; }
+
+    if (current.mAddEdges[id] == UINT32_MAX) {
+        current.mAddEdges[id] = FindOrCreateArchetype(current.Mask() | (ComponentMask{1} << id));
+    }
+    MoveEntity(entity, current.mAddEdges[id]);
+}
+
+void World::RemoveComponent(Entity entity, ComponentId id) {
+    if (!IsAlive(entity)) { return; }
+    Archetype& current = *mArchetypes[mRecords[entity.mIndex].mArchetype];
+    if (!((current.Mask() >> id) & 1)) { return; }
+
+    if (current.mRemoveEdges[id] == UINT32_MAX) {
+        current.mRemoveEdges[id] = FindOrCreateArchetype(current.Mask() & ~(ComponentMask{1} << id));
+    }
+    MoveEntity(entity, current.mRemoveEdges[id]);
+}
+
+void World::MoveEntity(Entity entity, uint32_t targetArchetype) {
+    EntityRecord& record = mRecords[entity.mIndex];
+    const Archetype& source = *mArchetypes[record.mArchetype];
+    Archetype& target = *mArchetypes[targetArchetype];
+
+    uint32_t chunk;
+    uint32_t row;
+    target.AllocateRow(&chunk, &row);
+    const Archetype::Chunk& sourceChunk = source.Chunks()[record.mChunk];
+    const Archetype::Chunk& targetChunk = target.Chunks()[chunk];
+    for (const ComponentId id : target.Components()) {
+        if ((source.Mask() >> id) & 1) {
+            std::memcpy(target.Component(targetChunk, id, row), source.Component(sourceChunk, id, record.mRow),
+                        GetComponentInfo(id).mSize);
+        }
+    }
+    target.Entities(targetChunk)[row] = entity;
+
+    ReleaseRow(record);
+    record.mArchetype = targetArchetype;
+    record.mChunk = chunk;
+    record.mRow = row;
+}
+
+void* World::GetComponent(Entity entity, ComponentId id) {
+    if (!IsAlive(entity)) { return nullptr; }
+    const EntityRecord& record = mRecords[entity.mIndex];
+    const Archetype& archetype = *mArchetypes[record.mArchetype];
+    if (!((archetype.Mask() >> id) & 1)) { return nullptr; }
+    return archetype.Component(archetype.Chunks()[record.mChunk], id, record.mRow);
+}
+
+void World::UpdateQuery(Query& query) {
+    for (; query.mArchetypesChecked < mArchetypes.size(); ++query.mArchetypesChecked) {
+        const ComponentMask mask{mArchetypes[query.mArchetypesChecked]->Mask()};
+        if ((mask & query.mAll) == query.mAll && (mask & query.mNone) == 0) {
+            query.mArchetypes.push_back(static_cast<uint32_t>(query.mArchetypesChecked));
+        }
+    }
+}
+
+void World::CollectChunks(Query& query, ArenaVector<ChunkView>* chunks) {
+    UpdateQuery(query);
+    size_t count{0};
+    for (const uint32_t index : query.mArchetypes) {
+        count += mArchetypes[index]->Chunks().size();
+    }
+    // Reserve exactly, since an arena never gets back what a growing vector drops
+    chunks->clear();
+    chunks->reserve(count);
+    ForEachChunk(query, [&](const ChunkView& chunk) {
+        chunks->push_back(chunk);
+    });
+}
+
+size_t World::EntityCount(Query& query) {
+    UpdateQuery(query);
+    size_t count{0};
+    for (const uint32_t index : query.mArchetypes) {
+        count += mArchetypes[index]->EntityCount();
+    }
+    return count;
+}
+
+uint64_t World::StructuralVersion(Query& query) {
+    UpdateQuery(query);
+    // Every version only goes up, so the sum does too
+    uint64_t version{0};
+    for (const uint32_t index : query.mArchetypes) {
+        version += mArchetypes[index]->Version();
+    }
+    return version;
+}
+
+void World::Playback(CommandBuffer& buffer) {
+    const std::vector<CommandBuffer::Command>& commands = buffer.mCommands;
+    Entity created{kNullEntity};
+    for (size_t i = 0; i < commands.size(); ++i) {
+        const CommandBuffer::Command& command = commands[i];
+        const Entity entity{command.mEntity == CommandBuffer::kCreatedEntity ? created : command.mEntity};
+        switch (command.mType) {
+            case CommandBuffer::CommandType::Create: {
+                // Create straight into the final archetype rather than moving through one
+                // archetype per added component
+                ComponentMask mask{0};
+                for (size_t next = i + 1; next < commands.size(); ++next) {
+                    if (commands[next].mType != CommandBuffer::CommandType::Add ||
+                        commands[next].mEntity != CommandBuffer::kCreatedEntity) {
+                        break;
+                    }
+                    mask |= ComponentMask{1} << commands[next].mComponent;
+                }
+                created = CreateEntity(mask);
+                break;
+            }
+            case CommandBuffer::CommandType::Destroy:
+                Destroy(entity);
+                break;
+            case CommandBuffer::CommandType::Add: {
+                AddComponent(entity, command.mComponent);
+                const size_t size{GetComponentInfo(command.mComponent).mSize};
+                if (void* component = GetComponent(entity, command.mComponent); component && size > 0) {
+                    std::memcpy(component, buffer.mPayload.data() + command.mPayload, size);
+                }
+                break;
+            }
+            case CommandBuffer::CommandType::Remove:
+                RemoveComponent(entity, command.mComponent);
+                break;
+        }
+    }
+    buffer.Clear();
+}
+
+void World::Clear() {
+    for (const auto& archetype : mArchetypes) {
+        archetype->Clear();
+    }
+    // Keep the generations so that handles from before the clear stay dead
+    mFreeIndices.clear();
+    for (uint32_t index = 0; index < mRecords.size(); ++index) {
+        EntityRecord& record = mRecords[index];
+        if (record.mGeneration % 2 == 1) {
+            ++record.mGeneration;
+        }
+        mFreeIndices.push_back(index);
+    }
+}
+
+size_t World::ChunkCount() const {
+    size_t count{0};
+    for (const auto& archetype : mArchetypes) {
+        count += archetype->Chunks().size();
+    }
+    return count;
+}
@@ -0,0 +1,342 @@
+//
+// Entity-component storage: archetypes of fixed-size chunks with one array per component.
+//
+
+#ifndef ECS_H
+#define ECS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "frame_arena.h"
+#include "job_system.h"
+
+
+using ComponentId = uint32_t;
+// Archetypes are identified by a bit per component type
+using ComponentMask = uint64_t;
+constexpr size_t kMaxComponentTypes{64};
+
+struct ComponentInfo {
+    // Zero for tag components, which mark entities without storing anything
+    size_t mSize;
+    size_t mAlignment;
+};
+
+ComponentId RegisterComponentType(size_t size, size_t alignment);
+const ComponentInfo& GetComponentInfo(ComponentId id);
+
+/**
+ * Ids are handed out on first use. Components are plain data: they are moved between
+ * chunks with memcpy and never constructed or destroyed.
+ */
+template <class T>
+ComponentId ComponentTypeId() {
+    static_assert(std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>,
+                  "components must be plain data");
+    static const ComponentId id{RegisterComponentType(std::is_empty_v<T> ? 0 : sizeof(T), alignof(T))};
+    return id;
+}
+
+template <class... Ts>
+ComponentMask MakeComponentMask() {
+    return (ComponentMask{0} | ... | (ComponentMask{1} << ComponentTypeId<Ts>()));
+}
+
+/**
+ * Index into the world's entity table, plus the generation of that slot so that a
+ * stale Entity is detected after the slot has been reused. Generation 0 is never alive.
+ */
+struct Entity {
+    uint32_t mIndex{0};
+    uint32_t mGeneration{0};
+
+    bool operator==(const Entity&) const = default;
+};
+
+constexpr Entity kNullEntity{};
+
+/**
+ * All entities with exactly the same set of components. Their components live in
+ * chunks of kChunkBytes, laid out as one array per component, so a system reading two
+ * components streams through two contiguous arrays.
+ * Every chunk except the last is full; removal moves the last entity into the hole.
+ */
+class Archetype {
+public:
+    static constexpr size_t kChunkBytes{16 * 1024};
+    static constexpr uint32_t kNoColumn{UINT32_MAX};
+
+    struct Chunk {
+        std::byte* mData{nullptr};
+        uint32_t mCount{0};
+    };
+
+    explicit Archetype(ComponentMask mask);
+    ~Archetype();
+
+    Archetype(const Archetype&) = delete;
+    Archetype& operator=(const Archetype&) = delete;
+
+    ComponentMask Mask() const { return mMask; }
+    const std::vector<ComponentId>& Components() const { return mComponents; }
+    uint32_t ChunkCapacity() const { return mChunkCapacity; }
+    size_t EntityCount() const { return mEntityCount; }
+    // Goes up whenever an entity joins or leaves
+    uint64_t Version() const { return mVersion; }
+    std::vector<Chunk>& Chunks() { return mChunks; }
+    const std::vector<Chunk>& Chunks() const { return mChunks; }
+
+    uint32_t ColumnOffset(ComponentId id) const { return mColumnOffsets[id]; }
+    std::byte* Component(const Chunk& chunk, ComponentId id, uint32_t row) const {
+        return chunk.mData + mColumnOffsets[id] + row * GetComponentInfo(id).mSize;
+    }
+    Entity* Entities(const Chunk& chunk) const { return reinterpret_cast<Entity*>(chunk.mData); }
+
+    // Appends a zeroed row; returns its chunk and row
+    void AllocateRow(uint32_t* chunk, uint32_t* row);
+    // Fills the hole at (chunk, row) with the last entity; returns the one that moved,
+    // or kNullEntity if the removed row was the last
+    Entity RemoveRow(uint32_t chunk, uint32_t row);
+    // Frees every chunk
+    void Clear();
+
+    // Where to go when a component is added or removed, filled in as transitions happen
+    std::array<uint32_t, kMaxComponentTypes> mAddEdges;
+    std::array<uint32_t, kMaxComponentTypes> mRemoveEdges;
+
+private:
+    ComponentMask mMask;
+    std::vector<ComponentId> mComponents;
+    std::array<uint32_t, kMaxComponentTypes> mColumnOffsets;
+    uint32_t mChunkCapacity{0};
+    size_t mEntityCount{0};
+    uint64_t mVersion{0};
+    std::vector<Chunk> mChunks;
+};
+
+/**
+ * One chunk as seen by a system: the entity count and a pointer to each component array.
+ */
+class ChunkView {
+public:
+    ChunkView(const Archetype* archetype, const Archetype::Chunk* chunk)
+        : mArchetype(archetype), mChunk(chunk) {}
+
+    size_t Count() const { return mChunk->mCount; }
+    const Entity* Entities() const { return mArchetype->Entities(*mChunk); }
+
+    template <class T>
+    bool Has() const { return (mArchetype->Mask() >> ComponentTypeId<T>()) & 1; }
+
+    // Only valid for components the query asked for, or checked with Has
+    template <class T>
+    T* Column() const {
+        return reinterpret_cast<T*>(mChunk->mData + mArchetype->ColumnOffset(ComponentTypeId<T>()));
+    }
+
+private:
+    const Archetype* mArchetype;
+    const Archetype::Chunk* mChunk;
+};
+
+/**
+ * Selects the archetypes that have all of one set of components and none of another.
+ * Matching archetypes are cached in the query and only new archetypes are checked on
+ * later runs, so keep a query around rather than building one per frame.
+ */
+struct Query {
+    template <class... Ts>
+    static Query With() {
+        Query query;
+        query.mAll = MakeComponentMask<Ts...>();
+        return query;
+    }
+
+    template <class... Ts>
+    Query& Without() {
+        mNone |= MakeComponentMask<Ts...>();
+        return *this;
+    }
+
+    ComponentMask mAll{0};
+    ComponentMask mNone{0};
+    std::vector<uint32_t> mArchetypes;
+    size_t mArchetypesChecked{0};
+};
+
+class World;
+
+/**
+ * Structural changes recorded while systems iterate, to be applied by
+ * World::Playback once nothing is iterating. Each thread should record into its own.
+ */
+class CommandBuffer {
+public:
+    // Components added right after a Create go to the entity it creates
+    void Create();
+    void Destroy(Entity entity);
+
+    template <class T>
+    void Add(Entity entity, const T& value) {
+        AddRaw(entity, ComponentTypeId<T>(), &value, std::is_empty_v<T> ? 0 : sizeof(T));
+    }
+    // Adds to the entity of the last Create
+    template <class T>
+    void AddToCreated(const T& value) { Add(kCreatedEntity, value); }
+
+    template <class T>
+    void Remove(Entity entity) { RemoveRaw(entity, ComponentTypeId<T>()); }
+
+    bool Empty() const { return mCommands.empty(); }
+    void Clear();
+
+private:
+    friend class World;
+
+    enum class CommandType : uint8_t { Create, Destroy, Add, Remove };
+
+    struct Command {
+        CommandType mType;
+        ComponentId mComponent;
+        Entity mEntity;
+        // Offset of an added component's value in mPayload
+        size_t mPayload;
+    };
+
+    static constexpr Entity kCreatedEntity{UINT32_MAX, UINT32_MAX};
+
+    void AddRaw(Entity entity, ComponentId id, const void* value, size_t size);
+    void RemoveRaw(Entity entity, ComponentId id);
+
+    std::vector<Command> mCommands;
+    std::vector<std::byte> mPayload;
+};
+
+/**
+ * Owns all entities and their components.
+ * Structural changes (creating or destroying entities, adding or removing components)
+ * move entities between chunks, so they must not happen while a system iterates;
+ * record them in a CommandBuffer instead.
+ */
+class World {
+public:
+    World();
+
+    template <class... Ts>
+    Entity Create(const Ts&... components) {
+        const Entity entity{CreateEntity(MakeComponentMask<Ts...>())};
+        (Set(entity, components), ...);
+        return entity;
+    }
+    Entity CreateEntity(ComponentMask mask);
+    void Destroy(Entity entity);
+    bool IsAlive(Entity entity) const;
+
+    // Adds the component, or overwrites it if the entity already has one
+    template <class T>
+    void Add(Entity entity, const T& value) {
+        AddComponent(entity, ComponentTypeId<T>());
+        Set(entity, value);
+    }
+
+    template <class T>
+    void Remove(Entity entity) { RemoveComponent(entity, ComponentTypeId<T>()); }
+
+    template <class T>
+    bool Has(Entity entity) const {
+        return IsAlive(entity) &&
+               (mArchetypes[mRecords[entity.mIndex].mArchetype]->Mask() >> ComponentTypeId<T>()) & 1;
+    }
+
+    // Null if the entity is dead or lacks the component
+    template <class T>
+    T* Get(Entity entity) {
+        return reinterpret_cast<T*>(GetComponent(entity, ComponentTypeId<T>()));
+    }
+
+    // Runs function(const ChunkView&) on every chunk the query matches
+    template <class Function>
+    void ForEachChunk(Query& query, Function&& function) {
+        UpdateQuery(query);
+        for (const uint32_t index : query.mArchetypes) {
+            const Archetype& archetype = *mArchetypes[index];
+            for (const Archetype::Chunk& chunk : archetype.Chunks()) {
+                function(ChunkView(&archetype, &chunk));
+            }
+        }
+    }
+
+    /**
+     * Runs function(const ChunkView&, size_t threadIndex) on every matching chunk, spread
+     * over the job system's threads chunksPerJob chunks at a time. The chunk list is
+     * built in frame scratch memory.
+     */
+    template <class Function>
+    void ParallelForEachChunk(Query& query, JobSystem& jobs, size_t chunksPerJob, Function&& function) {
+        ArenaVector<ChunkView> chunks{ArenaAllocator<ChunkView>(FrameScratch())};
+        CollectChunks(query, &chunks);
+        jobs.ParallelFor(chunks.size(), chunksPerJob, [&](size_t begin, size_t end, size_t thread) {
+            for (size_t i = begin; i < end; ++i) {
+                function(chunks[i], thread);
+            }
+        });
+    }
+
+    void CollectChunks(Query& query, ArenaVector<ChunkView>* chunks);
+    size_t EntityCount(Query& query);
+    /**
+     * Changes whenever an entity starts or stops matching the query, so a cache built
+     * from the matching entities can tell when to rebuild. Component values are not
+     * tracked.
+     */
+    uint64_t StructuralVersion(Query& query);
+
+    // Applies the buffer's changes in the order they were recorded, then clears it.
+    // Commands on entities that have died in the meantime are skipped.
+    void Playback(CommandBuffer& buffer);
+
+    // Destroys every entity. Archetypes are kept, so queries stay valid.
+    void Clear();
+
+    size_t EntityCount() const { return mRecords.size() - mFreeIndices.size(); }
+    size_t ArchetypeCount() const { return mArchetypes.size(); }
+    size_t ChunkCount() const;
+
+private:
+    struct EntityRecord {
+        uint32_t mArchetype{0};
+        uint32_t mChunk{0};
+        uint32_t mRow{0};
+        uint32_t mGeneration{0};
+    };
+
+    template <class T>
+    void Set(Entity entity, const T& value) {
+        if constexpr (!std::is_empty_v<T>) {
+            std::memcpy(GetComponent(entity, ComponentTypeId<T>()), &value, sizeof(T));
+        }
+    }
+
+    void UpdateQuery(Query& query);
+    uint32_t FindOrCreateArchetype(ComponentMask mask);
+    void AddComponent(Entity entity, ComponentId id);
+    void RemoveComponent(Entity entity, ComponentId id);
+    void MoveEntity(Entity entity, uint32_t targetArchetype);
+    void* GetComponent(Entity entity, ComponentId id);
+    void ReleaseRow(const EntityRecord& record);
+
+    std::vector<std::unique_ptr<Archetype>> mArchetypes;
+    std::unordered_map<ComponentMask, uint32_t> mArchetypeLookup;
+    std::vector<EntityRecord> mRecords;
+    std::vector<uint32_t> mFreeIndices;
+};
+
+
+#endif //ECS_H
@@ -0,0 +1,120 @@
+//
+// Bump allocators for data that only lives for a frame or two, one per thread.
+//
+
+#include "frame_arena.h"
+
+#include <algorithm>
+#include <bit>
+#include <print>
+
+#include "job_system.h"
+
+namespace {
+
+FrameArena* gActiveFrameArena{nullptr};
+
+constexpr double kKiB{1024.0};
+
+}
+
+LinearArena::LinearArena(size_t blockSize) : mBlockSize(blockSize) {}
+
+void LinearArena::AddBlock(size_t minimumSize) {
+    const size_t size = std::max(mBlockSize, minimumSize);
+    mBlocks.push_back(Block{std::make_unique<std::byte[]>(size), size});
+    ++mHeapAllocations;
+}
+
+void* LinearArena::Allocate(size_t bytes, size_t alignment) {
+    for (;;) {
+        if (mCurrent < mBlocks.size()) {
+            Block& block = mBlocks[mCurrent];
+            const auto base = reinterpret_cast<uintptr_t>(block.mData.get());
+            const uintptr_t aligned = (base + mOffset + alignment - 1) & ~(uintptr_t{alignment} - 1);
+            const size_t end = aligned - base + bytes;
+            if (end <= block.mSize) {
+                mOffset = end;
+                return reinterpret_cast<void*>(aligned);
+            }
+
+            // Does not fit: the rest of this block is wasted until the next reset
+            mUsedInEarlierBlocks += mOffset;
+            mOffset = 0;
+            ++mCurrent;
+            if (mCurrent < mBlocks.size()) { continue; }
+        }
+        AddBlock(bytes + alignment);
+    }
+}
+
+void LinearArena::Reset() {
+    mHighWater = HighWater();
+
+    // Swap several blocks for one that holds all of them, so the next frame like
+    // this one fits without going to the heap
+    if (mBlocks.size() > 1) {
+        const size_t total = std::bit_ceil(Capacity());
+        mBlocks.clear();
+        AddBlock(total);
+    }
+    mCurrent = 0;
+    mOffset = 0;
+    mUsedInEarlierBlocks = 0;
+}
+
+size_t LinearArena::Capacity() const {
+    size_t capacity = 0;
+    for (const Block& block : mBlocks) {
+        capacity += block.mSize;
+    }
+    return capacity;
+}
+
+void FrameArena::Initialize(size_t threadCount, size_t bytesPerThread) {
+    for (std::vector<LinearArena>& arenas : mArenas) {
+        arenas.clear();
+        for (size_t thread = 0; thread < threadCount; ++thread) {
+            arenas.emplace_back(bytesPerThread);
+        }
+    }
+    mFrame = 0;
+}
+
+void FrameArena::BeginFrame() {
+    ++mFrame;
+    for (LinearArena& arena : mArenas[mFrame % kBufferCount]) {
+        arena.Reset();
+    }
+}
+
+LinearArena* FrameArena::ThisThread() {
+    const int thread = JobSystem::ThreadIndex();
+    if (thread < 0 || static_cast<size_t>(thread) >= ThreadCount()) { return nullptr; }
+    return Current(static_cast<size_t>(thread));
+}
+
+void FrameArena::PrintReport() const {
+    std::println("Frame arenas (frame {}):", mFrame);
+    for (size_t thread = 0; thread < ThreadCount(); ++thread) {
+        size_t highWater = 0;
+        size_t capacity = 0;
+        size_t heapAllocations = 0;
+        for (const std::vector<LinearArena>& arenas : mArenas) {
+            highWater = std::max(highWater, arenas[thread].HighWater());
+            capacity += arenas[thread].Capacity();
+            heapAllocations += arenas[thread].HeapAllocations();
+        }
+        std::println("  thread {:>2}: high water {:>9.1f} KiB, capacity {:>9.1f} KiB, {} heap blocks",
+                     thread, static_cast<double>(highWater) / kKiB, static_cast<double>(capacity) / kKiB,
+                     heapAllocations);
+    }
+}
+
+void SetActiveFrameArena(FrameArena* arena) {
+    gActiveFrameArena = arena;
+}
+
+LinearArena* FrameScratch() {
+    return gActiveFrameArena != nullptr ? gActiveFrameArena->ThisThread() : nullptr;
+}
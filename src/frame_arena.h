@@ -0,0 +1,148 @@
+//
+// Bump allocators for data that only lives for a frame or two, one per thread.
+//
+
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+
+/**
+ * Hands out memory by bumping an offset and frees it all at once with Reset. When a
+ * block runs out another is taken from the heap; the next Reset replaces them all
+ * with one block big enough for everything, so once the arena has seen its busiest
+ * frame it stops touching the heap.
+ */
+class LinearArena {
+public:
+    static constexpr size_t kDefaultBlockSize{64 * 1024};
+
+    explicit LinearArena(size_t blockSize = kDefaultBlockSize);
+
+    LinearArena(LinearArena&&) = default;
+    LinearArena& operator=(LinearArena&&) = default;
+    LinearArena(const LinearArena&) = delete;
+    LinearArena& operator=(const LinearArena&) = delete;
+
+    void* Allocate(size_t bytes, size_t alignment);
+
+    template <class T>
+    T* AllocateArray(size_t count) {
+        return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+    }
+
+    // Everything allocated so far becomes invalid
+    void Reset();
+
+    size_t Used() const { return mUsedInEarlierBlocks + mOffset; }
+    // Most ever used between two resets
+    size_t HighWater() const { return std::max(mHighWater, Used()); }
+    size_t Capacity() const;
+    // Blocks taken from the heap, including the first
+    size_t HeapAllocations() const { return mHeapAllocations; }
+
+private:
+    struct Block {
+        std::unique_ptr<std::byte[]> mData;
+        size_t mSize{0};
+    };
+
+    void AddBlock(size_t minimumSize);
+
+    std::vector<Block> mBlocks;
+    size_t mCurrent{0};
+    size_t mOffset{0};
+    size_t mUsedInEarlierBlocks{0};
+    size_t mBlockSize;
+    size_t mHighWater{0};
+    size_t mHeapAllocations{0};
+};
+
+/**
+ * Standard allocator that takes from a LinearArena. Deallocation does nothing, so
+ * reserve up front: a growing container leaves its old storage behind in the arena.
+ * Without an arena it falls back to the heap, so code can be written once for both.
+ */
+template <class T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    ArenaAllocator() = default;
+    explicit ArenaAllocator(LinearArena* arena) : mArena(arena) {}
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : mArena(other.mArena) {}
+
+    T* allocate(size_t count) {
+        if (mArena != nullptr) { return mArena->AllocateArray<T>(count); }
+        return std::allocator<T>{}.allocate(count);
+    }
+
+    void deallocate(T* pointer, size_t count) {
+        if (mArena == nullptr) { std::allocator<T>{}.deallocate(pointer, count); }
+    }
+
+    template <class U>
+    bool operator==(const ArenaAllocator<U>& other) const { return mArena == other.mArena; }
+
+    LinearArena* mArena{nullptr};
+};
+
+template <class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+template <class Key, class Value, class Hash = std::hash<Key>, class Equal = std::equal_to<Key>>
+using ArenaHashMap = std::unordered_map<Key, Value, Hash, Equal, ArenaAllocator<std::pair<const Key, Value>>>;
+
+/**
+ * One arena per job system thread, double buffered: memory taken during frame N
+ * stays valid until frame N + 2 begins, so results can be handed to the next frame
+ * (e.g. last frame's visibility) without copying.
+ */
+class FrameArena {
+public:
+    static constexpr size_t kBufferCount{2};
+
+    void Initialize(size_t threadCount, size_t bytesPerThread = LinearArena::kDefaultBlockSize);
+
+    // Resets the arenas of two frames ago and makes them current. Call on the main
+    // thread at the start of a frame, while no jobs run.
+    void BeginFrame();
+
+    // The calling thread's arena for this frame; null on threads the job system does not know
+    LinearArena* ThisThread();
+    LinearArena* Current(size_t thread) { return &mArenas[mFrame % kBufferCount][thread]; }
+
+    uint64_t Frame() const { return mFrame; }
+    size_t ThreadCount() const { return mArenas[0].size(); }
+
+    // Per-thread high-water marks over both buffers
+    void PrintReport() const;
+
+private:
+    std::array<std::vector<LinearArena>, kBufferCount> mArenas;
+    uint64_t mFrame{0};
+};
+
+// Makes arena the one FrameScratch uses; null turns frame scratch back into the heap
+void SetActiveFrameArena(FrameArena* arena);
+// The calling thread's arena for this frame, or null (meaning: use the heap)
+LinearArena* FrameScratch();
+
+template <class T>
+ArenaVector<T> MakeFrameVector(size_t reserve = 0) {
+    ArenaVector<T> vector{ArenaAllocator<T>(FrameScratch())};
+    vector.reserve(reserve);
+    return vector;
+}
+
+
+#endif //FRAME_ARENA_H
@@ -0,0 +1,174 @@
+//
+// Frame timing: fixed-step simulation clock, swap interval control, a frame limiter and
+// a limit on frames queued for the GPU.
+//
+
+#include "frame_clock.h"
+
+#include <algorithm>
+#include <print>
+#include <string>
+#include <thread>
+#include <SDL2/SDL.h>
+
+// Never simulate more than this many steps in one frame. After a long stall
+// (e.g. dragging the window) we drop time instead of trying to catch up,
+// which would make the next frame even slower.
+static constexpr int kMaxStepsPerFrame{8};
+
+// Wake up now and then while blocked on a fence, so a lost context cannot hang us
+static constexpr GLuint64 kFenceWaitTimeoutNs{100'000'000};
+
+FrameClock::FrameClock(double fixedStep) : mFixedStep(fixedStep) {
+    Reset();
+}
+
+void FrameClock::Reset() {
+    mAccumulator = 0.0;
+    mFrameTime = 0.0;
+    mLastFrame = Clock::now();
+}
+
+int FrameClock::BeginFrame() {
+    const Clock::time_point now{Clock::now()};
+    mFrameTime = std::chrono::duration<double>(now - mLastFrame).count();
+    mLastFrame = now;
+
+    mAccumulator += mFrameTime;
+    int steps{static_cast<int>(mAccumulator / mFixedStep)};
+    if (steps > kMaxStepsPerFrame) {
+        steps = kMaxStepsPerFrame;
+        mAccumulator = 0.0;
+    } else {
+        mAccumulator -= steps * mFixedStep;
+    }
+    return steps;
+}
+
+void FrameLimiter::SetTargetFrameRate(double framesPerSecond) {
+    mTargetFrameRate = std::max(framesPerSecond, 0.0);
+    if (mTargetFrameRate > 0.0) {
+        mFrameDuration = std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / mTargetFrameRate));
+    }
+    mNextFrame = Clock::now();
+}
+
+void FrameLimiter::Wait() {
+    if (mTargetFrameRate <= 0.0) { return; }
+
+    // Leave enough slack for the scheduler to wake us up late
+    constexpr auto kSpinThreshold{std::chrono::microseconds(1500)};
+
+    Clock::time_point now{Clock::now()};
+    if (mNextFrame - now > kSpinThreshold) {
+        std::this_thread::sleep_for(mNextFrame - now - kSpinThreshold);
+    }
+    while (Clock::now() < mNextFrame) {
+        // Spin for the rest
+    }
+
+    // Schedule from the ideal time so that small overshoots do not add up, but
+    // resynchronize if we fell more than a frame behind.
+    now = Clock::now();
+    mNextFrame += mFrameDuration;
+    if (mNextFrame < now) {
+        mNextFrame = now + mFrameDuration;
+    }
+}
+
+void FrameLatencyLimiter::WaitForFrameSlot() {
+    // Fences signal in order, so stop at the first one that has not
+    while (!mInFlight.empty()) {
+        const GLenum result = glClientWaitSync(mInFlight.front().mSync, 0, 0);
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) { break; }
+        Retire(Clock::now());
+    }
+
+    if (mMaxFramesInFlight == 0) { return; }
+
+    const Clock::time_point waitStart{Clock::now()};
+    while (mInFlight.size() >= static_cast<size_t>(mMaxFramesInFlight)) {
+        // Flush, or the fence may never reach the GPU and the wait never end
+        const GLenum result = glClientWaitSync(mInFlight.front().mSync, GL_SYNC_FLUSH_COMMANDS_BIT,
+                                               kFenceWaitTimeoutNs);
+        if (result == GL_TIMEOUT_EXPIRED) { continue; }
+        if (result == GL_WAIT_FAILED) {
+            std::println("{}", "Waiting for a frame fence failed, no longer limiting frames in flight");
+            mMaxFramesInFlight = 0;
+            break;
+        }
+        Retire(Clock::now());
+    }
+    mTotalWaitMs += std::chrono::duration<double, std::milli>(Clock::now() - waitStart).count();
+}
+
+void FrameLatencyLimiter::EndFrame() {
+    mInFlight.push_back(InFlightFrame{glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0), mInputTime});
+}
+
+void FrameLatencyLimiter::Retire(const Clock::time_point finished) {
+    const InFlightFrame& frame = mInFlight.front();
+    mLastLatencyMs = std::chrono::duration<double, std::milli>(finished - frame.mInputTime).count();
+    mTotalLatencyMs += mLastLatencyMs;
+    mMaxLatencyMs = std::max(mMaxLatencyMs, mLastLatencyMs);
+    ++mFrames;
+
+    glDeleteSync(frame.mSync);
+    mInFlight.pop_front();
+}
+
+void FrameLatencyLimiter::Shutdown() {
+    for (const InFlightFrame& frame : mInFlight) {
+        glDeleteSync(frame.mSync);
+    }
+    mInFlight.clear();
+}
+
+double FrameLatencyLimiter::MeanLatencyMs() const {
+    return mFrames > 0 ? mTotalLatencyMs / static_cast<double>(mFrames) : 0.0;
+}
+
+void FrameLatencyLimiter::PrintReport() const {
+    if (mFrames == 0) { return; }
+    const double perFrame{1.0 / static_cast<double>(mFrames)};
+    std::println("Frames in flight: {}", mMaxFramesInFlight > 0 ? std::to_string(mMaxFramesInFlight) : "driver");
+    std::println("Input latency:    {:.2f} ms mean, {:.2f} ms max (input sampled to GPU done)",
+                 MeanLatencyMs(), mMaxLatencyMs);
+    std::println("Fence wait:       {:.2f} ms per frame", mTotalWaitMs * perFrame);
+}
+
+bool ParseSwapInterval(const std::string& name, SwapInterval* interval) {
+    for (const SwapInterval candidate : {SwapInterval::Immediate, SwapInterval::VSync, SwapInterval::Adaptive}) {
+        if (name == SwapIntervalName(candidate)) {
+            *interval = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* SwapIntervalName(const SwapInterval interval) {
+    switch (interval) {
+        case SwapInterval::Adaptive: return "adaptive";
+        case SwapInterval::Immediate: return "off";
+        case SwapInterval::VSync: return "on";
+    }
+    return "unknown";
+}
+
+SwapInterval ApplySwapInterval(SwapInterval interval) {
+    if (SDL_GL_SetSwapInterval(static_cast<int>(interval)) == 0) {
+        return interval;
+    }
+
+    if (interval == SwapInterval::Adaptive) {
+        std::println("{}", "Adaptive vsync is not supported, using vsync");
+        if (SDL_GL_SetSwapInterval(static_cast<int>(SwapInterval::VSync)) == 0) {
+            return SwapInterval::VSync;
+        }
+    }
+
+    std::println("Could not set the swap interval: {}", SDL_GetError());
+    return SwapInterval::Immediate;
+}
@@ -0,0 +1,142 @@
+//
+// Frame timing: fixed-step simulation clock, swap interval control, a frame limiter and
+// a limit on frames queued for the GPU.
+//
+
+#ifndef FRAME_CLOCK_H
+#define FRAME_CLOCK_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <glad/glad.h>
+
+
+/**
+ * Splits real time into fixed simulation steps.
+ * Each frame, BeginFrame returns how many steps of FixedStep() seconds to simulate,
+ * and Alpha() says how far we are between the last two simulated states so that
+ * rendering can interpolate between them.
+ */
+class FrameClock {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit FrameClock(double fixedStep = 1.0 / 120.0);
+
+    void Reset();
+    // Returns the number of fixed steps to run this frame
+    int BeginFrame();
+
+    double FixedStep() const { return mFixedStep; }
+    void SetFixedStep(double fixedStep) { mFixedStep = fixedStep; }
+    // Interpolation factor in [0, 1) between the previous and current simulation state
+    float Alpha() const { return static_cast<float>(mAccumulator / mFixedStep); }
+    // Real seconds between the start of this frame and the previous one
+    double FrameTime() const { return mFrameTime; }
+
+private:
+    double mFixedStep;
+    double mAccumulator{0.0};
+    double mFrameTime{0.0};
+    Clock::time_point mLastFrame;
+};
+
+
+/**
+ * Keeps frames from starting more often than the target frame rate.
+ * Sleeps for most of the remaining time and spins for the last bit, since
+ * sleeping alone can overshoot by a millisecond or more.
+ */
+class FrameLimiter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // A rate of 0 disables the limiter
+    void SetTargetFrameRate(double framesPerSecond);
+    double TargetFrameRate() const { return mTargetFrameRate; }
+
+    // Blocks until the next frame is due
+    void Wait();
+
+private:
+    double mTargetFrameRate{0.0};
+    Clock::duration mFrameDuration{};
+    Clock::time_point mNextFrame{};
+};
+
+
+/**
+ * Keeps the CPU from running more than a set number of frames ahead of the GPU, and
+ * measures input latency. The driver queues a few frames when left alone, and every
+ * queued frame is a frame of delay between reading the mouse and showing the result.
+ *
+ * Latency runs from the last input sample of a frame (MarkInputSampled) to the GPU
+ * finishing that frame, so it leaves out scanout. Frames are seen to finish when a
+ * fence is checked at the start of a frame. Without a limit the reading can be up to
+ * a frame late; with one the wait returns as the frame finishes.
+ */
+class FrameLatencyLimiter {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // 0 leaves it to the driver
+    void SetMaxFramesInFlight(int frames) { mMaxFramesInFlight = std::max(frames, 0); }
+    int MaxFramesInFlight() const { return mMaxFramesInFlight; }
+
+    // Call at the start of a frame, before input is read: retires the frames the GPU
+    // has finished and blocks until fewer than the maximum are left in flight
+    void WaitForFrameSlot();
+    // Call when the input that decides what the frame shows is read for the last time
+    void MarkInputSampled() { mInputTime = Clock::now(); }
+    // Call once the frame is submitted, after the swap
+    void EndFrame();
+    // Deletes the fences; call while the GL context still exists
+    void Shutdown();
+
+    double LastLatencyMs() const { return mLastLatencyMs; }
+    double MeanLatencyMs() const;
+    void PrintReport() const;
+
+private:
+    struct InFlightFrame {
+        GLsync mSync;
+        Clock::time_point mInputTime;
+    };
+
+    void Retire(Clock::time_point finished);
+
+    std::deque<InFlightFrame> mInFlight;
+    int mMaxFramesInFlight{0};
+    Clock::time_point mInputTime{};
+
+    size_t mFrames{0};
+    double mLastLatencyMs{0.0};
+    double mTotalLatencyMs{0.0};
+    double mMaxLatencyMs{0.0};
+    // Time spent blocked in WaitForFrameSlot
+    double mTotalWaitMs{0.0};
+};
+
+
+enum class SwapInterval {
+    Adaptive = -1, // vsync, but tear instead of waiting a whole frame when late
+    Immediate = 0,
+    VSync = 1
+};
+
+// --vsync off|on|adaptive
+bool ParseSwapInterval(const std::string& name, SwapInterval* interval);
+const char* SwapIntervalName(SwapInterval interval);
+
+/**
+ * Applies the swap interval to the current OpenGL context.
+ * Adaptive vsync falls back to regular vsync when the driver does not support it.
+ * Returns the interval that is actually in effect, or Immediate if vsync is unavailable.
+ */
+SwapInterval ApplySwapInterval(SwapInterval interval);
+
+
+#endif //FRAME_CLOCK_H
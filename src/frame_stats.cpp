@@ -0,0 +1,93 @@
+//
+// Frame time statistics and per-frame render counters for benchmarks.
+//
+
+#include "frame_stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <print>
+
+RenderCounters& RenderCounters::operator+=(const RenderCounters& other) {
+    mDrawCalls += other.mDrawCalls;
+    mTriangles += other.mTriangles;
+    mProgramBinds += other.mProgramBinds;
+    mVertexArrayBinds += other.mVertexArrayBinds;
+    mUniformUploads += other.mUniformUploads;
+    return *this;
+}
+
+void FrameStats::Reserve(size_t frames) {
+    mFrameTimesMs.reserve(frames);
+}
+
+void FrameStats::AddFrame(double frameTimeMs, const RenderCounters& counters) {
+    mFrameTimesMs.push_back(frameTimeMs);
+    mTotalTimeMs += frameTimeMs;
+    mTotals += counters;
+}
+
+void FrameStats::AddHeapAllocations(uint64_t allocations) {
+    mHeapTracked = true;
+    mHeapAllocations += allocations;
+    mMaxFrameHeapAllocations = std::max(mMaxFrameHeapAllocations, allocations);
+    if (allocations > 0) { ++mFramesWithHeapAllocations; }
+}
+
+double FrameStats::MeanMs() const {
+    if (mFrameTimesMs.empty()) { return 0.0; }
+    return mTotalTimeMs / static_cast<double>(mFrameTimesMs.size());
+}
+
+double FrameStats::PercentileMs(double p) const {
+    if (mFrameTimesMs.empty()) { return 0.0; }
+
+    // Nearest rank on a sorted copy; only called a handful of times at the end of a run
+    std::vector<double> sorted{mFrameTimesMs};
+    std::sort(sorted.begin(), sorted.end());
+    const double rank{std::ceil(p / 100.0 * static_cast<double>(sorted.size()))};
+    const size_t index{static_cast<size_t>(std::clamp(rank, 1.0, static_cast<double>(sorted.size()))) - 1};
+    return sorted[index];
+}
+
+double FrameStats::OnePercentLowMs() const {
+    if (mFrameTimesMs.empty()) { return 0.0; }
+
+    std::vector<double> sorted{mFrameTimesMs};
+    std::sort(sorted.begin(), sorted.end(), std::greater<>());
+    const size_t count{std::max<size_t>(1, sorted.size() / 100)};
+    double sum{0.0};
+    for (size_t i = 0; i < count; ++i) {
+        sum += sorted[i];
+    }
+    return sum / static_cast<double>(count);
+}
+
+void FrameStats::Print() const {
+    const size_t frames{mFrameTimesMs.size()};
+    if (frames == 0) {
+        std::println("{}", "No frames recorded");
+        return;
+    }
+
+    const double mean{MeanMs()};
+    const double onePercentLow{OnePercentLowMs()};
+    const double perFrame{1.0 / static_cast<double>(frames)};
+
+    std::println("Frames:          {} in {:.1f} ms", frames, mTotalTimeMs);
+    std::println("Frame time mean: {:.3f} ms ({:.1f} fps)", mean, 1000.0 / mean);
+    std::println("Frame time p50:  {:.3f} ms", PercentileMs(50.0));
+    std::println("Frame time p95:  {:.3f} ms", PercentileMs(95.0));
+    std::println("Frame time p99:  {:.3f} ms", PercentileMs(99.0));
+    std::println("1% low:          {:.3f} ms ({:.1f} fps)", onePercentLow, 1000.0 / onePercentLow);
+    std::println("Draw calls:      {:.1f} per frame", mTotals.mDrawCalls * perFrame);
+    std::println("Triangles:       {:.1f} per frame", mTotals.mTriangles * perFrame);
+    std::println("Program binds:   {:.1f} per frame", mTotals.mProgramBinds * perFrame);
+    std::println("VAO binds:       {:.1f} per frame", mTotals.mVertexArrayBinds * perFrame);
+    std::println("Uniform uploads: {:.1f} per frame", mTotals.mUniformUploads * perFrame);
+    if (mHeapTracked) {
+        std::println("Heap allocs:     {:.1f} per frame, at most {} ({} of {} frames allocated)",
+                     mHeapAllocations * perFrame, mMaxFrameHeapAllocations, mFramesWithHeapAllocations, frames);
+    }
+}
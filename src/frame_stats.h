@@ -0,0 +1,57 @@
+//
+// Frame time statistics and per-frame render counters for benchmarks.
+//
+
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Counted by the draw code every frame
+struct RenderCounters {
+    uint64_t mDrawCalls{0};
+    uint64_t mTriangles{0};
+    uint64_t mProgramBinds{0};
+    uint64_t mVertexArrayBinds{0};
+    uint64_t mUniformUploads{0};
+
+    RenderCounters& operator+=(const RenderCounters& other);
+};
+
+/**
+ * Collects frame times and counters over a benchmark run and prints a summary:
+ * mean, percentiles and the 1% lows.
+ */
+class FrameStats {
+public:
+    void Reserve(size_t frames);
+    void AddFrame(double frameTimeMs, const RenderCounters& counters);
+    // Heap allocations the frame made; only recorded when allocation tracking is on
+    void AddHeapAllocations(uint64_t allocations);
+
+    size_t FrameCount() const { return mFrameTimesMs.size(); }
+    double TotalTimeMs() const { return mTotalTimeMs; }
+
+    double MeanMs() const;
+    // p in [0, 100]
+    double PercentileMs(double p) const;
+    // Average of the slowest 1% of frames
+    double OnePercentLowMs() const;
+
+    void Print() const;
+
+private:
+    std::vector<double> mFrameTimesMs;
+    double mTotalTimeMs{0.0};
+    RenderCounters mTotals;
+    bool mHeapTracked{false};
+    uint64_t mHeapAllocations{0};
+    uint64_t mMaxFrameHeapAllocations{0};
+    size_t mFramesWithHeapAllocations{0};
+};
+
+
+#endif //FRAME_STATS_H
@@ -0,0 +1,57 @@
+//
+// Per-frame shader constants (camera matrices) in a uniform buffer shared by every program.
+//
+
+#include "frame_uniforms.h"
+
+#include <algorithm>
+#include <iostream>
+#include <print>
+
+bool FrameUniformBufferCreate(GpuResources* resources, FrameUniformBuffer* buffer, size_t slots) {
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+
+    buffer->mSlots.clear();
+    buffer->mNext = 0;
+    for (size_t slot = 0; slot < slots; ++slot) {
+        const AllocationHandle handle = resources->Allocate(BufferCategory::Uniform, sizeof(FrameUniforms),
+                                                            static_cast<size_t>(std::max(alignment, 1)), nullptr);
+        if (handle.IsNull()) {
+            std::println(std::cerr, "{}", "Could not allocate the frame uniform buffer");
+            FrameUniformBufferDelete(resources, buffer);
+            return false;
+        }
+        buffer->mSlots.push_back(handle);
+    }
+    return true;
+}
+
+void FrameUniformBufferUpload(const GpuResources& resources, FrameUniformBuffer* buffer,
+                              const FrameUniforms& uniforms) {
+    if (buffer->mSlots.empty()) { return; }
+
+    const AllocationHandle handle = buffer->mSlots[buffer->mNext];
+    buffer->mNext = (buffer->mNext + 1) % buffer->mSlots.size();
+
+    const GpuAllocation* allocation = resources.Get(handle);
+    const GLuint pool = resources.Name(handle);
+    glBindBuffer(GL_UNIFORM_BUFFER, pool);
+    glBufferSubData(GL_UNIFORM_BUFFER, allocation->mOffset, sizeof(FrameUniforms), &uniforms);
+    glBindBufferRange(GL_UNIFORM_BUFFER, kFrameUniformBinding, pool, allocation->mOffset, sizeof(FrameUniforms));
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void FrameUniformBufferDelete(GpuResources* resources, FrameUniformBuffer* buffer) {
+    for (const AllocationHandle handle : buffer->mSlots) {
+        resources->Free(handle);
+    }
+    buffer->mSlots.clear();
+    buffer->mNext = 0;
+}
+
+void BindFrameUniformBlock(const GLuint program) {
+    const GLuint block = glGetUniformBlockIndex(program, "FrameUniforms");
+    if (block == GL_INVALID_INDEX) { return; }
+    glUniformBlockBinding(program, block, kFrameUniformBinding);
+}
@@ -0,0 +1,68 @@
+//
+// Per-frame shader constants (camera matrices, light clusters, shadow cascades) in a uniform buffer shared by every program.
+//
+
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <cstddef>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "gpu_resources.h"
+
+
+// Uniform buffer binding point of the FrameUniforms block
+constexpr GLuint kFrameUniformBinding{0};
+// Directional light shadow cascades; their split depths are packed in one vec4
+constexpr int kShadowCascadeCount{4};
+
+// Matches the std140 FrameUniforms block in vert.glsl
+struct FrameUniforms {
+    glm::mat4 mViewMatrix;
+    glm::mat4 mProjection;
+    // Light clusters: 1 / tile size in pixels, then the scale and bias from log view depth to slice
+    glm::vec4 mClusterScale{0.0f};
+    // Clusters across, down and in depth, and the number of lights
+    glm::uvec4 mClusterCounts{0u};
+    glm::vec4 mAmbient{1.0f};
+    // Shadow cascades: world to shadow map texture coordinates and depth, the view
+    // depth where each ends, and how far to push receivers out along their normal
+    glm::mat4 mShadowMatrices[kShadowCascadeCount]{};
+    glm::vec4 mCascadeSplits{0.0f};
+    glm::vec4 mCascadeNormalOffsets{0.0f};
+    // Toward the directional light, w is 1 when there is one
+    glm::vec4 mSunDirection{0.0f};
+    // w is the size of a shadow map texel in texture coordinates
+    glm::vec4 mSunColor{0.0f};
+    // Clip space back to world space, for positions rebuilt from depth
+    glm::mat4 mInverseViewProjection{1.0f};
+    // w is 1 when clip space depth runs from 0 to 1 (reverse-Z) rather than -1 to 1
+    glm::vec4 mCameraPosition{0.0f};
+    // Width and height of the viewport in pixels, then their reciprocals
+    glm::vec4 mViewport{0.0f};
+};
+
+/**
+ * A ring of FrameUniforms slots in the uniform buffer pool. Each frame writes the
+ * next slot, so it never overwrites values a frame still in flight on the GPU reads;
+ * there should be at least one slot more than the frames allowed in flight.
+ */
+struct FrameUniformBuffer {
+    std::vector<AllocationHandle> mSlots;
+    size_t mNext{0};
+};
+
+bool FrameUniformBufferCreate(GpuResources* resources, FrameUniformBuffer* buffer, size_t slots);
+// Writes uniforms into the next slot and binds it to kFrameUniformBinding
+void FrameUniformBufferUpload(const GpuResources& resources, FrameUniformBuffer* buffer,
+                              const FrameUniforms& uniforms);
+void FrameUniformBufferDelete(GpuResources* resources, FrameUniformBuffer* buffer);
+
+// Points the program's FrameUniforms block at kFrameUniformBinding. GLSL 4.10 has no
+// layout(binding = N), so this is done from here for every program that is used.
+void BindFrameUniformBlock(GLuint program);
+
+
+#endif //FRAME_UNIFORMS_H
@@ -0,0 +1,66 @@
+//
+// View frustum planes for visibility tests.
+//
+
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+
+// Six planes (left, right, bottom, top, near, far) with normals pointing inward.
+// With no far plane the last one accepts everything.
+struct Frustum {
+    glm::vec4 mPlanes[6];
+};
+
+/**
+ * Extract the frustum planes from a view-projection matrix (Gribb/Hartmann).
+ * Points inside the frustum satisfy dot(plane.xyz, p) + plane.w >= 0 for every plane.
+ * reverseZ is for matrices that map near to 1 and far to 0 in a [0, 1] depth range.
+ */
+inline Frustum FrustumFromMatrix(const glm::mat4& m, const bool reverseZ = false) {
+    // glm matrices are column major: m[column][row]
+    const glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    const glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    const glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    const glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    Frustum frustum;
+    frustum.mPlanes[0] = row3 + row0;
+    frustum.mPlanes[1] = row3 - row0;
+    frustum.mPlanes[2] = row3 + row1;
+    frustum.mPlanes[3] = row3 - row1;
+    if (reverseZ) {
+        // z <= w at the near plane, z >= 0 at the far one
+        frustum.mPlanes[4] = row3 - row2;
+        frustum.mPlanes[5] = row2;
+    } else {
+        frustum.mPlanes[4] = row3 + row2;
+        frustum.mPlanes[5] = row3 - row2;
+    }
+
+    for (glm::vec4& plane : frustum.mPlanes) {
+        const float length = glm::length(glm::vec3(plane));
+        // An infinite far plane comes out with no normal
+        plane = length > 0.0f ? plane / length : glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+    }
+    return frustum;
+}
+
+// Distance of a point in front of the near plane, e.g. for sorting by depth
+inline float FrustumNearDistance(const Frustum& frustum, const glm::vec3& point) {
+    return glm::dot(glm::vec3(frustum.mPlanes[4]), point) + frustum.mPlanes[4].w;
+}
+
+inline bool FrustumIntersectsSphere(const Frustum& frustum, const glm::vec3& center, const float radius) {
+    for (const glm::vec4& plane : frustum.mPlanes) {
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+#endif //FRUSTUM_H
@@ -0,0 +1,387 @@
+//
+// Vertex, index and uniform ranges carved out of large pooled buffers, with a budget per category.
+//
+
+#include "gpu_allocator.h"
+
+#include <algorithm>
+#include <bit>
+#include <print>
+
+namespace {
+
+constexpr double kMiB{1024.0 * 1024.0};
+
+// Pools are created this size unless a single request needs more
+constexpr size_t kDefaultPageSize{4 * 1024 * 1024};
+constexpr size_t kDefaultUniformPageSize{1024 * 1024};
+
+uint32_t RoundUp(uint32_t value, uint32_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// A power-of-two alignment comes for free, since blocks are aligned to their size.
+// Anything else needs room to slide the data forward.
+size_t BlockRequest(size_t bytes, size_t alignment) {
+    return std::has_single_bit(alignment) ? std::max(bytes, alignment) : bytes + alignment - 1;
+}
+
+}
+
+BuddyAllocator::BuddyAllocator(uint32_t capacity, uint32_t minBlockSize)
+    : mCapacity(capacity),
+      mMinBlockShift(static_cast<uint32_t>(std::countr_zero(minBlockSize))),
+      mOrderCount(static_cast<uint32_t>(std::countr_zero(capacity / minBlockSize)) + 1) {
+    const uint32_t blocks = capacity / minBlockSize;
+    mFreeOrder.assign(blocks, kNone);
+    mAllocatedOrder.assign(blocks, kNone);
+    mNext.assign(blocks, kEndOfList);
+    mPrevious.assign(blocks, kEndOfList);
+    mFreeLists.assign(mOrderCount, kEndOfList);
+    // Everything starts out as one free block of the highest order
+    PushFree(0, mOrderCount - 1);
+}
+
+uint32_t BuddyAllocator::BlockSize(uint32_t bytes) const {
+    return std::bit_ceil(std::max(bytes, 1u << mMinBlockShift));
+}
+
+uint32_t BuddyAllocator::Allocate(uint32_t bytes) {
+    if (bytes == 0 || bytes > mCapacity) { return kInvalidOffset; }
+    const auto order = static_cast<uint32_t>(std::countr_zero(BlockSize(bytes) >> mMinBlockShift));
+
+    uint32_t available = order;
+    while (available < mOrderCount && mFreeLists[available] == kEndOfList) {
+        ++available;
+    }
+    if (available == mOrderCount) { return kInvalidOffset; }
+
+    const uint32_t block = mFreeLists[available];
+    RemoveFree(block, available);
+    // Split, keeping the front half and freeing the back half each time
+    while (available > order) {
+        --available;
+        PushFree(block + (1u << available), available);
+    }
+
+    mAllocatedOrder[block] = static_cast<uint8_t>(order);
+    mUsedBytes += 1u << (order + mMinBlockShift);
+    return block << mMinBlockShift;
+}
+
+void BuddyAllocator::Free(uint32_t offset) {
+    uint32_t block = offset >> mMinBlockShift;
+    uint32_t order = mAllocatedOrder[block];
+    mAllocatedOrder[block] = kNone;
+    mUsedBytes -= 1u << (order + mMinBlockShift);
+
+    // Merge with the buddy for as long as it is free and whole
+    while (order + 1 < mOrderCount) {
+        const uint32_t buddy = block ^ (1u << order);
+        if (mFreeOrder[buddy] != order) { break; }
+        RemoveFree(buddy, order);
+        block = std::min(block, buddy);
+        ++order;
+    }
+    PushFree(block, order);
+}
+
+uint32_t BuddyAllocator::LargestFreeBlock() const {
+    for (uint32_t order = mOrderCount; order-- > 0;) {
+        if (mFreeLists[order] != kEndOfList) {
+            return 1u << (order + mMinBlockShift);
+        }
+    }
+    return 0;
+}
+
+void BuddyAllocator::PushFree(uint32_t block, uint32_t order) {
+    mFreeOrder[block] = static_cast<uint8_t>(order);
+    mPrevious[block] = kEndOfList;
+    mNext[block] = mFreeLists[order];
+    if (mFreeLists[order] != kEndOfList) {
+        mPrevious[mFreeLists[order]] = block;
+    }
+    mFreeLists[order] = block;
+}
+
+void BuddyAllocator::RemoveFree(uint32_t block, uint32_t order) {
+    if (mPrevious[block] != kEndOfList) {
+        mNext[mPrevious[block]] = mNext[block];
+    } else {
+        mFreeLists[order] = mNext[block];
+    }
+    if (mNext[block] != kEndOfList) {
+        mPrevious[mNext[block]] = mPrevious[block];
+    }
+    mFreeOrder[block] = kNone;
+}
+
+const char* BufferCategoryName(BufferCategory category) {
+    switch (category) {
+        case BufferCategory::Vertex: return "vertex";
+        case BufferCategory::Index: return "index";
+        case BufferCategory::Uniform: return "uniform";
+    }
+    return "";
+}
+
+GpuBufferAllocator::GpuBufferAllocator() {
+    mCategories[static_cast<size_t>(BufferCategory::Vertex)].mPageSize = kDefaultPageSize;
+    mCategories[static_cast<size_t>(BufferCategory::Index)].mPageSize = kDefaultPageSize;
+    mCategories[static_cast<size_t>(BufferCategory::Uniform)].mPageSize = kDefaultUniformPageSize;
+}
+
+void GpuBufferAllocator::SetPageSize(BufferCategory category, size_t bytes) {
+    mCategories[static_cast<size_t>(category)].mPageSize = std::bit_ceil(std::max<size_t>(bytes, kMinBlockSize));
+}
+
+void GpuBufferAllocator::SetBudget(BufferCategory category, size_t bytes) {
+    mCategories[static_cast<size_t>(category)].mBudget.mLimit = bytes;
+}
+
+GLenum GpuBufferAllocator::UsageFor(BufferCategory category) {
+    return category == BufferCategory::Uniform ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW;
+}
+
+AllocationHandle GpuBufferAllocator::Allocate(BufferCategory category, size_t bytes, size_t alignment,
+                                              const void* data) {
+    Category& pools = mCategories[static_cast<size_t>(category)];
+    alignment = std::max<size_t>(alignment, 1);
+
+    const size_t request = BlockRequest(bytes, alignment);
+    if (bytes == 0 || request > (1u << 31)) { return AllocationHandle{}; }
+    const uint32_t blockBytes = std::bit_ceil(std::max(static_cast<uint32_t>(request), kMinBlockSize));
+
+    GpuAllocation allocation;
+    allocation.mCategory = category;
+    allocation.mBytes = static_cast<uint32_t>(bytes);
+    allocation.mAlignment = static_cast<uint32_t>(alignment);
+    if (!PlaceInPools(pools, blockBytes, allocation.mAlignment, UINT32_MAX, &allocation)) {
+        const uint32_t pool = CreatePool(category, std::max(pools.mPageSize, static_cast<size_t>(blockBytes)));
+        if (pool == UINT32_MAX) {
+            ++pools.mBudget.mFailures;
+            std::println("WARNING: {} buffer budget exceeded, could not allocate {} bytes",
+                         BufferCategoryName(category), bytes);
+            return AllocationHandle{};
+        }
+        PlaceInPools(pools, blockBytes, allocation.mAlignment, UINT32_MAX, &allocation);
+    }
+
+    if (data != nullptr) {
+        // The copy binding point leaves any bound VAO's element buffer alone
+        glBindBuffer(GL_COPY_WRITE_BUFFER, pools.mPools[allocation.mPool].mBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, allocation.mOffset, static_cast<GLsizeiptr>(bytes), data);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+
+    pools.mBudget.mAllocated += blockBytes;
+    pools.mBudget.mRequested += bytes;
+    ++pools.mBudget.mAllocations;
+    return mAllocations.Insert(allocation);
+}
+
+bool GpuBufferAllocator::PlaceInPools(Category& pools, uint32_t blockBytes, uint32_t alignment,
+                                      uint32_t skipPool, GpuAllocation* allocation) {
+    for (uint32_t index = 0; index < pools.mPools.size(); ++index) {
+        Pool& pool = pools.mPools[index];
+        if (index == skipPool || pool.mBuffer == 0) { continue; }
+
+        const uint32_t block = pool.mBlocks.Allocate(blockBytes);
+        if (block == BuddyAllocator::kInvalidOffset) { continue; }
+        ++pool.mAllocations;
+        allocation->mPool = index;
+        allocation->mBlock = block;
+        allocation->mOffset = RoundUp(block, alignment);
+        return true;
+    }
+    return false;
+}
+
+uint32_t GpuBufferAllocator::CreatePool(BufferCategory category, size_t capacity) {
+    Category& pools = mCategories[static_cast<size_t>(category)];
+    BufferBudget& budget = pools.mBudget;
+    if (budget.mLimit > 0 && budget.mReserved + capacity > budget.mLimit) { return UINT32_MAX; }
+    if (mTotalLimit > 0 && TotalReserved() + capacity > mTotalLimit) { return UINT32_MAX; }
+
+    // Reuse the slot of a deleted pool, so allocation pool indices stay small
+    uint32_t index = 0;
+    while (index < pools.mPools.size() && pools.mPools[index].mBuffer != 0) {
+        ++index;
+    }
+    if (index == pools.mPools.size()) {
+        pools.mPools.emplace_back();
+    }
+
+    Pool& pool = pools.mPools[index];
+    glGenBuffers(1, &pool.mBuffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, pool.mBuffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(capacity), nullptr, UsageFor(category));
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    pool.mBlocks = BuddyAllocator(static_cast<uint32_t>(capacity), kMinBlockSize);
+    pool.mAllocations = 0;
+
+    budget.mReserved += capacity;
+    budget.mPeakReserved = std::max(budget.mPeakReserved, budget.mReserved);
+    ++budget.mPools;
+    return index;
+}
+
+void GpuBufferAllocator::DeletePool(Category& pools, uint32_t index) {
+    Pool& pool = pools.mPools[index];
+    pools.mBudget.mReserved -= pool.mBlocks.Capacity();
+    --pools.mBudget.mPools;
+    pool = Pool{};
+}
+
+void GpuBufferAllocator::Free(AllocationHandle handle) {
+    const GpuAllocation* allocation = mAllocations.Get(handle);
+    if (allocation == nullptr) { return; }
+
+    Category& pools = mCategories[static_cast<size_t>(allocation->mCategory)];
+    const uint32_t poolIndex = allocation->mPool;
+    Pool& pool = pools.mPools[poolIndex];
+    pool.mBlocks.Free(allocation->mBlock);
+    --pool.mAllocations;
+
+    pools.mBudget.mAllocated -= pool.mBlocks.BlockSize(
+        static_cast<uint32_t>(BlockRequest(allocation->mBytes, allocation->mAlignment)));
+    pools.mBudget.mRequested -= allocation->mBytes;
+    --pools.mBudget.mAllocations;
+    mAllocations.Remove(handle);
+
+    // Keep one pool around so that allocating and freeing in turn does not thrash,
+    // but give back the others as soon as they empty. The GPU is done with them,
+    // since everything in them has been freed.
+    if (pool.mAllocations == 0 && pools.mBudget.mPools > 1) {
+        glDeleteBuffers(1, &pool.mBuffer);
+        DeletePool(pools, poolIndex);
+    }
+}
+
+GLuint GpuBufferAllocator::BufferName(AllocationHandle handle) const {
+    const GpuAllocation* allocation = mAllocations.Get(handle);
+    if (allocation == nullptr) { return 0; }
+    return mCategories[static_cast<size_t>(allocation->mCategory)].mPools[allocation->mPool].mBuffer;
+}
+
+std::vector<RetiredPool> GpuBufferAllocator::Compact(BufferCategory category,
+                                                     std::vector<AllocationHandle>* moved) {
+    Category& pools = mCategories[static_cast<size_t>(category)];
+    std::vector<RetiredPool> emptied;
+    std::vector<AllocationHandle> evacuees;
+    std::vector<GpuAllocation> targets;
+
+    for (;;) {
+        // The emptiest pool that is less than half used
+        uint32_t source = UINT32_MAX;
+        double lowestUse = 0.5;
+        for (uint32_t index = 0; index < pools.mPools.size(); ++index) {
+            const Pool& pool = pools.mPools[index];
+            if (pool.mBuffer == 0) { continue; }
+            const double use = static_cast<double>(pool.mBlocks.UsedBytes()) / pool.mBlocks.Capacity();
+            if (use < lowestUse) {
+                lowestUse = use;
+                source = index;
+            }
+        }
+        if (source == UINT32_MAX || pools.mBudget.mPools < 2) { break; }
+
+        evacuees.clear();
+        mAllocations.ForEach([&](AllocationHandle handle, const GpuAllocation& allocation) {
+            if (allocation.mCategory == category && allocation.mPool == source) {
+                evacuees.push_back(handle);
+            }
+        });
+
+        // Find room for all of them before moving any, and give up if there is none
+        targets.clear();
+        for (const AllocationHandle handle : evacuees) {
+            GpuAllocation target = *mAllocations.Get(handle);
+            const uint32_t blockBytes = std::bit_ceil(std::max(
+                static_cast<uint32_t>(BlockRequest(target.mBytes, target.mAlignment)), kMinBlockSize));
+            if (!PlaceInPools(pools, blockBytes, target.mAlignment, source, &target)) { break; }
+            targets.push_back(target);
+        }
+        if (targets.size() < evacuees.size()) {
+            for (const GpuAllocation& target : targets) {
+                Pool& pool = pools.mPools[target.mPool];
+                pool.mBlocks.Free(target.mBlock);
+                --pool.mAllocations;
+            }
+            break;
+        }
+
+        // The copies are ordered after the draws already submitted, so those still
+        // read the old contents from the old pool
+        const GLuint sourceBuffer = pools.mPools[source].mBuffer;
+        glBindBuffer(GL_COPY_READ_BUFFER, sourceBuffer);
+        for (size_t i = 0; i < evacuees.size(); ++i) {
+            GpuAllocation* allocation = mAllocations.Get(evacuees[i]);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, pools.mPools[targets[i].mPool].mBuffer);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, allocation->mOffset, targets[i].mOffset,
+                                allocation->mBytes);
+            *allocation = targets[i];
+            moved->push_back(evacuees[i]);
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+        emptied.push_back(RetiredPool{sourceBuffer, pools.mPools[source].mBlocks.Capacity()});
+        DeletePool(pools, source);
+    }
+    return emptied;
+}
+
+size_t GpuBufferAllocator::TotalReserved() const {
+    size_t total = 0;
+    for (const Category& pools : mCategories) {
+        total += pools.mBudget.mReserved;
+    }
+    return total;
+}
+
+void GpuBufferAllocator::PrintReport() const {
+    std::println("GPU buffer pools: {:.2f} MiB reserved", static_cast<double>(TotalReserved()) / kMiB);
+    if (mTotalLimit > 0) {
+        std::println("  total limit {:.2f} MiB", static_cast<double>(mTotalLimit) / kMiB);
+    }
+    for (size_t i = 0; i < kBufferCategoryCount; ++i) {
+        const Category& pools = mCategories[i];
+        const BufferBudget& budget = pools.mBudget;
+
+        uint32_t largestFree = 0;
+        for (const Pool& pool : pools.mPools) {
+            if (pool.mBuffer != 0) { largestFree = std::max(largestFree, pool.mBlocks.LargestFreeBlock()); }
+        }
+        std::println("  {:<8}{:>8} allocations {:>3} pools {:>8.2f} MiB reserved {:>8.2f} MiB used"
+                     " {:>8.2f} MiB requested {:>8.2f} MiB peak {:>8.2f} MiB largest free",
+                     BufferCategoryName(static_cast<BufferCategory>(i)), budget.mAllocations, budget.mPools,
+                     static_cast<double>(budget.mReserved) / kMiB, static_cast<double>(budget.mAllocated) / kMiB,
+                     static_cast<double>(budget.mRequested) / kMiB, static_cast<double>(budget.mPeakReserved) / kMiB,
+                     static_cast<double>(largestFree) / kMiB);
+        if (budget.mLimit > 0) {
+            std::println("          limit {:.2f} MiB", static_cast<double>(budget.mLimit) / kMiB);
+        }
+        if (budget.mFailures > 0) {
+            std::println("          {} allocations refused by the budget", budget.mFailures);
+        }
+    }
+}
+
+void GpuBufferAllocator::DeleteAll() {
+    for (Category& pools : mCategories) {
+        for (uint32_t index = 0; index < pools.mPools.size(); ++index) {
+            if (pools.mPools[index].mBuffer != 0) {
+                glDeleteBuffers(1, &pools.mPools[index].mBuffer);
+                DeletePool(pools, index);
+            }
+        }
+        const size_t limit = pools.mBudget.mLimit;
+        const size_t peak = pools.mBudget.mPeakReserved;
+        pools.mBudget = BufferBudget{};
+        pools.mBudget.mLimit = limit;
+        pools.mBudget.mPeakReserved = peak;
+    }
+    mAllocations = SlotMap<GpuAllocation, AllocationTag>{};
+}
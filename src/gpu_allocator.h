@@ -0,0 +1,184 @@
+//
+// Vertex, index and uniform ranges carved out of large pooled buffers, with a budget per category.
+//
+
+#ifndef GPU_ALLOCATOR_H
+#define GPU_ALLOCATOR_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+
+#include "gpu_handles.h"
+#include "slot_map.h"
+
+
+/**
+ * Power-of-two block allocator over [0, capacity). Only does the bookkeeping; it
+ * never touches memory. Blocks are split in halves until they fit a request and a
+ * freed block merges with its buddy whenever that is free too, so free space does
+ * not splinter into ever smaller pieces. Every block is aligned to its own size.
+ */
+class BuddyAllocator {
+public:
+    static constexpr uint32_t kInvalidOffset{UINT32_MAX};
+
+    BuddyAllocator() = default;
+    // Both must be powers of two, with capacity >= minBlockSize
+    BuddyAllocator(uint32_t capacity, uint32_t minBlockSize);
+
+    // Returns the block's offset, or kInvalidOffset when no block is big enough
+    uint32_t Allocate(uint32_t bytes);
+    void Free(uint32_t offset);
+
+    // Size of the block that Allocate(bytes) hands out
+    uint32_t BlockSize(uint32_t bytes) const;
+
+    uint32_t Capacity() const { return mCapacity; }
+    uint32_t UsedBytes() const { return mUsedBytes; }
+    uint32_t LargestFreeBlock() const;
+
+private:
+    static constexpr uint8_t kNone{0xFF};
+    static constexpr uint32_t kEndOfList{UINT32_MAX};
+
+    void PushFree(uint32_t block, uint32_t order);
+    void RemoveFree(uint32_t block, uint32_t order);
+
+    uint32_t mCapacity{0};
+    uint32_t mMinBlockShift{0};
+    uint32_t mOrderCount{0};
+    uint32_t mUsedBytes{0};
+
+    // Indexed by offset / minBlockSize. A block of order n spans 2^n minimum blocks.
+    std::vector<uint8_t> mFreeOrder;
+    std::vector<uint8_t> mAllocatedOrder;
+    std::vector<uint32_t> mNext;
+    std::vector<uint32_t> mPrevious;
+    // Head of the free list for each order
+    std::vector<uint32_t> mFreeLists;
+};
+
+enum class BufferCategory : uint8_t { Vertex, Index, Uniform };
+constexpr size_t kBufferCategoryCount{3};
+
+const char* BufferCategoryName(BufferCategory category);
+
+// A pool emptied by compaction, to be deleted once the GPU is done with it
+struct RetiredPool {
+    GLuint mBuffer;
+    size_t mBytes;
+};
+
+struct GpuAllocation {
+    BufferCategory mCategory{BufferCategory::Vertex};
+    uint32_t mPool{0};
+    // The buddy block, and the aligned start of the data inside it
+    uint32_t mBlock{0};
+    uint32_t mOffset{0};
+    uint32_t mBytes{0};
+    uint32_t mAlignment{1};
+};
+
+/**
+ * Memory use of one category. Reserved is what the pools hold on the GPU; allocated
+ * is the blocks handed out of them, which is more than requested because blocks are
+ * powers of two.
+ */
+struct BufferBudget {
+    // Cap on reserved bytes, 0 for none
+    size_t mLimit{0};
+    size_t mReserved{0};
+    size_t mPeakReserved{0};
+    size_t mAllocated{0};
+    size_t mRequested{0};
+    size_t mAllocations{0};
+    size_t mPools{0};
+    // Allocations refused because they would have gone over a limit
+    size_t mFailures{0};
+};
+
+/**
+ * Hands out ranges of a few large buffers per category instead of a buffer per mesh.
+ * Each pool is one buffer managed by a BuddyAllocator; requests larger than a page
+ * get a pool of their own. Allocations are referred to by handle so that Compact can
+ * move them.
+ *
+ * Free is immediate. Use GpuResources::Free, which waits until the GPU is done with
+ * the range. Must be used from the thread that owns the GL context.
+ */
+class GpuBufferAllocator {
+public:
+    static constexpr uint32_t kMinBlockSize{256};
+
+    GpuBufferAllocator();
+    ~GpuBufferAllocator() = default;
+
+    GpuBufferAllocator(const GpuBufferAllocator&) = delete;
+    GpuBufferAllocator& operator=(const GpuBufferAllocator&) = delete;
+
+    // Size of the pools created from now on, rounded up to a power of two
+    void SetPageSize(BufferCategory category, size_t bytes);
+    void SetBudget(BufferCategory category, size_t bytes);
+    // Cap on the bytes reserved by all categories together, 0 for none
+    void SetTotalBudget(size_t bytes) { mTotalLimit = bytes; }
+
+    // Alignment need not be a power of two (e.g. a vertex stride, for base vertex draws).
+    // Returns a null handle when the budget does not allow a new pool.
+    AllocationHandle Allocate(BufferCategory category, size_t bytes, size_t alignment, const void* data);
+    void Free(AllocationHandle handle);
+
+    // Null when the handle is dead
+    const GpuAllocation* Get(AllocationHandle handle) const { return mAllocations.Get(handle); }
+    // The pool buffer the allocation lives in, or 0 when the handle is dead
+    GLuint BufferName(AllocationHandle handle) const;
+
+    /**
+     * Moves every allocation out of pools that are less than half used into space in
+     * the other pools, so the emptied pools can be deleted. Returns them for the caller
+     * to delete once the GPU is done with them; the handles of the allocations that
+     * moved are appended to moved. Free space inside a pool needs no compacting, as
+     * buddies merge as soon as both are free.
+     */
+    std::vector<RetiredPool> Compact(BufferCategory category, std::vector<AllocationHandle>* moved);
+
+    const BufferBudget& Budget(BufferCategory category) const {
+        return mCategories[static_cast<size_t>(category)].mBudget;
+    }
+    size_t TotalReserved() const;
+    size_t TotalBudget() const { return mTotalLimit; }
+
+    void PrintReport() const;
+    // Deletes every pool right away, live allocations included
+    void DeleteAll();
+
+private:
+    struct Pool {
+        GLuint mBuffer{0};
+        BuddyAllocator mBlocks;
+        size_t mAllocations{0};
+    };
+
+    struct Category {
+        std::vector<Pool> mPools;
+        size_t mPageSize{0};
+        BufferBudget mBudget;
+    };
+
+    static GLenum UsageFor(BufferCategory category);
+    // Finds room in an existing pool, skipping one; false when none has room
+    bool PlaceInPools(Category& pools, uint32_t blockBytes, uint32_t alignment, uint32_t skipPool,
+                      GpuAllocation* allocation);
+    // Returns the new pool's index, or UINT32_MAX when it would go over budget
+    uint32_t CreatePool(BufferCategory category, size_t capacity);
+    void DeletePool(Category& pools, uint32_t index);
+
+    std::array<Category, kBufferCategoryCount> mCategories;
+    SlotMap<GpuAllocation, AllocationTag> mAllocations;
+    size_t mTotalLimit{0};
+};
+
+
+#endif //GPU_ALLOCATOR_H
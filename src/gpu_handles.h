@@ -0,0 +1,25 @@
+//
+// Handle types for the GPU resources owned by GpuResources.
+//
+
+#ifndef GPU_HANDLES_H
+#define GPU_HANDLES_H
+
+#include "slot_map.h"
+
+
+struct BufferTag {};
+struct TextureTag {};
+struct ProgramTag {};
+struct MeshTag {};
+struct AllocationTag {};
+
+using BufferHandle = Handle<BufferTag>;
+using TextureHandle = Handle<TextureTag>;
+using ProgramHandle = Handle<ProgramTag>;
+using MeshHandle = Handle<MeshTag>;
+// A range of a pooled buffer, see GpuBufferAllocator
+using AllocationHandle = Handle<AllocationTag>;
+
+
+#endif //GPU_HANDLES_H
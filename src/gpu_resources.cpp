@@ -0,0 +1,317 @@
+//
+// Owns GPU objects behind generational handles and deletes them once the GPU is done.
+//
+
+#include "gpu_resources.h"
+
+#include <algorithm>
+#include <iostream>
+#include <print>
+
+namespace {
+
+template <class Map, class HandleType>
+void AddRefIn(Map& map, HandleType handle) {
+    if (auto* entry = map.Get(handle)) {
+        ++entry->mRefCount;
+    }
+}
+
+void PrintCount(const char* name, const ResourceCount& count) {
+    std::println("  {:<10}{:>8} live {:>10.2f} MiB {:>8} pending {:>10.2f} MiB", name,
+                 count.mLive, static_cast<double>(count.mLiveBytes) / (1024.0 * 1024.0),
+                 count.mPending, static_cast<double>(count.mPendingBytes) / (1024.0 * 1024.0));
+}
+
+}
+
+BufferHandle GpuResources::CreateBuffer(GLenum target, size_t bytes, const void* data, GLenum usage) {
+    GpuBuffer buffer{0, target, bytes};
+    // Note: We'll see this pattern of code often in OpenGL of creating and binding to a buffer.
+    glGenBuffers(1, &buffer.mName);
+    // Bind is equivalent to 'selecting the active buffer object' that we want to work with
+    glBindBuffer(target, buffer.mName);
+    // Copy the data from the CPU into the buffer that lives on the GPU
+    glBufferData(target, static_cast<GLsizeiptr>(bytes), data, usage);
+    return mBuffers.Insert(Counted<GpuBuffer>{buffer, 1});
+}
+
+TextureHandle GpuResources::CreateTexture2D(GLenum internalFormat, int width, int height, GLenum format,
+                                            GLenum type, size_t bytesPerPixel) {
+    GpuTexture texture{0, GL_TEXTURE_2D, static_cast<size_t>(width) * static_cast<size_t>(height) * bytesPerPixel};
+    glGenTextures(1, &texture.mName);
+    glBindTexture(GL_TEXTURE_2D, texture.mName);
+    glTexImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(internalFormat), width, height, 0, format, type, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return mTextures.Insert(Counted<GpuTexture>{texture, 1});
+}
+
+TextureHandle GpuResources::CreateTexture2DArray(GLenum internalFormat, int width, int height, int layers,
+                                                 GLenum format, GLenum type, size_t bytesPerPixel) {
+    GpuTexture texture{0, GL_TEXTURE_2D_ARRAY, static_cast<size_t>(width) * static_cast<size_t>(height) *
+                                               static_cast<size_t>(layers) * bytesPerPixel};
+    glGenTextures(1, &texture.mName);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture.mName);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, static_cast<GLint>(internalFormat), width, height, layers, 0, format, type,
+                 nullptr);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    return mTextures.Insert(Counted<GpuTexture>{texture, 1});
+}
+
+TextureHandle GpuResources::CreateRenderbuffer(GLenum internalFormat, int width, int height, size_t bytesPerPixel) {
+    GpuTexture texture{0, GL_RENDERBUFFER, static_cast<size_t>(width) * static_cast<size_t>(height) * bytesPerPixel};
+    glGenRenderbuffers(1, &texture.mName);
+    glBindRenderbuffer(GL_RENDERBUFFER, texture.mName);
+    glRenderbufferStorage(GL_RENDERBUFFER, internalFormat, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    return mTextures.Insert(Counted<GpuTexture>{texture, 1});
+}
+
+ProgramHandle GpuResources::AdoptProgram(GLuint program) {
+    return mPrograms.Insert(Counted<GpuProgram>{GpuProgram{program}, 1});
+}
+
+AllocationHandle GpuResources::Allocate(BufferCategory category, size_t bytes, size_t alignment,
+                                        const void* data) {
+    return mBufferAllocator.Allocate(category, bytes, alignment, data);
+}
+
+MeshHandle GpuResources::AdoptMesh(const Mesh3D& mesh) {
+    return mMeshes.Insert(Counted<Mesh3D>{mesh, 1});
+}
+
+const GpuBuffer* GpuResources::Get(BufferHandle handle) const {
+    const auto* entry = mBuffers.Get(handle);
+    return entry ? &entry->mResource : nullptr;
+}
+
+const GpuTexture* GpuResources::Get(TextureHandle handle) const {
+    const auto* entry = mTextures.Get(handle);
+    return entry ? &entry->mResource : nullptr;
+}
+
+const GpuProgram* GpuResources::Get(ProgramHandle handle) const {
+    const auto* entry = mPrograms.Get(handle);
+    return entry ? &entry->mResource : nullptr;
+}
+
+const Mesh3D* GpuResources::Get(MeshHandle handle) const {
+    const auto* entry = mMeshes.Get(handle);
+    return entry ? &entry->mResource : nullptr;
+}
+
+GLuint GpuResources::Name(BufferHandle handle) const {
+    const GpuBuffer* buffer = Get(handle);
+    return buffer ? buffer->mName : 0;
+}
+
+GLuint GpuResources::Name(TextureHandle handle) const {
+    const GpuTexture* texture = Get(handle);
+    return texture ? texture->mName : 0;
+}
+
+GLuint GpuResources::Name(ProgramHandle handle) const {
+    const GpuProgram* program = Get(handle);
+    return program ? program->mName : 0;
+}
+
+void GpuResources::AddRef(BufferHandle handle) { AddRefIn(mBuffers, handle); }
+void GpuResources::AddRef(TextureHandle handle) { AddRefIn(mTextures, handle); }
+void GpuResources::AddRef(ProgramHandle handle) { AddRefIn(mPrograms, handle); }
+void GpuResources::AddRef(MeshHandle handle) { AddRefIn(mMeshes, handle); }
+
+void GpuResources::Release(BufferHandle handle) {
+    auto* entry = mBuffers.Get(handle);
+    if (entry == nullptr || --entry->mRefCount > 0) { return; }
+    QueueDelete(ObjectKind::Buffer, entry->mResource.mName, entry->mResource.mBytes);
+    mBuffers.Remove(handle);
+}
+
+void GpuResources::Release(TextureHandle handle) {
+    auto* entry = mTextures.Get(handle);
+    if (entry == nullptr || --entry->mRefCount > 0) { return; }
+    const GpuTexture& texture = entry->mResource;
+    QueueDelete(texture.mTarget == GL_RENDERBUFFER ? ObjectKind::Renderbuffer : ObjectKind::Texture,
+                texture.mName, texture.mBytes);
+    mTextures.Remove(handle);
+}
+
+void GpuResources::Release(ProgramHandle handle) {
+    auto* entry = mPrograms.Get(handle);
+    if (entry == nullptr || --entry->mRefCount > 0) { return; }
+    QueueDelete(ObjectKind::Program, entry->mResource.mName, 0);
+    mPrograms.Remove(handle);
+}
+
+void GpuResources::Release(MeshHandle handle) {
+    auto* entry = mMeshes.Get(handle);
+    if (entry == nullptr || --entry->mRefCount > 0) { return; }
+    const Mesh3D mesh = entry->mResource;
+    mMeshes.Remove(handle);
+
+    QueueDelete(ObjectKind::VertexArray, mesh.mVertexArrayObject, 0);
+    QueueDelete(ObjectKind::VertexArray, mesh.mDepthVertexArrayObject, 0);
+    Free(mesh.mVertices);
+    Free(mesh.mPositions);
+    Free(mesh.mIndices);
+}
+
+void GpuResources::Free(AllocationHandle handle) {
+    const GpuAllocation* allocation = mBufferAllocator.Get(handle);
+    if (allocation == nullptr) { return; }
+    mPendingDeletes.push_back(PendingDelete{ObjectKind::Allocation, 0, allocation->mBytes, mFrame, handle});
+}
+
+std::vector<MeshHandle> GpuResources::CompactBuffers() {
+    std::vector<AllocationHandle> moved;
+    for (const BufferCategory category : {BufferCategory::Vertex, BufferCategory::Index}) {
+        for (const RetiredPool& pool : mBufferAllocator.Compact(category, &moved)) {
+            // Draws already submitted may still read the old pool
+            QueueDelete(ObjectKind::Buffer, pool.mBuffer, pool.mBytes);
+        }
+    }
+    if (moved.empty()) { return {}; }
+
+    std::vector<MeshHandle> meshes;
+    mMeshes.ForEach([&](MeshHandle handle, const Counted<Mesh3D>& entry) {
+        const Mesh3D& mesh = entry.mResource;
+        if (std::find(moved.begin(), moved.end(), mesh.mVertices) != moved.end() ||
+            std::find(moved.begin(), moved.end(), mesh.mPositions) != moved.end() ||
+            std::find(moved.begin(), moved.end(), mesh.mIndices) != moved.end()) {
+            meshes.push_back(handle);
+        }
+    });
+    for (const MeshHandle handle : meshes) {
+        Mesh3D& mesh = mMeshes.Get(handle)->mResource;
+        mesh.mBaseVertex = static_cast<GLint>(mBufferAllocator.Get(mesh.mVertices)->mOffset / mesh.mVertexStride);
+        mesh.mPositionBaseVertex =
+            static_cast<GLint>(mBufferAllocator.Get(mesh.mPositions)->mOffset / mesh.mPositionStride);
+        mesh.mIndexOffset = mBufferAllocator.Get(mesh.mIndices)->mOffset;
+    }
+    std::println("Compacted buffer pools: {} ranges of {} meshes moved", moved.size(), meshes.size());
+    return meshes;
+}
+
+void GpuResources::QueueDelete(ObjectKind kind, GLuint name, size_t bytes) {
+    if (name == 0) { return; }
+    mPendingDeletes.push_back(PendingDelete{kind, name, bytes, mFrame, AllocationHandle{}});
+}
+
+void GpuResources::DeleteObject(const PendingDelete& pending) {
+    switch (pending.mKind) {
+        case ObjectKind::Buffer: glDeleteBuffers(1, &pending.mName); break;
+        case ObjectKind::Texture: glDeleteTextures(1, &pending.mName); break;
+        case ObjectKind::Renderbuffer: glDeleteRenderbuffers(1, &pending.mName); break;
+        case ObjectKind::Program: glDeleteProgram(pending.mName); break;
+        case ObjectKind::VertexArray: glDeleteVertexArrays(1, &pending.mName); break;
+        case ObjectKind::Allocation: mBufferAllocator.Free(pending.mAllocation); break;
+    }
+}
+
+void GpuResources::EndFrame() {
+    mFences.push_back(FrameFence{mFrame, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+    ++mFrame;
+}
+
+void GpuResources::CollectGarbage() {
+    // Fences signal in order, so stop at the first one that has not
+    while (!mFences.empty()) {
+        const GLenum result = glClientWaitSync(mFences.front().mSync, 0, 0);
+        if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) { break; }
+        mFinishedFrames = mFences.front().mFrame + 1;
+        glDeleteSync(mFences.front().mSync);
+        mFences.pop_front();
+    }
+
+    while (!mPendingDeletes.empty() && mPendingDeletes.front().mFrame < mFinishedFrames) {
+        DeleteObject(mPendingDeletes.front());
+        mPendingDeletes.pop_front();
+    }
+}
+
+void GpuResources::Shutdown() {
+    glFinish();
+    for (const FrameFence& fence : mFences) {
+        glDeleteSync(fence.mSync);
+    }
+    mFences.clear();
+    for (const PendingDelete& pending : mPendingDeletes) {
+        DeleteObject(pending);
+    }
+    mPendingDeletes.clear();
+    mFinishedFrames = mFrame;
+
+    // Anything still alive now was never released
+    const ResourceStats stats = Stats();
+    const size_t leaked = stats.mBuffers.mLive + stats.mTextures.mLive + stats.mPrograms.mLive + stats.mMeshes.mLive;
+    if (stats.mAllocations.mLive > 0) {
+        std::println(std::cerr, "{} buffer ranges were never freed", stats.mAllocations.mLive);
+    }
+    mBufferAllocator.DeleteAll();
+    if (leaked == 0) { return; }
+
+    std::println(std::cerr, "{} GPU resources were never released:", leaked);
+    mMeshes.ForEach([](MeshHandle handle, const Counted<Mesh3D>& entry) {
+        std::println(std::cerr, "  mesh {}.{} ({} references)", handle.mIndex, handle.mGeneration, entry.mRefCount);
+    });
+    mBuffers.ForEach([](BufferHandle handle, const Counted<GpuBuffer>& entry) {
+        std::println(std::cerr, "  buffer {}.{} ({} bytes, {} references)", handle.mIndex, handle.mGeneration,
+                     entry.mResource.mBytes, entry.mRefCount);
+    });
+    mTextures.ForEach([](TextureHandle handle, const Counted<GpuTexture>& entry) {
+        std::println(std::cerr, "  texture {}.{} ({} bytes, {} references)", handle.mIndex, handle.mGeneration,
+                     entry.mResource.mBytes, entry.mRefCount);
+    });
+    mPrograms.ForEach([](ProgramHandle handle, const Counted<GpuProgram>& entry) {
+        std::println(std::cerr, "  program {}.{} ({} references)", handle.mIndex, handle.mGeneration, entry.mRefCount);
+    });
+}
+
+ResourceStats GpuResources::Stats() const {
+    ResourceStats stats;
+    mBuffers.ForEach([&](BufferHandle, const Counted<GpuBuffer>& entry) {
+        stats.mBuffers.mLiveBytes += entry.mResource.mBytes;
+    });
+    mTextures.ForEach([&](TextureHandle, const Counted<GpuTexture>& entry) {
+        stats.mTextures.mLiveBytes += entry.mResource.mBytes;
+    });
+    stats.mBuffers.mLive = mBuffers.Size();
+    stats.mTextures.mLive = mTextures.Size();
+    stats.mPrograms.mLive = mPrograms.Size();
+    stats.mMeshes.mLive = mMeshes.Size();
+    for (size_t i = 0; i < kBufferCategoryCount; ++i) {
+        const BufferBudget& budget = mBufferAllocator.Budget(static_cast<BufferCategory>(i));
+        stats.mAllocations.mLive += budget.mAllocations;
+        stats.mAllocations.mLiveBytes += budget.mRequested;
+    }
+
+    for (const PendingDelete& pending : mPendingDeletes) {
+        ResourceCount* count{nullptr};
+        switch (pending.mKind) {
+            case ObjectKind::Buffer: count = &stats.mBuffers; break;
+            case ObjectKind::Texture:
+            case ObjectKind::Renderbuffer: count = &stats.mTextures; break;
+            case ObjectKind::Program: count = &stats.mPrograms; break;
+            case ObjectKind::VertexArray: count = &stats.mMeshes; break;
+            case ObjectKind::Allocation: count = &stats.mAllocations; break;
+        }
+        count->mPending += 1;
+        count->mPendingBytes += pending.mBytes;
+    }
+    // A freed range keeps its place in the allocator's budget until its frame retires;
+    // count it as pending only, like the objects whose handles are already gone
+    stats.mAllocations.mLive -= stats.mAllocations.mPending;
+    stats.mAllocations.mLiveBytes -= stats.mAllocations.mPendingBytes;
+    return stats;
+}
+
+void GpuResources::PrintReport() const {
+    const ResourceStats stats = Stats();
+    std::println("{}", "GPU resources:");
+    PrintCount("buffers", stats.mBuffers);
+    PrintCount("textures", stats.mTextures);
+    PrintCount("programs", stats.mPrograms);
+    PrintCount("meshes", stats.mMeshes);
+    PrintCount("ranges", stats.mAllocations);
+    mBufferAllocator.PrintReport();
+}
@@ -0,0 +1,178 @@
+//
+// Owns GPU objects behind generational handles and deletes them once the GPU is done.
+//
+
+#ifndef GPU_RESOURCES_H
+#define GPU_RESOURCES_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <glad/glad.h>
+
+#include "gpu_allocator.h"
+#include "gpu_handles.h"
+#include "mesh3d.h"
+#include "slot_map.h"
+
+
+struct GpuBuffer {
+    GLuint mName{0};
+    GLenum mTarget{0};
+    size_t mBytes{0};
+};
+
+struct GpuTexture {
+    GLuint mName{0};
+    // GL_TEXTURE_2D, GL_TEXTURE_2D_ARRAY or GL_RENDERBUFFER
+    GLenum mTarget{0};
+    size_t mBytes{0};
+};
+
+struct GpuProgram {
+    GLuint mName{0};
+};
+
+// Live and pending objects of one kind. Pending objects are released and wait for the
+// GPU; they are not counted as live.
+struct ResourceCount {
+    size_t mLive{0};
+    size_t mLiveBytes{0};
+    size_t mPending{0};
+    size_t mPendingBytes{0};
+};
+
+struct ResourceStats {
+    ResourceCount mBuffers;
+    ResourceCount mTextures;
+    ResourceCount mPrograms;
+    ResourceCount mMeshes;
+    // Ranges of the pooled buffers
+    ResourceCount mAllocations;
+};
+
+/**
+ * Every buffer, texture, program and mesh is created through here and referenced by
+ * handle. Handles are reference counted: Create/Adopt returns one reference, AddRef
+ * takes another, and Release drops one. When the last reference goes the handle dies
+ * at once, so later lookups return null rather than touching a reused name, but the
+ * GL object is only deleted once the GPU has finished every frame that was submitted
+ * before the release. Frames are tracked with a fence each.
+ *
+ * Mesh geometry goes in pooled buffers rather than a buffer per mesh; see
+ * GpuBufferAllocator. Its budget can be set and read through BufferAllocator().
+ *
+ * Must be used from the thread that owns the GL context.
+ */
+class GpuResources {
+public:
+    GpuResources() = default;
+    ~GpuResources() = default;
+
+    GpuResources(const GpuResources&) = delete;
+    GpuResources& operator=(const GpuResources&) = delete;
+
+    // Creates a buffer and leaves it bound to target, so a bound VAO records an index buffer
+    BufferHandle CreateBuffer(GLenum target, size_t bytes, const void* data, GLenum usage);
+    TextureHandle CreateTexture2D(GLenum internalFormat, int width, int height, GLenum format, GLenum type,
+                                  size_t bytesPerPixel);
+    TextureHandle CreateTexture2DArray(GLenum internalFormat, int width, int height, int layers, GLenum format,
+                                       GLenum type, size_t bytesPerPixel);
+    TextureHandle CreateRenderbuffer(GLenum internalFormat, int width, int height, size_t bytesPerPixel);
+    // Takes ownership of a linked program
+    ProgramHandle AdoptProgram(GLuint program);
+    // A range of a pooled buffer; null when the budget does not allow it
+    AllocationHandle Allocate(BufferCategory category, size_t bytes, size_t alignment, const void* data);
+    // Takes ownership of the mesh's vertex arrays and its vertex, position and index ranges
+    MeshHandle AdoptMesh(const Mesh3D& mesh);
+
+    // Null when the handle is dead
+    const GpuBuffer* Get(BufferHandle handle) const;
+    const GpuTexture* Get(TextureHandle handle) const;
+    const GpuProgram* Get(ProgramHandle handle) const;
+    const Mesh3D* Get(MeshHandle handle) const;
+    const GpuAllocation* Get(AllocationHandle handle) const { return mBufferAllocator.Get(handle); }
+
+    // The GL name, or 0 when the handle is dead
+    GLuint Name(BufferHandle handle) const;
+    GLuint Name(TextureHandle handle) const;
+    GLuint Name(ProgramHandle handle) const;
+    // The pool buffer the range lives in
+    GLuint Name(AllocationHandle handle) const { return mBufferAllocator.BufferName(handle); }
+
+    void AddRef(BufferHandle handle);
+    void AddRef(TextureHandle handle);
+    void AddRef(ProgramHandle handle);
+    void AddRef(MeshHandle handle);
+
+    void Release(BufferHandle handle);
+    void Release(TextureHandle handle);
+    void Release(ProgramHandle handle);
+    void Release(MeshHandle handle);
+    // Ranges are not reference counted; the range is reused once the GPU is done with it
+    void Free(AllocationHandle handle);
+
+    /**
+     * Empties sparsely used vertex and index pools into the others, so they can be
+     * deleted. Meshes whose geometry moved get their base vertex and index offset
+     * updated and are returned; their vertex arrays still point at the old pools
+     * until they are set up again (MeshCompactBuffers does both).
+     */
+    std::vector<MeshHandle> CompactBuffers();
+
+    GpuBufferAllocator& BufferAllocator() { return mBufferAllocator; }
+    const GpuBufferAllocator& BufferAllocator() const { return mBufferAllocator; }
+
+    // Call after submitting a frame: fences it so its deletions can be retired
+    void EndFrame();
+    // Deletes the objects whose frames the GPU has finished; call once per frame
+    void CollectGarbage();
+    // Waits for the GPU, deletes everything pending and reports what is still alive
+    void Shutdown();
+
+    ResourceStats Stats() const;
+    void PrintReport() const;
+
+private:
+    template <class T>
+    struct Counted {
+        T mResource{};
+        uint32_t mRefCount{0};
+    };
+
+    enum class ObjectKind : uint8_t { Buffer, Texture, Renderbuffer, Program, VertexArray, Allocation };
+
+    struct PendingDelete {
+        ObjectKind mKind;
+        GLuint mName;
+        size_t mBytes;
+        // Deletable once this frame has finished on the GPU
+        uint64_t mFrame;
+        AllocationHandle mAllocation;
+    };
+
+    struct FrameFence {
+        uint64_t mFrame;
+        GLsync mSync;
+    };
+
+    void QueueDelete(ObjectKind kind, GLuint name, size_t bytes);
+    void DeleteObject(const PendingDelete& pending);
+
+    SlotMap<Counted<GpuBuffer>, BufferTag> mBuffers;
+    SlotMap<Counted<GpuTexture>, TextureTag> mTextures;
+    SlotMap<Counted<GpuProgram>, ProgramTag> mPrograms;
+    SlotMap<Counted<Mesh3D>, MeshTag> mMeshes;
+    GpuBufferAllocator mBufferAllocator;
+
+    std::deque<PendingDelete> mPendingDeletes;
+    std::deque<FrameFence> mFences;
+    // Frames submitted so far; releases made now belong to frame mFrame
+    uint64_t mFrame{0};
+    // Frames the GPU is known to have finished
+    uint64_t mFinishedFrames{0};
+};
+
+
+#endif //GPU_RESOURCES_H
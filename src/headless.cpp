@@ -0,0 +1,123 @@
+//
+// Headless OpenGL context for running the renderer without a window or a GPU.
+//
+
+#include "headless.h"
+
+#include <print>
+#include <glad/glad.h>
+
+#ifdef OPENGLNOTES_HEADLESS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#ifndef EGL_PLATFORM_SURFACELESS_MESA
+#define EGL_PLATFORM_SURFACELESS_MESA 0x31DD
+#endif
+
+void* HeadlessGetProcAddress(const char* name) {
+    return reinterpret_cast<void*>(eglGetProcAddress(name));
+}
+
+bool HeadlessContextCreate(HeadlessContext* context) {
+    // Prefer Mesa's surfaceless platform, which needs neither X11/Wayland nor a GPU
+    EGLDisplay display{EGL_NO_DISPLAY};
+    auto getPlatformDisplay{reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+        eglGetProcAddress("eglGetPlatformDisplayEXT"))};
+    if (getPlatformDisplay != nullptr) {
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    }
+    if (display == EGL_NO_DISPLAY) {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    }
+
+    EGLint major{0};
+    EGLint minor{0};
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+        std::println("{}", "EGL could not initialize a display");
+        return false;
+    }
+    std::println("EGL {}.{}", major, minor);
+
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        std::println("{}", "EGL does not support desktop OpenGL");
+        eglTerminate(display);
+        return false;
+    }
+
+    const EGLint configAttributes[]{
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+    EGLConfig config{nullptr};
+    EGLint configCount{0};
+    if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0) {
+        std::println("{}", "EGL has no suitable config");
+        eglTerminate(display);
+        return false;
+    }
+
+    // Same version and profile as the windowed path
+    const EGLint contextAttributes[]{
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 1,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext eglContext{eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes)};
+    if (eglContext == EGL_NO_CONTEXT) {
+        std::println("{}", "EGL could not create an OpenGL 4.1 core context");
+        eglTerminate(display);
+        return false;
+    }
+
+    // No surface at all: everything is rendered into framebuffer objects
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext)) {
+        std::println("{}", "EGL could not make the surfaceless context current");
+        eglDestroyContext(display, eglContext);
+        eglTerminate(display);
+        return false;
+    }
+
+    if (!gladLoadGLLoader(HeadlessGetProcAddress)) {
+        std::println("{}", "glad could not initialize");
+        eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+        eglDestroyContext(display, eglContext);
+        eglTerminate(display);
+        return false;
+    }
+
+    context->mDisplay = display;
+    context->mContext = eglContext;
+    return true;
+}
+
+void HeadlessContextDelete(HeadlessContext* context) {
+    if (context->mDisplay == nullptr) { return; }
+
+    eglMakeCurrent(context->mDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(context->mDisplay, context->mContext);
+    eglTerminate(context->mDisplay);
+    *context = HeadlessContext{};
+}
+
+#else
+
+bool HeadlessContextCreate(HeadlessContext* context) {
+    std::println("{}", "Headless mode is not available in this build (needs EGL)");
+    return false;
+}
+
+void HeadlessContextDelete(HeadlessContext* context) {
+}
+
+void* HeadlessGetProcAddress(const char* name) {
+    return nullptr;
+}
+
+#endif
@@ -0,0 +1,26 @@
+//
+// Headless OpenGL context for running the renderer without a window or a GPU.
+//
+
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+
+struct HeadlessContext {
+    void* mDisplay{nullptr};
+    void* mContext{nullptr};
+};
+
+/**
+ * Create a surfaceless EGL context and make it current. With Mesa this works on
+ * machines without a GPU or display server (llvmpipe), e.g. set
+ * LIBGL_ALWAYS_SOFTWARE=1 to force software rendering.
+ * Only available when built with OPENGLNOTES_HEADLESS_EGL.
+ */
+bool HeadlessContextCreate(HeadlessContext* context);
+void HeadlessContextDelete(HeadlessContext* context);
+// OpenGL function loader for the headless context
+void* HeadlessGetProcAddress(const char* name);
+
+
+#endif //HEADLESS_H
@@ -0,0 +1,240 @@
+//
+// Work-stealing job system for per-frame engine tasks.
+//
+
+#include "job_system.h"
+
+#include <string>
+
+#include "profiler.h"
+
+namespace {
+
+// Index of the calling thread within its JobSystem; -1 for threads it does not own
+thread_local int tThreadIndex{-1};
+
+class SpinLock {
+public:
+    explicit SpinLock(std::atomic_flag& flag) : mFlag(flag) {
+        while (mFlag.test_and_set(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+    }
+    ~SpinLock() { mFlag.clear(std::memory_order_release); }
+
+private:
+    std::atomic_flag& mFlag;
+};
+
+}
+
+bool JobSystem::WorkQueue::Push(const Job& job) {
+    SpinLock lock(mLock);
+    if (mTail - mHead == kQueueCapacity) { return false; }
+    mJobs[mTail % kQueueCapacity] = job;
+    ++mTail;
+    return true;
+}
+
+bool JobSystem::WorkQueue::Pop(Job* job) {
+    SpinLock lock(mLock);
+    if (mTail == mHead) { return false; }
+    --mTail;
+    *job = mJobs[mTail % kQueueCapacity];
+    return true;
+}
+
+bool JobSystem::WorkQueue::Steal(Job* job) {
+    SpinLock lock(mLock);
+    if (mTail == mHead) { return false; }
+    *job = mJobs[mHead % kQueueCapacity];
+    ++mHead;
+    return true;
+}
+
+JobSystem::~JobSystem() {
+    Stop();
+}
+
+int JobSystem::ThreadIndex() {
+    return tThreadIndex;
+}
+
+void JobSystem::Start(size_t workerCount) {
+    Stop();
+    mStopping = false;
+    tThreadIndex = 0;
+
+    mQueues.clear();
+    for (size_t i = 0; i < workerCount + 1; ++i) {
+        mQueues.push_back(std::make_unique<WorkQueue>());
+    }
+    mInjectedQueue = std::make_unique<WorkQueue>();
+    for (size_t i = 0; i < workerCount; ++i) {
+        mWorkers.emplace_back(&JobSystem::WorkerMain, this, i + 1);
+    }
+}
+
+void JobSystem::Stop() {
+    mStopping = true;
+    WakeWorkers();
+    for (std::thread& worker : mWorkers) {
+        worker.join();
+    }
+    mWorkers.clear();
+
+    // Anything still queued runs here rather than being dropped, so waiters never hang
+    Job job;
+    for (auto& queue : mQueues) {
+        while (queue->Pop(&job)) {
+            Execute(job);
+        }
+    }
+    while (mInjectedQueue && mInjectedQueue->Steal(&job)) {
+        Execute(job);
+    }
+    RunMainThreadJobs();
+}
+
+void JobSystem::Schedule(const Job& job, JobCounter* dependency) {
+    if (job.mCounter) {
+        job.mCounter->mValue.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (dependency) {
+        std::lock_guard lock(dependency->mMutex);
+        if (!dependency->IsDone()) {
+            dependency->mContinuations.push_back(job);
+            return;
+        }
+    }
+    Enqueue(job);
+}
+
+void JobSystem::ScheduleOnMainThread(const Job& job) {
+    if (job.mCounter) {
+        job.mCounter->mValue.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::lock_guard lock(mMainThreadMutex);
+    mMainThreadJobs.push_back(job);
+}
+
+void JobSystem::RunMainThreadJobs() {
+    // Without workers nobody else would run what other threads scheduled
+    Job injected;
+    while (mWorkers.empty() && mInjectedQueue && mInjectedQueue->Steal(&injected)) {
+        Execute(injected);
+    }
+
+    {
+        std::lock_guard lock(mMainThreadMutex);
+        if (mMainThreadJobs.empty()) { return; }
+        mRunningMainThreadJobs.swap(mMainThreadJobs);
+    }
+    for (const Job& job : mRunningMainThreadJobs) {
+        Execute(job);
+    }
+    mRunningMainThreadJobs.clear();
+}
+
+void JobSystem::Wait(JobCounter* counter) {
+    const int threadIndex{tThreadIndex};
+    while (!counter->IsDone()) {
+        if (threadIndex >= 0 && TryRunOne(static_cast<size_t>(threadIndex))) { continue; }
+        // A main-thread job may be what the counter is waiting for
+        if (threadIndex == 0) { RunMainThreadJobs(); }
+        std::this_thread::yield();
+    }
+
+    // The last job reaches zero while holding the lock; wait for it to let go
+    std::lock_guard lock(counter->mMutex);
+}
+
+void JobSystem::Enqueue(const Job& job) {
+    if (mQueues.empty()) {
+        Execute(job);
+        return;
+    }
+
+    // Threads outside the pool have no queue of their own, and pushing to the main
+    // thread's would race its pops from the back; theirs go to a shared queue instead
+    WorkQueue& queue{tThreadIndex >= 0 ? *mQueues[static_cast<size_t>(tThreadIndex)] : *mInjectedQueue};
+    if (!queue.Push(job)) {
+        // Queue full: running it now is slower than spreading it out but always safe
+        Execute(job);
+        return;
+    }
+
+    // One job needs one worker; waking them all would only have the rest find nothing
+    mWorkEpoch.fetch_add(1, std::memory_order_release);
+    mWorkEpoch.notify_one();
+}
+
+void JobSystem::Execute(const Job& job) {
+    job.mFunction(job.mData);
+    Finish(job.mCounter);
+}
+
+void JobSystem::Finish(JobCounter* counter) {
+    if (!counter) { return; }
+
+    // Only the last job takes the lock; the others must not touch the counter after
+    // decrementing, since its owner may destroy it as soon as it reads zero
+    int value{counter->mValue.load(std::memory_order_relaxed)};
+    while (value > 1) {
+        if (counter->mValue.compare_exchange_weak(value, value - 1, std::memory_order_acq_rel)) { return; }
+    }
+
+    std::vector<Job> continuations;
+    {
+        std::lock_guard lock(counter->mMutex);
+        if (counter->mValue.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            continuations.swap(counter->mContinuations);
+        }
+    }
+    for (const Job& job : continuations) {
+        Enqueue(job);
+    }
+}
+
+bool JobSystem::TryRunOne(size_t threadIndex) {
+    Job job;
+    if (mQueues[threadIndex]->Pop(&job)) {
+        Execute(job);
+        return true;
+    }
+    if (mInjectedQueue->Steal(&job)) {
+        Execute(job);
+        return true;
+    }
+
+    // Start at a different victim on each thread so thieves do not all hit the same queue
+    const size_t queueCount{mQueues.size()};
+    for (size_t i = 1; i < queueCount; ++i) {
+        if (mQueues[(threadIndex + i) % queueCount]->Steal(&job)) {
+            Execute(job);
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::WakeWorkers() {
+    mWorkEpoch.fetch_add(1, std::memory_order_release);
+    mWorkEpoch.notify_all();
+}
+
+void JobSystem::WorkerMain(size_t threadIndex) {
+    tThreadIndex = static_cast<int>(threadIndex);
+    const std::string name{"Worker " + std::to_string(threadIndex)};
+    ProfilerSetThreadName(name.c_str());
+
+    while (true) {
+        // Read the epoch before checking for stop or work, so that a Stop or a job
+        // coming in between has already changed it and the wait returns at once
+        const uint32_t epoch{mWorkEpoch.load(std::memory_order_acquire)};
+        if (mStopping.load(std::memory_order_acquire)) { return; }
+        if (TryRunOne(threadIndex)) { continue; }
+        mWorkEpoch.wait(epoch, std::memory_order_acquire);
+    }
+}
@@ -0,0 +1,178 @@
+//
+// Work-stealing job system for per-frame engine tasks.
+//
+
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+struct JobCounter;
+
+/**
+ * A unit of work: a function and a pointer to its data. The data must stay alive
+ * until the job has run, which callers guarantee by waiting on the job's counter.
+ */
+struct Job {
+    void (*mFunction)(void* data){nullptr};
+    void* mData{nullptr};
+    // Decremented when the job finishes; may be null
+    JobCounter* mCounter{nullptr};
+};
+
+/**
+ * Counts unfinished jobs. Wait on it to join them, or pass it as the dependency of
+ * other jobs to run those once it reaches zero.
+ */
+struct JobCounter {
+    JobCounter() = default;
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+
+    // Use JobSystem::Wait before destroying a counter, not just IsDone
+    bool IsDone() const { return mValue.load(std::memory_order_acquire) == 0; }
+
+    std::atomic<int> mValue{0};
+    // Jobs scheduled to run once the counter reaches zero
+    std::mutex mMutex;
+    std::vector<Job> mContinuations;
+};
+
+/**
+ * One work queue per thread. A thread pushes and pops its own jobs at the back;
+ * idle threads steal from the front of the others' queues. Jobs that must touch
+ * OpenGL go to a separate queue that only the main thread runs.
+ *
+ * The thread that calls Start is the main thread and has thread index 0; workers
+ * are 1..N. The main thread takes part in ParallelFor and runs jobs while it waits.
+ * Other threads may schedule jobs too; those go to a queue all pool threads share.
+ */
+class JobSystem {
+public:
+    JobSystem() = default;
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    void Start(size_t workerCount);
+    void Stop();
+
+    // Worker threads plus the main thread
+    size_t ThreadCount() const { return mQueues.empty() ? 1 : mQueues.size(); }
+    // 0 on the main thread, 1..N on workers, -1 on any other thread
+    static int ThreadIndex();
+
+    // Run a job on any thread, once dependency (if given) has reached zero
+    void Schedule(const Job& job, JobCounter* dependency = nullptr);
+    // Run a job on the main thread, e.g. because it makes OpenGL calls
+    void ScheduleOnMainThread(const Job& job);
+    // Runs the jobs queued for the main thread; call once per frame from the main thread
+    void RunMainThreadJobs();
+
+    // Blocks until counter reaches zero, running other jobs in the meantime
+    void Wait(JobCounter* counter);
+
+    /**
+     * Split [0, count) into ranges of grainSize and run function(begin, end, threadIndex)
+     * on all threads. Smaller grains balance better, larger grains cost less overhead.
+     * Blocks until every range has run. Called from a thread outside the pool, only the
+     * pool's threads run the ranges.
+     */
+    template <class Function>
+    void ParallelFor(size_t count, size_t grainSize, Function&& function);
+
+private:
+    static constexpr size_t kQueueCapacity{4096};
+
+    // Fixed-size ring buffer guarded by a spinlock; critical sections are a few instructions
+    struct WorkQueue {
+        bool Push(const Job& job);
+        bool Pop(Job* job);
+        bool Steal(Job* job);
+
+        std::atomic_flag mLock = ATOMIC_FLAG_INIT;
+        std::array<Job, kQueueCapacity> mJobs{};
+        size_t mHead{0};
+        size_t mTail{0};
+    };
+
+    void WorkerMain(size_t threadIndex);
+    bool TryRunOne(size_t threadIndex);
+    void Execute(const Job& job);
+    void Enqueue(const Job& job);
+    void Finish(JobCounter* counter);
+    void WakeWorkers();
+
+    std::vector<std::unique_ptr<WorkQueue>> mQueues;
+    // Jobs scheduled from threads outside the pool; every pool thread takes from it
+    std::unique_ptr<WorkQueue> mInjectedQueue;
+    std::vector<std::thread> mWorkers;
+    std::atomic<uint32_t> mWorkEpoch{0};
+    std::atomic<bool> mStopping{false};
+
+    std::mutex mMainThreadMutex;
+    std::vector<Job> mMainThreadJobs;
+    std::vector<Job> mRunningMainThreadJobs;
+};
+
+template <class Function>
+void JobSystem::ParallelFor(size_t count, size_t grainSize, Function&& function) {
+    if (count == 0) { return; }
+    grainSize = std::max<size_t>(grainSize, 1);
+    const size_t rangeCount{(count + grainSize - 1) / grainSize};
+
+    // A thread outside the pool has no thread index to hand function, so it leaves
+    // every range to the pool's threads and only waits
+    const bool inPool{ThreadIndex() >= 0};
+    if (inPool && (rangeCount == 1 || mWorkers.empty())) {
+        function(size_t{0}, count, static_cast<size_t>(ThreadIndex()));
+        return;
+    }
+
+    // Rather than one job per range, schedule one job per thread that keeps claiming
+    // ranges until none are left. Threads that start late simply claim fewer.
+    struct Context {
+        Function* mFunction;
+        size_t mCount;
+        size_t mGrainSize;
+        size_t mRangeCount;
+        std::atomic<size_t> mNextRange{0};
+
+        static void Run(void* data) {
+            auto* context{static_cast<Context*>(data)};
+            const auto thread{static_cast<size_t>(ThreadIndex())};
+            while (true) {
+                const size_t range{context->mNextRange.fetch_add(1, std::memory_order_relaxed)};
+                if (range >= context->mRangeCount) { return; }
+                const size_t begin{range * context->mGrainSize};
+                (*context->mFunction)(begin, std::min(begin + context->mGrainSize, context->mCount), thread);
+            }
+        }
+    };
+
+    Context context{&function, count, grainSize, rangeCount};
+    JobCounter counter;
+    const size_t helpers{inPool ? std::min(rangeCount, ThreadCount()) - 1
+                                : std::clamp<size_t>(rangeCount, 1, std::max<size_t>(mWorkers.size(), 1))};
+    for (size_t i = 0; i < helpers; ++i) {
+        Schedule(Job{&Context::Run, &context, &counter});
+    }
+
+    if (inPool) {
+        Context::Run(&context);
+    }
+    Wait(&counter);
+}
+
+
+#endif //JOB_SYSTEM_H
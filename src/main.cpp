@@ -1,33 +1,182 @@
 #include <iostream>
 #include <fstream>
 #include <print>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <thread>
 #include <SDL2/SDL.h>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "alloc_tracker.h"
 #include "camera.h"
 #include "app.h"
 #include "mesh3d.h"
 #include "shaders.h"
 #include "mesh.h"
+#include "profiler.h"
+#include "headless.h"
+#include "render_target.h"
+#include "frame_stats.h"
+#include "scene.h"
+#include "draw_list.h"
+#include "frustum.h"
+#include "components.h"
+#include "systems.h"
 
 
 // Global Application State
 App gApp;
-Mesh3D gMesh1;
-Mesh3D gMesh2;
-std::vector<Mesh3D*> meshPtrs{&gMesh1, &gMesh2};
+// The two quads share one mesh
+MeshHandle gQuadMesh;
+// The camera's near plane; also where the light clusters and shadow cascades start
+constexpr float kNearPlane{0.1f};
+// Width and height of each shadow cascade with --shadows
+constexpr int kDefaultShadowResolution{2048};
 
 
+/**
+ * Pick up the current programs of the transparent pass
+ */
+void UpdateTransparentPrograms() {
+    gApp.mTransparentPrograms.mSorted = gApp.mBillboardPermutations.GetProgram(SHADER_FEATURE_NONE);
+    gApp.mTransparentPrograms.mWeighted = gApp.mBillboardPermutations.GetProgram(SHADER_FEATURE_WEIGHTED_OIT);
+    gApp.mTransparentPrograms.mComposite = gApp.mCompositePermutations.GetProgram(SHADER_FEATURE_NONE);
+}
+
+/**
+ * Features every opaque mesh variant gets from the renderer: the deferred one draws
+ * the meshes into its G-buffer instead of shading them
+ */
+uint32_t RendererShaderFeatures() {
+    return gApp.mRenderer == RendererKind::Deferred ? SHADER_FEATURE_GBUFFER : SHADER_FEATURE_NONE;
+}
+
 /**
  * Create the graphics pipeline
+ * Every shader variant the scene uses is declared here and compiled up front,
+ * so that no variant has to be compiled the first time it is drawn.
  */
 void CreateGraphicsPipeline() {
-    std::string vertexShaderSource = LoadShaderAsString("../shaders/vert.glsl");
-    std::string fragmentShaderSource = LoadShaderAsString("../shaders/frag.glsl");
+    ALLOC_SCOPE("CreateGraphicsPipeline");
+    ShaderPermutationManager& permutations = gApp.mShaderPermutations;
+    permutations.SetResources(&gApp.mResources);
+    permutations.SetSources("../shaders/vert.glsl", "../shaders/frag.glsl");
+
+    permutations.Declare(RendererShaderFeatures());
+    DeclareShaderVariants(gApp.mWorld, gApp.mSystemQueries, permutations, RendererShaderFeatures());
+    permutations.Precompile();
+
+    gApp.mGraphicsPipelineShaderProgram = permutations.GetProgram(RendererShaderFeatures());
+
+    ShaderPermutationManager& depthPermutations = gApp.mDepthPermutations;
+    depthPermutations.SetResources(&gApp.mResources);
+    depthPermutations.SetSources("../shaders/depth_vert.glsl", "../shaders/depth_frag.glsl");
+    depthPermutations.Declare(SHADER_FEATURE_NONE);
+    depthPermutations.Precompile();
+    gApp.mDepthPrePassProgram = depthPermutations.GetProgram(SHADER_FEATURE_NONE);
+
+    // Shadow casters draw depth alone, like the pre-pass, but from the light
+    ShaderPermutationManager& shadowPermutations = gApp.mShadowPermutations;
+    shadowPermutations.SetResources(&gApp.mResources);
+    shadowPermutations.SetSources("../shaders/shadow_vert.glsl", "../shaders/depth_frag.glsl");
+    shadowPermutations.Declare(SHADER_FEATURE_NONE);
+    shadowPermutations.Precompile();
+    gApp.mShadowProgram = shadowPermutations.GetProgram(SHADER_FEATURE_NONE);
+
+    // The deferred renderer shades with the mesh fragment shader, run once per pixel
+    if (gApp.mRenderer == RendererKind::Deferred) {
+        ShaderPermutationManager& lightingPermutations = gApp.mDeferredLightingPermutations;
+        lightingPermutations.SetResources(&gApp.mResources);
+        lightingPermutations.SetSources("../shaders/fullscreen_vert.glsl", "../shaders/frag.glsl");
+        lightingPermutations.Declare(SHADER_FEATURE_DEFERRED_LIGHTING);
+        lightingPermutations.Precompile();
+        gApp.mDeferredLightingProgram = lightingPermutations.GetProgram(SHADER_FEATURE_DEFERRED_LIGHTING);
+    }
 
-    gApp.mGraphicsPipelineShaderProgram = CreateShaderProgram(vertexShaderSource, fragmentShaderSource);
+    if (gApp.mDynamicResolution.mEnabled) {
+        ShaderPermutationManager& upscalePermutations = gApp.mUpscalePermutations;
+        upscalePermutations.SetResources(&gApp.mResources);
+        upscalePermutations.SetSources("../shaders/fullscreen_vert.glsl", "../shaders/upscale_frag.glsl");
+        upscalePermutations.Declare(SHADER_FEATURE_NONE);
+        upscalePermutations.Precompile();
+        gApp.mUpscaleProgram = upscalePermutations.GetProgram(SHADER_FEATURE_NONE);
+    }
+
+    ShaderPermutationManager& billboardPermutations = gApp.mBillboardPermutations;
+    billboardPermutations.SetResources(&gApp.mResources);
+    billboardPermutations.SetSources("../shaders/billboard_vert.glsl", "../shaders/billboard_frag.glsl");
+    billboardPermutations.Declare(SHADER_FEATURE_NONE);
+    billboardPermutations.Declare(SHADER_FEATURE_WEIGHTED_OIT);
+    billboardPermutations.Precompile();
+
+    ShaderPermutationManager& compositePermutations = gApp.mCompositePermutations;
+    compositePermutations.SetResources(&gApp.mResources);
+    compositePermutations.SetSources("../shaders/fullscreen_vert.glsl", "../shaders/oit_composite_frag.glsl");
+    compositePermutations.Declare(SHADER_FEATURE_NONE);
+    compositePermutations.Precompile();
+    UpdateTransparentPrograms();
+
+    // Recompile whenever a shader is saved
+    gApp.mShaderWatcher.Watch("../shaders");
+}
+
+/**
+ * Attach the pipeline variant each object asks for
+ */
+void AssignMeshPipelines() {
+    AssignPipelines(gApp.mWorld, gApp.mSystemQueries, gApp.mShaderPermutations, RendererShaderFeatures());
+}
+
+/**
+ * Called once per frame. Starts recompiling all shader variants in the background
+ * after a shader changed, and swaps them in once the driver has finished compiling
+ * them, without ever waiting on the compile.
+ */
+void UpdateGraphicsPipeline() {
+    if (gApp.mShaderWatcher.PollChanged()) {
+        std::println("{}", "Shader change detected, recompiling");
+        gApp.mShaderPermutations.BeginReload();
+        gApp.mDepthPermutations.BeginReload();
+        gApp.mShadowPermutations.BeginReload();
+        if (gApp.mRenderer == RendererKind::Deferred) {
+            gApp.mDeferredLightingPermutations.BeginReload();
+        }
+        if (gApp.mDynamicResolution.mEnabled) {
+            gApp.mUpscalePermutations.BeginReload();
+        }
+        gApp.mBillboardPermutations.BeginReload();
+        gApp.mCompositePermutations.BeginReload();
+    }
+
+    if (gApp.mShaderPermutations.UpdateReload()) {
+        // The reloaded programs can have the names of the ones they replace
+        gApp.mDrawQueue.InvalidateUniformCache();
+        gApp.mGraphicsPipelineShaderProgram = gApp.mShaderPermutations.GetProgram(RendererShaderFeatures());
+        AssignMeshPipelines();
+    }
+    if (gApp.mDepthPermutations.UpdateReload()) {
+        gApp.mDepthPrePassProgram = gApp.mDepthPermutations.GetProgram(SHADER_FEATURE_NONE);
+    }
+    if (gApp.mShadowPermutations.UpdateReload()) {
+        gApp.mShadowProgram = gApp.mShadowPermutations.GetProgram(SHADER_FEATURE_NONE);
+    }
+    if (gApp.mRenderer == RendererKind::Deferred && gApp.mDeferredLightingPermutations.UpdateReload()) {
+        gApp.mDeferredLightingProgram = gApp.mDeferredLightingPermutations.GetProgram(SHADER_FEATURE_DEFERRED_LIGHTING);
+    }
+    if (gApp.mDynamicResolution.mEnabled && gApp.mUpscalePermutations.UpdateReload()) {
+        gApp.mUpscaleProgram = gApp.mUpscalePermutations.GetProgram(SHADER_FEATURE_NONE);
+    }
+    // Both reloads have to be polled every frame, so no short-circuiting
+    const bool billboardsReloaded = gApp.mBillboardPermutations.UpdateReload();
+    const bool compositeReloaded = gApp.mCompositePermutations.UpdateReload();
+    if (billboardsReloaded || compositeReloaded) {
+        UpdateTransparentPrograms();
+    }
 }
 
 void GetOpenGLVersionInfo() {
@@ -57,7 +206,8 @@ void InitializeProgram(App* app) {
 
     // We want to request a double buffer for smooth updating
     SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
-    SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+    // The scene has its own depth buffer in mOffscreenTarget
+    SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 0);
 
     // Create an application window using OpenGL that supports SDL
     app->mGraphicsAppWindow =
@@ -81,16 +231,41 @@ void InitializeProgram(App* app) {
     if (!gladLoadGLLoader(SDL_GL_GetProcAddress)) {
         std::println("{}", "glad could not initialize");
     }
+    // Let the driver compile shaders on its own threads when it can
+    if (InitParallelShaderCompile(SDL_GL_GetProcAddress)) {
+        std::println("{}", "Using KHR_parallel_shader_compile");
+    }
+    app->mDepthMode = InitDepthMode(SDL_GL_GetProcAddress);
     // Display information from our above setup
     GetOpenGLVersionInfo();
 }
 
+/**
+ * Record the next mProfileCaptureFrames frames. The capture is written to
+ * profile.json, which can be opened in chrome://tracing or ui.perfetto.dev.
+ */
+void StartProfileCapture() {
+    if (ProfilerIsCapturing()) { return; }
+    std::println("Capturing {} frames", gApp.mProfileCaptureFrames);
+    ProfilerBeginCapture();
+    gApp.mProfileFramesRemaining = gApp.mProfileCaptureFrames;
+}
+
+void UpdateProfileCapture() {
+    if (gApp.mProfileFramesRemaining <= 0) { return; }
+    if (--gApp.mProfileFramesRemaining == 0) {
+        ProfilerEndCapture();
+        ProfilerExportChromeTrace("profile.json");
+    }
+}
+
 /**
  * Function called int the main application loop to handle user input
+ * Events are handled once per frame; anything that moves objects over time
+ * happens in Simulate instead.
  */
-void Input(Mesh3D* mesh) {
-    static int mouseX = gApp.mScreenWidth / 2;
-    static int mouseY = gApp.mScreenHeight / 2;
+void Input() {
+    ALLOC_SCOPE("Input");
 
     // Event handler that handles various events in SDL
     // that are related to input and output
@@ -101,10 +276,24 @@ void Input(Mesh3D* mesh) {
         if (e.type == SDL_QUIT) {
             std::println("{}", "Closing the application");
             gApp.mQuit = true;
-        } else if (e.type == SDL_MOUSEMOTION) {
-            mouseX += e.motion.xrel;
-            mouseY += e.motion.yrel;
-            gApp.mCamera.MouseLook(mouseX, mouseY);
+        } else if (e.type == SDL_KEYDOWN && e.key.repeat == 0) {
+            if (e.key.keysym.scancode == SDL_SCANCODE_P) {
+                StartProfileCapture();
+            } else if (e.key.keysym.scancode == SDL_SCANCODE_M) {
+                gApp.mResources.PrintReport();
+                gApp.mFrameArena.PrintReport();
+                gApp.mRenderGraph.PrintReport();
+                DynamicResolutionPrintReport(gApp.mDynamicResolution, gApp.mOffscreenTarget);
+                gApp.mLatencyLimiter.PrintReport();
+                AllocPrintLeakReport();
+            } else if (e.key.keysym.scancode == SDL_SCANCODE_C) {
+                if (!MeshCompactBuffers(&gApp.mResources).empty()) {
+                    RefreshMeshInstances(gApp.mWorld, gApp.mSystemQueries, gApp.mResources);
+                }
+            } else if (e.key.keysym.scancode == SDL_SCANCODE_Z) {
+                gApp.mDepthPrePass = !gApp.mDepthPrePass;
+                std::println("Depth pre-pass {}", gApp.mDepthPrePass ? "on" : "off");
+            }
         }
     }
 
@@ -115,24 +304,48 @@ void Input(Mesh3D* mesh) {
     if (state[SDL_SCANCODE_ESCAPE]) {
         gApp.mQuit = true;
     }
-    if (state[SDL_SCANCODE_UP]) {
-        mesh->mTransform.z += 0.0005f;
-        // std::println("g_uOffset: {}", g_uOffset);
-    }
-    if (state[SDL_SCANCODE_DOWN]) {
-        mesh->mTransform.z -= 0.0005f;
-        // std::println("g_uOffset: {}", g_uOffset);
-    }
-    if (state[SDL_SCANCODE_LEFT]) {
-        mesh->m_uRotate -= 0.05f;
-        // std::println("g_uRotate: {}", g_uRotate);
-    }
-    if (state[SDL_SCANCODE_RIGHT]) {
-        mesh->m_uRotate += 0.05f;
-        // std::println("g_uRotate: {}", g_uRotate);
-    }
+}
+
+/**
+ * Advance the simulation by one fixed step of dt seconds.
+ * Speeds are per second, so behavior no longer depends on the frame rate.
+ */
+void Simulate(const float dt) {
+    ALLOC_SCOPE("Simulate");
+    // Remember where everything was, so rendering can interpolate
+    StoreTransformsSystem(gApp.mWorld, gApp.mSystemQueries, gApp.mJobSystem);
+    gApp.mCamera.StoreState();
+
+    SpinSystem(gApp.mWorld, gApp.mSystemQueries, dt, gApp.mJobSystem);
+    LightOrbitSystem(gApp.mWorld, gApp.mSystemQueries, dt, gApp.mJobSystem);
 
-    float speed = 0.001f;
+    // Nothing is driven by the keyboard in headless runs
+    if (gApp.mHeadless) { return; }
+
+    const Uint8* state = SDL_GetKeyboardState(nullptr);
+
+    constexpr float meshSpeed = 0.5f;
+    constexpr float meshRotationSpeed = 90.0f; // degrees per second
+    gApp.mWorld.ForEachChunk(gApp.mSystemQueries.mPlayer, [&](const ChunkView& chunk) {
+        LocalTransform* transforms = chunk.Column<LocalTransform>();
+        for (size_t i = 0; i < chunk.Count(); ++i) {
+            LocalTransform& transform = transforms[i];
+            if (state[SDL_SCANCODE_UP]) {
+                transform.mPosition.z += meshSpeed * dt;
+            }
+            if (state[SDL_SCANCODE_DOWN]) {
+                transform.mPosition.z -= meshSpeed * dt;
+            }
+            if (state[SDL_SCANCODE_LEFT]) {
+                transform.mRotate -= meshRotationSpeed * dt;
+            }
+            if (state[SDL_SCANCODE_RIGHT]) {
+                transform.mRotate += meshRotationSpeed * dt;
+            }
+        }
+    });
+
+    const float speed = 2.0f * dt;
     if (state[SDL_SCANCODE_W]) {
         gApp.mCamera.MoveForward(speed);
     }
@@ -147,31 +360,642 @@ void Input(Mesh3D* mesh) {
     }
 }
 
+/**
+ * Mouse look is read here rather than in Input, right before the draws are submitted,
+ * so the camera they are drawn with is as fresh as it can be. Relative mouse motion
+ * piles up in SDL between calls, so none is lost or counted twice.
+ */
+void LateLatchCamera() {
+    if (gApp.mHeadless) { return; }
+
+    static int mouseX = gApp.mScreenWidth / 2;
+    static int mouseY = gApp.mScreenHeight / 2;
+
+    SDL_PumpEvents();
+    int deltaX = 0;
+    int deltaY = 0;
+    SDL_GetRelativeMouseState(&deltaX, &deltaY);
+    if (deltaX != 0 || deltaY != 0) {
+        mouseX += deltaX;
+        mouseY += deltaY;
+        gApp.mCamera.MouseLook(mouseX, mouseY);
+    }
+    gApp.mLatencyLimiter.MarkInputSampled();
+}
+
+/**
+ * Latch the camera and write it to the frame uniform buffer; the last thing before
+ * the draws are submitted. The lights are binned with the latched camera, since the
+ * clusters are in view space and would no longer line up after a turn.
+ */
+void UploadFrameUniforms(const RenderTarget& target) {
+    LateLatchCamera();
+    ClusteredLightingBin(&gApp.mClusteredLighting, gApp.mCamera.GetViewMatrix(), gApp.mCamera.GetProjectionMatrix(),
+                         kNearPlane, &gApp.mJobSystem);
+    ClusteredLightingUpload(&gApp.mClusteredLighting, &gApp.mResources);
+
+    // Likewise the shadow cascades are fitted to the latched camera
+    if (gApp.mShadowResolution > 0) {
+        const DirectionalLight* sun{nullptr};
+        gApp.mWorld.ForEachChunk(gApp.mSystemQueries.mDirectionalLights, [&](const ChunkView& chunk) {
+            if (sun == nullptr && chunk.Count() > 0) {
+                sun = chunk.Column<DirectionalLight>();
+            }
+        });
+        CascadedShadowsUpdate(&gApp.mShadows, sun, gApp.mCamera, kNearPlane,
+                              gApp.mWorld.StructuralVersion(gApp.mSystemQueries.mStaticCasters));
+    }
+
+    FrameUniforms uniforms{gApp.mCamera.GetViewMatrix(), gApp.mCamera.GetProjectionMatrix()};
+    ClusteredLightingFillUniforms(gApp.mClusteredLighting, target.mViewportWidth, target.mViewportHeight, &uniforms);
+    CascadedShadowsFillUniforms(gApp.mShadows, &uniforms);
+    // Without lights the scene keeps its unlit colors
+    const bool lit = !gApp.mClusteredLighting.mLights.empty() || gApp.mShadows.mHasLight;
+    uniforms.mAmbient = lit ? glm::vec4(0.15f, 0.15f, 0.15f, 1.0f) : glm::vec4(1.0f);
+    uniforms.mInverseViewProjection = gApp.mCamera.GetInverseViewProjectionMatrix();
+    uniforms.mCameraPosition = glm::vec4(glm::vec3(gApp.mCamera.GetInverseViewMatrix()[3]),
+                                         gApp.mDepthMode == DepthMode::ReverseZ ? 1.0f : 0.0f);
+    const float viewportWidth = static_cast<float>(target.mViewportWidth);
+    const float viewportHeight = static_cast<float>(target.mViewportHeight);
+    uniforms.mViewport = glm::vec4(viewportWidth, viewportHeight, 1.0f / viewportWidth, 1.0f / viewportHeight);
+    FrameUniformBufferUpload(gApp.mResources, &gApp.mFrameUniforms, uniforms);
+    gApp.mRenderCounters.mUniformUploads += 1;
+}
+
+/**
+ * Cull and record the opaque draws on all threads, each into its own command list
+ */
+void RecordOpaqueDraws(const Frustum& frustum) {
+    PROFILE_SCOPE("RecordDraws");
+    std::vector<CommandList>& lists = gApp.mCommandLists;
+    for (CommandList& list : lists) {
+        list.Reset();
+    }
+
+    constexpr size_t recordChunksPerJob = 16;
+    gApp.mWorld.ParallelForEachChunk(gApp.mSystemQueries.mDrawable, gApp.mJobSystem, recordChunksPerJob,
+                                     [&](const ChunkView& chunk, size_t thread) {
+                                         RecordMeshDraws(&lists[thread], chunk.Column<WorldMatrix>(),
+                                                         chunk.Column<MeshInstance>(), chunk.Count(), frustum);
+                                     });
+}
+
+/**
+ * Issue the recorded opaque draws, after a depth pre-pass when it is on
+ */
+void SubmitOpaqueDraws() {
+    if (!gApp.mDepthPrePass) {
+        gApp.mDrawQueue.Submit(gApp.mCommandLists, &gApp.mRenderCounters);
+        return;
+    }
+
+    // Depth first, from positions alone; then shade each pixel once, where the
+    // surface drawn is the one the pre-pass left in the depth buffer
+    gApp.mDrawQueue.Merge(gApp.mCommandLists);
+    gApp.mDrawQueue.ReplayDepthOnly(gApp.mCommandLists, gApp.mDepthPrePassProgram, &gApp.mRenderCounters);
+    glDepthFunc(GL_EQUAL);
+    glDepthMask(GL_FALSE);
+    gApp.mDrawQueue.Replay(gApp.mCommandLists, &gApp.mRenderCounters);
+    glDepthMask(GL_TRUE);
+    ApplyDepthState(gApp.mDepthMode);
+}
+
+/**
+ * Draw the opaque meshes into whatever is bound: one MeshDraw per object, or the
+ * command lists recorded earlier in the frame
+ */
+void DrawOpaque() {
+    if (gApp.mImmediateDraws) {
+        gApp.mWorld.ForEachChunk(gApp.mSystemQueries.mDrawable, [](const ChunkView& chunk) {
+            const WorldMatrix* matrices = chunk.Column<WorldMatrix>();
+            const MeshInstance* instances = chunk.Column<MeshInstance>();
+            for (size_t i = 0; i < chunk.Count(); ++i) {
+                MeshDraw(&gApp, instances[i], matrices[i].mMatrix);
+            }
+        });
+    } else {
+        SubmitOpaqueDraws();
+    }
+}
+
+/**
+ * What the passes of the frame's render graph hand each other, filled in while the
+ * graph is built and read by the passes as they run
+ */
+struct FrameGraph {
+    const RenderTarget* mTarget{nullptr};
+    RenderGraphTexture mGBufferAlbedoMaterial{};
+    RenderGraphTexture mGBufferNormal{};
+    RenderGraphTexture mGBufferDepth{};
+    RenderGraphTexture mSceneDepth{};
+    RenderGraphTexture mAccumulation{};
+    RenderGraphTexture mRevealage{};
+};
+
+FrameGraph gFrameGraph;
+
+/**
+ * Draw the shadow cascades that need it. Runs after UploadFrameUniforms, which fits them.
+ */
+void ShadowPass(RenderGraph&, void*) {
+    CascadedShadowsRender(&gApp.mShadows, gApp.mResources, gApp.mWorld, gApp.mSystemQueries.mStaticCasters,
+                          gApp.mSystemQueries.mDynamicCasters, gApp.mShadowProgram, gApp.mJobSystem,
+                          &gApp.mRenderCounters);
+    // Back to the scene's culling
+    ApplyDepthState(gApp.mDepthMode);
+}
+
+/**
+ * Clear the scene target and shade the opaque meshes straight into it
+ */
+void ForwardOpaquePass(RenderGraph&, void* data) {
+    const FrameGraph& frame = *static_cast<const FrameGraph*>(data);
+    RenderTargetBind(frame.mTarget);
+    // Opaque geometry is depth tested and drawn front to back
+    ApplyDepthState(gApp.mDepthMode);
+    glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+    DrawOpaque();
+}
+
+/**
+ * Draw the opaque meshes' surfaces into the G-buffer
+ */
+void GBufferPass(RenderGraph& graph, void* data) {
+    const FrameGraph& frame = *static_cast<const FrameGraph*>(data);
+    if (graph.Framebuffer({frame.mGBufferAlbedoMaterial, frame.mGBufferNormal}, frame.mGBufferDepth) == 0) {
+        return;
+    }
+    glViewport(0, 0, frame.mTarget->mViewportWidth, frame.mTarget->mViewportHeight);
+    ApplyDepthState(gApp.mDepthMode);
+    // Only depth tells the lighting pass where nothing was drawn, so the colors need no
+    // particular value; cleared anyway, which lets tiled GPUs skip loading them
+    glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+    DrawOpaque();
+}
+
+/**
+ * Light the G-buffer into the cleared scene target, and give the target its depth
+ */
+void LightingPass(RenderGraph& graph, void* data) {
+    const FrameGraph& frame = *static_cast<const FrameGraph*>(data);
+    const GBuffer gbuffer{graph.Framebuffer({frame.mGBufferAlbedoMaterial, frame.mGBufferNormal},
+                                            frame.mGBufferDepth),
+                          graph.Name(frame.mGBufferAlbedoMaterial), graph.Name(frame.mGBufferNormal),
+                          graph.Name(frame.mGBufferDepth), frame.mTarget->mViewportWidth,
+                          frame.mTarget->mViewportHeight};
+    RenderTargetBind(frame.mTarget);
+    glClear(GL_COLOR_BUFFER_BIT);
+    if (gbuffer.mFramebuffer == 0) { return; }
+    DeferredLightingDraw(gApp.mDeferredLighting, gbuffer, *frame.mTarget, gApp.mDeferredLightingProgram,
+                         &gApp.mRenderCounters);
+}
+
+/**
+ * Blend the billboards over the opaque scene
+ */
+void TransparencyPass(RenderGraph& graph, void* data) {
+    const FrameGraph& frame = *static_cast<const FrameGraph*>(data);
+    WeightedBlendedTarget weightedTarget{};
+    if (!frame.mAccumulation.IsNull()) {
+        weightedTarget.mFramebuffer = graph.Framebuffer({frame.mAccumulation, frame.mRevealage}, frame.mSceneDepth);
+        weightedTarget.mAccumulation = graph.Name(frame.mAccumulation);
+        weightedTarget.mRevealage = graph.Name(frame.mRevealage);
+    }
+    RenderTargetBind(frame.mTarget);
+    TransparentPassDraw(&gApp.mTransparentPass, &gApp.mResources, gApp.mTransparentPrograms, *frame.mTarget,
+                        weightedTarget, gApp.mJobSystem, &gApp.mRenderCounters);
+}
+
+void PresentPass(RenderGraph&, void* data) {
+    const FrameGraph& frame = *static_cast<const FrameGraph*>(data);
+    RenderTargetBlitToScreen(frame.mTarget, gApp.mScreenWidth, gApp.mScreenHeight);
+}
+
+/**
+ * Fill the window from the part of the target dynamic resolution drew into, sharpened
+ */
+void UpscalePass(RenderGraph&, void* data) {
+    const FrameGraph& frame = *static_cast<const FrameGraph*>(data);
+    DynamicResolutionUpscale(gApp.mDynamicResolution, gApp.mResources, *frame.mTarget, gApp.mUpscaleProgram,
+                             gApp.mScreenWidth, gApp.mScreenHeight, &gApp.mRenderCounters);
+}
+
+/**
+ * Lay out the frame's passes and what each reads and writes. The graph drops the ones
+ * nothing needs and hands out the transient targets: the G-buffer, and the
+ * order-independent transparency targets. Those are always the target's full size, and
+ * dynamic resolution draws into a corner of them, so a change of scale does not
+ * reallocate anything.
+ */
+void BuildFrameGraph(const RenderTarget& target, const bool present) {
+    RenderGraph& graph = gApp.mRenderGraph;
+    FrameGraph& frame = gFrameGraph;
+    graph.Reset();
+    frame = FrameGraph{};
+    frame.mTarget = &target;
+    const int width = target.mWidth;
+    const int height = target.mHeight;
+
+    RenderGraphTexture sceneColor = graph.ImportTexture("SceneColor", gApp.mResources.Name(target.mColorTexture));
+    RenderGraphTexture sceneDepth = graph.ImportRenderbuffer("SceneDepth",
+                                                             gApp.mResources.Name(target.mDepthRenderbuffer));
+
+    RenderGraphTexture shadowMap{};
+    if (gApp.mShadows.mHasLight) {
+        shadowMap = graph.ImportTexture("ShadowMap", gApp.mResources.Name(gApp.mShadows.mShadowMap));
+        const RenderGraph::PassIndex shadows = graph.AddPass("Shadows", ShadowPass);
+        shadowMap = graph.Write(shadows, shadowMap);
+    }
+
+    if (gApp.mRenderer == RendererKind::Deferred) {
+        const RenderGraph::PassIndex geometry = graph.AddPass("GBuffer", GBufferPass, &frame);
+        frame.mGBufferAlbedoMaterial = graph.Create(geometry, "GBufferAlbedoMaterial",
+                                                    GBufferAlbedoMaterialDesc(width, height));
+        frame.mGBufferNormal = graph.Create(geometry, "GBufferNormal", GBufferNormalDesc(width, height));
+        frame.mGBufferDepth = graph.Create(geometry, "GBufferDepth", GBufferDepthDesc(width, height));
+
+        const RenderGraph::PassIndex lighting = graph.AddPass("Lighting", LightingPass, &frame);
+        graph.Read(lighting, frame.mGBufferAlbedoMaterial);
+        graph.Read(lighting, frame.mGBufferNormal);
+        graph.Read(lighting, frame.mGBufferDepth);
+        graph.Read(lighting, shadowMap);
+        sceneColor = graph.Write(lighting, sceneColor);
+        sceneDepth = graph.Write(lighting, sceneDepth);
+    } else {
+        const RenderGraph::PassIndex opaque = graph.AddPass("Opaque", ForwardOpaquePass, &frame);
+        graph.Read(opaque, shadowMap);
+        sceneColor = graph.Write(opaque, sceneColor);
+        sceneDepth = graph.Write(opaque, sceneDepth);
+    }
+
+    const TransparentPass& transparent = gApp.mTransparentPass;
+    if (transparent.mWeightedCount > 0 || !transparent.mOrder.empty()) {
+        const RenderGraph::PassIndex transparency = graph.AddPass("Transparency", TransparencyPass, &frame);
+        graph.Read(transparency, sceneColor);
+        graph.Read(transparency, sceneDepth);
+        frame.mSceneDepth = sceneDepth;
+        if (transparent.mWeightedCount > 0) {
+            frame.mAccumulation = graph.Create(transparency, "Accumulation",
+                                               WeightedBlendedAccumulationDesc(width, height));
+            frame.mRevealage = graph.Create(transparency, "Revealage", WeightedBlendedRevealageDesc(width, height));
+        }
+        sceneColor = graph.Write(transparency, sceneColor);
+    }
+
+    if (present && gApp.mDynamicResolution.mEnabled) {
+        const RenderGraph::PassIndex upscale = graph.AddPass("Upscale", UpscalePass, &frame);
+        graph.Read(upscale, sceneColor);
+        graph.SetSideEffect(upscale);
+    } else if (present) {
+        const RenderGraph::PassIndex presentPass = graph.AddPass("Present", PresentPass, &frame);
+        graph.Read(presentPass, sceneColor);
+        graph.SetSideEffect(presentPass);
+    } else {
+        graph.SetOutput(sceneColor);
+    }
+}
+
+/**
+ * Draw the scene into target through the frame's render graph, and copy it to the
+ * window if present is set. Shared by the windowed and the headless loop.
+ */
+void RenderScene(const RenderTarget& target, const bool present) {
+    PROFILE_SCOPE("Render");
+    ALLOC_SCOPE("Render");
+    GPU_PROFILE_SCOPE(gApp.mGpuProfiler, "Scene");
+    gApp.mRenderCounters = RenderCounters{};
+
+    glClearColor(1.f, 1.f, 0.f, 1.f);
+
+    // Blend the last two simulation steps so movement stays smooth at any frame rate
+    TransformSystem(gApp.mWorld, gApp.mSystemQueries, gApp.mInterpolationAlpha, gApp.mJobSystem);
+
+    // The camera can still turn, left and right or up and down, before the draws go out
+    // (LateLatchCamera), so cull with a frustum a little wider and taller than the screen
+    constexpr float lateLatchCullMargin = 0.9f;
+    glm::mat4 cullProjection = gApp.mCamera.GetProjectionMatrix();
+    cullProjection[0][0] *= lateLatchCullMargin;
+    cullProjection[1][1] *= lateLatchCullMargin;
+    const Frustum frustum = FrustumFromMatrix(cullProjection * gApp.mCamera.GetViewMatrix(),
+                                              gApp.mDepthMode == DepthMode::ReverseZ);
+
+    ClusteredLightingGather(&gApp.mClusteredLighting, gApp.mWorld, gApp.mSystemQueries.mLights);
+
+    if (!gApp.mImmediateDraws) {
+        RecordOpaqueDraws(frustum);
+    }
+    UploadFrameUniforms(target);
+
+    // Gathered before the graph is built, which only asks for the order-independent
+    // targets when there is something to draw into them. Sorted by the camera as it
+    // was latched for this frame.
+    TransparentPassGather(&gApp.mTransparentPass, gApp.mWorld, gApp.mSystemQueries.mTransparent,
+                          gApp.mSystemQueries.mOrderIndependent, gApp.mCamera.GetViewMatrix(), frustum,
+                          gApp.mJobSystem);
+
+    // Then make all the GL calls from this thread
+    BuildFrameGraph(target, present);
+    gApp.mRenderGraph.Compile(&gApp.mResources);
+    // Dynamic resolution goes by how long the passes keep the GPU busy
+    const int passesZone = gApp.mGpuProfiler.BeginZone("Passes");
+    gApp.mGpuProfiler.SetWorkZone(passesZone);
+    gApp.mRenderGraph.Execute(gApp.mGpuProfiler);
+    gApp.mGpuProfiler.EndZone(passesZone);
+}
+
+/**
+ * Pick how much of the offscreen target to draw into this frame, from the GPU time of
+ * the render passes of the latest frame the profiler has timed
+ */
+void UpdateRenderResolution() {
+    DynamicResolutionUpdate(&gApp.mDynamicResolution, gApp.mGpuProfiler);
+    DynamicResolutionApply(gApp.mDynamicResolution, &gApp.mOffscreenTarget);
+}
+
 void MainLoop() {
+    if (!RenderTargetCreate(&gApp.mResources, &gApp.mOffscreenTarget, gApp.mScreenWidth, gApp.mScreenHeight)) {
+        return;
+    }
+
     SDL_WarpMouseInWindow(gApp.mGraphicsAppWindow, gApp.mScreenWidth / 2, gApp.mScreenHeight / 2);
     SDL_SetRelativeMouseMode(SDL_TRUE);
 
+    // Frame pacing: the swap interval from --vsync, and the limiter on top of it when
+    // --fps gives a target. Without a target, cap the frame rate ourselves only when
+    // vsync was asked for but is unavailable, so the loop does not spin a full core.
+    const SwapInterval swapInterval = ApplySwapInterval(gApp.mSwapInterval);
+    double targetFrameRate = gApp.mTargetFrameRate;
+    if (swapInterval == SwapInterval::Immediate && targetFrameRate <= 0.0 &&
+        gApp.mSwapInterval != SwapInterval::Immediate) {
+        targetFrameRate = 60.0;
+    }
+    gApp.mFrameLimiter.SetTargetFrameRate(targetFrameRate);
+    std::println("Vsync: {}, frame limit: {}", SwapIntervalName(swapInterval),
+                 targetFrameRate > 0.0 ? std::to_string(static_cast<int>(targetFrameRate)) + " fps" : "none");
+
+    gApp.mFrameClock.SetFixedStep(gApp.mFixedTimeStep);
+    gApp.mFrameClock.Reset();
+
+    ProfilerSetThreadName("Main");
+    gApp.mGpuProfiler.Initialize();
+
     // While the application is running
     while (!gApp.mQuit) {
-        // Handle input
-        Input(meshPtrs[0]);
+        {
+            PROFILE_SCOPE("Frame");
+            // Do not get more than the allowed number of frames ahead of the GPU
+            {
+                PROFILE_SCOPE("WaitForGpu");
+                gApp.mLatencyLimiter.WaitForFrameSlot();
+            }
+            gApp.mGpuProfiler.BeginFrame();
+            gApp.mFrameArena.BeginFrame();
+            AllocBeginFrame();
 
-        // set OpenGL state
-        glDisable(GL_DEPTH_TEST);
-        glDisable(GL_CULL_FACE);
+            // Delete whatever the GPU has finished with
+            gApp.mResources.CollectGarbage();
 
-        glViewport(0, 0, gApp.mScreenWidth, gApp.mScreenHeight);
-        glClearColor(1.f, 1.f, 0.f, 1.f);
-        glClear(GL_DEPTH_BUFFER_BIT | GL_COLOR_BUFFER_BIT);
+            // Handle input
+            {
+                PROFILE_SCOPE("Input");
+                Input();
+            }
 
+            // Pick up edited shaders without stalling the frame
+            UpdateGraphicsPipeline();
 
-        for (const auto meshPtr : meshPtrs) {
-            MeshDraw(&gApp, meshPtr);
+            // GL work that jobs handed back to this thread
+            gApp.mJobSystem.RunMainThreadJobs();
+
+            // Run as many fixed simulation steps as real time calls for
+            {
+                PROFILE_SCOPE("Simulate");
+                const int steps = gApp.mFrameClock.BeginFrame();
+                for (int step = 0; step < steps; ++step) {
+                    Simulate(static_cast<float>(gApp.mFrameClock.FixedStep()));
+                }
+                gApp.mInterpolationAlpha = gApp.mFrameClock.Alpha();
+                gApp.mCamera.Interpolate(gApp.mInterpolationAlpha);
+            }
+
+            UpdateRenderResolution();
+            RenderTargetBind(&gApp.mOffscreenTarget);
+            RenderScene(gApp.mOffscreenTarget, true);
+
+            gApp.mGpuProfiler.EndFrame();
+
+            // Update the screen of the specified window
+            {
+                PROFILE_SCOPE("Swap");
+                SDL_GL_SwapWindow(gApp.mGraphicsAppWindow);
+            }
+            gApp.mResources.EndFrame();
+            gApp.mLatencyLimiter.EndFrame();
+
+            // Hold off the next frame if we are ahead of the target frame rate
+            {
+                PROFILE_SCOPE("FrameLimiter");
+                gApp.mFrameLimiter.Wait();
+            }
         }
 
-        // Update the screen of the specified window
-        SDL_GL_SwapWindow(gApp.mGraphicsAppWindow);
+        UpdateProfileCapture();
     }
+
+    gApp.mLatencyLimiter.PrintReport();
+}
+
+/**
+ * Benchmark loop for headless runs: renders into an offscreen framebuffer for a fixed
+ * number of frames or a fixed duration, then prints frame time statistics.
+ * Every frame simulates exactly one fixed step, so runs are repeatable.
+ */
+bool HeadlessLoop() {
+    using Clock = std::chrono::steady_clock;
+
+    if (!RenderTargetCreate(&gApp.mResources, &gApp.mOffscreenTarget, gApp.mScreenWidth, gApp.mScreenHeight)) {
+        return false;
+    }
+
+    ProfilerSetThreadName("Main");
+    gApp.mGpuProfiler.Initialize();
+
+    // Run for 1000 frames unless told otherwise
+    int frameLimit = gApp.mBenchmarkFrames;
+    if (frameLimit <= 0 && gApp.mBenchmarkSeconds <= 0.0) {
+        frameLimit = 1000;
+    }
+
+    FrameStats stats;
+    stats.Reserve(frameLimit > 0 ? frameLimit : 10000);
+
+    constexpr int warmupFrames = 10;
+    int overAllocationLimit = 0;
+    const Clock::time_point start = Clock::now();
+    for (int frame = -warmupFrames; ; ++frame) {
+        if (frameLimit > 0 && frame >= frameLimit) { break; }
+        if (gApp.mBenchmarkSeconds > 0.0 && frame >= 0 &&
+            std::chrono::duration<double>(Clock::now() - start).count() >= gApp.mBenchmarkSeconds) {
+            break;
+        }
+
+        const Clock::time_point frameStart = Clock::now();
+        {
+            PROFILE_SCOPE("Frame");
+            gApp.mGpuProfiler.BeginFrame();
+            gApp.mFrameArena.BeginFrame();
+            AllocBeginFrame();
+            gApp.mResources.CollectGarbage();
+
+            Simulate(gApp.mFixedTimeStep);
+            gApp.mJobSystem.RunMainThreadJobs();
+            gApp.mInterpolationAlpha = 1.0f;
+            gApp.mCamera.Interpolate(gApp.mInterpolationAlpha);
+
+            UpdateRenderResolution();
+            RenderTargetBind(&gApp.mOffscreenTarget);
+            RenderScene(gApp.mOffscreenTarget, false);
+
+            gApp.mGpuProfiler.EndFrame();
+
+            // There is no swap to throttle us, so wait for the frame to finish to
+            // measure what it really costs
+            PROFILE_SCOPE("Finish");
+            glFinish();
+            gApp.mResources.EndFrame();
+        }
+        const double frameTimeMs =
+            std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count();
+
+        // Read before the bookkeeping below, which is not part of the frame
+        const uint64_t allocations = AllocFrameCounts().Allocations();
+
+        if (frame >= 0) {
+            stats.AddFrame(frameTimeMs, gApp.mRenderCounters);
+            if constexpr (kAllocationTracking) {
+                // Once warmed up, a frame should find everything it needs already allocated
+                stats.AddHeapAllocations(allocations);
+                if (gApp.mMaxFrameAllocations >= 0 &&
+                    allocations > static_cast<uint64_t>(gApp.mMaxFrameAllocations)) {
+                    if (overAllocationLimit == 0) {
+                        std::println("Frame {} made {} heap allocations, over the limit of {}:", frame,
+                                     allocations, gApp.mMaxFrameAllocations);
+                        AllocPrintFrameReport();
+                    }
+                    ++overAllocationLimit;
+                }
+            }
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    stats.Print();
+    gApp.mResources.PrintReport();
+    gApp.mFrameArena.PrintReport();
+    gApp.mRenderGraph.PrintReport();
+    DynamicResolutionPrintReport(gApp.mDynamicResolution, gApp.mOffscreenTarget);
+
+    if (overAllocationLimit > 0) {
+        std::println("{} frames went over the heap allocation limit", overAllocationLimit);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Read the command line. Returns false if it could not be understood.
+ */
+bool ParseArguments(App* app, const int argc, char* argv[]) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        if (argument == "--headless") {
+            app->mHeadless = true;
+        } else if (argument == "--frames" && hasValue) {
+            app->mBenchmarkFrames = std::atoi(argv[++i]);
+        } else if (argument == "--duration" && hasValue) {
+            app->mBenchmarkSeconds = std::atof(argv[++i]);
+        } else if (argument == "--width" && hasValue) {
+            app->mScreenWidth = std::atoi(argv[++i]);
+        } else if (argument == "--height" && hasValue) {
+            app->mScreenHeight = std::atoi(argv[++i]);
+        } else if (argument == "--scene" && hasValue) {
+            app->mSceneConfig.mObjectCount = std::strtoull(argv[++i], nullptr, 10);
+        } else if (argument == "--distribution" && hasValue) {
+            if (!ParseSceneDistribution(argv[++i], &app->mSceneConfig.mDistribution)) {
+                std::println("Unknown distribution {}, expected grid, clustered, overlapping or offscreen", argv[i]);
+                return false;
+            }
+        } else if (argument == "--particles" && hasValue) {
+            app->mSceneConfig.mParticleCount = std::strtoull(argv[++i], nullptr, 10);
+        } else if (argument == "--oit" && hasValue) {
+            app->mSceneConfig.mOrderIndependentFraction = static_cast<float>(std::atof(argv[++i]));
+        } else if (argument == "--lights" && hasValue) {
+            app->mSceneConfig.mLightCount = std::strtoull(argv[++i], nullptr, 10);
+        } else if (argument == "--mesh-variety" && hasValue) {
+            app->mSceneConfig.mMeshVariety = std::atoi(argv[++i]);
+        } else if (argument == "--pipelines" && hasValue) {
+            app->mSceneConfig.mPipelineCount = std::atoi(argv[++i]);
+        } else if (argument == "--dynamic" && hasValue) {
+            app->mSceneConfig.mDynamicFraction = static_cast<float>(std::atof(argv[++i]));
+        } else if (argument == "--threads" && hasValue) {
+            app->mWorkerThreads = std::atoi(argv[++i]);
+        } else if (argument == "--immediate-draws") {
+            app->mImmediateDraws = true;
+        } else if (argument == "--depth-prepass") {
+            app->mDepthPrePass = true;
+        } else if (argument == "--renderer" && hasValue) {
+            if (!ParseRendererKind(argv[++i], &app->mRenderer)) {
+                std::println("Unknown renderer {}, expected forward or deferred", argv[i]);
+                return false;
+            }
+        } else if (argument == "--dynamic-resolution" && hasValue) {
+            app->mDynamicResolution.mEnabled = true;
+            app->mDynamicResolution.mTargetFrameTimeMs = std::atof(argv[++i]);
+        } else if (argument == "--min-resolution-scale" && hasValue) {
+            app->mDynamicResolution.mMinScale = std::clamp(static_cast<float>(std::atof(argv[++i])), 0.1f, 1.0f);
+        } else if (argument == "--shadows") {
+            app->mShadowResolution = kDefaultShadowResolution;
+        } else if (argument == "--shadow-resolution" && hasValue) {
+            app->mShadowResolution = std::max(std::atoi(argv[++i]), 0);
+        } else if (argument == "--gpu-budget" && hasValue) {
+            const double megabytes = std::atof(argv[++i]);
+            app->mResources.BufferAllocator().SetTotalBudget(static_cast<size_t>(megabytes * 1024.0 * 1024.0));
+        } else if (argument == "--max-frames-in-flight" && hasValue) {
+            app->mLatencyLimiter.SetMaxFramesInFlight(std::atoi(argv[++i]));
+        } else if (argument == "--vsync" && hasValue) {
+            if (!ParseSwapInterval(argv[++i], &app->mSwapInterval)) {
+                std::println("Unknown vsync mode {}, expected off, on or adaptive", argv[i]);
+                return false;
+            }
+        } else if (argument == "--fps" && hasValue) {
+            app->mTargetFrameRate = std::max(std::atof(argv[++i]), 0.0);
+        } else if (argument == "--low-latency") {
+            app->mLatencyLimiter.SetMaxFramesInFlight(1);
+        } else if (argument == "--max-frame-allocations" && hasValue) {
+            app->mMaxFrameAllocations = std::atoi(argv[++i]);
+            if (!kAllocationTracking) {
+                std::println("{}", "--max-frame-allocations needs a build with OPENGLNOTES_TRACK_ALLOCATIONS=ON");
+                return false;
+            }
+        } else if (argument == "--seed" && hasValue) {
+            app->mSceneConfig.mSeed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+        } else {
+            std::println("Unknown argument: {}", argument);
+            std::println("{}", "Usage: OpenGLTutorial [--headless] [--frames N] [--duration SECONDS]"
+                               " [--width W] [--height H]\n"
+                               "    [--scene OBJECTS] [--distribution grid|clustered|overlapping|offscreen]"
+                               " [--mesh-variety N] [--pipelines N] [--dynamic FRACTION] [--particles N] [--oit FRACTION] [--lights N] [--seed N]\n"
+                               "    [--threads N] [--immediate-draws] [--depth-prepass] [--shadows]"
+                               " [--shadow-resolution N] [--gpu-budget MIB] [--max-frame-allocations N]\n"
+                               "    [--vsync off|on|adaptive] [--fps N] [--max-frames-in-flight N] [--low-latency]"
+                               " [--renderer forward|deferred]"
+                               " [--dynamic-resolution TARGET_MS] [--min-resolution-scale SCALE]");
+            return false;
+        }
+    }
+    return true;
 }
 
 /**
@@ -179,50 +1003,155 @@ void MainLoop() {
  * created in heap memory.
  */
 void CleanUp() {
-    SDL_DestroyWindow(gApp.mGraphicsAppWindow);
-    gApp.mGraphicsAppWindow = nullptr;
+    gApp.mJobSystem.Stop();
+    SetActiveFrameArena(nullptr);
 
-    MeshDelete(&gMesh1);
-    // Delete our graphics pipeline
-    glDeleteProgram(gApp.mGraphicsPipelineShaderProgram);
+    // GL objects go first, while the context they belong to still exists
+    gApp.mGpuProfiler.Shutdown();
+    gApp.mLatencyLimiter.Shutdown();
+    FrameUniformBufferDelete(&gApp.mResources, &gApp.mFrameUniforms);
+    TransparentPassDelete(&gApp.mResources, &gApp.mTransparentPass);
+    ClusteredLightingDelete(&gApp.mResources, &gApp.mClusteredLighting);
+    CascadedShadowsDelete(&gApp.mResources, &gApp.mShadows);
+    DeferredLightingDelete(&gApp.mDeferredLighting);
+    DynamicResolutionDelete(&gApp.mDynamicResolution);
+    gApp.mRenderGraph.Release(&gApp.mResources);
+    RenderTargetDelete(&gApp.mResources, &gApp.mOffscreenTarget);
+    // Entities only borrow their meshes, so they go before the meshes are released
+    gApp.mWorld.Clear();
+    MeshDelete(&gApp.mResources, &gQuadMesh);
+    SceneDelete(&gApp.mScene, &gApp.mResources);
+    // Delete our graphics pipelines
+    gApp.mShaderPermutations.DeleteAll();
+    gApp.mGraphicsPipelineShaderProgram = 0;
+    gApp.mDepthPermutations.DeleteAll();
+    gApp.mDepthPrePassProgram = 0;
+    gApp.mShadowPermutations.DeleteAll();
+    gApp.mShadowProgram = 0;
+    gApp.mDeferredLightingPermutations.DeleteAll();
+    gApp.mDeferredLightingProgram = 0;
+    gApp.mUpscalePermutations.DeleteAll();
+    gApp.mUpscaleProgram = 0;
+    gApp.mBillboardPermutations.DeleteAll();
+    gApp.mCompositePermutations.DeleteAll();
+    gApp.mTransparentPrograms = TransparentPrograms{};
+    gApp.mResources.Shutdown();
+    gApp.mShaderWatcher.Stop();
 
-    SDL_Quit();
+    if (gApp.mHeadless) {
+        HeadlessContextDelete(&gApp.mHeadlessContext);
+    } else {
+        SDL_GL_DeleteContext(gApp.mOpenGLContext);
+        gApp.mOpenGLContext = nullptr;
+        SDL_DestroyWindow(gApp.mGraphicsAppWindow);
+        gApp.mGraphicsAppWindow = nullptr;
+        SDL_Quit();
+    }
+
+    // Everything we made is gone by now, so whatever is left was leaked
+    AllocPrintLeakReport();
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+    if (!ParseArguments(&gApp, argc, argv)) {
+        return EXIT_FAILURE;
+    }
+
+    // Worker threads for draw recording, plus one command list per thread
+    const int hardwareThreads = static_cast<int>(std::thread::hardware_concurrency());
+    const int workerThreads = gApp.mWorkerThreads >= 0 ? gApp.mWorkerThreads : std::max(hardwareThreads - 1, 0);
+    gApp.mJobSystem.Start(static_cast<size_t>(workerThreads));
+    gApp.mCommandLists.resize(gApp.mJobSystem.ThreadCount());
+    gApp.mFrameArena.Initialize(gApp.mJobSystem.ThreadCount());
+    SetActiveFrameArena(&gApp.mFrameArena);
+
     // 1. Set up the graphics program
-    InitializeProgram(&gApp);
-    // Set up our camera
+    if (gApp.mHeadless) {
+        if (!HeadlessContextCreate(&gApp.mHeadlessContext)) {
+            return EXIT_FAILURE;
+        }
+        InitParallelShaderCompile(HeadlessGetProcAddress);
+        gApp.mDepthMode = InitDepthMode(HeadlessGetProcAddress);
+        GetOpenGLVersionInfo();
+    } else {
+        InitializeProgram(&gApp);
+    }
+    std::println("Depth: {}", DepthModeName(gApp.mDepthMode));
+    std::println("Renderer: {}", RendererKindName(gApp.mRenderer));
+    if (gApp.mDynamicResolution.mEnabled) {
+        const DynamicResolution& resolution = gApp.mDynamicResolution;
+        std::println("Dynamic resolution: {:.2f} ms, scale {:.2f} to {:.2f}", resolution.mTargetFrameTimeMs,
+                     resolution.mMinScale, resolution.mMaxScale);
+    }
+
+    // Set up our camera, with no far plane: depth precision holds up with reverse-Z,
+    // and culling keeps what is out of view off the GPU
     const float aspect = (float)gApp.mScreenWidth / (float)gApp.mScreenHeight;
     gApp.mCamera.SetProjectionMatrix(glm::radians(45.0f),
                                      aspect,
-                                     0.1f,
-                                     10.0f
+                                     kNearPlane,
+                                     std::numeric_limits<float>::infinity(),
+                                     gApp.mDepthMode
     );
 
     // 2. Setup our geometry
-    MeshCreate(&gMesh1);
-    gMesh1.mTransform.x = 0.0f;
-    gMesh1.mTransform.y = 0.0f;
-    gMesh1.mTransform.z = -2.0f;
+    gQuadMesh = MeshCreate(&gApp.mResources);
 
-    MeshCreate(&gMesh2);
-    gMesh2.mTransform.x = 2.0f;
-    gMesh2.mTransform.y = 0.1f;
-    gMesh2.mTransform.z = -4.0f;
+    // One slot per frame that can be in flight, plus the one being written
+    constexpr size_t driverFramesInFlight = 3;
+    const int maxFramesInFlight = gApp.mLatencyLimiter.MaxFramesInFlight();
+    const size_t uniformSlots = (maxFramesInFlight > 0 ? static_cast<size_t>(maxFramesInFlight) : driverFramesInFlight) + 1;
+    if (!FrameUniformBufferCreate(&gApp.mResources, &gApp.mFrameUniforms, uniformSlots) ||
+        !TransparentPassCreate(&gApp.mTransparentPass) ||
+        !ClusteredLightingCreate(&gApp.mClusteredLighting) ||
+        !DeferredLightingCreate(&gApp.mDeferredLighting) ||
+        !DynamicResolutionCreate(&gApp.mDynamicResolution)) {
+        return EXIT_FAILURE;
+    }
+    if (gApp.mShadowResolution > 0) {
+        if (!CascadedShadowsCreate(&gApp.mResources, &gApp.mShadows, gApp.mShadowResolution, gApp.mDepthMode)) {
+            return EXIT_FAILURE;
+        }
+        // From above and behind the camera, so nearer objects shadow the ones behind them
+        gApp.mWorld.Create(DirectionalLight{glm::normalize(glm::vec3(0.4f, -0.5f, -1.0f)), glm::vec3(0.9f)});
+    }
+
+    // The arrow keys move the near quad
+    const LocalTransform playerTransform{Transform{0.0f, 0.0f, -2.0f}};
+    gApp.mWorld.Create(playerTransform,
+                       PreviousTransform{playerTransform.mPosition, playerTransform.mRotate},
+                       WorldMatrix{MakeModelMatrix(playerTransform)},
+                       MeshMakeInstance(gApp.mResources, gQuadMesh, SHADER_FEATURE_NONE),
+                       PlayerControlled{});
+
+    // The farther quad fades into the background
+    const LocalTransform fogTransform{Transform{2.0f, 0.1f, -4.0f}};
+    gApp.mWorld.Create(fogTransform,
+                       WorldMatrix{MakeModelMatrix(fogTransform)},
+                       MeshMakeInstance(gApp.mResources, gQuadMesh, SHADER_FEATURE_FOG));
+
+    // Optional stress scene (--scene N, --particles N, --lights N)
+    if (gApp.mSceneConfig.mObjectCount > 0 || gApp.mSceneConfig.mParticleCount > 0 ||
+        gApp.mSceneConfig.mLightCount > 0) {
+        SceneGenerate(&gApp.mScene, &gApp.mWorld, &gApp.mResources, gApp.mSceneConfig);
+    }
 
     // 3. Create our graphics pipel ine
     //   - At a minimum, this means the vertex and fragment shader
     CreateGraphicsPipeline();
 
     // 3.5 Attach a pipeline to each mesh
-    MeshSetPipeline(&gMesh1, gApp.mGraphicsPipelineShaderProgram);
-    MeshSetPipeline(&gMesh2, gApp.mGraphicsPipelineShaderProgram);
+    AssignMeshPipelines();
 
     // 4. Call the main application loop
-    MainLoop();
+    bool succeeded = true;
+    if (gApp.mHeadless) {
+        succeeded = HeadlessLoop();
+    } else {
+        MainLoop();
+    }
 
     // 5. Call the cleanup function upon termination
     CleanUp();
-    return 0;
+    return succeeded ? 0 : EXIT_FAILURE;
 }
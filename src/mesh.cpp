@@ -4,34 +4,34 @@
 
 #include "mesh.h"
 
+#include <cmath>
 #include <iostream>
 #include <print>
+#include <span>
+#include <vector>
 #include <SDL2/SDL.h>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "alloc_tracker.h"
 #include "app.h"
 #include "camera.h"
+#include "clustered_lighting.h"
+#include "frame_arena.h"
+#include "frame_uniforms.h"
 #include "mesh3d.h"
+#include "profiler.h"
+#include "shadows.h"
 
-/**
- * Attach a graphics pipeline to the mesh
- */
-
-void MeshSetPipeline(Mesh3D* mesh, GLuint pipeline) {
-    mesh->mPipeline = pipeline;
-}
-
-
-void MeshCreate(Mesh3D* mesh) {
+MeshHandle MeshCreate(GpuResources* resources) {
     // Geometry Data
     // Here we are going to store x, y, and z position attributes within vertexPositions
     // for the data. For now, this information is just stored in the CPU, and we are going
     // to store this data on the GPU shortly, in a call to glBufferData which will store this
     // information into a vertex buffer object (VBO).
     // Vertices on the CPU
-    const std::vector<GLfloat> vertexData{
+    const GLfloat vertexData[]{
         // 0 - Vertex
         -0.5f, -0.5f, 0.0f, // Left vertex position
         1.0f, 0.0f, 0.0f, // color
@@ -45,57 +45,125 @@ void MeshCreate(Mesh3D* mesh) {
         0.5f, 0.5f, 0.0f, // Top right vertex position
         0.0f, 0.0f, 1.0f, // color
     };
+    // Front faces, then the same triangles wound the other way, so the card still
+    // shows from behind with back-face culling on
+    const GLuint indexBufferData[]{2, 0, 1, 3, 2, 1,
+                                   1, 0, 2, 1, 2, 3};
 
+    return MeshCreate(resources, vertexData, indexBufferData);
+}
+
+/**
+ * Create a flat, regular polygon with the given number of sides, facing +z and -z.
+ * Used to give generated scenes some variety in geometry.
+ */
+MeshHandle MeshCreatePolygon(GpuResources* resources, const int sides) {
+    // Only needed until the upload, so build it in frame scratch memory
+    ArenaVector<GLfloat> vertexData = MakeFrameVector<GLfloat>((sides + 1) * 6);
+    ArenaVector<GLuint> indexBufferData = MakeFrameVector<GLuint>(sides * 6);
+
+    // Center vertex, then one vertex per corner, drawn as a fan of triangles
+    vertexData.insert(vertexData.end(), {0.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f});
+    for (int i = 0; i < sides; ++i) {
+        const float angle = glm::radians(360.0f * static_cast<float>(i) / static_cast<float>(sides));
+        const float hue = static_cast<float>(i) / static_cast<float>(sides);
+        vertexData.insert(vertexData.end(), {
+            0.5f * std::cos(angle), 0.5f * std::sin(angle), 0.0f, // position
+            hue, 1.0f - hue, 0.5f // color
+        });
+        indexBufferData.insert(indexBufferData.end(), {
+            0, static_cast<GLuint>(i + 1), static_cast<GLuint>((i + 1) % sides + 1)
+        });
+    }
+    // The back, wound the other way so back-face culling keeps the side we look at
+    for (int i = 0; i < sides; ++i) {
+        indexBufferData.insert(indexBufferData.end(), {
+            0, static_cast<GLuint>((i + 1) % sides + 1), static_cast<GLuint>(i + 1)
+        });
+    }
+
+    return MeshCreate(resources, vertexData, indexBufferData);
+}
+
+/**
+ * Upload interleaved position/color vertices and triangle indices to the GPU.
+ * Returns a null handle if the buffer budget does not have room for them.
+ */
+MeshHandle MeshCreate(GpuResources* resources, std::span<const GLfloat> vertexData,
+                      std::span<const GLuint> indexBufferData) {
+    ALLOC_SCOPE("MeshCreate");
+    Mesh3D mesh;
+    mesh.mIndexCount = static_cast<GLsizei>(indexBufferData.size());
+    mesh.mVertexStride = kMeshVertexStride;
+    mesh.mPositionStride = kMeshPositionStride;
+
+    // Vertex Buffer Object (VBO) creation
+    // Rather than a buffer of our own, we copy our 'vertexData' (which is in the CPU)
+    // into a range of a large vertex buffer on the GPU that other meshes share.
+    // The range starts on a whole vertex so that we can draw it with a base vertex.
+    mesh.mVertices = resources->Allocate(BufferCategory::Vertex, vertexData.size() * sizeof(GLfloat),
+                                         kMeshVertexStride, vertexData.data());
+
+    // The positions once more without the colors in between, for the depth pre-pass
+    const size_t vertexCount = vertexData.size() / 6;
+    ArenaVector<GLfloat> positionData = MakeFrameVector<GLfloat>(vertexCount * 3);
+    for (size_t vertex = 0; vertex < vertexCount; ++vertex) {
+        positionData.insert(positionData.end(), vertexData.begin() + vertex * 6, vertexData.begin() + vertex * 6 + 3);
+    }
+    mesh.mPositions = resources->Allocate(BufferCategory::Vertex, positionData.size() * sizeof(GLfloat),
+                                          kMeshPositionStride, positionData.data());
+
+    // Index Buffer Object (IBO aka EBO)
+    // The indices go in a range of a shared index buffer the same way
+    mesh.mIndices = resources->Allocate(BufferCategory::Index, indexBufferData.size() * sizeof(GLuint),
+                                        sizeof(GLuint), indexBufferData.data());
+
+    if (mesh.mVertices.IsNull() || mesh.mPositions.IsNull() || mesh.mIndices.IsNull()) {
+        std::println("Could not create a mesh of {} vertices within the buffer budget", vertexCount);
+        resources->Free(mesh.mVertices);
+        resources->Free(mesh.mPositions);
+        resources->Free(mesh.mIndices);
+        return MeshHandle{};
+    }
+    mesh.mBaseVertex = static_cast<GLint>(resources->Get(mesh.mVertices)->mOffset / kMeshVertexStride);
+    mesh.mPositionBaseVertex = static_cast<GLint>(resources->Get(mesh.mPositions)->mOffset / kMeshPositionStride);
+    mesh.mIndexOffset = resources->Get(mesh.mIndices)->mOffset;
 
     // Vertex Array Object (VAO) Setup
     // Note: We can think of the VAO as a 'wrapper around' all the Vertex Buffer Objects,
     // in the sense that it encapsulates all VBO state that we are setting up.
-    // Thus, it is also important that we glBindVertexArray (i.e. select the VAO we want
-    // to use) before our vertex buffer object operations
-    glGenVertexArrays(1, &mesh->mVertexArrayObject);
-    // We bind (i.e. select) to the Vertex Array Object (VAO) that we want to work within.
-    glBindVertexArray(mesh->mVertexArrayObject);
+    glGenVertexArrays(1, &mesh.mVertexArrayObject);
+    glGenVertexArrays(1, &mesh.mDepthVertexArrayObject);
+    MeshSetupVertexArray(*resources, mesh);
 
-    // Vertex Buffer Object (VBO) creation
-    // Create a new vertex buffer object
-    // Note: We'll see this pattern of code often in OpenGL of creating and binding to a buffer.
-    glGenBuffers(1, &mesh->mVertexBufferObject);
-    // Next we will do glBindBuffer.
-    // Bind is equivalent to 'selecting the active buffer object' that we want to work with
-    // in OpenGL.
-    glBindBuffer(GL_ARRAY_BUFFER, mesh->mVertexBufferObject);
-    // Now, in our currently bound buffer, we populate the data from our
-    // 'vertexPositions' (which is in the CPU), onto a buffer that will live on the GPU
-    glBufferData(GL_ARRAY_BUFFER, // Kind of buffer we are working with
-                 vertexData.size() * sizeof(GLfloat), // Size of data in bytes
-                 vertexData.data(), // Raw * array of data
-                 GL_STATIC_DRAW // How we intend to use the data
-    );
+    return resources->AdoptMesh(mesh);
+}
 
-    const std::vector<GLuint> indexBufferData{2, 0, 1, 3, 2, 1};
-    // Set up the Index Buffer Object (IBO aka EBO)
-    glGenBuffers(1, &mesh->mIndexBufferObject);
+/**
+ * Point the mesh's vertex arrays at the pools its geometry lives in
+ */
+void MeshSetupVertexArray(const GpuResources& resources, const Mesh3D& mesh) {
+    // We bind (i.e. select) to the Vertex Array Object (VAO) that we want to work within.
+    glBindVertexArray(mesh.mVertexArrayObject);
+
+    // Binding the index pool while the VAO is bound makes it part of the VAO
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, resources.Name(mesh.mIndices));
+    // Attribute pointers take whatever is bound to GL_ARRAY_BUFFER
+    glBindBuffer(GL_ARRAY_BUFFER, resources.Name(mesh.mVertices));
 
     // For our given Vertex Array Object, we need to tell Opengl 'how'
     // the information in our buffer will be used.
     glEnableVertexAttribArray(0);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER,
-                 mesh->mIndexBufferObject);
-    // Populate our Index Buffer (shifting data to GPU)
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-                 indexBufferData.size() * sizeof(GLuint),
-                 indexBufferData.data(),
-                 GL_STATIC_DRAW
-    );
 
     // For the specific attribute in our vertex specification, we use
     // 'glVertexAttribPointer' to figure out how we are going to move
-    // through the data.
+    // through the data. Offsets are from the start of the pool; the base
+    // vertex of each draw picks out our range.
     glVertexAttribPointer(0, // Corresponds to the enabled glEnableVertexAttribArray
                           3, // The number of components (e.g. x,y,z = 3 components)
                           GL_FLOAT, // Type
                           GL_FALSE, // Is the data normalized
-                          sizeof(GLfloat) * 6, // Stride
+                          kMeshVertexStride, // Stride
                           (void*)0 // Offset (pointer)
     );
 
@@ -105,64 +173,90 @@ void MeshCreate(Mesh3D* mesh) {
                           3,
                           GL_FLOAT,
                           GL_FALSE,
-                          sizeof(GLfloat) * 6,
+                          kMeshVertexStride,
                           (GLvoid*)(sizeof(GLfloat) * 3)
     );
 
+    // The depth pre-pass reads the same indices and the packed positions only
+    glBindVertexArray(mesh.mDepthVertexArrayObject);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, resources.Name(mesh.mIndices));
+    glBindBuffer(GL_ARRAY_BUFFER, resources.Name(mesh.mPositions));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, kMeshPositionStride, (void*)0);
+
     // Unbind our currently bound Vertex Array object
     glBindVertexArray(0);
-    // Disable any attributes we opened in our Vertex Attribute Array,
-    // as we do not want to leave them open.
-    glDisableVertexAttribArray(0);
-    glDisableVertexAttribArray(1);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 /**
- * The render function gets called once per loop.
+ * Empty sparsely used buffer pools into the others and point the meshes that moved
+ * at their new pools. Instances copied from those meshes need RefreshMeshInstances
+ * to pick up the new offsets.
  */
-void MeshDraw(App* app, const Mesh3D* mesh) {
-    if (mesh == nullptr) { return; }
+std::vector<MeshHandle> MeshCompactBuffers(GpuResources* resources) {
+    std::vector<MeshHandle> moved = resources->CompactBuffers();
+    for (const MeshHandle handle : moved) {
+        MeshSetupVertexArray(*resources, *resources->Get(handle));
+    }
+    return moved;
+}
 
-    // Set which graphics pipeline to use
-    glUseProgram(mesh->mPipeline);
+/**
+ * An object drawing this mesh with the given shader variant. Its pipeline is
+ * assigned once the variant has been compiled.
+ */
+MeshInstance MeshMakeInstance(const GpuResources& resources, const MeshHandle handle,
+                              const ShaderVariantKey shaderVariant) {
+    MeshInstance instance;
+    instance.mMesh = handle;
+    if (const Mesh3D* mesh = resources.Get(handle)) {
+        instance.mVertexArray = mesh->mVertexArrayObject;
+        instance.mIndexCount = mesh->mIndexCount;
+        instance.mBaseVertex = mesh->mBaseVertex;
+        instance.mIndexOffset = mesh->mIndexOffset;
+        instance.mDepthVertexArray = mesh->mDepthVertexArrayObject;
+        instance.mPositionBaseVertex = mesh->mPositionBaseVertex;
+    }
+    instance.mShaderVariant = shaderVariant;
+    return instance;
+}
 
+/**
+ * The render function gets called once per loop.
+ */
+void MeshDraw(App* app, const MeshInstance& instance, const glm::mat4& model) {
+    PROFILE_FUNCTION();
 
-    // Model transformation by translating our object into world space
-    glm::mat4 model = glm::translate(glm::mat4(1.0f),
-                                     glm::vec3(mesh->mTransform.x, mesh->mTransform.y, mesh->mTransform.z));
-    model = glm::rotate(model, glm::radians(mesh->m_uRotate), glm::vec3(0.0f, 1.0f, 0.0f));
-    // Update the model matrix by applying a rotation after our translation
-    model = glm::scale(model, glm::vec3(mesh->m_uScale, mesh->m_uScale, mesh->m_uScale));
+    // Set which graphics pipeline to use
+    glUseProgram(instance.mPipeline);
 
 
     // Retrieve our location of our Model Matrix
-    GLint u_ModelMatrixLocation = FindUniformLocation(app->mGraphicsPipelineShaderProgram, "u_ModelMatrix");
+    GLint u_ModelMatrixLocation = FindUniformLocation(instance.mPipeline, "u_ModelMatrix");
     glUniformMatrix4fv(u_ModelMatrixLocation, 1, false, &model[0][0]);
 
 
-    // Camera work section
-    glm::mat4 viewMatrix = app->mCamera.GetViewMatrix();
-
-    // Retrieve our location of our Projection Matrix
-
-    GLint u_ViewMatrixLocation = FindUniformLocation(app->mGraphicsPipelineShaderProgram, "u_ViewMatrix");
-    glUniformMatrix4fv(u_ViewMatrixLocation, 1, false, &viewMatrix[0][0]);
-
-
-    // Retrieve our location of our Projection Matrix
-    glm::mat4 perspective = app->mCamera.GetProjectionMatrix();
-    GLint u_ProjectionLocation = FindUniformLocation(app->mGraphicsPipelineShaderProgram, "u_Projection");
-    glUniformMatrix4fv(u_ProjectionLocation, 1, false, &perspective[0][0]);
+    // The camera comes from the frame uniform buffer, uploaded once for all draws
+    BindFrameUniformBlock(instance.mPipeline);
+    BindClusteredLightingSamplers(instance.mPipeline);
+    BindShadowSampler(instance.mPipeline);
 
 
     // Enable our attributes
-    glBindVertexArray(mesh->mVertexArrayObject);
-
-    // Select the vertex buffer object we want to enable
-    glBindBuffer(GL_ARRAY_BUFFER, mesh->mVertexBufferObject);
+    glBindVertexArray(instance.mVertexArray);
 
     // Render data
-    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    glDrawElementsBaseVertex(GL_TRIANGLES, instance.mIndexCount, GL_UNSIGNED_INT,
+                             reinterpret_cast<const void*>(static_cast<uintptr_t>(instance.mIndexOffset)),
+                             instance.mBaseVertex);
+
+    RenderCounters& counters = app->mRenderCounters;
+    counters.mDrawCalls += 1;
+    counters.mTriangles += instance.mIndexCount / 3;
+    counters.mProgramBinds += 1;
+    counters.mVertexArrayBinds += 1;
+    counters.mUniformUploads += 1;
 
     // Stop using our current graphics pipeline
     // Note: This is not necessary if we only have one graphics pipeline
@@ -170,12 +264,12 @@ void MeshDraw(App* app, const Mesh3D* mesh) {
 }
 
 /**
- * Delete a mesh from GPU memory
+ * Drop our reference to a mesh. Its vertex array and buffers are deleted from GPU
+ * memory once no one else holds them and the GPU has finished drawing with them.
  */
-void MeshDelete(Mesh3D* mesh) {
-    // Delete our OpenGL objects
-    glDeleteBuffers(1, &mesh->mVertexBufferObject);
-    glDeleteVertexArrays(1, &mesh->mVertexBufferObject);
+void MeshDelete(GpuResources* resources, MeshHandle* handle) {
+    resources->Release(*handle);
+    *handle = MeshHandle{};
 }
 
 // Returns the location of a uniform variable after validating its existence
@@ -5,13 +5,28 @@
 #ifndef MESH_H
 #define MESH_H
 
+#include <span>
+#include <vector>
+#include <glm/glm.hpp>
 #include "mesh3d.h"
 #include "app.h"
+#include "components.h"
+#include "gpu_resources.h"
 
-void MeshSetPipeline(Mesh3D* mesh, GLuint pipeline);
-void MeshCreate(Mesh3D* mesh);
-void MeshDraw(App* app, const Mesh3D* mesh);
-void MeshDelete(Mesh3D* mesh);
+// Interleaved position and color
+constexpr GLsizei kMeshVertexStride{sizeof(GLfloat) * 6};
+// Position only, for the depth pre-pass
+constexpr GLsizei kMeshPositionStride{sizeof(GLfloat) * 3};
+
+MeshHandle MeshCreate(GpuResources* resources);
+MeshHandle MeshCreate(GpuResources* resources, std::span<const GLfloat> vertexData,
+                      std::span<const GLuint> indexBufferData);
+MeshHandle MeshCreatePolygon(GpuResources* resources, int sides);
+void MeshSetupVertexArray(const GpuResources& resources, const Mesh3D& mesh);
+std::vector<MeshHandle> MeshCompactBuffers(GpuResources* resources);
+MeshInstance MeshMakeInstance(const GpuResources& resources, MeshHandle handle, ShaderVariantKey shaderVariant);
+void MeshDraw(App* app, const MeshInstance& instance, const glm::mat4& model);
+void MeshDelete(GpuResources* resources, MeshHandle* handle);
 GLint FindUniformLocation(GLuint pipeline, const GLchar* name);
 
 
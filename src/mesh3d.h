@@ -6,9 +6,15 @@
 #define MESH3D_H
 
 #include <glad/glad.h>
-#include "transform.h"
+#include "gpu_handles.h"
 
 
+/**
+ * Geometry on the GPU. Objects that draw it are entities with a MeshInstance, so
+ * many objects can share one mesh. Meshes live in GpuResources and are referred to
+ * by MeshHandle. Their vertices and indices are ranges of pooled buffers shared
+ * with other meshes, drawn with a base vertex and an index offset.
+ */
 struct Mesh3D {
 
     // OpenGL Objects
@@ -23,21 +29,28 @@ struct Mesh3D {
     // Vertex Buffer Objects store information relating to vertices (e.g. positions, normals,
     // textures)
     // VBOs are our mechanism for arranging geometry on the GPU.
-    GLuint mVertexBufferObject{0};
+    // Ours is a range of a vertex pool, aligned to the vertex stride.
+    AllocationHandle mVertices{};
+    GLsizei mVertexStride{0};
 
     // Index Buffer Object
     // This is used to store the array of indices that we want to draw from
-    // when we do indexed drawing.
-    GLuint mIndexBufferObject{0};
-
-    // The pipeline used with this mesh
-
-    GLuint mPipeline = 0;
-
-    Transform mTransform{};
-    // Global offsets for rotations/zoom
-    float m_uRotate{0.0f};
-    float m_uScale{0.5f};
+    // when we do indexed drawing. Ours is a range of an index pool.
+    AllocationHandle mIndices{};
+    // Number of indices drawn with glDrawElementsBaseVertex
+    GLsizei mIndexCount{0};
+
+    // Where our range starts in each pool, kept up to date when compaction moves them
+    GLint mBaseVertex{0};
+    GLuint mIndexOffset{0};
+
+    // Positions again, tightly packed, for the depth pre-pass: it needs nothing else,
+    // and fetching the interleaved vertices would read twice the data. Drawn with
+    // the same indices through a vertex array of its own.
+    GLuint mDepthVertexArrayObject{0};
+    AllocationHandle mPositions{};
+    GLsizei mPositionStride{0};
+    GLint mPositionBaseVertex{0};
 
 };
 
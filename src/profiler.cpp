@@ -0,0 +1,274 @@
+//
+// CPU and GPU frame profiler with Chrome trace (chrome://tracing, Perfetto) export.
+//
+
+#include "profiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <print>
+
+namespace {
+
+// Zones per thread per capture; zones past this are dropped
+constexpr uint32_t kEventsPerThread{1u << 16};
+
+struct ProfileEvent {
+    const char* mName;
+    uint64_t mStart;
+    uint64_t mEnd;
+};
+
+/**
+ * Zones recorded by one thread. Only the owning thread writes to it; the count is
+ * published with release semantics so the exporter sees complete events.
+ */
+struct ThreadBuffer {
+    uint32_t mThreadId{0};
+    std::string mName;
+    std::unique_ptr<ProfileEvent[]> mEvents{new ProfileEvent[kEventsPerThread]};
+    std::atomic<uint32_t> mCount{0};
+};
+
+const std::chrono::steady_clock::time_point gEpoch{std::chrono::steady_clock::now()};
+std::atomic<bool> gCapturing{false};
+
+// The registry lock is only taken the first time a thread records a zone, and when
+// starting or exporting a capture. Buffers live until the program exits, so zones
+// from threads that have already finished can still be exported.
+std::mutex gRegistryMutex;
+std::vector<std::unique_ptr<ThreadBuffer>> gThreadBuffers;
+thread_local ThreadBuffer* tThreadBuffer{nullptr};
+
+// GPU zones are resolved on the thread that owns the GL context
+std::vector<ProfileEvent> gGpuEvents;
+
+ThreadBuffer* GetThreadBuffer() {
+    if (tThreadBuffer == nullptr) {
+        std::lock_guard lock(gRegistryMutex);
+        auto& buffer = gThreadBuffers.emplace_back(std::make_unique<ThreadBuffer>());
+        buffer->mThreadId = static_cast<uint32_t>(gThreadBuffers.size());
+        buffer->mName = "Thread " + std::to_string(buffer->mThreadId);
+        tThreadBuffer = buffer.get();
+    }
+    return tThreadBuffer;
+}
+
+void RecordGpuZone(const char* name, uint64_t start, uint64_t end) {
+    if (gCapturing.load(std::memory_order_relaxed) && gGpuEvents.size() < kEventsPerThread) {
+        gGpuEvents.push_back(ProfileEvent{name, start, end});
+    }
+}
+
+void WriteJsonString(std::ofstream& out, const char* text) {
+    out << '"';
+    for (const char* c = text; *c != '\0'; ++c) {
+        if (*c == '"' || *c == '\\') { out << '\\'; }
+        out << *c;
+    }
+    out << '"';
+}
+
+void WriteTraceEvent(std::ofstream& out, bool& first, const ProfileEvent& event, int pid, uint32_t tid) {
+    out << (first ? "\n" : ",\n");
+    first = false;
+    out << "{\"name\":";
+    WriteJsonString(out, event.mName);
+    // Chrome trace timestamps are in microseconds
+    std::print(out, ",\"ph\":\"X\",\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":{},\"tid\":{}}}",
+               event.mStart / 1000.0, (event.mEnd - event.mStart) / 1000.0, pid, tid);
+}
+
+void WriteThreadName(std::ofstream& out, bool& first, int pid, uint32_t tid, const std::string& name) {
+    out << (first ? "\n" : ",\n");
+    first = false;
+    out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << tid
+        << ",\"args\":{\"name\":";
+    WriteJsonString(out, name.c_str());
+    out << "}}";
+}
+
+}
+
+uint64_t ProfilerNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - gEpoch).count();
+}
+
+void ProfilerSetThreadName(const char* name) {
+    ThreadBuffer* buffer{GetThreadBuffer()};
+    std::lock_guard lock(gRegistryMutex);
+    buffer->mName = name;
+}
+
+void ProfilerBeginCapture() {
+    {
+        std::lock_guard lock(gRegistryMutex);
+        for (const auto& buffer : gThreadBuffers) {
+            buffer->mCount.store(0, std::memory_order_relaxed);
+        }
+    }
+    gGpuEvents.clear();
+    gCapturing.store(true, std::memory_order_release);
+}
+
+void ProfilerEndCapture() {
+    gCapturing.store(false, std::memory_order_release);
+}
+
+bool ProfilerIsCapturing() {
+    return gCapturing.load(std::memory_order_relaxed);
+}
+
+ProfileScope::ProfileScope(const char* name)
+    : mName(gCapturing.load(std::memory_order_relaxed) ? name : nullptr),
+      mStart(mName != nullptr ? ProfilerNow() : 0) {
+}
+
+ProfileScope::~ProfileScope() {
+    // Skip zones that started before the capture or end after it
+    if (mName == nullptr || !gCapturing.load(std::memory_order_relaxed)) { return; }
+
+    ThreadBuffer* buffer{GetThreadBuffer()};
+    const uint32_t index{buffer->mCount.load(std::memory_order_relaxed)};
+    if (index >= kEventsPerThread) { return; }
+
+    buffer->mEvents[index] = ProfileEvent{mName, mStart, ProfilerNow()};
+    buffer->mCount.store(index + 1, std::memory_order_release);
+}
+
+bool ProfilerExportChromeTrace(const std::string& fileName) {
+    std::ofstream out(fileName);
+    if (!out.is_open()) {
+        std::println("Could not write profile to {}", fileName);
+        return false;
+    }
+
+    // CPU threads go in process 0, GPU zones in process 1
+    constexpr int cpuProcess{0};
+    constexpr int gpuProcess{1};
+
+    size_t eventCount{0};
+    bool first{true};
+    out << "{\"traceEvents\":[";
+    {
+        std::lock_guard lock(gRegistryMutex);
+        for (const auto& buffer : gThreadBuffers) {
+            WriteThreadName(out, first, cpuProcess, buffer->mThreadId, buffer->mName);
+            const uint32_t count{buffer->mCount.load(std::memory_order_acquire)};
+            for (uint32_t i = 0; i < count; ++i) {
+                WriteTraceEvent(out, first, buffer->mEvents[i], cpuProcess, buffer->mThreadId);
+            }
+            eventCount += count;
+        }
+    }
+    WriteThreadName(out, first, gpuProcess, 0, "GPU");
+    for (const ProfileEvent& event : gGpuEvents) {
+        WriteTraceEvent(out, first, event, gpuProcess, 0);
+    }
+    eventCount += gGpuEvents.size();
+    out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    std::println("Wrote {} profile zones to {}", eventCount, fileName);
+    return true;
+}
+
+void GpuProfiler::Initialize() {
+    for (FrameQueries& frame : mFrames) {
+        glGenQueries(static_cast<GLsizei>(frame.mQueries.size()), frame.mQueries.data());
+    }
+    mFrameIndex = 0;
+    mInitialized = true;
+}
+
+void GpuProfiler::Shutdown() {
+    if (!mInitialized) { return; }
+    for (FrameQueries& frame : mFrames) {
+        glDeleteQueries(static_cast<GLsizei>(frame.mQueries.size()), frame.mQueries.data());
+        frame = FrameQueries{};
+    }
+    mInitialized = false;
+}
+
+void GpuProfiler::BeginFrame() {
+    if (!mInitialized) { return; }
+
+    // This slot was last used kFramesInFlight frames ago, so its results should be in
+    FrameQueries& frame{mFrames[mFrameIndex % kFramesInFlight]};
+    if (frame.mSubmitted) {
+        ResolveFrame(frame);
+    }
+
+    frame.mZoneCount = 0;
+    frame.mWorkZone = -1;
+    frame.mSubmitted = false;
+    frame.mCpuStart = ProfilerNow();
+    glGetInteger64v(GL_TIMESTAMP, &frame.mGpuStart);
+    frame.mFrameZone = BeginZone("GPU Frame");
+}
+
+void GpuProfiler::EndFrame() {
+    if (!mInitialized) { return; }
+
+    FrameQueries& frame{mFrames[mFrameIndex % kFramesInFlight]};
+    EndZone(frame.mFrameZone);
+    frame.mSubmitted = true;
+    ++mFrameIndex;
+}
+
+int GpuProfiler::BeginZone(const char* name) {
+    if (!mInitialized) { return -1; }
+
+    FrameQueries& frame{mFrames[mFrameIndex % kFramesInFlight]};
+    if (frame.mZoneCount >= kMaxZonesPerFrame) { return -1; }
+
+    const int zone{frame.mZoneCount++};
+    frame.mNames[zone] = name;
+    glQueryCounter(frame.mQueries[zone * 2], GL_TIMESTAMP);
+    return zone;
+}
+
+void GpuProfiler::SetWorkZone(const int zone) {
+    if (zone < 0) { return; }
+    mFrames[mFrameIndex % kFramesInFlight].mWorkZone = zone;
+}
+
+void GpuProfiler::EndZone(int zone) {
+    if (zone < 0) { return; }
+
+    FrameQueries& frame{mFrames[mFrameIndex % kFramesInFlight]};
+    glQueryCounter(frame.mQueries[zone * 2 + 1], GL_TIMESTAMP);
+}
+
+void GpuProfiler::ResolveFrame(FrameQueries& frame) {
+    // The frame zone ends last; if it is not available yet, drop this frame rather
+    // than wait for the GPU
+    GLuint available{GL_FALSE};
+    glGetQueryObjectuiv(frame.mQueries[frame.mFrameZone * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available == GL_FALSE) { return; }
+
+    for (int zone = 0; zone < frame.mZoneCount; ++zone) {
+        GLuint64 begin{0};
+        GLuint64 end{0};
+        glGetQueryObjectui64v(frame.mQueries[zone * 2], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(frame.mQueries[zone * 2 + 1], GL_QUERY_RESULT, &end);
+
+        if (zone == frame.mFrameZone) {
+            mLastFrameTimeMs = (end - begin) / 1.0e6;
+            mHasResults = true;
+        }
+        if (zone == frame.mWorkZone) {
+            mLastWorkTimeMs = (end - begin) / 1.0e6;
+            ++mWorkTimeSamples;
+        }
+
+        // Place the zone on the CPU timeline using the clocks sampled at frame start
+        const int64_t offset{static_cast<int64_t>(frame.mCpuStart) - frame.mGpuStart};
+        RecordGpuZone(frame.mNames[zone],
+                      static_cast<uint64_t>(static_cast<int64_t>(begin) + offset),
+                      static_cast<uint64_t>(static_cast<int64_t>(end) + offset));
+    }
+}
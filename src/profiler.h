@@ -0,0 +1,135 @@
+//
+// CPU and GPU frame profiler with Chrome trace (chrome://tracing, Perfetto) export.
+//
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <glad/glad.h>
+
+
+// CPU zones
+// Every thread records into its own buffer, so recording a zone never takes a lock.
+// Zones are only recorded while a capture is running; otherwise a scope costs one
+// atomic load.
+
+void ProfilerSetThreadName(const char* name);
+void ProfilerBeginCapture();
+void ProfilerEndCapture();
+bool ProfilerIsCapturing();
+// Nanoseconds since the profiler started, shared by all threads
+uint64_t ProfilerNow();
+
+// Writes everything recorded during the last capture as Chrome trace JSON
+bool ProfilerExportChromeTrace(const std::string& fileName);
+
+/**
+ * Records the time between its construction and destruction as a named zone.
+ * The name must outlive the capture (string literals are the intended use).
+ */
+class ProfileScope {
+public:
+    explicit ProfileScope(const char* name);
+    ~ProfileScope();
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* mName;
+    uint64_t mStart;
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__){name}
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
+
+
+// GPU zones
+// Timestamp queries are written into a ring of kFramesInFlight frames and only read
+// back once a frame has come around again, by which point the GPU is done with it and
+// reading the results does not stall.
+
+class GpuProfiler {
+public:
+    static constexpr int kFramesInFlight{4};
+    static constexpr int kMaxZonesPerFrame{64};
+
+    void Initialize();
+    void Shutdown();
+
+    void BeginFrame();
+    void EndFrame();
+
+    // Returns a zone index to pass to EndZone, or -1 if the frame is out of zones
+    int BeginZone(const char* name);
+    void EndZone(int zone);
+
+    // GPU time of the most recent frame whose results have come back, in milliseconds
+    double LastFrameTimeMs() const { return mLastFrameTimeMs; }
+    bool HasResults() const { return mHasResults; }
+
+    /**
+     * Marks a zone of the current frame as its GPU work. The frame zone opens before the
+     * CPU has done anything, so it also counts the GPU waiting on input, simulation and
+     * recording; the work zone should only span the commands themselves.
+     */
+    void SetWorkZone(int zone);
+    // GPU time of the work zone of the most recent frame whose results have come back
+    double LastWorkTimeMs() const { return mLastWorkTimeMs; }
+    // Goes up by one with every new LastWorkTimeMs; frames dropped by the readback do not count
+    uint64_t WorkTimeSamples() const { return mWorkTimeSamples; }
+
+    bool IsInitialized() const { return mInitialized; }
+
+private:
+    struct FrameQueries {
+        std::array<GLuint, kMaxZonesPerFrame * 2> mQueries{};
+        std::array<const char*, kMaxZonesPerFrame> mNames{};
+        int mZoneCount{0};
+        int mFrameZone{-1};
+        int mWorkZone{-1};
+        bool mSubmitted{false};
+        // CPU and GPU clocks sampled together when the frame began
+        uint64_t mCpuStart{0};
+        GLint64 mGpuStart{0};
+    };
+
+    void ResolveFrame(FrameQueries& frame);
+
+    std::array<FrameQueries, kFramesInFlight> mFrames{};
+    uint64_t mFrameIndex{0};
+    bool mInitialized{false};
+    bool mHasResults{false};
+    double mLastFrameTimeMs{0.0};
+    double mLastWorkTimeMs{0.0};
+    uint64_t mWorkTimeSamples{0};
+};
+
+/**
+ * Measures the GPU time of the commands issued inside its scope.
+ */
+class GpuProfileScope {
+public:
+    GpuProfileScope(GpuProfiler& profiler, const char* name)
+        : mProfiler(profiler), mZone(profiler.BeginZone(name)) {}
+    ~GpuProfileScope() { mProfiler.EndZone(mZone); }
+
+    GpuProfileScope(const GpuProfileScope&) = delete;
+    GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+    GpuProfiler& mProfiler;
+    int mZone;
+};
+
+#define GPU_PROFILE_SCOPE(profiler, name) \
+    GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__){profiler, name}
+
+
+#endif //PROFILER_H
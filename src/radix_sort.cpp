@@ -0,0 +1,94 @@
+//
+// Parallel least significant digit radix sort of integer keys with a payload.
+//
+
+#include "radix_sort.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "profiler.h"
+
+static constexpr int kDigitBits{8};
+static constexpr size_t kDigitCount{size_t{1} << kDigitBits};
+// Below this many keys per block, counting and scattering is cheaper than scheduling
+static constexpr size_t kMinBlockSize{16 * 1024};
+
+void RadixSortPairs(std::vector<uint32_t>* keys, std::vector<uint32_t>* values, const int keyBits,
+                    RadixSortScratch* scratch, JobSystem* jobs) {
+    PROFILE_FUNCTION();
+
+    const size_t count = keys->size();
+    if (count < 2) { return; }
+
+    const size_t threads = jobs != nullptr ? jobs->ThreadCount() : 1;
+    const size_t blockCount = std::clamp<size_t>(count / kMinBlockSize, 1, threads);
+    const size_t blockSize = (count + blockCount - 1) / blockCount;
+
+    scratch->mKeys.resize(count);
+    scratch->mValues.resize(count);
+    scratch->mHistograms.resize(blockCount * kDigitCount);
+
+    // Runs function(block) for every block, on all threads when there is more than one
+    const auto forEachBlock = [&](auto&& function) {
+        if (blockCount == 1 || jobs == nullptr) {
+            for (size_t block = 0; block < blockCount; ++block) {
+                function(block);
+            }
+            return;
+        }
+        jobs->ParallelFor(blockCount, 1, [&](size_t begin, size_t end, size_t) {
+            for (size_t block = begin; block < end; ++block) {
+                function(block);
+            }
+        });
+    };
+
+    for (int shift = 0; shift < keyBits; shift += kDigitBits) {
+        const uint32_t* inKeys = keys->data();
+        const uint32_t* inValues = values->data();
+        uint32_t* outKeys = scratch->mKeys.data();
+        uint32_t* outValues = scratch->mValues.data();
+        uint32_t* histograms = scratch->mHistograms.data();
+
+        forEachBlock([&](size_t block) {
+            uint32_t* histogram = histograms + block * kDigitCount;
+            std::fill_n(histogram, kDigitCount, 0u);
+            const size_t end = std::min(count, (block + 1) * blockSize);
+            for (size_t i = block * blockSize; i < end; ++i) {
+                ++histogram[(inKeys[i] >> shift) & (kDigitCount - 1)];
+            }
+        });
+
+        // Exclusive prefix sum, digit-major so block b's keys land after block b-1's
+        // for the same digit and the sort stays stable. A digit holding every key
+        // means this pass would not move anything.
+        bool allOneDigit{false};
+        uint32_t offset{0};
+        for (size_t digit = 0; digit < kDigitCount; ++digit) {
+            uint32_t digitTotal{0};
+            for (size_t block = 0; block < blockCount; ++block) {
+                uint32_t& entry = histograms[block * kDigitCount + digit];
+                const uint32_t digitCount = entry;
+                entry = offset;
+                offset += digitCount;
+                digitTotal += digitCount;
+            }
+            allOneDigit |= digitTotal == count;
+        }
+        if (allOneDigit) { continue; }
+
+        forEachBlock([&](size_t block) {
+            uint32_t* next = histograms + block * kDigitCount;
+            const size_t end = std::min(count, (block + 1) * blockSize);
+            for (size_t i = block * blockSize; i < end; ++i) {
+                const uint32_t destination = next[(inKeys[i] >> shift) & (kDigitCount - 1)]++;
+                outKeys[destination] = inKeys[i];
+                outValues[destination] = inValues[i];
+            }
+        });
+
+        std::swap(*keys, scratch->mKeys);
+        std::swap(*values, scratch->mValues);
+    }
+}
@@ -0,0 +1,40 @@
+//
+// Parallel least significant digit radix sort of integer keys with a payload.
+//
+
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "job_system.h"
+
+
+/**
+ * Buffers the sort ping-pongs through. Keep one around between sorts: once it has
+ * grown to the largest input, sorting does not allocate.
+ */
+struct RadixSortScratch {
+    std::vector<uint32_t> mKeys;
+    std::vector<uint32_t> mValues;
+    // A 256-entry digit histogram per block
+    std::vector<uint32_t> mHistograms;
+};
+
+/**
+ * Sort keys ascending and move values along with them; equal keys keep their order.
+ * Only the low keyBits of each key are sorted on, eight bits per pass, and a pass is
+ * skipped when every key has the same digit in it, so narrow keys sort in fewer passes.
+ *
+ * Each pass counts digits per block of the input on all threads, turns the counts
+ * into an output offset for every block and digit, then scatters the blocks in
+ * parallel. The sorted result may come back in the scratch's storage: keys, values
+ * and scratch swap buffers rather than copying. jobs may be null to sort on this thread.
+ */
+void RadixSortPairs(std::vector<uint32_t>* keys, std::vector<uint32_t>* values, int keyBits,
+                    RadixSortScratch* scratch, JobSystem* jobs);
+
+
+#endif //RADIX_SORT_H
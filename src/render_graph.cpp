@@ -0,0 +1,296 @@
+//
+// The frame's render passes as a graph: passes nothing needs are culled, and transient targets share textures.
+//
+
+#include "render_graph.h"
+
+#include <algorithm>
+#include <print>
+
+static size_t TextureBytes(const RenderGraphTextureDesc& desc) {
+    return static_cast<size_t>(desc.mWidth) * static_cast<size_t>(desc.mHeight) * desc.mBytesPerPixel;
+}
+
+void RenderGraph::Reset() {
+    mResources.clear();
+    mVersions.clear();
+    mPasses.clear();
+    mReads.clear();
+    mWrites.clear();
+    mOutput = RenderGraphTexture{};
+    mCulledPasses = 0;
+    mTransientBytes = 0;
+}
+
+RenderGraphTexture RenderGraph::AddResource(const Resource& resource) {
+    mResources.push_back(resource);
+    mVersions.push_back(Version{static_cast<uint32_t>(mResources.size() - 1)});
+    return RenderGraphTexture{static_cast<uint32_t>(mVersions.size() - 1)};
+}
+
+RenderGraphTexture RenderGraph::ImportTexture(const char* name, const GLuint texture) {
+    Resource resource{};
+    resource.mName = name;
+    resource.mImported = texture;
+    return AddResource(resource);
+}
+
+RenderGraphTexture RenderGraph::ImportRenderbuffer(const char* name, const GLuint renderbuffer) {
+    Resource resource{};
+    resource.mName = name;
+    resource.mImported = renderbuffer;
+    resource.mRenderbuffer = true;
+    return AddResource(resource);
+}
+
+RenderGraph::PassIndex RenderGraph::AddPass(const char* name, const RenderGraphExecute execute, void* data) {
+    mPasses.push_back(Pass{name, execute, data});
+    return static_cast<PassIndex>(mPasses.size() - 1);
+}
+
+RenderGraphTexture RenderGraph::Create(const PassIndex pass, const char* name, const RenderGraphTextureDesc& desc) {
+    Resource resource{};
+    resource.mName = name;
+    resource.mDesc = desc;
+    resource.mTransient = true;
+    return Write(pass, AddResource(resource));
+}
+
+void RenderGraph::Read(const PassIndex pass, const RenderGraphTexture texture) {
+    if (texture.IsNull()) { return; }
+    mReads.push_back(Access{pass, texture.mVersion});
+}
+
+RenderGraphTexture RenderGraph::Write(const PassIndex pass, const RenderGraphTexture texture) {
+    if (texture.IsNull()) { return texture; }
+    mVersions.push_back(Version{mVersions[texture.mVersion].mResource, pass});
+    const RenderGraphTexture written{static_cast<uint32_t>(mVersions.size() - 1)};
+    mWrites.push_back(Access{pass, written.mVersion});
+    return written;
+}
+
+void RenderGraph::SetSideEffect(const PassIndex pass) {
+    mPasses[pass].mSideEffect = true;
+}
+
+void RenderGraph::SetOutput(const RenderGraphTexture texture) {
+    mOutput = texture;
+}
+
+/**
+ * Walk the passes back to front: a pass runs if it has side effects or writes a
+ * version something after it needs, and then everything it reads is needed too.
+ * Passes are added in the order they run, so one walk sees every reader first.
+ */
+void RenderGraph::Cull() {
+    for (Version& version : mVersions) {
+        version.mNeeded = false;
+    }
+    if (!mOutput.IsNull()) {
+        mVersions[mOutput.mVersion].mNeeded = true;
+    }
+
+    mCulledPasses = 0;
+    for (PassIndex pass = static_cast<PassIndex>(mPasses.size()); pass-- > 0;) {
+        bool needed = mPasses[pass].mSideEffect;
+        for (const Access& write : mWrites) {
+            needed = needed || (write.mPass == pass && mVersions[write.mVersion].mNeeded);
+        }
+        mPasses[pass].mCulled = !needed;
+        if (!needed) {
+            ++mCulledPasses;
+            continue;
+        }
+        for (const Access& read : mReads) {
+            if (read.mPass == pass) {
+                mVersions[read.mVersion].mNeeded = true;
+            }
+        }
+    }
+}
+
+uint32_t RenderGraph::AcquirePooledTexture(GpuResources* resources, const RenderGraphTextureDesc& desc) {
+    for (uint32_t i = 0; i < mPool.size(); ++i) {
+        PooledTexture& pooled = mPool[i];
+        if (!pooled.mInUse && pooled.mDesc == desc) {
+            pooled.mInUse = true;
+            pooled.mLastUsedFrame = mFrame;
+            return i;
+        }
+    }
+
+    PooledTexture pooled{};
+    pooled.mDesc = desc;
+    pooled.mTexture = resources->CreateTexture2D(desc.mInternalFormat, desc.mWidth, desc.mHeight, desc.mFormat,
+                                                 desc.mType, desc.mBytesPerPixel);
+    pooled.mName = resources->Name(pooled.mTexture);
+    pooled.mLastUsedFrame = mFrame;
+    pooled.mInUse = true;
+    // Passes read them with texelFetch, but they still need a filter that does not ask for mipmaps
+    glBindTexture(GL_TEXTURE_2D, pooled.mName);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    mPool.push_back(pooled);
+    return static_cast<uint32_t>(mPool.size() - 1);
+}
+
+/**
+ * Lifetimes run from the first to the last pass that touches a texture. Going through
+ * the passes in order, each transient takes a pooled texture at its first pass and
+ * hands it back after its last, for the transients that start later.
+ */
+void RenderGraph::AssignPooledTextures(GpuResources* resources) {
+    for (Resource& resource : mResources) {
+        resource.mFirstPass = kNone;
+        resource.mLastPass = kNone;
+        resource.mPooled = kNone;
+    }
+    const auto use = [&](const Access& access) {
+        if (mPasses[access.mPass].mCulled) { return; }
+        Resource& resource = mResources[mVersions[access.mVersion].mResource];
+        resource.mFirstPass = std::min(resource.mFirstPass, access.mPass);
+        resource.mLastPass = resource.mLastPass == kNone ? access.mPass : std::max(resource.mLastPass, access.mPass);
+    };
+    for (const Access& read : mReads) { use(read); }
+    for (const Access& write : mWrites) { use(write); }
+
+    for (PooledTexture& pooled : mPool) {
+        pooled.mInUse = false;
+    }
+    mTransientBytes = 0;
+    for (PassIndex pass = 0; pass < mPasses.size(); ++pass) {
+        if (mPasses[pass].mCulled) { continue; }
+        for (Resource& resource : mResources) {
+            if (resource.mTransient && resource.mFirstPass == pass) {
+                resource.mPooled = AcquirePooledTexture(resources, resource.mDesc);
+                mTransientBytes += TextureBytes(resource.mDesc);
+            }
+        }
+        for (const Resource& resource : mResources) {
+            if (resource.mPooled != kNone && resource.mLastPass == pass) {
+                mPool[resource.mPooled].mInUse = false;
+            }
+        }
+    }
+}
+
+void RenderGraph::DeleteFramebuffersUsing(const GLuint texture) {
+    std::erase_if(mFramebuffers, [&](const CachedFramebuffer& cached) {
+        const auto colorsEnd = cached.mColors.begin() + static_cast<std::ptrdiff_t>(cached.mColorCount);
+        const bool uses = std::find(cached.mColors.begin(), colorsEnd, texture) != colorsEnd ||
+                          (!cached.mDepthRenderbuffer && cached.mDepth == texture);
+        if (uses) {
+            glDeleteFramebuffers(1, &cached.mFramebuffer);
+        }
+        return uses;
+    });
+}
+
+void RenderGraph::ReleaseUnusedPooledTextures(GpuResources* resources) {
+    std::erase_if(mPool, [&](const PooledTexture& pooled) {
+        if (mFrame - pooled.mLastUsedFrame < kUnusedFramesBeforeRelease) { return false; }
+        DeleteFramebuffersUsing(pooled.mName);
+        resources->Release(pooled.mTexture);
+        return true;
+    });
+}
+
+void RenderGraph::Compile(GpuResources* resources) {
+    ++mFrame;
+    Cull();
+    // Before any index into the pool is handed out for this frame
+    ReleaseUnusedPooledTextures(resources);
+    AssignPooledTextures(resources);
+}
+
+void RenderGraph::Execute(GpuProfiler& profiler) {
+    for (const Pass& pass : mPasses) {
+        if (pass.mCulled) { continue; }
+        PROFILE_SCOPE(pass.mName);
+        GPU_PROFILE_SCOPE(profiler, pass.mName);
+        pass.mExecute(*this, pass.mData);
+    }
+}
+
+GLuint RenderGraph::Name(const RenderGraphTexture texture) const {
+    if (texture.IsNull()) { return 0; }
+    const Resource& resource = mResources[mVersions[texture.mVersion].mResource];
+    if (!resource.mTransient) { return resource.mImported; }
+    return resource.mPooled == kNone ? 0 : mPool[resource.mPooled].mName;
+}
+
+GLuint RenderGraph::Framebuffer(const std::initializer_list<RenderGraphTexture> colors,
+                                const RenderGraphTexture depth) {
+    CachedFramebuffer wanted{};
+    for (const RenderGraphTexture color : colors) {
+        if (wanted.mColorCount == kMaxColorAttachments) { break; }
+        wanted.mColors[wanted.mColorCount++] = Name(color);
+    }
+    if (!depth.IsNull()) {
+        wanted.mDepth = Name(depth);
+        wanted.mDepthRenderbuffer = mResources[mVersions[depth.mVersion].mResource].mRenderbuffer;
+    }
+
+    for (const CachedFramebuffer& cached : mFramebuffers) {
+        if (cached.mColors == wanted.mColors && cached.mColorCount == wanted.mColorCount &&
+            cached.mDepth == wanted.mDepth && cached.mDepthRenderbuffer == wanted.mDepthRenderbuffer) {
+            glBindFramebuffer(GL_FRAMEBUFFER, cached.mFramebuffer);
+            return cached.mFramebuffer;
+        }
+    }
+
+    glGenFramebuffers(1, &wanted.mFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, wanted.mFramebuffer);
+    std::array<GLenum, kMaxColorAttachments> drawBuffers{};
+    for (size_t i = 0; i < wanted.mColorCount; ++i) {
+        drawBuffers[i] = GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(i);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, drawBuffers[i], GL_TEXTURE_2D, wanted.mColors[i], 0);
+    }
+    glDrawBuffers(static_cast<GLsizei>(wanted.mColorCount), drawBuffers.data());
+    if (wanted.mDepth != 0) {
+        if (wanted.mDepthRenderbuffer) {
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, wanted.mDepth);
+        } else {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, wanted.mDepth, 0);
+        }
+    }
+
+    const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::println("Render graph framebuffer is incomplete: {:#x}", status);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &wanted.mFramebuffer);
+        return 0;
+    }
+    mFramebuffers.push_back(wanted);
+    return wanted.mFramebuffer;
+}
+
+void RenderGraph::Release(GpuResources* resources) {
+    for (const CachedFramebuffer& cached : mFramebuffers) {
+        glDeleteFramebuffers(1, &cached.mFramebuffer);
+    }
+    mFramebuffers.clear();
+    for (const PooledTexture& pooled : mPool) {
+        resources->Release(pooled.mTexture);
+    }
+    mPool.clear();
+    Reset();
+}
+
+size_t RenderGraph::PooledBytes() const {
+    size_t bytes = 0;
+    for (const PooledTexture& pooled : mPool) {
+        bytes += TextureBytes(pooled.mDesc);
+    }
+    return bytes;
+}
+
+void RenderGraph::PrintReport() const {
+    constexpr double mebibyte = 1024.0 * 1024.0;
+    std::println("Render graph: {} passes, {} culled; transient targets {:.2f} MiB in {} textures, "
+                 "{:.2f} MiB unshared; {} framebuffers",
+                 mPasses.size(), mCulledPasses, static_cast<double>(PooledBytes()) / mebibyte, mPool.size(),
+                 static_cast<double>(mTransientBytes) / mebibyte, mFramebuffers.size());
+}
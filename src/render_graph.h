@@ -0,0 +1,191 @@
+//
+// The frame's render passes as a graph: passes nothing needs are culled, and transient targets share textures.
+//
+
+#ifndef RENDER_GRAPH_H
+#define RENDER_GRAPH_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+#include <glad/glad.h>
+
+#include "gpu_resources.h"
+#include "profiler.h"
+
+
+// Format and size of a transient texture; two of them can share a texture only if these match
+struct RenderGraphTextureDesc {
+    GLenum mInternalFormat{GL_RGBA8};
+    GLenum mFormat{GL_RGBA};
+    GLenum mType{GL_UNSIGNED_BYTE};
+    size_t mBytesPerPixel{4};
+    int mWidth{0};
+    int mHeight{0};
+
+    bool operator==(const RenderGraphTextureDesc&) const = default;
+};
+
+/**
+ * One version of a texture in the graph. Every write makes a new version, so a pass
+ * that reads a version depends on the pass that wrote it and nothing later.
+ */
+struct RenderGraphTexture {
+    uint32_t mVersion{UINT32_MAX};
+
+    bool IsNull() const { return mVersion == UINT32_MAX; }
+};
+
+class RenderGraph;
+
+// What a pass does once the graph has decided it runs; data is what it was added with
+using RenderGraphExecute = void (*)(RenderGraph& graph, void* data);
+
+/**
+ * Built anew every frame: passes are added in the order they should run, each saying
+ * which textures it reads and writes. Compile then walks back from the output and the
+ * passes with side effects, culls every pass none of them depend on, and works out
+ * when each transient texture is first and last used. Transient textures come from a
+ * pool kept between frames; one whose last use is over goes back to the pool, and a
+ * later transient with the same format and size gets it, so targets whose lifetimes do
+ * not overlap share memory. OpenGL 4.1 cannot put two textures of different formats in
+ * the same memory, so only identical ones alias.
+ *
+ * OpenGL orders a pass that samples a texture after the pass that rendered into it on
+ * its own, so there are no barriers to issue; what the graph rules out is a pass
+ * running before what it reads has been written.
+ *
+ * Storage is kept between frames too, so a steady frame does not allocate.
+ */
+class RenderGraph {
+public:
+    using PassIndex = uint32_t;
+
+    RenderGraph() = default;
+    RenderGraph(const RenderGraph&) = delete;
+    RenderGraph& operator=(const RenderGraph&) = delete;
+
+    // Forgets the last frame's passes; its transient textures stay in the pool
+    void Reset();
+
+    // A texture or renderbuffer the graph does not own, like the scene target
+    RenderGraphTexture ImportTexture(const char* name, GLuint texture);
+    RenderGraphTexture ImportRenderbuffer(const char* name, GLuint renderbuffer);
+
+    // name must outlive the frame; it is also the pass's profiler zone
+    PassIndex AddPass(const char* name, RenderGraphExecute execute, void* data = nullptr);
+    // A texture that only lives this frame, first written by pass; undefined until then
+    RenderGraphTexture Create(PassIndex pass, const char* name, const RenderGraphTextureDesc& desc);
+    void Read(PassIndex pass, RenderGraphTexture texture);
+    // Returns the version pass leaves behind. A pass that keeps what was there, like
+    // one blending on top, reads the texture as well.
+    RenderGraphTexture Write(PassIndex pass, RenderGraphTexture texture);
+    // Never culled, e.g. a pass that draws to the window
+    void SetSideEffect(PassIndex pass);
+    // What the frame is for; passes it does not depend on are culled
+    void SetOutput(RenderGraphTexture texture);
+
+    // Cull, and give every transient texture of the passes left a texture from the pool
+    void Compile(GpuResources* resources);
+    // Run the passes that were not culled, each in its own CPU and GPU profiler zone
+    void Execute(GpuProfiler& profiler);
+
+    // The GL texture (or renderbuffer, if imported as one) behind a version, once compiled
+    GLuint Name(RenderGraphTexture texture) const;
+    /**
+     * A framebuffer with these attachments, kept for as long as its textures are.
+     * Draws go to the colors in order. Leaves it bound; 0 if it is incomplete.
+     */
+    GLuint Framebuffer(std::initializer_list<RenderGraphTexture> colors, RenderGraphTexture depth);
+
+    // Deletes the pool and every framebuffer
+    void Release(GpuResources* resources);
+
+    size_t PassCount() const { return mPasses.size(); }
+    size_t CulledPassCount() const { return mCulledPasses; }
+    // What the pool holds, and what this frame's transients would take without sharing
+    size_t PooledBytes() const;
+    size_t TransientBytes() const { return mTransientBytes; }
+    void PrintReport() const;
+
+private:
+    static constexpr uint32_t kNone{UINT32_MAX};
+    static constexpr size_t kMaxColorAttachments{4};
+    // Pooled textures no frame has used for this long are deleted, e.g. after a resize
+    static constexpr uint64_t kUnusedFramesBeforeRelease{8};
+
+    struct Resource {
+        const char* mName{nullptr};
+        RenderGraphTextureDesc mDesc{};
+        bool mTransient{false};
+        // GL name of an imported texture or renderbuffer
+        GLuint mImported{0};
+        bool mRenderbuffer{false};
+        // Passes of the first and last use, and the pooled texture it was given
+        PassIndex mFirstPass{kNone};
+        PassIndex mLastPass{kNone};
+        uint32_t mPooled{kNone};
+    };
+
+    struct Version {
+        uint32_t mResource{kNone};
+        // kNone for the version a texture starts out as
+        PassIndex mWriter{kNone};
+        bool mNeeded{false};
+    };
+
+    struct Pass {
+        const char* mName{nullptr};
+        RenderGraphExecute mExecute{nullptr};
+        void* mData{nullptr};
+        bool mSideEffect{false};
+        bool mCulled{false};
+    };
+
+    struct Access {
+        PassIndex mPass{kNone};
+        uint32_t mVersion{kNone};
+    };
+
+    struct PooledTexture {
+        RenderGraphTextureDesc mDesc{};
+        TextureHandle mTexture{};
+        GLuint mName{0};
+        uint64_t mLastUsedFrame{0};
+        // Held by a transient whose lifetime has not ended yet
+        bool mInUse{false};
+    };
+
+    struct CachedFramebuffer {
+        GLuint mFramebuffer{0};
+        std::array<GLuint, kMaxColorAttachments> mColors{};
+        size_t mColorCount{0};
+        GLuint mDepth{0};
+        bool mDepthRenderbuffer{false};
+    };
+
+    RenderGraphTexture AddResource(const Resource& resource);
+    void Cull();
+    void AssignPooledTextures(GpuResources* resources);
+    uint32_t AcquirePooledTexture(GpuResources* resources, const RenderGraphTextureDesc& desc);
+    void ReleaseUnusedPooledTextures(GpuResources* resources);
+    void DeleteFramebuffersUsing(GLuint texture);
+
+    std::vector<Resource> mResources;
+    std::vector<Version> mVersions;
+    std::vector<Pass> mPasses;
+    std::vector<Access> mReads;
+    std::vector<Access> mWrites;
+    RenderGraphTexture mOutput{};
+
+    std::vector<PooledTexture> mPool;
+    std::vector<CachedFramebuffer> mFramebuffers;
+    uint64_t mFrame{0};
+    size_t mCulledPasses{0};
+    size_t mTransientBytes{0};
+};
+
+
+#endif //RENDER_GRAPH_H
@@ -0,0 +1,72 @@
+//
+// Offscreen framebuffer with a color texture and a depth attachment.
+//
+
+#include "render_target.h"
+
+#include <print>
+
+#include "depth_state.h"
+
+/**
+ * Create a framebuffer we can render into instead of the window
+ */
+bool RenderTargetCreate(GpuResources* resources, RenderTarget* target, const int width, const int height) {
+    target->mWidth = width;
+    target->mHeight = height;
+    target->mViewportWidth = width;
+    target->mViewportHeight = height;
+
+    target->mColorTexture = resources->CreateTexture2D(GL_RGBA8, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 4);
+    glBindTexture(GL_TEXTURE_2D, resources->Name(target->mColorTexture));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    target->mDepthRenderbuffer = resources->CreateRenderbuffer(kDepthFormat, width, height, 4);
+
+    glGenFramebuffers(1, &target->mFramebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->mFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                           resources->Name(target->mColorTexture), 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,
+                              resources->Name(target->mDepthRenderbuffer));
+
+    const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::println("Framebuffer is incomplete: {:#x}", status);
+        RenderTargetDelete(resources, target);
+        return false;
+    }
+    return true;
+}
+
+void RenderTargetBind(const RenderTarget* target) {
+    glBindFramebuffer(GL_FRAMEBUFFER, target->mFramebuffer);
+    glViewport(0, 0, target->mViewportWidth, target->mViewportHeight);
+}
+
+/**
+ * Copy the drawn part of the color attachment to the window, scaled to width x height
+ */
+void RenderTargetBlitToScreen(const RenderTarget* target, const int width, const int height) {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, target->mFramebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    glBlitFramebuffer(0, 0, target->mViewportWidth, target->mViewportHeight, 0, 0, width, height, GL_COLOR_BUFFER_BIT,
+                      GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/**
+ * Delete the framebuffer and release its attachments, which go once the GPU is done with them
+ */
+void RenderTargetDelete(GpuResources* resources, RenderTarget* target) {
+    glDeleteFramebuffers(1, &target->mFramebuffer);
+    resources->Release(target->mDepthRenderbuffer);
+    resources->Release(target->mColorTexture);
+    *target = RenderTarget{};
+}
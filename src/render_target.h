@@ -0,0 +1,32 @@
+//
+// Offscreen framebuffer with a color texture and a depth attachment.
+//
+
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include <glad/glad.h>
+
+#include "gpu_resources.h"
+
+
+struct RenderTarget {
+    GLuint mFramebuffer{0};
+    TextureHandle mColorTexture{};
+    TextureHandle mDepthRenderbuffer{};
+    int mWidth{0};
+    int mHeight{0};
+    // The part drawn to, from the bottom-left corner: all of it, unless dynamic
+    // resolution has scaled the scene down
+    int mViewportWidth{0};
+    int mViewportHeight{0};
+};
+
+bool RenderTargetCreate(GpuResources* resources, RenderTarget* target, int width, int height);
+// Binds the framebuffer with the viewport over the drawn part
+void RenderTargetBind(const RenderTarget* target);
+void RenderTargetBlitToScreen(const RenderTarget* target, int width, int height);
+void RenderTargetDelete(GpuResources* resources, RenderTarget* target);
+
+
+#endif //RENDER_TARGET_H
@@ -0,0 +1,237 @@
+//
+// Procedural stress scenes for finding where each render path stops scaling.
+//
+
+#include "scene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <print>
+#include <random>
+#include <glm/glm.hpp>
+
+#include "alloc_tracker.h"
+#include "components.h"
+#include "mesh.h"
+
+namespace {
+
+// Matches the camera set up in main(): 45 degree vertical field of view at 4:3,
+// looking down -z from the origin. Its far plane is at infinity, so the depth range
+// below only bounds where the scene is placed, out to just short of 10.
+constexpr float kTanHalfFov{0.41421356f};
+constexpr float kAspect{4.0f / 3.0f};
+constexpr float kNearDepth{1.5f};
+constexpr float kFarDepth{9.5f};
+
+// Half extents of the view at the given distance from the camera
+glm::vec2 ViewExtents(float depth) {
+    return glm::vec2(kTanHalfFov * kAspect * depth, kTanHalfFov * depth);
+}
+
+Transform PlaceGrid(size_t index, size_t count, float* scale) {
+    // Fill the view volume with a side x side x side lattice, spreading x/y with depth
+    // so each layer covers the whole view
+    const auto side = static_cast<size_t>(std::ceil(std::cbrt(static_cast<double>(count))));
+    const size_t x = index % side;
+    const size_t y = (index / side) % side;
+    const size_t z = index / (side * side);
+
+    const float cell = 1.0f / static_cast<float>(side);
+    const float depth = kNearDepth + (kFarDepth - kNearDepth) * (static_cast<float>(z) + 0.5f) * cell;
+    const glm::vec2 extents = ViewExtents(depth);
+    *scale = std::min(0.5f, 1.6f * extents.y * cell);
+    return Transform{extents.x * ((static_cast<float>(x) + 0.5f) * cell * 2.0f - 1.0f),
+                     extents.y * ((static_cast<float>(y) + 0.5f) * cell * 2.0f - 1.0f),
+                     -depth};
+}
+
+}
+
+bool ParseSceneDistribution(const std::string& name, SceneDistribution* distribution) {
+    for (const SceneDistribution candidate : {SceneDistribution::Grid, SceneDistribution::Clustered,
+                                              SceneDistribution::Overlapping, SceneDistribution::OffScreen}) {
+        if (name == SceneDistributionName(candidate)) {
+            *distribution = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* SceneDistributionName(SceneDistribution distribution) {
+    switch (distribution) {
+        case SceneDistribution::Grid: return "grid";
+        case SceneDistribution::Clustered: return "clustered";
+        case SceneDistribution::Overlapping: return "overlapping";
+        case SceneDistribution::OffScreen: return "offscreen";
+    }
+    return "";
+}
+
+void SceneGenerate(Scene* scene, World* world, GpuResources* resources, const SceneConfig& config) {
+    ALLOC_SCOPE("SceneGenerate");
+    std::mt19937 random{config.mSeed};
+    std::uniform_real_distribution<float> unit{0.0f, 1.0f};
+    std::uniform_real_distribution<float> angle{0.0f, 360.0f};
+
+    // Prototype 0 is the quad; the others are polygons with more and more sides
+    const int variety = std::max(config.mMeshVariety, 1);
+    scene->mPrototypes.resize(variety);
+    scene->mPrototypes[0] = MeshCreate(resources);
+    for (int i = 1; i < variety; ++i) {
+        scene->mPrototypes[i] = MeshCreatePolygon(resources, i + 2);
+    }
+
+    // Clustered scenes get one clump per ~1000 objects
+    std::vector<Transform> clusterCenters;
+    if (config.mDistribution == SceneDistribution::Clustered) {
+        const size_t clusterCount = config.mObjectCount / 1000 + 1;
+        for (size_t i = 0; i < clusterCount; ++i) {
+            const float depth = kNearDepth + 1.0f + (kFarDepth - kNearDepth - 2.0f) * unit(random);
+            const glm::vec2 extents = ViewExtents(depth) * 0.8f;
+            clusterCenters.push_back(Transform{extents.x * (unit(random) * 2.0f - 1.0f),
+                                               extents.y * (unit(random) * 2.0f - 1.0f),
+                                               -depth});
+        }
+    }
+    std::normal_distribution<float> clusterSpread{0.0f, 0.3f};
+
+    // Place everything first, so the objects can be shuffled before they become entities
+    struct Placement {
+        LocalTransform mTransform;
+        MeshInstance mInstance;
+    };
+    const int pipelineCount = std::max(config.mPipelineCount, 1);
+    std::vector<Placement> placements(config.mObjectCount);
+    for (size_t i = 0; i < config.mObjectCount; ++i) {
+        const size_t prototype = i % static_cast<size_t>(variety);
+        Placement& placement = placements[i];
+        // Share the GPU buffers of the prototype
+        placement.mInstance = MeshMakeInstance(*resources, scene->mPrototypes[prototype],
+                                               MakeShaderVariantKey(SHADER_FEATURE_NONE,
+                                                                    static_cast<uint32_t>(i % pipelineCount)));
+        LocalTransform& transform = placement.mTransform;
+        transform.mRotate = angle(random);
+        transform.mScale = 0.25f;
+
+        switch (config.mDistribution) {
+            case SceneDistribution::Grid:
+                transform.mPosition = PlaceGrid(i, config.mObjectCount, &transform.mScale);
+                break;
+            case SceneDistribution::Clustered: {
+                const Transform& center = clusterCenters[i % clusterCenters.size()];
+                transform.mPosition = Transform{center.x + clusterSpread(random),
+                                                center.y + clusterSpread(random),
+                                                center.z + clusterSpread(random)};
+                transform.mScale = 0.1f;
+                break;
+            }
+            case SceneDistribution::Overlapping:
+                transform.mPosition = Transform{(unit(random) - 0.5f) * 0.2f,
+                                                (unit(random) - 0.5f) * 0.2f,
+                                                -3.0f - unit(random)};
+                transform.mScale = 1.0f;
+                break;
+            case SceneDistribution::OffScreen: {
+                const float depth = kNearDepth + (kFarDepth - kNearDepth) * unit(random);
+                const glm::vec2 extents = ViewExtents(depth);
+                float x = extents.x * (unit(random) * 2.0f - 1.0f);
+                float z = -depth;
+                if (i % 10 != 0) {
+                    // Either behind the camera or well to the side of the view
+                    if (unit(random) < 0.5f) {
+                        z = depth;
+                    } else {
+                        x = (extents.x + 1.0f + unit(random) * 5.0f) * (unit(random) < 0.5f ? -1.0f : 1.0f);
+                    }
+                }
+                transform.mPosition = Transform{x, extents.y * (unit(random) * 2.0f - 1.0f), z};
+                break;
+            }
+        }
+    }
+
+    // Shuffle so that draw order does not follow placement or pipeline, and so that
+    // taking the first objects as the dynamic ones spreads them over the scene
+    std::shuffle(placements.begin(), placements.end(), random);
+
+    scene->mObjectCount = config.mObjectCount;
+    scene->mDynamicCount = static_cast<size_t>(
+        std::clamp(config.mDynamicFraction, 0.0f, 1.0f) * static_cast<float>(config.mObjectCount));
+    for (size_t i = 0; i < placements.size(); ++i) {
+        const Placement& placement = placements[i];
+        const WorldMatrix matrix{MakeModelMatrix(placement.mTransform)};
+        if (i < scene->mDynamicCount) {
+            const PreviousTransform previous{placement.mTransform.mPosition, placement.mTransform.mRotate};
+            world->Create(placement.mTransform, previous, matrix, placement.mInstance,
+                          Spin{30.0f + 150.0f * unit(random)});
+        } else {
+            world->Create(placement.mTransform, matrix, placement.mInstance);
+        }
+    }
+
+    // Translucent particles anywhere in the view, from faint to half opaque
+    std::uniform_real_distribution<float> particleDepth{kNearDepth, kFarDepth};
+    scene->mOrderIndependentCount = static_cast<size_t>(
+        std::clamp(config.mOrderIndependentFraction, 0.0f, 1.0f) * static_cast<float>(config.mParticleCount));
+    for (size_t i = 0; i < config.mParticleCount; ++i) {
+        const float depth = particleDepth(random);
+        const glm::vec2 extents = ViewExtents(depth);
+        Billboard particle;
+        particle.mPosition = glm::vec3(extents.x * (unit(random) * 2.0f - 1.0f),
+                                       extents.y * (unit(random) * 2.0f - 1.0f),
+                                       -depth);
+        particle.mSize = 0.02f + 0.06f * unit(random);
+        particle.mColor = glm::vec4(unit(random), unit(random), 1.0f, 0.1f + 0.4f * unit(random));
+        if (i < scene->mOrderIndependentCount) {
+            world->Create(particle, OrderIndependent{});
+        } else {
+            world->Create(particle);
+        }
+    }
+    scene->mParticleCount = config.mParticleCount;
+
+    // Small lights circling through the view volume; every fourth is a spot light
+    // pointing away from the camera, at the geometry
+    for (size_t i = 0; i < config.mLightCount; ++i) {
+        const float depth = particleDepth(random);
+        const glm::vec2 extents = ViewExtents(depth);
+        LightOrbit orbit;
+        orbit.mCenter = glm::vec3(extents.x * (unit(random) * 2.0f - 1.0f),
+                                  extents.y * (unit(random) * 2.0f - 1.0f),
+                                  -depth);
+        orbit.mRadius = 0.2f + 0.8f * unit(random);
+        orbit.mRadiansPerSecond = (unit(random) < 0.5f ? -1.0f : 1.0f) * (0.2f + 1.3f * unit(random));
+        orbit.mAngle = glm::radians(angle(random));
+
+        Light light;
+        light.mRange = 0.5f + unit(random);
+        light.mPosition = orbit.mCenter +
+                          orbit.mRadius * glm::vec3(std::cos(orbit.mAngle), 0.0f, std::sin(orbit.mAngle));
+        light.mColor = glm::vec3(unit(random), unit(random), unit(random)) * 2.0f;
+        if (i % 4 == 3) {
+            light.mRange *= 2.0f;
+            light.mSpotCosOuter = std::cos(glm::radians(35.0f));
+            light.mSpotCosInner = std::cos(glm::radians(25.0f));
+        }
+        world->Create(light, orbit);
+    }
+    scene->mLightCount = config.mLightCount;
+
+    std::println("Generated {} objects ({}, {} meshes, {} pipelines, {} dynamic), {} particles ({} order-independent)"
+                 " and {} lights",
+                 config.mObjectCount, SceneDistributionName(config.mDistribution),
+                 variety, pipelineCount, scene->mDynamicCount, scene->mParticleCount,
+                 scene->mOrderIndependentCount, scene->mLightCount);
+}
+
+/**
+ * Release the prototypes. The objects only borrowed them, so clear the world first.
+ */
+void SceneDelete(Scene* scene, GpuResources* resources) {
+    for (MeshHandle& prototype : scene->mPrototypes) {
+        MeshDelete(resources, &prototype);
+    }
+    *scene = Scene{};
+}
@@ -0,0 +1,65 @@
+//
+// Procedural stress scenes for finding where each render path stops scaling.
+//
+
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ecs.h"
+#include "gpu_resources.h"
+
+
+enum class SceneDistribution {
+    Grid,        // evenly spaced through the view volume
+    Clustered,   // dense clumps with empty space in between
+    Overlapping, // everything stacked in a small region: maximum overdraw
+    OffScreen    // 90% outside the view frustum, for testing culling
+};
+
+struct SceneConfig {
+    size_t mObjectCount{0};
+    SceneDistribution mDistribution{SceneDistribution::Grid};
+    // Number of distinct geometries the objects share
+    int mMeshVariety{1};
+    // Number of distinct shader programs the objects are spread over
+    int mPipelineCount{1};
+    // Fraction of objects that move every simulation step
+    float mDynamicFraction{0.0f};
+    // Blended billboards spread through the view volume
+    size_t mParticleCount{0};
+    // Fraction of them blended order-independently instead of sorted
+    float mOrderIndependentFraction{0.0f};
+    // Colored point and spot lights circling through the view volume
+    size_t mLightCount{0};
+    uint32_t mSeed{1};
+};
+
+/**
+ * A generated scene. Its objects are entities in the world that draw one of the
+ * prototype meshes; the scene holds the only reference to each prototype.
+ * Dynamic objects spin and are interpolated; the others never move.
+ */
+struct Scene {
+    std::vector<MeshHandle> mPrototypes;
+    size_t mObjectCount{0};
+    size_t mDynamicCount{0};
+    size_t mParticleCount{0};
+    size_t mOrderIndependentCount{0};
+    size_t mLightCount{0};
+};
+
+bool ParseSceneDistribution(const std::string& name, SceneDistribution* distribution);
+const char* SceneDistributionName(SceneDistribution distribution);
+
+// Creates the prototype meshes and an entity per object, per particle and per light
+void SceneGenerate(Scene* scene, World* world, GpuResources* resources, const SceneConfig& config);
+// Releases the prototypes; the world's entities are left alone
+void SceneDelete(Scene* scene, GpuResources* resources);
+
+
+#endif //SCENE_H
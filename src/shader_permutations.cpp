@@ -0,0 +1,232 @@
+//
+// #define-driven shader variants built from one vertex/fragment source pair.
+//
+
+#include "shader_permutations.h"
+
+#include <algorithm>
+#include <print>
+
+const char* ShaderFeatureDefine(ShaderFeature feature) {
+    switch (feature) {
+        case SHADER_FEATURE_SKINNING: return "SKINNING";
+        case SHADER_FEATURE_INSTANCING: return "INSTANCING";
+        case SHADER_FEATURE_TEXTURED: return "TEXTURED";
+        case SHADER_FEATURE_FOG: return "FOG";
+        case SHADER_FEATURE_WEIGHTED_OIT: return "WEIGHTED_OIT";
+        case SHADER_FEATURE_GBUFFER: return "GBUFFER";
+        case SHADER_FEATURE_DEFERRED_LIGHTING: return "DEFERRED_LIGHTING";
+        default: return "";
+    }
+}
+
+std::string GenerateShaderVariantSource(const std::string& source, ShaderVariantKey key) {
+    std::string defines;
+    for (uint32_t bit = 0; bit < kShaderFeatureCount; ++bit) {
+        const auto feature{static_cast<ShaderFeature>(1u << bit)};
+        if (key & feature) {
+            defines += "#define ";
+            defines += ShaderFeatureDefine(feature);
+            defines += " 1\n";
+        }
+    }
+    if (const uint32_t pipelineIndex{ShaderVariantPipelineIndex(key)}; pipelineIndex != 0) {
+        defines += "#define PIPELINE_INDEX " + std::to_string(pipelineIndex) + "\n";
+    }
+    if (defines.empty()) { return source; }
+
+    // #version has to stay the first statement, so the defines go on the line after it
+    size_t insertAt{0};
+    const size_t versionAt{source.find("#version")};
+    if (versionAt != std::string::npos) {
+        const size_t lineEnd{source.find('\n', versionAt)};
+        insertAt = lineEnd == std::string::npos ? source.size() : lineEnd + 1;
+    }
+
+    std::string result;
+    result.reserve(source.size() + defines.size() + 1);
+    result.append(source, 0, insertAt);
+    if (insertAt > 0 && result.back() != '\n') { result += '\n'; }
+    result += defines;
+    result.append(source, insertAt);
+    return result;
+}
+
+ShaderPermutationManager::~ShaderPermutationManager() {
+    DeleteAll();
+}
+
+void ShaderPermutationManager::SetSources(const std::string& vertexShaderPath,
+                                          const std::string& fragmentShaderPath) {
+    mVertexShaderPath = vertexShaderPath;
+    mFragmentShaderPath = fragmentShaderPath;
+    LoadSources();
+}
+
+void ShaderPermutationManager::LoadSources() {
+    mVertexShaderSource = LoadShaderAsString(mVertexShaderPath);
+    mFragmentShaderSource = LoadShaderAsString(mFragmentShaderPath);
+}
+
+void ShaderPermutationManager::Declare(ShaderVariantKey key) {
+    if (std::find(mDeclared.begin(), mDeclared.end(), key) == mDeclared.end()) {
+        mDeclared.push_back(key);
+    }
+}
+
+/**
+ * Drops the features that neither shader mentions. Those variants would generate
+ * different text but compile to the same thing, so they can share one program.
+ */
+ShaderVariantKey ShaderPermutationManager::CanonicalKey(ShaderVariantKey key) const {
+    ShaderVariantKey canonical{key & ((1u << kShaderFeatureCount) - 1)};
+    const uint32_t pipelineIndex{ShaderVariantPipelineIndex(key)};
+    for (uint32_t bit = 0; bit < kShaderFeatureCount; ++bit) {
+        const auto feature{static_cast<ShaderFeature>(1u << bit)};
+        if (!(key & feature)) { continue; }
+
+        const char* define{ShaderFeatureDefine(feature)};
+        if (mVertexShaderSource.find(define) == std::string::npos &&
+            mFragmentShaderSource.find(define) == std::string::npos) {
+            canonical &= ~feature;
+        }
+    }
+    if (mVertexShaderSource.find("PIPELINE_INDEX") == std::string::npos &&
+        mFragmentShaderSource.find("PIPELINE_INDEX") == std::string::npos) {
+        return canonical;
+    }
+    return MakeShaderVariantKey(canonical, pipelineIndex);
+}
+
+/**
+ * Generates the source for a variant and starts compiling it, unless a program with
+ * exactly the same source is already in the table. Returns the program index.
+ */
+size_t ShaderPermutationManager::BeginVariant(VariantTable& table, ShaderVariantKey key) {
+    if (auto it = table.mVariantToProgram.find(key); it != table.mVariantToProgram.end()) {
+        return it->second;
+    }
+
+    const ShaderVariantKey canonical{CanonicalKey(key)};
+    std::string vertexSource{GenerateShaderVariantSource(mVertexShaderSource, canonical)};
+    std::string fragmentSource{GenerateShaderVariantSource(mFragmentShaderSource, canonical)};
+
+    std::string sourceKey;
+    sourceKey.reserve(vertexSource.size() + fragmentSource.size() + 1);
+    sourceKey += vertexSource;
+    sourceKey += '\0';
+    sourceKey += fragmentSource;
+
+    size_t index;
+    if (auto it = table.mSourceToProgram.find(sourceKey); it != table.mSourceToProgram.end()) {
+        index = it->second;
+    } else {
+        index = table.mPrograms.size();
+        ProgramEntry& entry{table.mPrograms.emplace_back()};
+        entry.mBuild = BeginShaderProgramBuild(vertexSource, fragmentSource);
+        table.mSourceToProgram.emplace(std::move(sourceKey), index);
+    }
+
+    table.mVariantToProgram.emplace(key, index);
+    return index;
+}
+
+void ShaderPermutationManager::Precompile() {
+    // Begin every variant first so the compiles overlap, then wait for all of them
+    for (const ShaderVariantKey key : mDeclared) {
+        BeginVariant(mTable, key);
+    }
+    for (ProgramEntry& entry : mTable.mPrograms) {
+        if (entry.mBuild.mStatus == ShaderBuildStatus::Pending) {
+            AdoptProgram(entry, FinishShaderProgramBuild(entry.mBuild));
+        }
+    }
+
+    std::println("Precompiled {} shader variants into {} programs",
+                 mTable.mVariantToProgram.size(), mTable.mPrograms.size());
+}
+
+GLuint ShaderPermutationManager::GetProgram(ShaderVariantKey key) {
+    if (auto it = mTable.mVariantToProgram.find(key); it != mTable.mVariantToProgram.end()) {
+        return mTable.mPrograms[it->second].mProgram;
+    }
+
+    ProgramEntry& entry{mTable.mPrograms[BeginVariant(mTable, key)]};
+    if (entry.mBuild.mStatus == ShaderBuildStatus::Pending) {
+        std::println("WARNING: shader variant {:#x} was not declared and is compiled mid-frame", key);
+        AdoptProgram(entry, FinishShaderProgramBuild(entry.mBuild));
+    }
+    return entry.mProgram;
+}
+
+void ShaderPermutationManager::BeginReload() {
+    // A newer edit replaces a reload that is still compiling
+    DeleteTable(mReload);
+    LoadSources();
+
+    for (const auto& [key, index] : mTable.mVariantToProgram) {
+        BeginVariant(mReload, key);
+    }
+    mReloading = true;
+}
+
+bool ShaderPermutationManager::UpdateReload() {
+    if (!mReloading) { return false; }
+
+    // Poll every build, not just up to the first pending one, so that they all get
+    // their first poll in the same frame
+    bool pending{false};
+    for (ProgramEntry& entry : mReload.mPrograms) {
+        pending |= PollShaderProgramBuild(entry.mBuild) == ShaderBuildStatus::Pending;
+    }
+    if (pending) { return false; }
+
+    bool failed{false};
+    for (ProgramEntry& entry : mReload.mPrograms) {
+        if (entry.mBuild.mStatus == ShaderBuildStatus::Failed) {
+            failed = true;
+        }
+        AdoptProgram(entry, entry.mBuild.mProgram);
+    }
+
+    mReloading = false;
+    if (failed) {
+        // Keep drawing with the previous programs until the shaders are fixed
+        std::println("{}", "Shader reload failed, keeping the previous pipelines");
+        DeleteTable(mReload);
+        return false;
+    }
+
+    DeleteTable(mTable);
+    mTable = std::move(mReload);
+    mReload = VariantTable{};
+    std::println("Reloaded {} shader programs", mTable.mPrograms.size());
+    return true;
+}
+
+void ShaderPermutationManager::AdoptProgram(ProgramEntry& entry, GLuint program) {
+    entry.mProgram = program;
+    if (mResources != nullptr && program != 0) {
+        entry.mHandle = mResources->AdoptProgram(program);
+    }
+}
+
+void ShaderPermutationManager::DeleteTable(VariantTable& table) {
+    for (ProgramEntry& entry : table.mPrograms) {
+        if (entry.mBuild.mStatus == ShaderBuildStatus::Pending) {
+            DeleteShaderProgramBuild(entry.mBuild);
+        } else if (!entry.mHandle.IsNull()) {
+            // Draws recorded this frame may still use it
+            mResources->Release(entry.mHandle);
+        } else {
+            glDeleteProgram(entry.mProgram);
+        }
+    }
+    table = VariantTable{};
+}
+
+void ShaderPermutationManager::DeleteAll() {
+    DeleteTable(mTable);
+    DeleteTable(mReload);
+    mReloading = false;
+}
@@ -0,0 +1,130 @@
+//
+// #define-driven shader variants built from one vertex/fragment source pair.
+//
+
+#ifndef SHADER_PERMUTATIONS_H
+#define SHADER_PERMUTATIONS_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <glad/glad.h>
+
+#include "gpu_resources.h"
+#include "shaders.h"
+
+
+// Each feature bit turns into a #define injected right after the #version line
+enum ShaderFeature : uint32_t {
+    SHADER_FEATURE_NONE       = 0,
+    SHADER_FEATURE_SKINNING   = 1u << 0,
+    SHADER_FEATURE_INSTANCING = 1u << 1,
+    SHADER_FEATURE_TEXTURED   = 1u << 2,
+    SHADER_FEATURE_FOG        = 1u << 3,
+    // Write weighted blended order-independent transparency targets instead of a color
+    SHADER_FEATURE_WEIGHTED_OIT = 1u << 4,
+    // Write the surface to the deferred renderer's G-buffer instead of shading it
+    SHADER_FEATURE_GBUFFER = 1u << 5,
+    // The deferred renderer's full-screen pass that shades the G-buffer
+    SHADER_FEATURE_DEFERRED_LIGHTING = 1u << 6,
+};
+
+inline constexpr uint32_t kShaderFeatureCount{7};
+
+// A variant key is the set of feature bits, plus an optional pipeline index in the
+// upper bits. The index becomes a PIPELINE_INDEX define and lets generated scenes ask
+// for several distinct programs that otherwise use the same features.
+using ShaderVariantKey = uint32_t;
+
+inline constexpr uint32_t kShaderPipelineIndexShift{16};
+
+inline ShaderVariantKey MakeShaderVariantKey(uint32_t features, uint32_t pipelineIndex) {
+    return features | (pipelineIndex << kShaderPipelineIndexShift);
+}
+
+inline uint32_t ShaderVariantPipelineIndex(ShaderVariantKey key) {
+    return key >> kShaderPipelineIndexShift;
+}
+
+// Name of the #define for a single feature bit
+const char* ShaderFeatureDefine(ShaderFeature feature);
+
+// Returns the source with a #define for every feature in key
+std::string GenerateShaderVariantSource(const std::string& source, ShaderVariantKey key);
+
+
+/**
+ * Owns every compiled variant of a vertex/fragment shader pair.
+ *
+ * Variants are declared at load time and compiled together by Precompile, so
+ * the driver can work on them in parallel and nothing has to be compiled
+ * mid-frame. Variants that end up with identical generated source (e.g. a
+ * feature the shaders never test for) share a single program object.
+ */
+class ShaderPermutationManager {
+public:
+    ShaderPermutationManager() = default;
+    ~ShaderPermutationManager();
+
+    ShaderPermutationManager(const ShaderPermutationManager&) = delete;
+    ShaderPermutationManager& operator=(const ShaderPermutationManager&) = delete;
+
+    void SetSources(const std::string& vertexShaderPath, const std::string& fragmentShaderPath);
+    // Programs are handed to resources once built, so replaced ones are deleted only
+    // after the frames still using them have finished. Without it they are deleted at once.
+    void SetResources(GpuResources* resources) { mResources = resources; }
+
+    // Add a variant to the set that Precompile builds
+    void Declare(ShaderVariantKey key);
+    // Compile all declared variants, waiting for them to finish
+    void Precompile();
+
+    // Program for a variant; compiles it on the spot (and warns) if it was not declared
+    GLuint GetProgram(ShaderVariantKey key);
+
+    // Hot reload: rebuild every known variant in the background
+    void BeginReload();
+    // Returns true on the frame the reloaded programs replace the old ones
+    bool UpdateReload();
+
+    void DeleteAll();
+
+    size_t VariantCount() const { return mTable.mVariantToProgram.size(); }
+    size_t ProgramCount() const { return mTable.mPrograms.size(); }
+
+private:
+    struct ProgramEntry {
+        GLuint mProgram{0};
+        ProgramHandle mHandle{};
+        ShaderProgramBuild mBuild;
+    };
+
+    // Tables mapping variant keys to unique programs, swapped as a whole on reload
+    struct VariantTable {
+        std::vector<ProgramEntry> mPrograms;
+        std::unordered_map<ShaderVariantKey, size_t> mVariantToProgram;
+        std::unordered_map<std::string, size_t> mSourceToProgram;
+    };
+
+    void LoadSources();
+    ShaderVariantKey CanonicalKey(ShaderVariantKey key) const;
+    size_t BeginVariant(VariantTable& table, ShaderVariantKey key);
+    void AdoptProgram(ProgramEntry& entry, GLuint program);
+    void DeleteTable(VariantTable& table);
+
+    std::string mVertexShaderPath;
+    std::string mFragmentShaderPath;
+    std::string mVertexShaderSource;
+    std::string mFragmentShaderSource;
+
+    std::vector<ShaderVariantKey> mDeclared;
+    GpuResources* mResources{nullptr};
+
+    VariantTable mTable;
+    VariantTable mReload;
+    bool mReloading{false};
+};
+
+
+#endif //SHADER_PERMUTATIONS_H
@@ -0,0 +1,110 @@
+//
+// Watches the shader directory so that edited .glsl files can be hot reloaded.
+//
+
+#include "shader_watcher.h"
+
+#include <print>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+ShaderWatcher::~ShaderWatcher() {
+    Stop();
+}
+
+bool ShaderWatcher::Watch(const std::string& directory) {
+    Stop();
+    mDirectory = directory;
+
+#ifdef __linux__
+    mNotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (mNotifyFd >= 0) {
+        // Editors either write in place (IN_CLOSE_WRITE) or write a temporary file and
+        // rename it over the original (IN_MOVED_TO). Not IN_CREATE: it comes before the
+        // new file is written, and would compile an empty or half-written shader.
+        if (inotify_add_watch(mNotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+            close(mNotifyFd);
+            mNotifyFd = -1;
+        }
+    }
+#endif
+
+    if (mNotifyFd < 0) {
+        std::error_code error;
+        if (!std::filesystem::is_directory(directory, error)) {
+            std::println("Could not watch shader directory {}", directory);
+            return false;
+        }
+        ScanModificationTimes();
+    }
+
+    mWatching = true;
+    return true;
+}
+
+void ShaderWatcher::Stop() {
+#ifdef __linux__
+    if (mNotifyFd >= 0) {
+        close(mNotifyFd);
+    }
+#endif
+    mNotifyFd = -1;
+    mWatching = false;
+    mModificationTimes.clear();
+}
+
+bool ShaderWatcher::PollChanged() {
+    if (!mWatching) { return false; }
+
+#ifdef __linux__
+    if (mNotifyFd >= 0) {
+        bool changed{false};
+        alignas(inotify_event) char buffer[4096];
+        while (true) {
+            const ssize_t length{read(mNotifyFd, buffer, sizeof(buffer))};
+            // EAGAIN: nothing left to read
+            if (length <= 0) { break; }
+
+            for (ssize_t offset = 0; offset < length;) {
+                const auto* event{reinterpret_cast<const inotify_event*>(buffer + offset)};
+                if (event->len > 0 && std::filesystem::path(event->name).extension() == ".glsl") {
+                    changed = true;
+                }
+                offset += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+            }
+        }
+        return changed;
+    }
+#endif
+
+    // Without inotify, stat the files a few times a second rather than every frame
+    const auto now{std::chrono::steady_clock::now()};
+    if (now - mLastScan < std::chrono::milliseconds(250)) {
+        return false;
+    }
+    return ScanModificationTimes();
+}
+
+bool ShaderWatcher::ScanModificationTimes() {
+    mLastScan = std::chrono::steady_clock::now();
+
+    bool changed{false};
+    std::error_code error;
+    for (const auto& entry : std::filesystem::directory_iterator(mDirectory, error)) {
+        if (entry.path().extension() != ".glsl") { continue; }
+
+        const auto writeTime{entry.last_write_time(error)};
+        if (error) { continue; }
+
+        auto [it, inserted] = mModificationTimes.try_emplace(entry.path().string(), writeTime);
+        if (!inserted && it->second != writeTime) {
+            it->second = writeTime;
+            changed = true;
+        }
+    }
+    return changed;
+}
@@ -0,0 +1,48 @@
+//
+// Watches the shader directory so that edited .glsl files can be hot reloaded.
+//
+
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+
+
+/**
+ * Reports when any .glsl file in a directory has been written.
+ * On Linux this is driven by inotify; elsewhere the modification times are
+ * checked a few times per second. Polling never blocks, so it is safe to call
+ * once per frame.
+ */
+class ShaderWatcher {
+public:
+    ShaderWatcher() = default;
+    ~ShaderWatcher();
+
+    ShaderWatcher(const ShaderWatcher&) = delete;
+    ShaderWatcher& operator=(const ShaderWatcher&) = delete;
+
+    bool Watch(const std::string& directory);
+    void Stop();
+
+    // Returns true if a shader changed since the last call
+    bool PollChanged();
+
+private:
+    bool ScanModificationTimes();
+
+    std::string mDirectory;
+    bool mWatching{false};
+
+    // inotify file descriptor, -1 when we fall back to polling modification times
+    int mNotifyFd{-1};
+
+    std::unordered_map<std::string, std::filesystem::file_time_type> mModificationTimes;
+    std::chrono::steady_clock::time_point mLastScan{};
+};
+
+
+#endif //SHADER_WATCHER_H
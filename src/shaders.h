@@ -7,6 +7,9 @@
 
 #include <string>
 #include <fstream>
+#include <iostream>
+#include <print>
+#include <cstring>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 
@@ -113,8 +116,205 @@ inline GLuint CreateShaderProgram(const std::string& vertexShaderSource,
 
     // Once our final program Object has been created, we can detach and
     // then delete our individual shaders.
+    glDetachShader(programObject, myVertexShader);
+    glDetachShader(programObject, myFragmentShader);
+    glDeleteShader(myVertexShader);
+    glDeleteShader(myFragmentShader);
 
     return programObject;
 }
 
+
+// Asynchronous shader compilation
+// Querying GL_COMPILE_STATUS or GL_LINK_STATUS right after glCompileShader/glLinkProgram
+// forces the driver to finish the work on the calling thread. Instead, we issue every
+// compile and the link up front, and only ask for the result once the driver reports
+// that it is done. With KHR_parallel_shader_compile the driver compiles on its own
+// threads and GL_COMPLETION_STATUS_KHR tells us when the result can be read without
+// blocking. Without the extension we still defer the status query to a later frame.
+
+// KHR_parallel_shader_compile is not part of the core profile glad was generated for,
+// so we declare the token and the entry point ourselves and load them at runtime.
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+using PFNMaxShaderCompilerThreads = void (APIENTRY *)(GLuint count);
+
+// Set by InitParallelShaderCompile once the extension has been found
+inline bool gParallelShaderCompile{false};
+
+/**
+ * Looks for KHR_parallel_shader_compile (or the older ARB version) and, when found,
+ * lets the driver use as many compiler threads as it wants.
+ * Must be called after the OpenGL function pointers have been loaded.
+ */
+inline bool InitParallelShaderCompile(GLADloadproc loadProc) {
+    GLint extensionCount{0};
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+
+    const char* entryPoint{nullptr};
+    for (GLint i = 0; i < extensionCount; ++i) {
+        auto name{reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i))};
+        if (std::strcmp(name, "GL_KHR_parallel_shader_compile") == 0) {
+            entryPoint = "glMaxShaderCompilerThreadsKHR";
+            break;
+        }
+        if (std::strcmp(name, "GL_ARB_parallel_shader_compile") == 0) {
+            entryPoint = "glMaxShaderCompilerThreadsARB";
+        }
+    }
+
+    if (entryPoint == nullptr) {
+        gParallelShaderCompile = false;
+        return false;
+    }
+
+    // 0xFFFFFFFF lets the implementation pick the number of threads
+    auto maxShaderCompilerThreads{reinterpret_cast<PFNMaxShaderCompilerThreads>(loadProc(entryPoint))};
+    if (maxShaderCompilerThreads != nullptr) {
+        maxShaderCompilerThreads(0xFFFFFFFF);
+    }
+
+    gParallelShaderCompile = true;
+    return true;
+}
+
+enum class ShaderBuildStatus {
+    Empty,
+    Pending,
+    Ready,
+    Failed
+};
+
+/**
+ * A program whose shaders have been submitted for compilation and linking
+ * but whose status has not been read back yet.
+ */
+struct ShaderProgramBuild {
+    GLuint mProgram{0};
+    GLuint mVertexShader{0};
+    GLuint mFragmentShader{0};
+    ShaderBuildStatus mStatus{ShaderBuildStatus::Empty};
+    // Without KHR_parallel_shader_compile the first poll only sets this, so the status
+    // is not asked for before the frame after the build was issued
+    bool mPolledOnce{false};
+};
+
+/**
+ * Kicks off the compilation of both shaders and the link of the program without
+ * querying any status. Call PollShaderProgramBuild to find out when it is done.
+ */
+inline ShaderProgramBuild BeginShaderProgramBuild(const std::string& vertexShaderSource,
+                                                  const std::string& fragmentShaderSource) {
+    ShaderProgramBuild build;
+    build.mVertexShader = glCreateShader(GL_VERTEX_SHADER);
+    build.mFragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+
+    auto vertexSource{vertexShaderSource.c_str()};
+    auto fragmentSource{fragmentShaderSource.c_str()};
+    glShaderSource(build.mVertexShader, 1, &vertexSource, nullptr);
+    glShaderSource(build.mFragmentShader, 1, &fragmentSource, nullptr);
+    glCompileShader(build.mVertexShader);
+    glCompileShader(build.mFragmentShader);
+
+    // Linking does not have to wait for us to check the compile status; if a shader
+    // failed, the link fails too and we report the shader logs then.
+    build.mProgram = glCreateProgram();
+    glAttachShader(build.mProgram, build.mVertexShader);
+    glAttachShader(build.mProgram, build.mFragmentShader);
+    glLinkProgram(build.mProgram);
+
+    build.mStatus = ShaderBuildStatus::Pending;
+    return build;
+}
+
+// Prints the info log of a shader if it failed to compile
+inline void PrintShaderBuildLog(GLuint shaderObject, const char* stage) {
+    int result;
+    glGetShaderiv(shaderObject, GL_COMPILE_STATUS, &result);
+    if (result == GL_TRUE) { return; }
+
+    int length{0};
+    glGetShaderiv(shaderObject, GL_INFO_LOG_LENGTH, &length);
+    std::string errorMessages(length, '\0');
+    glGetShaderInfoLog(shaderObject, length, &length, errorMessages.data());
+
+    std::println("ERROR: {} compilation failed!", stage);
+    std::cerr << errorMessages << std::endl;
+}
+
+/**
+ * Checks a pending build without stalling when KHR_parallel_shader_compile is available.
+ * Passing block = true reads the result even if the driver is still working on it.
+ * Returns the new status; once Ready, build.mProgram is a linked program the caller owns.
+ */
+inline ShaderBuildStatus PollShaderProgramBuild(ShaderProgramBuild& build, bool block = false) {
+    if (build.mStatus != ShaderBuildStatus::Pending) {
+        return build.mStatus;
+    }
+
+    if (gParallelShaderCompile && !block) {
+        GLint completed{GL_FALSE};
+        glGetProgramiv(build.mProgram, GL_COMPLETION_STATUS_KHR, &completed);
+        if (completed == GL_FALSE) {
+            return build.mStatus;
+        }
+    } else if (!block && !build.mPolledOnce) {
+        // No way to ask whether it is done; give the driver until the next poll
+        build.mPolledOnce = true;
+        return build.mStatus;
+    }
+
+    GLint linked{GL_FALSE};
+    glGetProgramiv(build.mProgram, GL_LINK_STATUS, &linked);
+
+    if (linked == GL_FALSE) {
+        PrintShaderBuildLog(build.mVertexShader, "GL_VERTEX_SHADER");
+        PrintShaderBuildLog(build.mFragmentShader, "GL_FRAGMENT_SHADER");
+
+        int length{0};
+        glGetProgramiv(build.mProgram, GL_INFO_LOG_LENGTH, &length);
+        if (length > 0) {
+            std::string errorMessages(length, '\0');
+            glGetProgramInfoLog(build.mProgram, length, &length, errorMessages.data());
+            std::println("{}", "ERROR: program link failed!");
+            std::cerr << errorMessages << std::endl;
+        }
+
+        glDeleteProgram(build.mProgram);
+        build.mProgram = 0;
+        build.mStatus = ShaderBuildStatus::Failed;
+    } else {
+        glDetachShader(build.mProgram, build.mVertexShader);
+        glDetachShader(build.mProgram, build.mFragmentShader);
+        build.mStatus = ShaderBuildStatus::Ready;
+    }
+
+    glDeleteShader(build.mVertexShader);
+    glDeleteShader(build.mFragmentShader);
+    build.mVertexShader = 0;
+    build.mFragmentShader = 0;
+    return build.mStatus;
+}
+
+/**
+ * Blocks until a build is finished. Used at load time, where all programs are begun
+ * first so that the driver can compile them in parallel, and then waited on.
+ */
+inline GLuint FinishShaderProgramBuild(ShaderProgramBuild& build) {
+    PollShaderProgramBuild(build, true);
+    return build.mStatus == ShaderBuildStatus::Ready ? build.mProgram : 0;
+}
+
+/**
+ * Releases whatever GL objects a build still owns, e.g. when a reload is abandoned.
+ */
+inline void DeleteShaderProgramBuild(ShaderProgramBuild& build) {
+    glDeleteProgram(build.mProgram);
+    glDeleteShader(build.mVertexShader);
+    glDeleteShader(build.mFragmentShader);
+    build = ShaderProgramBuild{};
+}
+
 #endif //SHADERS_H
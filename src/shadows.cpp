@@ -0,0 +1,341 @@
+//
+// Cascaded shadow maps for the directional light, with the static casters' depth cached between frames.
+//
+
+#include "shadows.h"
+
+#include <algorithm>
+#include <cmath>
+#include <print>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "depth_state.h"
+#include "mesh.h"
+#include "profiler.h"
+
+// Slope-scaled and constant depth bias while drawing casters, against shadow acne
+static constexpr float kSlopeBias{2.0f};
+static constexpr float kConstantBias{4.0f};
+// Receivers are looked up this many texels out along their normal
+static constexpr float kNormalOffsetTexels{1.5f};
+// Each chunk holds a hundred or so objects
+static constexpr size_t kCasterChunksPerJob{16};
+
+namespace {
+
+// View depth where cascade index begins: a blend of even and logarithmic splits
+float CascadeSplitDepth(const int index, const float nearDepth) {
+    const float fraction = static_cast<float>(index) / kShadowCascadeCount;
+    const float logarithmic = nearDepth * std::pow(kShadowDistance / nearDepth, fraction);
+    const float even = nearDepth + (kShadowDistance - nearDepth) * fraction;
+    return kCascadeSplitLambda * logarithmic + (1.0f - kCascadeSplitLambda) * even;
+}
+
+// Looks down the light's direction from the origin; only the rotation matters
+glm::mat4 LightViewMatrix(const glm::vec3& direction) {
+    const glm::vec3 up = std::abs(direction.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    return glm::lookAt(glm::vec3(0.0f), direction, up);
+}
+
+// Orthographic projection with the depth range laid out like the scene's
+glm::mat4 OrthographicMatrix(const float left, const float right, const float bottom, const float top,
+                             const float near, const float far, const DepthMode depthMode) {
+    glm::mat4 projection{1.0f};
+    projection[0][0] = 2.0f / (right - left);
+    projection[1][1] = 2.0f / (top - bottom);
+    projection[3][0] = -(right + left) / (right - left);
+    projection[3][1] = -(top + bottom) / (top - bottom);
+    if (depthMode == DepthMode::ReverseZ) {
+        // 1 at the near plane, 0 at the far plane
+        projection[2][2] = 1.0f / (far - near);
+        projection[3][2] = far / (far - near);
+    } else {
+        projection[2][2] = -2.0f / (far - near);
+        projection[3][2] = -(far + near) / (far - near);
+    }
+    return projection;
+}
+
+/**
+ * Point the cascade at a sphere. The center is snapped to whole texels in light space,
+ * so that as the camera moves the shadow map shifts by whole texels and the shadow
+ * edges stay put; one texel of margin keeps the sphere covered after the snap.
+ */
+void FitCascade(ShadowCascade* cascade, const glm::mat4& lightView, const glm::vec3& center, const float radius,
+                const int resolution, const DepthMode depthMode) {
+    cascade->mCenter = center;
+    cascade->mRadius = radius;
+
+    // The map spans 2 * halfExtent, with one of its own texels of margin on each side:
+    // halfExtent = radius + texel and texel = 2 * halfExtent / resolution
+    const float texels = static_cast<float>(std::max(resolution, 4));
+    const float halfExtent = radius * texels / (texels - 2.0f);
+    const float texel = 2.0f * halfExtent / texels;
+    glm::vec3 lightCenter{lightView * glm::vec4(center, 1.0f)};
+    lightCenter.x = std::floor(lightCenter.x / texel) * texel;
+    lightCenter.y = std::floor(lightCenter.y / texel) * texel;
+
+    // The light looks down -z; casters up to kShadowCasterReach in front of the sphere are kept
+    const float near = -lightCenter.z - halfExtent - kShadowCasterReach;
+    const float far = -lightCenter.z + halfExtent;
+    cascade->mViewProjection = OrthographicMatrix(lightCenter.x - halfExtent, lightCenter.x + halfExtent,
+                                                  lightCenter.y - halfExtent, lightCenter.y + halfExtent,
+                                                  near, far, depthMode) * lightView;
+    cascade->mFrustum = FrustumFromMatrix(cascade->mViewProjection, depthMode == DepthMode::ReverseZ);
+}
+
+// Cull query's casters against the cascade on all threads, adding to the command lists
+void RecordCasters(CascadedShadows* shadows, World& world, Query& query, const Frustum& frustum, JobSystem& jobs) {
+    std::vector<CommandList>& lists = shadows->mLists;
+    world.ParallelForEachChunk(query, jobs, kCasterChunksPerJob, [&](const ChunkView& chunk, const size_t thread) {
+        RecordMeshDraws(&lists[thread], chunk.Column<WorldMatrix>(), chunk.Column<MeshInstance>(), chunk.Count(),
+                        frustum);
+    });
+}
+
+void ResetLists(CascadedShadows* shadows) {
+    for (CommandList& list : shadows->mLists) {
+        list.Reset();
+    }
+}
+
+size_t RecordedDraws(const CascadedShadows& shadows) {
+    size_t count{0};
+    for (const CommandList& list : shadows.mLists) {
+        count += list.Commands().size();
+    }
+    return count;
+}
+
+// Draw the recorded casters into one layer of texture
+void DrawCasters(CascadedShadows* shadows, const GLuint texture, const int layer, const bool clear,
+                 const ShadowCascade& cascade, const GLuint program, const GLint viewProjectionLocation,
+                 RenderCounters* counters) {
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, texture, 0, layer);
+    if (clear) {
+        glClear(GL_DEPTH_BUFFER_BIT);
+    }
+    // Uniforms stay with the program, so this survives ReplayDepthOnly binding it again
+    glUseProgram(program);
+    glUniformMatrix4fv(viewProjectionLocation, 1, GL_FALSE, &cascade.mViewProjection[0][0]);
+    counters->mUniformUploads += 1;
+    shadows->mQueue.Merge(shadows->mLists);
+    shadows->mQueue.ReplayDepthOnly(shadows->mLists, program, counters);
+}
+
+// Start a cached cascade's shadow map layer from its static casters' depth
+void CopyStaticDepth(const CascadedShadows& shadows, const GLuint staticDepth, const GLuint shadowMap,
+                     const int layer) {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, shadows.mCopyFramebuffer);
+    glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, staticDepth, 0, layer);
+    glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadowMap, 0, layer);
+    const int size = shadows.mResolution;
+    glBlitFramebuffer(0, 0, size, size, 0, 0, size, size, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, shadows.mFramebuffer);
+}
+
+}
+
+bool CascadedShadowsCreate(GpuResources* resources, CascadedShadows* shadows, const int resolution,
+                           const DepthMode depthMode) {
+    shadows->mResolution = resolution;
+    shadows->mDepthMode = depthMode;
+    shadows->mShadowMap = resources->CreateTexture2DArray(kDepthFormat, resolution, resolution, kShadowCascadeCount,
+                                                          GL_DEPTH_COMPONENT, GL_FLOAT, 4);
+    shadows->mStaticDepth = resources->CreateTexture2DArray(kDepthFormat, resolution, resolution,
+                                                            kShadowCascadeCount, GL_DEPTH_COMPONENT, GL_FLOAT, 4);
+
+    // Filtered depth comparisons: every lookup is already a 2x2 PCF. Lit is nearer to
+    // the light than the stored depth, which is bigger with reverse-Z.
+    glBindTexture(GL_TEXTURE_2D_ARRAY, resources->Name(shadows->mShadowMap));
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC,
+                    depthMode == DepthMode::ReverseZ ? GL_GEQUAL : GL_LEQUAL);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, resources->Name(shadows->mStaticDepth));
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+
+    // Depth only, so neither framebuffer reads or draws color
+    glGenFramebuffers(1, &shadows->mFramebuffer);
+    glGenFramebuffers(1, &shadows->mCopyFramebuffer);
+    GLenum status{GL_FRAMEBUFFER_COMPLETE};
+    for (const GLuint framebuffer : {shadows->mFramebuffer, shadows->mCopyFramebuffer}) {
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, resources->Name(shadows->mShadowMap), 0, 0);
+        if (status == GL_FRAMEBUFFER_COMPLETE) {
+            status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::println("Shadow map framebuffer is incomplete: {:#x}", status);
+        CascadedShadowsDelete(resources, shadows);
+        return false;
+    }
+    return true;
+}
+
+void CascadedShadowsUpdate(CascadedShadows* shadows, const DirectionalLight* light, const Camera& camera,
+                           const float nearDepth, const uint64_t staticVersion) {
+    PROFILE_FUNCTION();
+    shadows->mHasLight = light != nullptr;
+    if (light == nullptr) { return; }
+
+    const glm::vec3 direction = glm::normalize(light->mDirection);
+    const bool lightTurned = direction != shadows->mLightDirection;
+    const bool staticCastersChanged = staticVersion != shadows->mStaticVersion;
+    shadows->mLightDirection = direction;
+    shadows->mLightColor = light->mColor;
+    shadows->mStaticVersion = staticVersion;
+
+    const glm::mat4 lightView = LightViewMatrix(direction);
+    const glm::mat4& projection = camera.GetProjectionMatrix();
+    const glm::mat4& inverseView = camera.GetInverseViewMatrix();
+    // Squared distance from the view axis to a corner of the frustum, per unit of depth
+    const float cornerSlopeSquared = 1.0f / (projection[0][0] * projection[0][0]) +
+                                     1.0f / (projection[1][1] * projection[1][1]);
+
+    float sliceNear = nearDepth;
+    for (int i = 0; i < kShadowCascadeCount; ++i) {
+        ShadowCascade& cascade = shadows->mCascades[i];
+        const float sliceFar = CascadeSplitDepth(i + 1, nearDepth);
+        cascade.mSplitDepth = sliceFar;
+
+        // The smallest sphere around the slice is centered on the view axis, where its
+        // near and far corners are equally far away; it only depends on the projection
+        const float centerDepth = std::min(0.5f * (sliceNear + sliceFar) * (1.0f + cornerSlopeSquared), sliceFar);
+        const float radius = std::sqrt(sliceFar * sliceFar * cornerSlopeSquared +
+                                       (sliceFar - centerDepth) * (sliceFar - centerDepth));
+        const glm::vec3 center{inverseView * glm::vec4(0.0f, 0.0f, -centerDepth, 1.0f)};
+        sliceNear = sliceFar;
+
+        if (i < kFirstCachedCascade) {
+            FitCascade(&cascade, lightView, center, radius, shadows->mResolution, shadows->mDepthMode);
+            continue;
+        }
+        const bool stillCovered = glm::distance(center, cascade.mCenter) + radius <= cascade.mRadius;
+        if (lightTurned || !stillCovered) {
+            FitCascade(&cascade, lightView, center, radius * kCachedCascadePadding, shadows->mResolution,
+                       shadows->mDepthMode);
+            cascade.mStaticDepthValid = false;
+        } else if (staticCastersChanged) {
+            cascade.mStaticDepthValid = false;
+        }
+    }
+}
+
+void CascadedShadowsRender(CascadedShadows* shadows, const GpuResources& resources, World& world,
+                           Query& staticCasters, Query& dynamicCasters, const GLuint program, JobSystem& jobs,
+                           RenderCounters* counters) {
+    PROFILE_FUNCTION();
+    shadows->mStaticRedraws = 0;
+    if (!shadows->mHasLight) { return; }
+    shadows->mLists.resize(jobs.ThreadCount());
+
+    const GLuint shadowMap = resources.Name(shadows->mShadowMap);
+    const GLuint staticDepth = resources.Name(shadows->mStaticDepth);
+    glBindFramebuffer(GL_FRAMEBUFFER, shadows->mFramebuffer);
+    glViewport(0, 0, shadows->mResolution, shadows->mResolution);
+    ApplyDepthState(shadows->mDepthMode);
+    // Quads are one-sided, and should cast a shadow from either side
+    glDisable(GL_CULL_FACE);
+    // Casters beyond the near plane are flattened onto it rather than lost
+    glEnable(GL_DEPTH_CLAMP);
+    // Push caster depth away from the light, which is toward 0 with reverse-Z
+    const float biasSign = shadows->mDepthMode == DepthMode::ReverseZ ? -1.0f : 1.0f;
+    glEnable(GL_POLYGON_OFFSET_FILL);
+    glPolygonOffset(biasSign * kSlopeBias, biasSign * kConstantBias);
+
+    glUseProgram(program);
+    const GLint viewProjectionLocation = FindUniformLocation(program, "u_LightViewProjection");
+
+    for (int i = 0; i < kShadowCascadeCount; ++i) {
+        ShadowCascade& cascade = shadows->mCascades[i];
+        if (i < kFirstCachedCascade) {
+            ResetLists(shadows);
+            RecordCasters(shadows, world, staticCasters, cascade.mFrustum, jobs);
+            RecordCasters(shadows, world, dynamicCasters, cascade.mFrustum, jobs);
+            DrawCasters(shadows, shadowMap, i, true, cascade, program, viewProjectionLocation, counters);
+            continue;
+        }
+
+        const bool redrawStatic = !cascade.mStaticDepthValid;
+        if (redrawStatic) {
+            ResetLists(shadows);
+            RecordCasters(shadows, world, staticCasters, cascade.mFrustum, jobs);
+            DrawCasters(shadows, staticDepth, i, true, cascade, program, viewProjectionLocation, counters);
+            cascade.mStaticDepthValid = true;
+            shadows->mStaticRedraws += 1;
+        }
+
+        ResetLists(shadows);
+        RecordCasters(shadows, world, dynamicCasters, cascade.mFrustum, jobs);
+        const bool hasDynamicDepth = RecordedDraws(*shadows) > 0;
+        // With nothing moving in the cascade, last frame's layer is still right
+        if (redrawStatic || hasDynamicDepth || cascade.mHasDynamicDepth) {
+            CopyStaticDepth(*shadows, staticDepth, shadowMap, i);
+            if (hasDynamicDepth) {
+                DrawCasters(shadows, shadowMap, i, false, cascade, program, viewProjectionLocation, counters);
+            }
+        }
+        cascade.mHasDynamicDepth = hasDynamicDepth;
+    }
+
+    glDisable(GL_POLYGON_OFFSET_FILL);
+    glDisable(GL_DEPTH_CLAMP);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, 0, 0, 0);
+
+    // Left bound for the frame; nothing else uses this unit
+    glActiveTexture(GL_TEXTURE0 + kShadowMapTextureUnit);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, shadowMap);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+void CascadedShadowsFillUniforms(const CascadedShadows& shadows, FrameUniforms* uniforms) {
+    if (!shadows.mHasLight) {
+        uniforms->mSunDirection = glm::vec4(0.0f);
+        return;
+    }
+
+    // Light clip space to texture coordinates, and to [0, 1] depth unless it already is
+    glm::mat4 toTexture{1.0f};
+    toTexture[0][0] = 0.5f;
+    toTexture[1][1] = 0.5f;
+    toTexture[3][0] = 0.5f;
+    toTexture[3][1] = 0.5f;
+    if (shadows.mDepthMode != DepthMode::ReverseZ) {
+        toTexture[2][2] = 0.5f;
+        toTexture[3][2] = 0.5f;
+    }
+
+    const float resolution = static_cast<float>(shadows.mResolution);
+    for (int i = 0; i < kShadowCascadeCount; ++i) {
+        const ShadowCascade& cascade = shadows.mCascades[i];
+        uniforms->mShadowMatrices[i] = toTexture * cascade.mViewProjection;
+        uniforms->mCascadeSplits[i] = cascade.mSplitDepth;
+        uniforms->mCascadeNormalOffsets[i] = kNormalOffsetTexels * 2.0f * cascade.mRadius / resolution;
+    }
+    uniforms->mSunDirection = glm::vec4(-shadows.mLightDirection, 1.0f);
+    uniforms->mSunColor = glm::vec4(shadows.mLightColor, 1.0f / resolution);
+}
+
+void CascadedShadowsDelete(GpuResources* resources, CascadedShadows* shadows) {
+    resources->Release(shadows->mShadowMap);
+    resources->Release(shadows->mStaticDepth);
+    glDeleteFramebuffers(1, &shadows->mFramebuffer);
+    glDeleteFramebuffers(1, &shadows->mCopyFramebuffer);
+    *shadows = CascadedShadows{};
+}
+
+void BindShadowSampler(const GLuint program) {
+    const GLint location = glGetUniformLocation(program, "u_ShadowMap");
+    if (location != -1) { glUniform1i(location, kShadowMapTextureUnit); }
+}
@@ -0,0 +1,117 @@
+//
+// Cascaded shadow maps for the directional light, with the static casters' depth cached between frames.
+//
+
+#ifndef SHADOWS_H
+#define SHADOWS_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "camera.h"
+#include "components.h"
+#include "draw_list.h"
+#include "ecs.h"
+#include "frame_stats.h"
+#include "frame_uniforms.h"
+#include "frustum.h"
+#include "gpu_resources.h"
+#include "job_system.h"
+
+
+// Texture unit the shaders read the shadow map from
+constexpr GLint kShadowMapTextureUnit{7};
+// The cascades cover the view out to this depth; nothing farther is shadowed
+constexpr float kShadowDistance{40.0f};
+// 0 splits the view evenly, 1 logarithmically
+constexpr float kCascadeSplitLambda{0.75f};
+// Cascades from this one on keep their static casters' depth between frames. The
+// first is small and moves with every step the camera takes, so it is redrawn.
+constexpr int kFirstCachedCascade{1};
+// Cached cascades cover this much more than they need to, so the camera can move a
+// while before they have to be refitted
+constexpr float kCachedCascadePadding{1.3f};
+// Casters this far toward the light from a cascade still land in it
+constexpr float kShadowCasterReach{50.0f};
+
+struct ShadowCascade {
+    // World to light clip space
+    glm::mat4 mViewProjection{1.0f};
+    Frustum mFrustum{};
+    // The world space sphere the cascade covers
+    glm::vec3 mCenter{0.0f};
+    float mRadius{0.0f};
+    // View depth where the cascade ends
+    float mSplitDepth{0.0f};
+    // The static layer holds this cascade's static casters
+    bool mStaticDepthValid{false};
+    // The shadow map layer holds dynamic casters on top of the static ones
+    bool mHasDynamicDepth{false};
+};
+
+/**
+ * Shadows of the first DirectionalLight in a depth texture array, one layer per
+ * cascade. Cascades are spheres around slices of the view frustum, so their size does
+ * not change as the camera turns, and their centers are snapped to whole texels, so
+ * the shadow edges do not crawl as it moves.
+ *
+ * Cached cascades are drawn in two layers. Static casters go into mStaticDepth, which
+ * is only redrawn when the light turns, the static casters change or the camera leaves
+ * the padded sphere. Each frame the static layer is copied into the shadow map and
+ * the dynamic casters are drawn on top, so most frames draw only what moves.
+ */
+struct CascadedShadows {
+    int mResolution{0};
+    // Light space depth is laid out like the scene's, so the same depth state works for both
+    DepthMode mDepthMode{DepthMode::Standard};
+    TextureHandle mShadowMap{};
+    TextureHandle mStaticDepth{};
+    GLuint mFramebuffer{0};
+    // Read side of the static to shadow map copy
+    GLuint mCopyFramebuffer{0};
+
+    std::array<ShadowCascade, kShadowCascadeCount> mCascades{};
+    bool mHasLight{false};
+    glm::vec3 mLightDirection{0.0f};
+    glm::vec3 mLightColor{0.0f};
+    // World::StructuralVersion of the static casters when their depth was drawn
+    uint64_t mStaticVersion{UINT64_MAX};
+
+    std::vector<CommandList> mLists;
+    DrawQueue mQueue;
+    // Cascades whose static depth was redrawn in the last Render
+    int mStaticRedraws{0};
+};
+
+// resolution is the width and height of each cascade's layer; depthMode is the scene's
+bool CascadedShadowsCreate(GpuResources* resources, CascadedShadows* shadows, int resolution, DepthMode depthMode);
+
+/**
+ * Fit the cascades to the camera and work out which cached ones have to be redrawn.
+ * light may be null, which turns the shadows off. staticVersion is the structural
+ * version of the static caster query.
+ */
+void CascadedShadowsUpdate(CascadedShadows* shadows, const DirectionalLight* light, const Camera& camera,
+                           float nearDepth, uint64_t staticVersion);
+
+/**
+ * Draw the casters of every cascade with program, which takes u_LightViewProjection.
+ * Leaves its own framebuffer bound and face culling off; the caller restores them.
+ */
+void CascadedShadowsRender(CascadedShadows* shadows, const GpuResources& resources, World& world,
+                           Query& staticCasters, Query& dynamicCasters, GLuint program, JobSystem& jobs,
+                           RenderCounters* counters);
+
+// The cascades and the light as the shaders need them
+void CascadedShadowsFillUniforms(const CascadedShadows& shadows, FrameUniforms* uniforms);
+void CascadedShadowsDelete(GpuResources* resources, CascadedShadows* shadows);
+
+// Points the program's shadow sampler at its texture unit; the program must be in use
+void BindShadowSampler(GLuint program);
+
+
+#endif //SHADOWS_H
@@ -0,0 +1,100 @@
+//
+// Generational handles and the slot maps they index.
+//
+
+#ifndef SLOT_MAP_H
+#define SLOT_MAP_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+/**
+ * Typed reference into a SlotMap. The Tag keeps handles to different kinds of
+ * resource from being mixed up. A handle stays valid until its slot is removed;
+ * after that the generation no longer matches and lookups return null instead of
+ * whatever reused the slot. Generation 0 is the null handle.
+ */
+template <class Tag>
+struct Handle {
+    uint32_t mIndex{0};
+    uint32_t mGeneration{0};
+
+    bool IsNull() const { return mGeneration == 0; }
+    bool operator==(const Handle&) const = default;
+};
+
+/**
+ * Dense array of slots with a free list. Insert and Remove are O(1), and a lookup
+ * is one index plus one generation check.
+ */
+template <class T, class Tag>
+class SlotMap {
+public:
+    using HandleType = Handle<Tag>;
+
+    HandleType Insert(const T& value) {
+        uint32_t index;
+        if (!mFreeSlots.empty()) {
+            index = mFreeSlots.back();
+            mFreeSlots.pop_back();
+        } else {
+            index = static_cast<uint32_t>(mSlots.size());
+            mSlots.emplace_back();
+        }
+
+        Slot& slot = mSlots[index];
+        slot.mValue = value;
+        slot.mOccupied = true;
+        ++mSize;
+        return HandleType{index, slot.mGeneration};
+    }
+
+    bool Remove(HandleType handle) {
+        if (!Contains(handle)) { return false; }
+        Slot& slot = mSlots[handle.mIndex];
+        slot.mOccupied = false;
+        slot.mValue = T{};
+        // Skip 0 when wrapping, it marks the null handle
+        if (++slot.mGeneration == 0) { slot.mGeneration = 1; }
+        mFreeSlots.push_back(handle.mIndex);
+        --mSize;
+        return true;
+    }
+
+    bool Contains(HandleType handle) const {
+        return handle.mIndex < mSlots.size() && mSlots[handle.mIndex].mOccupied &&
+               mSlots[handle.mIndex].mGeneration == handle.mGeneration;
+    }
+
+    T* Get(HandleType handle) { return Contains(handle) ? &mSlots[handle.mIndex].mValue : nullptr; }
+    const T* Get(HandleType handle) const { return Contains(handle) ? &mSlots[handle.mIndex].mValue : nullptr; }
+
+    size_t Size() const { return mSize; }
+
+    // Calls function(handle, value) for every occupied slot
+    template <class Function>
+    void ForEach(Function&& function) const {
+        for (uint32_t index = 0; index < mSlots.size(); ++index) {
+            const Slot& slot = mSlots[index];
+            if (slot.mOccupied) {
+                function(HandleType{index, slot.mGeneration}, slot.mValue);
+            }
+        }
+    }
+
+private:
+    struct Slot {
+        T mValue{};
+        uint32_t mGeneration{1};
+        bool mOccupied{false};
+    };
+
+    std::vector<Slot> mSlots;
+    std::vector<uint32_t> mFreeSlots;
+    size_t mSize{0};
+};
+
+
+#endif //SLOT_MAP_H
@@ -0,0 +1,112 @@
+//
+// Systems that update the world's components once per fixed step or once per frame.
+//
+
+#include "systems.h"
+
+#include <cmath>
+#include <glm/gtc/constants.hpp>
+
+#include "components.h"
+#include "profiler.h"
+
+// Each chunk holds a hundred or so objects, so this is a few thousand objects per job
+static constexpr size_t kChunksPerJob{16};
+
+SystemQueries::SystemQueries()
+    : mMoving(Query::With<LocalTransform, PreviousTransform>()),
+      mInterpolated(Query::With<LocalTransform, PreviousTransform, WorldMatrix>()),
+      mSpinning(Query::With<LocalTransform, Spin>()),
+      mDrawable(Query::With<WorldMatrix, MeshInstance>()),
+      mTransparent(Query::With<Billboard>().Without<OrderIndependent>()),
+      mOrderIndependent(Query::With<Billboard, OrderIndependent>()),
+      mLights(Query::With<Light>()),
+      mOrbitingLights(Query::With<Light, LightOrbit>()),
+      mDirectionalLights(Query::With<DirectionalLight>()),
+      mStaticCasters(Query::With<WorldMatrix, MeshInstance>().Without<PreviousTransform>()),
+      mDynamicCasters(Query::With<WorldMatrix, MeshInstance, PreviousTransform>()),
+      mPlayer(Query::With<LocalTransform, PlayerControlled>()) {
+}
+
+void StoreTransformsSystem(World& world, SystemQueries& queries, JobSystem& jobs) {
+    PROFILE_FUNCTION();
+    world.ParallelForEachChunk(queries.mMoving, jobs, kChunksPerJob, [](const ChunkView& chunk, size_t) {
+        const LocalTransform* current = chunk.Column<LocalTransform>();
+        PreviousTransform* previous = chunk.Column<PreviousTransform>();
+        for (size_t i = 0; i < chunk.Count(); ++i) {
+            previous[i] = PreviousTransform{current[i].mPosition, current[i].mRotate};
+        }
+    });
+}
+
+void SpinSystem(World& world, SystemQueries& queries, const float dt, JobSystem& jobs) {
+    PROFILE_FUNCTION();
+    world.ParallelForEachChunk(queries.mSpinning, jobs, kChunksPerJob, [dt](const ChunkView& chunk, size_t) {
+        LocalTransform* transforms = chunk.Column<LocalTransform>();
+        const Spin* spins = chunk.Column<Spin>();
+        for (size_t i = 0; i < chunk.Count(); ++i) {
+            transforms[i].mRotate += spins[i].mDegreesPerSecond * dt;
+        }
+    });
+}
+
+void LightOrbitSystem(World& world, SystemQueries& queries, const float dt, JobSystem& jobs) {
+    PROFILE_FUNCTION();
+    world.ParallelForEachChunk(queries.mOrbitingLights, jobs, kChunksPerJob, [dt](const ChunkView& chunk, size_t) {
+        Light* lights = chunk.Column<Light>();
+        LightOrbit* orbits = chunk.Column<LightOrbit>();
+        for (size_t i = 0; i < chunk.Count(); ++i) {
+            LightOrbit& orbit = orbits[i];
+            orbit.mAngle = std::fmod(orbit.mAngle + orbit.mRadiansPerSecond * dt, glm::two_pi<float>());
+            lights[i].mPosition = orbit.mCenter +
+                                  orbit.mRadius * glm::vec3(std::cos(orbit.mAngle), 0.0f, std::sin(orbit.mAngle));
+        }
+    });
+}
+
+void TransformSystem(World& world, SystemQueries& queries, const float alpha, JobSystem& jobs) {
+    PROFILE_FUNCTION();
+    world.ParallelForEachChunk(queries.mInterpolated, jobs, kChunksPerJob, [alpha](const ChunkView& chunk, size_t) {
+        const LocalTransform* current = chunk.Column<LocalTransform>();
+        const PreviousTransform* previous = chunk.Column<PreviousTransform>();
+        WorldMatrix* matrices = chunk.Column<WorldMatrix>();
+        for (size_t i = 0; i < chunk.Count(); ++i) {
+            matrices[i].mMatrix = MakeModelMatrix(previous[i], current[i], alpha);
+        }
+    });
+}
+
+void DeclareShaderVariants(World& world, SystemQueries& queries, ShaderPermutationManager& permutations,
+                           uint32_t rendererFeatures) {
+    world.ForEachChunk(queries.mDrawable, [&](const ChunkView& chunk) {
+        const MeshInstance* instances = chunk.Column<MeshInstance>();
+        for (size_t i = 0; i < chunk.Count(); ++i) {
+            permutations.Declare(instances[i].mShaderVariant | rendererFeatures);
+        }
+    });
+}
+
+void AssignPipelines(World& world, SystemQueries& queries, ShaderPermutationManager& permutations,
+                     uint32_t rendererFeatures) {
+    world.ForEachChunk(queries.mDrawable, [&](const ChunkView& chunk) {
+        MeshInstance* instances = chunk.Column<MeshInstance>();
+        for (size_t i = 0; i < chunk.Count(); ++i) {
+            instances[i].mPipeline = permutations.GetProgram(instances[i].mShaderVariant | rendererFeatures);
+        }
+    });
+}
+
+void RefreshMeshInstances(World& world, SystemQueries& queries, const GpuResources& resources) {
+    world.ForEachChunk(queries.mDrawable, [&](const ChunkView& chunk) {
+        MeshInstance* instances = chunk.Column<MeshInstance>();
+        for (size_t i = 0; i < chunk.Count(); ++i) {
+            if (const Mesh3D* mesh = resources.Get(instances[i].mMesh)) {
+                instances[i].mVertexArray = mesh->mVertexArrayObject;
+                instances[i].mBaseVertex = mesh->mBaseVertex;
+                instances[i].mIndexOffset = mesh->mIndexOffset;
+                instances[i].mDepthVertexArray = mesh->mDepthVertexArrayObject;
+                instances[i].mPositionBaseVertex = mesh->mPositionBaseVertex;
+            }
+        }
+    });
+}
@@ -0,0 +1,56 @@
+//
+// Systems that update the world's components once per fixed step or once per frame.
+//
+
+#ifndef SYSTEMS_H
+#define SYSTEMS_H
+
+#include "ecs.h"
+#include "gpu_resources.h"
+#include "job_system.h"
+#include "shader_permutations.h"
+
+
+/**
+ * The queries the systems run, built once so that archetype matching is cached.
+ */
+struct SystemQueries {
+    SystemQueries();
+
+    Query mMoving;
+    Query mInterpolated;
+    Query mSpinning;
+    Query mDrawable;
+    // Sorted billboards, and those blended order-independently
+    Query mTransparent;
+    Query mOrderIndependent;
+    Query mLights;
+    Query mOrbitingLights;
+    Query mDirectionalLights;
+    // Shadow casters that never move, whose shadow depth can be kept between frames,
+    // and those that do
+    Query mStaticCasters;
+    Query mDynamicCasters;
+    Query mPlayer;
+};
+
+// Copies every moving object's current transform to its previous one, before a step
+void StoreTransformsSystem(World& world, SystemQueries& queries, JobSystem& jobs);
+void SpinSystem(World& world, SystemQueries& queries, float dt, JobSystem& jobs);
+// Moves every orbiting light along its circle
+void LightOrbitSystem(World& world, SystemQueries& queries, float dt, JobSystem& jobs);
+// Writes the interpolated WorldMatrix of every moving object
+void TransformSystem(World& world, SystemQueries& queries, float alpha, JobSystem& jobs);
+
+// Declares the shader variant of every drawable object so it gets precompiled.
+// rendererFeatures are added to every object's own, e.g. SHADER_FEATURE_GBUFFER.
+void DeclareShaderVariants(World& world, SystemQueries& queries, ShaderPermutationManager& permutations,
+                           uint32_t rendererFeatures);
+// Points every drawable object at the program for its shader variant plus rendererFeatures
+void AssignPipelines(World& world, SystemQueries& queries, ShaderPermutationManager& permutations,
+                     uint32_t rendererFeatures);
+// Copies the current vertex array and offsets of each object's mesh, after meshes have moved
+void RefreshMeshInstances(World& world, SystemQueries& queries, const GpuResources& resources);
+
+
+#endif //SYSTEMS_H
@@ -11,6 +11,13 @@ struct  Transform {
     float x,y,z;
 };
 
+// Blend between two transforms, e.g. the previous and current simulation state
+inline Transform LerpTransform(const Transform& from, const Transform& to, float t) {
+    return Transform{from.x + (to.x - from.x) * t,
+                     from.y + (to.y - from.y) * t,
+                     from.z + (to.z - from.z) * t};
+}
+
 
 
 #endif //TRANSFORM_H
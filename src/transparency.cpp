@@ -0,0 +1,287 @@
+//
+// Blended billboards, drawn after the opaque scene: sorted back to front, or order-independent.
+//
+
+#include "transparency.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+
+#include "frame_arena.h"
+#include "frame_uniforms.h"
+#include "mesh.h"
+#include "profiler.h"
+
+// Chunks hold a hundred or so billboards; a few thousand per job
+static constexpr size_t kGatherChunksPerJob{16};
+static constexpr size_t kCopyInstancesPerJob{16 * 1024};
+
+static_assert(sizeof(Billboard) == 8 * sizeof(GLfloat), "Billboard is uploaded as two vec4 attributes");
+
+bool TransparentPassCreate(TransparentPass* pass) {
+    glGenVertexArrays(1, &pass->mSortedInstances.mVertexArray);
+    glGenVertexArrays(1, &pass->mWeightedInstances.mVertexArray);
+    glGenVertexArrays(1, &pass->mCompositeVertexArray);
+    return pass->mSortedInstances.mVertexArray != 0 && pass->mWeightedInstances.mVertexArray != 0 &&
+           pass->mCompositeVertexArray != 0;
+}
+
+void TransparentPassGather(TransparentPass* pass, World& world, Query& sorted, Query& orderIndependent,
+                           const glm::mat4& view, const Frustum& frustum, JobSystem& jobs) {
+    PROFILE_FUNCTION();
+
+    const size_t threads = jobs.ThreadCount();
+    pass->mThreadWeighted.resize(threads);
+    for (std::vector<Billboard>& billboards : pass->mThreadWeighted) {
+        billboards.clear();
+    }
+
+    // Order-independent billboards only need culling
+    world.ParallelForEachChunk(orderIndependent, jobs, kGatherChunksPerJob, [&](const ChunkView& chunk, size_t thread) {
+        std::vector<Billboard>& billboards = pass->mThreadWeighted[thread];
+        const Billboard* column = chunk.Column<Billboard>();
+        for (size_t i = 0; i < chunk.Count(); ++i) {
+            if (FrustumIntersectsSphere(frustum, column[i].mPosition, column[i].mSize * 1.4143f)) {
+                billboards.push_back(column[i]);
+            }
+        }
+    });
+    pass->mWeightedCount = 0;
+    for (const std::vector<Billboard>& billboards : pass->mThreadWeighted) {
+        pass->mWeightedCount += billboards.size();
+    }
+
+    /*
+     * Each chunk culls into its own slot of one array, sized for all of its billboards,
+     * and the slots are then packed in chunk order. The sort is stable, so billboards
+     * at the same depth are drawn in the world's order, which does not change with
+     * which thread ran which chunk, and they do not swap places from frame to frame.
+     */
+    ArenaVector<ChunkView> chunks = MakeFrameVector<ChunkView>();
+    world.CollectChunks(sorted, &chunks);
+    ArenaVector<size_t> chunkBegin = MakeFrameVector<size_t>(chunks.size());
+    size_t capacity{0};
+    for (const ChunkView& chunk : chunks) {
+        chunkBegin.push_back(capacity);
+        capacity += chunk.Count();
+    }
+    ArenaVector<size_t> chunkVisible = MakeFrameVector<size_t>(chunks.size());
+    chunkVisible.resize(chunks.size());
+    pass->mBillboards.resize(capacity);
+    pass->mKeys.resize(capacity);
+
+    // Depth in front of the camera is minus the view space z
+    const glm::vec4 depthRow{-view[0][2], -view[1][2], -view[2][2], -view[3][2]};
+    jobs.ParallelFor(chunks.size(), kGatherChunksPerJob, [&](size_t begin, size_t end, size_t) {
+        for (size_t chunkIndex = begin; chunkIndex < end; ++chunkIndex) {
+            const ChunkView& chunk = chunks[chunkIndex];
+            Billboard* billboards = pass->mBillboards.data() + chunkBegin[chunkIndex];
+            uint32_t* keys = pass->mKeys.data() + chunkBegin[chunkIndex];
+            const Billboard* column = chunk.Column<Billboard>();
+            size_t visible{0};
+            for (size_t i = 0; i < chunk.Count(); ++i) {
+                const Billboard& billboard = column[i];
+                if (!FrustumIntersectsSphere(frustum, billboard.mPosition, billboard.mSize * 1.4143f)) {
+                    continue;
+                }
+                const float depth = glm::dot(depthRow, glm::vec4(billboard.mPosition, 1.0f));
+                billboards[visible] = billboard;
+                keys[visible] = MakeBackToFrontKey(depth);
+                ++visible;
+            }
+            chunkVisible[chunkIndex] = visible;
+        }
+    });
+
+    // Close the gaps the culled billboards left; every slot moves toward the front
+    size_t count{0};
+    for (size_t chunkIndex = 0; chunkIndex < chunks.size(); ++chunkIndex) {
+        const size_t begin = chunkBegin[chunkIndex];
+        const size_t visible = chunkVisible[chunkIndex];
+        if (count != begin) {
+            std::copy_n(pass->mBillboards.begin() + begin, visible, pass->mBillboards.begin() + count);
+            std::copy_n(pass->mKeys.begin() + begin, visible, pass->mKeys.begin() + count);
+        }
+        count += visible;
+    }
+    pass->mBillboards.resize(count);
+    pass->mKeys.resize(count);
+    pass->mOrder.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        pass->mOrder[i] = static_cast<uint32_t>(i);
+    }
+
+    RadixSortPairs(&pass->mKeys, &pass->mOrder, kBackToFrontKeyBits, &pass->mSortScratch, &jobs);
+}
+
+/**
+ * Make room for count instances. The buffer is replaced rather than resized, with
+ * headroom so a growing particle count does not replace it every frame.
+ */
+static bool ReserveInstances(BillboardInstances* instances, GpuResources* resources, size_t count) {
+    if (count <= instances->mCapacity && !instances->mBuffer.IsNull()) { return true; }
+
+    resources->Release(instances->mBuffer);
+    const size_t capacity = std::max<size_t>(count + count / 2, 1024);
+    instances->mBuffer = resources->CreateBuffer(GL_ARRAY_BUFFER, capacity * sizeof(Billboard), nullptr,
+                                                 GL_STREAM_DRAW);
+    if (instances->mBuffer.IsNull()) {
+        instances->mCapacity = 0;
+        return false;
+    }
+    instances->mCapacity = capacity;
+
+    // Four corners from gl_VertexID, and one billboard per instance
+    glBindVertexArray(instances->mVertexArray);
+    glBindBuffer(GL_ARRAY_BUFFER, resources->Name(instances->mBuffer));
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, sizeof(Billboard), (void*)0);
+    glVertexAttribDivisor(0, 1);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Billboard), (void*)offsetof(Billboard, mColor));
+    glVertexAttribDivisor(1, 1);
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    return true;
+}
+
+/**
+ * Replace the instance data with count billboards written by write(Billboard* mapped).
+ * Invalidating lets the driver hand out fresh storage instead of waiting for the GPU
+ * to finish reading last frame's instances.
+ */
+template <class Write>
+static bool UploadInstances(BillboardInstances* instances, GpuResources* resources, size_t count, Write&& write) {
+    if (!ReserveInstances(instances, resources, count)) { return false; }
+
+    glBindBuffer(GL_ARRAY_BUFFER, resources->Name(instances->mBuffer));
+    auto* mapped = static_cast<Billboard*>(glMapBufferRange(
+        GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(count * sizeof(Billboard)),
+        GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+    if (mapped == nullptr) {
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return false;
+    }
+    {
+        PROFILE_SCOPE("WriteInstances");
+        write(mapped);
+    }
+    const bool written = glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE;
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    // The store was lost (e.g. a mode switch); skip a frame rather than draw garbage
+    return written;
+}
+
+static void DrawInstances(const BillboardInstances& instances, GLuint program, size_t count,
+                          RenderCounters* counters) {
+    glUseProgram(program);
+    BindFrameUniformBlock(program);
+    glBindVertexArray(instances.mVertexArray);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(count));
+    counters->mProgramBinds += 1;
+    counters->mVertexArrayBinds += 1;
+    counters->mDrawCalls += 1;
+    counters->mTriangles += count * 2;
+}
+
+/**
+ * Accumulate the order-independent billboards, then resolve them over the scene
+ */
+static void DrawWeightedBlended(TransparentPass* pass, GpuResources* resources, const TransparentPrograms& programs,
+                                const RenderTarget& scene, const WeightedBlendedTarget& target,
+                                RenderCounters* counters) {
+    PROFILE_FUNCTION();
+
+    const size_t count = pass->mWeightedCount;
+    if (count == 0 || programs.mWeighted == 0 || programs.mComposite == 0 || target.mFramebuffer == 0) { return; }
+
+    // No order to keep, so each thread's billboards are copied as they are
+    const bool uploaded = UploadInstances(&pass->mWeightedInstances, resources, count, [&](Billboard* mapped) {
+        for (const std::vector<Billboard>& billboards : pass->mThreadWeighted) {
+            std::memcpy(mapped, billboards.data(), billboards.size() * sizeof(Billboard));
+            mapped += billboards.size();
+        }
+    });
+    if (!uploaded) { return; }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, target.mFramebuffer);
+    constexpr GLfloat noAccumulation[]{0.0f, 0.0f, 0.0f, 0.0f};
+    constexpr GLfloat fullyRevealed[]{1.0f, 1.0f, 1.0f, 1.0f};
+    glClearBufferfv(GL_COLOR, 0, noAccumulation);
+    glClearBufferfv(GL_COLOR, 1, fullyRevealed);
+
+    // Sum the weighted colors; multiply the revealage by 1 - alpha
+    glEnable(GL_BLEND);
+    glBlendFunci(0, GL_ONE, GL_ONE);
+    glBlendFunci(1, GL_ZERO, GL_ONE_MINUS_SRC_COLOR);
+    DrawInstances(pass->mWeightedInstances, programs.mWeighted, count, counters);
+
+    // Average color over the scene, as opaque as everything in front of it together
+    glBindFramebuffer(GL_FRAMEBUFFER, scene.mFramebuffer);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDisable(GL_DEPTH_TEST);
+    glUseProgram(programs.mComposite);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, target.mAccumulation);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, target.mRevealage);
+    glUniform1i(FindUniformLocation(programs.mComposite, "u_Accumulation"), 0);
+    glUniform1i(FindUniformLocation(programs.mComposite, "u_Revealage"), 1);
+    glBindVertexArray(pass->mCompositeVertexArray);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    counters->mProgramBinds += 1;
+    counters->mDrawCalls += 1;
+    counters->mTriangles += 1;
+
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glEnable(GL_DEPTH_TEST);
+}
+
+void TransparentPassDraw(TransparentPass* pass, GpuResources* resources, const TransparentPrograms& programs,
+                         const RenderTarget& scene, const WeightedBlendedTarget& weightedTarget, JobSystem& jobs,
+                         RenderCounters* counters) {
+    PROFILE_FUNCTION();
+
+    // Test against the opaque depth, but do not write it: the billboards behind
+    // each other must all blend
+    glDepthMask(GL_FALSE);
+    glDisable(GL_CULL_FACE);
+
+    DrawWeightedBlended(pass, resources, programs, scene, weightedTarget, counters);
+
+    const size_t count = pass->mOrder.size();
+    if (count > 0 && programs.mSorted != 0) {
+        const bool uploaded = UploadInstances(&pass->mSortedInstances, resources, count, [&](Billboard* mapped) {
+            const Billboard* billboards = pass->mBillboards.data();
+            const uint32_t* order = pass->mOrder.data();
+            jobs.ParallelFor(count, kCopyInstancesPerJob, [&](size_t begin, size_t end, size_t) {
+                for (size_t i = begin; i < end; ++i) {
+                    std::memcpy(&mapped[i], &billboards[order[i]], sizeof(Billboard));
+                }
+            });
+        });
+        if (uploaded) {
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            DrawInstances(pass->mSortedInstances, programs.mSorted, count, counters);
+        }
+    }
+
+    glBindVertexArray(0);
+    glUseProgram(0);
+    glEnable(GL_CULL_FACE);
+    glDepthMask(GL_TRUE);
+    glDisable(GL_BLEND);
+}
+
+void TransparentPassDelete(GpuResources* resources, TransparentPass* pass) {
+    for (BillboardInstances* instances : {&pass->mSortedInstances, &pass->mWeightedInstances}) {
+        resources->Release(instances->mBuffer);
+        glDeleteVertexArrays(1, &instances->mVertexArray);
+    }
+    glDeleteVertexArrays(1, &pass->mCompositeVertexArray);
+    *pass = TransparentPass{};
+}
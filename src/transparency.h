@@ -0,0 +1,122 @@
+//
+// Blended billboards, drawn after the opaque scene: sorted back to front, or order-independent.
+//
+
+#ifndef TRANSPARENCY_H
+#define TRANSPARENCY_H
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "components.h"
+#include "ecs.h"
+#include "frame_stats.h"
+#include "frustum.h"
+#include "gpu_resources.h"
+#include "job_system.h"
+#include "radix_sort.h"
+#include "render_graph.h"
+#include "render_target.h"
+
+
+// Depth keys keep the top 24 bits of the float: 15 bits of mantissa, three radix passes
+constexpr int kBackToFrontKeyBits{24};
+
+/**
+ * Sort key that puts the farthest draw first. The bits of a non-negative float sort
+ * like the float, so the key is those bits, flipped so ascending order is back to front.
+ */
+inline uint32_t MakeBackToFrontKey(float viewDepth) {
+    const uint32_t bits = std::bit_cast<uint32_t>(std::max(viewDepth, 0.0f)) >> (32 - kBackToFrontKeyBits);
+    return ((1u << kBackToFrontKeyBits) - 1) - bits;
+}
+
+// A stream buffer of Billboard instance data and the vertex array that reads it
+struct BillboardInstances {
+    GLuint mVertexArray{0};
+    BufferHandle mBuffer{};
+    size_t mCapacity{0};
+};
+
+/**
+ * Targets for weighted blended order-independent transparency (McGuire and Bavoil):
+ * the weighted sum of premultiplied colors and alphas, and the product of the
+ * fragments' transparencies (the revealage). The framebuffer shares the scene's depth
+ * buffer so opaque geometry still hides what is behind it. They only live through the
+ * transparent pass, so the render graph hands them out.
+ */
+struct WeightedBlendedTarget {
+    GLuint mFramebuffer{0};
+    // RGBA16F, cleared to 0 and added to
+    GLuint mAccumulation{0};
+    // R8, cleared to 1 and multiplied by 1 - alpha
+    GLuint mRevealage{0};
+};
+
+inline RenderGraphTextureDesc WeightedBlendedAccumulationDesc(int width, int height) {
+    return RenderGraphTextureDesc{GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, 8, width, height};
+}
+
+inline RenderGraphTextureDesc WeightedBlendedRevealageDesc(int width, int height) {
+    return RenderGraphTextureDesc{GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1, width, height};
+}
+
+struct TransparentPrograms {
+    // Billboards blended in order
+    GLuint mSorted{0};
+    // Billboards accumulated into the WeightedBlendedTarget (SHADER_FEATURE_WEIGHTED_OIT)
+    GLuint mWeighted{0};
+    // Full-screen resolve of the WeightedBlendedTarget over the scene
+    GLuint mComposite{0};
+};
+
+/**
+ * Everything blended. Billboards are gathered from the world on all threads. Those
+ * without OrderIndependent are sorted back to front with a parallel radix sort and
+ * copied in that order into a stream buffer for one instanced draw; the others are
+ * copied as gathered and drawn with weighted blended OIT, which needs no sort. All
+ * storage is kept between frames, so a steady scene does not allocate.
+ */
+struct TransparentPass {
+    // The order-independent billboards each thread gathered
+    std::vector<std::vector<Billboard>> mThreadWeighted;
+    // The visible sorted billboards in chunk order, their depth keys, and the indices
+    // into them in draw order
+    std::vector<Billboard> mBillboards;
+    std::vector<uint32_t> mKeys;
+    std::vector<uint32_t> mOrder;
+    RadixSortScratch mSortScratch;
+    size_t mWeightedCount{0};
+
+    BillboardInstances mSortedInstances;
+    BillboardInstances mWeightedInstances;
+    // Binds nothing; the composite's full-screen triangle comes from gl_VertexID
+    GLuint mCompositeVertexArray{0};
+};
+
+bool TransparentPassCreate(TransparentPass* pass);
+/**
+ * Cull the billboards of both queries against the frustum, and sort the visible ones
+ * of the first back to front by their depth along the view matrix's forward axis.
+ */
+void TransparentPassGather(TransparentPass* pass, World& world, Query& sorted, Query& orderIndependent,
+                           const glm::mat4& view, const Frustum& frustum, JobSystem& jobs);
+/**
+ * Draw what was gathered over scene, which must be bound: the order-independent
+ * billboards first, into weightedTarget and composited in one full-screen pass, then
+ * the sorted ones on top. Both are depth tested against the scene without writing
+ * depth. weightedTarget is only touched when mWeightedCount is not 0. FrameUniforms
+ * must have been uploaded. Leaves blending off and depth writes on.
+ */
+void TransparentPassDraw(TransparentPass* pass, GpuResources* resources, const TransparentPrograms& programs,
+                         const RenderTarget& scene, const WeightedBlendedTarget& weightedTarget, JobSystem& jobs,
+                         RenderCounters* counters);
+void TransparentPassDelete(GpuResources* resources, TransparentPass* pass);
+
+
+#endif //TRANSPARENCY_H